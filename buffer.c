@@ -68,6 +68,15 @@
 #ifdef EVENT__HAVE_SYS_STAT_H
 #include <sys/stat.h>
 #endif
+#ifdef EVENT__HAVE_NETINET_IN_H
+#include <netinet/in.h>
+#endif
+#ifdef EVENT__HAVE_LINUX_ERRQUEUE_H
+#include <linux/errqueue.h>
+#endif
+#ifdef EVENT__HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
 
 
 #include <errno.h>
@@ -117,6 +126,12 @@
 #define SENDFILE_IS_SOLARIS	1
 #endif
 
+/* zero-copy send support */
+#if defined(EVENT__HAVE_LINUX_ERRQUEUE_H) && defined(EVENT__HAVE_SYS_UIO_H) && \
+    defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#define USE_ZEROCOPY		1
+#endif
+
 /* Mask of user-selectable callback flags. */
 #define EVBUFFER_CB_USER_FLAGS	    0xffff
 /* Mask of all internal-use-only flags. */
@@ -152,6 +167,9 @@ static int evbuffer_ptr_subtract(struct evbuffer *buf, struct evbuffer_ptr *pos,
     size_t howfar);
 static int evbuffer_file_segment_materialize(struct evbuffer_file_segment *seg);
 static inline void evbuffer_chain_incref(struct evbuffer_chain *chain);
+#ifdef USE_ZEROCOPY
+static void evbuffer_zerocopy_orphan(struct evbuffer_zerocopy *zc);
+#endif
 
 static struct evbuffer_chain *
 evbuffer_chain_new(size_t size)
@@ -192,6 +210,450 @@ evbuffer_chain_new(size_t size)
 	return (chain);
 }
 
+/* Chains allocated from a pool come in MIN_BUFFER_SIZE << 0 through
+ * MIN_BUFFER_SIZE << (EVBUFFER_POOL_N_CLASSES-1) byte allocations; larger
+ * ones are always malloc()ed. */
+#define EVBUFFER_POOL_N_CLASSES 7
+#define EVBUFFER_POOL_MAX_ALLOC (MIN_BUFFER_SIZE << (EVBUFFER_POOL_N_CLASSES-1))
+/* Space taken at the start of a pooled allocation before the data. */
+#define EVBUFFER_POOL_OVERHEAD \
+	(sizeof(struct evbuffer_pooled_chain) + EVBUFFER_CHAIN_SIZE)
+
+/** A cache of freed evbuffer chains, kept by size class. */
+struct evbuffer_chain_pool {
+	/** Protects every other field. */
+	void *lock;
+	/** One reference for the event_base that created the pool, one for
+	 * each evbuffer that allocates from it, and one for each chain that
+	 * is currently allocated from it. */
+	int refcnt;
+	/** The most bytes we'll cache in any single size class. */
+	size_t max_cached;
+	/** Singly-linked lists of free chains, linked through 'next'. */
+	struct evbuffer_chain *free_chains[EVBUFFER_POOL_N_CLASSES];
+	/** The number of chains on each of the free_chains lists. */
+	size_t n_free[EVBUFFER_POOL_N_CLASSES];
+	/** Allocations that were satisfied from the cache. */
+	ev_uint64_t hits;
+	/** Allocations that had to go to mm_malloc(). */
+	ev_uint64_t misses;
+};
+
+/** Lives just before an evbuffer_chain with the EVBUFFER_POOLED flag set. */
+struct evbuffer_pooled_chain {
+	struct evbuffer_chain_pool *pool;
+	/* Keep the chain that follows suitably aligned. */
+	size_t unused;
+};
+
+static int
+evbuffer_chain_pool_class(size_t to_alloc)
+{
+	int cls = 0;
+	size_t sz = MIN_BUFFER_SIZE;
+	while (sz < to_alloc) {
+		sz <<= 1;
+		++cls;
+	}
+	return cls;
+}
+
+struct evbuffer_chain_pool *
+evbuffer_chain_pool_new_(size_t max_cached)
+{
+	struct evbuffer_chain_pool *pool;
+
+	if ((pool = mm_calloc(1, sizeof(*pool))) == NULL)
+		return NULL;
+	EVTHREAD_ALLOC_LOCK(pool->lock, 0);
+	pool->refcnt = 1;
+	pool->max_cached = max_cached;
+	return pool;
+}
+
+static void
+evbuffer_chain_pool_decref_and_unlock(struct evbuffer_chain_pool *pool)
+{
+	struct evbuffer_chain *chain, *next;
+	int i;
+
+	EVUTIL_ASSERT(pool->refcnt > 0);
+	if (--pool->refcnt > 0) {
+		EVLOCK_UNLOCK(pool->lock, 0);
+		return;
+	}
+
+	for (i = 0; i < EVBUFFER_POOL_N_CLASSES; ++i) {
+		for (chain = pool->free_chains[i]; chain; chain = next) {
+			next = chain->next;
+			mm_free((struct evbuffer_pooled_chain *)chain - 1);
+		}
+	}
+	EVLOCK_UNLOCK(pool->lock, 0);
+	EVTHREAD_FREE_LOCK(pool->lock, 0);
+	mm_free(pool);
+}
+
+void
+evbuffer_chain_pool_decref_(struct evbuffer_chain_pool *pool)
+{
+	EVLOCK_LOCK(pool->lock, 0);
+	evbuffer_chain_pool_decref_and_unlock(pool);
+}
+
+#define EVBUFFER_ARENA_ALIGN(p) ((unsigned char *)			\
+	(((ev_uintptr_t)(p) + EVBUFFER_ARENA_ALIGNMENT - 1) &		\
+	    ~(ev_uintptr_t)(EVBUFFER_ARENA_ALIGNMENT - 1)))
+/* Space taken at the start of an arena chain before the data. */
+#define EVBUFFER_ARENA_OVERHEAD \
+	(sizeof(struct evbuffer_arena_chain) + EVBUFFER_CHAIN_SIZE)
+/* Once an arena has handed out this many blocks' worth, new chains come
+ * from the allocator instead, so that a buffer which lives longer than
+ * expected can't make its arena grow without bound. */
+#define EVBUFFER_ARENA_CHAIN_BLOCKS 16
+
+/** A block of memory that an arena got from mm_malloc() after its first
+ * one.  The data follows it. */
+struct evbuffer_arena_block {
+	struct evbuffer_arena_block *next;
+	size_t size;
+};
+
+struct evbuffer_arena {
+	/** Protects every other field. */
+	void *lock;
+	/** One reference for the owner, one for each evbuffer that allocates
+	 * from the arena, and one for each chain that is currently allocated
+	 * from it. */
+	int refcnt;
+	/** The size of each ordinary block. */
+	size_t block_size;
+	/** Blocks allocated since the arena was created or reset, newest
+	 * first.  The first block follows the arena itself and isn't on this
+	 * list. */
+	struct evbuffer_arena_block *blocks;
+	/** The free part of the current block. */
+	unsigned char *pos, *end;
+	/** Chains that were freed, to be handed out again, linked through
+	 * 'next'.  A chain is on the list of the largest of the chain pool's
+	 * size classes that it can hold in full. */
+	struct evbuffer_chain *free_chains[EVBUFFER_POOL_N_CLASSES];
+	/** Statistics for evbuffer_arena_get_stats(). */
+	size_t n_blocks;
+	size_t used;
+};
+
+/** Lives just before an evbuffer_chain with the EVBUFFER_ARENA flag set. */
+struct evbuffer_arena_chain {
+	struct evbuffer_arena *arena;
+	/** The number of bytes taken from the arena, this included. */
+	size_t size;
+};
+
+struct evbuffer_arena *
+evbuffer_arena_new(size_t block_size)
+{
+	struct evbuffer_arena *arena;
+
+	if (!block_size)
+		block_size = EVBUFFER_ARENA_DEFAULT_BLOCK;
+	if (block_size > EVBUFFER_CHAIN_MAX - sizeof(*arena) -
+	    EVBUFFER_ARENA_ALIGNMENT)
+		return NULL;
+	/* The first block follows the arena, so leave room to align it:
+	 * callers that size the arena to fit exactly count on that. */
+	if ((arena = mm_malloc(sizeof(*arena) + EVBUFFER_ARENA_ALIGNMENT - 1 +
+		    block_size)) == NULL)
+		return NULL;
+	memset(arena, 0, sizeof(*arena));
+	EVTHREAD_ALLOC_LOCK(arena->lock, 0);
+	arena->refcnt = 1;
+	arena->block_size = block_size;
+	arena->pos = EVBUFFER_ARENA_ALIGN(arena + 1);
+	arena->end = arena->pos + block_size;
+	arena->n_blocks = 1;
+	return arena;
+}
+
+/** Release every block of 'arena' but the first, and start over at the
+ * beginning of that one. */
+static void
+evbuffer_arena_rewind(struct evbuffer_arena *arena)
+{
+	struct evbuffer_arena_block *block, *next;
+
+	for (block = arena->blocks; block; block = next) {
+		next = block->next;
+		mm_free(block);
+	}
+	arena->blocks = NULL;
+	arena->pos = EVBUFFER_ARENA_ALIGN(arena + 1);
+	arena->end = arena->pos + arena->block_size;
+	memset(arena->free_chains, 0, sizeof(arena->free_chains));
+	arena->n_blocks = 1;
+	arena->used = 0;
+}
+
+static void
+evbuffer_arena_decref_and_unlock(struct evbuffer_arena *arena)
+{
+	EVUTIL_ASSERT(arena->refcnt > 0);
+	if (--arena->refcnt > 0) {
+		EVLOCK_UNLOCK(arena->lock, 0);
+		return;
+	}
+
+	evbuffer_arena_rewind(arena);
+	EVLOCK_UNLOCK(arena->lock, 0);
+	EVTHREAD_FREE_LOCK(arena->lock, 0);
+	mm_free(arena);
+}
+
+static void
+evbuffer_arena_decref(struct evbuffer_arena *arena)
+{
+	EVLOCK_LOCK(arena->lock, 0);
+	evbuffer_arena_decref_and_unlock(arena);
+}
+
+/** Take 'size' bytes from 'arena', starting a new block if the current one
+ * is too full.  Something too big to share a block gets one of its own,
+ * and the current block stays current. */
+static void *
+evbuffer_arena_alloc_locked(struct evbuffer_arena *arena, size_t size)
+{
+	struct evbuffer_arena_block *block;
+	unsigned char *p = EVBUFFER_ARENA_ALIGN(arena->pos);
+	size_t block_size = arena->block_size;
+
+	if (p <= arena->end && size <= (size_t)(arena->end - p)) {
+		arena->pos = p + size;
+		arena->used += size;
+		return p;
+	}
+
+	if (size > block_size / 2)
+		block_size = size;
+	if (block_size > EVBUFFER_CHAIN_MAX - sizeof(*block) -
+	    EVBUFFER_ARENA_ALIGNMENT)
+		return NULL;
+	block = mm_malloc(sizeof(*block) + block_size +
+	    EVBUFFER_ARENA_ALIGNMENT);
+	if (block == NULL)
+		return NULL;
+	block->size = block_size;
+	block->next = arena->blocks;
+	arena->blocks = block;
+	++arena->n_blocks;
+	arena->used += size;
+
+	p = EVBUFFER_ARENA_ALIGN(block + 1);
+	if (block_size == arena->block_size) {
+		arena->pos = p + size;
+		arena->end = p + block_size;
+	}
+	return p;
+}
+
+void *
+evbuffer_arena_alloc(struct evbuffer_arena *arena, size_t size)
+{
+	void *p;
+
+	EVLOCK_LOCK(arena->lock, 0);
+	p = evbuffer_arena_alloc_locked(arena, size);
+	EVLOCK_UNLOCK(arena->lock, 0);
+	return p;
+}
+
+int
+evbuffer_arena_reset(struct evbuffer_arena *arena)
+{
+	int r = -1;
+
+	EVLOCK_LOCK(arena->lock, 0);
+	if (arena->refcnt == 1) {
+		evbuffer_arena_rewind(arena);
+		r = 0;
+	}
+	EVLOCK_UNLOCK(arena->lock, 0);
+	return r;
+}
+
+void
+evbuffer_arena_free(struct evbuffer_arena *arena)
+{
+	evbuffer_arena_decref(arena);
+}
+
+void
+evbuffer_arena_get_stats(struct evbuffer_arena *arena,
+    size_t *n_blocks, size_t *used)
+{
+	EVLOCK_LOCK(arena->lock, 0);
+	if (n_blocks)
+		*n_blocks = arena->n_blocks;
+	if (used)
+		*used = arena->used;
+	EVLOCK_UNLOCK(arena->lock, 0);
+}
+
+/** Take a freed chain of at least 'to_alloc' bytes off the free lists of
+ * 'arena', or return NULL if there is none. */
+static struct evbuffer_arena_chain *
+evbuffer_arena_chain_reuse_locked(struct evbuffer_arena *arena,
+    size_t to_alloc)
+{
+	struct evbuffer_chain **cp, *chain;
+	int cls = evbuffer_chain_pool_class(to_alloc);
+
+	/* Everything on the list of this class is big enough; only some of
+	 * what is on the list below it may be. */
+	cp = &arena->free_chains[cls];
+	if (*cp == NULL && cls > 0) {
+		for (cp = &arena->free_chains[cls - 1]; *cp; cp = &(*cp)->next) {
+			if (((struct evbuffer_arena_chain *)*cp - 1)->size >=
+			    to_alloc)
+				break;
+		}
+	}
+	if ((chain = *cp) == NULL)
+		return NULL;
+	*cp = chain->next;
+	return (struct evbuffer_arena_chain *)chain - 1;
+}
+
+/** Get a chain that can hold at least 'size' bytes of data from 'arena',
+ * reusing a freed one if it can.  Return NULL if the chain is too big for
+ * an arena, if the arena has handed out as much as it should, or on
+ * failure. */
+static struct evbuffer_chain *
+evbuffer_arena_chain_new(struct evbuffer_arena *arena, size_t size)
+{
+	struct evbuffer_arena_chain *hdr;
+	struct evbuffer_chain *chain;
+	size_t to_alloc;
+
+	if (size > EVBUFFER_POOL_MAX_ALLOC - EVBUFFER_ARENA_OVERHEAD)
+		return NULL;
+	to_alloc = EVBUFFER_ARENA_ROUNDUP(size + EVBUFFER_ARENA_OVERHEAD);
+	if (to_alloc < MIN_BUFFER_SIZE)
+		to_alloc = MIN_BUFFER_SIZE;
+
+	EVLOCK_LOCK(arena->lock, 0);
+	hdr = evbuffer_arena_chain_reuse_locked(arena, to_alloc);
+	if (hdr == NULL &&
+	    arena->used / EVBUFFER_ARENA_CHAIN_BLOCKS < arena->block_size &&
+	    (hdr = evbuffer_arena_alloc_locked(arena, to_alloc)) != NULL) {
+		hdr->arena = arena;
+		hdr->size = to_alloc;
+	}
+	if (hdr)
+		++arena->refcnt;
+	EVLOCK_UNLOCK(arena->lock, 0);
+	if (hdr == NULL)
+		return NULL;
+
+	chain = (struct evbuffer_chain *)(hdr + 1);
+	memset(chain, 0, EVBUFFER_CHAIN_SIZE);
+	chain->buffer_len = hdr->size - EVBUFFER_ARENA_OVERHEAD;
+	chain->buffer = EVBUFFER_CHAIN_EXTRA(unsigned char, chain);
+	chain->flags = EVBUFFER_ARENA;
+	chain->refcnt = 1;
+
+	return (chain);
+}
+
+/** Give a chain back to the arena it came from, for reuse. */
+static void
+evbuffer_arena_chain_put(struct evbuffer_chain *chain)
+{
+	struct evbuffer_arena_chain *hdr =
+	    (struct evbuffer_arena_chain *)chain - 1;
+	struct evbuffer_arena *arena = hdr->arena;
+	int cls = evbuffer_chain_pool_class(hdr->size);
+
+	if (((size_t)MIN_BUFFER_SIZE << cls) > hdr->size)
+		--cls;
+	EVLOCK_LOCK(arena->lock, 0);
+	chain->next = arena->free_chains[cls];
+	arena->free_chains[cls] = chain;
+	evbuffer_arena_decref_and_unlock(arena);
+}
+
+/** Allocate a chain that can hold at least 'size' bytes of data for 'buf',
+ * taking it from the arena or chain pool of 'buf' if it has one. */
+static struct evbuffer_chain *
+evbuffer_chain_new_membuf(struct evbuffer *buf, size_t size)
+{
+	struct evbuffer_chain_pool *pool = buf->chain_pool;
+	struct evbuffer_pooled_chain *hdr;
+	struct evbuffer_chain *chain;
+	size_t to_alloc;
+	int cls;
+
+	if (buf->arena &&
+	    (chain = evbuffer_arena_chain_new(buf->arena, size)) != NULL)
+		return (chain);
+
+	if (!pool || size > EVBUFFER_POOL_MAX_ALLOC - EVBUFFER_POOL_OVERHEAD)
+		return evbuffer_chain_new(size);
+
+	cls = evbuffer_chain_pool_class(size + EVBUFFER_POOL_OVERHEAD);
+	to_alloc = (size_t)MIN_BUFFER_SIZE << cls;
+
+	EVLOCK_LOCK(pool->lock, 0);
+	if ((chain = pool->free_chains[cls]) != NULL) {
+		pool->free_chains[cls] = chain->next;
+		--pool->n_free[cls];
+		++pool->hits;
+	} else {
+		++pool->misses;
+	}
+	++pool->refcnt;
+	EVLOCK_UNLOCK(pool->lock, 0);
+
+	if (chain == NULL) {
+		if ((hdr = mm_malloc(to_alloc)) == NULL) {
+			evbuffer_chain_pool_decref_(pool);
+			return (NULL);
+		}
+		hdr->pool = pool;
+		chain = (struct evbuffer_chain *)(hdr + 1);
+	}
+
+	memset(chain, 0, EVBUFFER_CHAIN_SIZE);
+	chain->buffer_len = to_alloc - EVBUFFER_POOL_OVERHEAD;
+	chain->buffer = EVBUFFER_CHAIN_EXTRA(unsigned char, chain);
+	chain->flags = EVBUFFER_POOLED;
+	chain->refcnt = 1;
+
+	return (chain);
+}
+
+/** Give the memory of a chain back to its pool, or to the allocator if the
+ * pool already holds as much as it's allowed to. */
+static void
+evbuffer_chain_pool_put(struct evbuffer_chain *chain)
+{
+	struct evbuffer_pooled_chain *hdr =
+	    (struct evbuffer_pooled_chain *)chain - 1;
+	struct evbuffer_chain_pool *pool = hdr->pool;
+	size_t to_alloc = chain->buffer_len + EVBUFFER_POOL_OVERHEAD;
+	int cls = evbuffer_chain_pool_class(to_alloc);
+
+	EVLOCK_LOCK(pool->lock, 0);
+	if ((pool->n_free[cls] + 1) * to_alloc <= pool->max_cached) {
+		chain->next = pool->free_chains[cls];
+		pool->free_chains[cls] = chain;
+		++pool->n_free[cls];
+		hdr = NULL;
+	}
+	evbuffer_chain_pool_decref_and_unlock(pool);
+	if (hdr)
+		mm_free(hdr);
+}
+
 static inline void
 evbuffer_chain_free(struct evbuffer_chain *chain)
 {
@@ -249,7 +711,12 @@ evbuffer_chain_free(struct evbuffer_chain *chain)
 		evbuffer_decref_and_unlock_(info->source);
 	}
 
-	mm_free(chain);
+	if (chain->flags & EVBUFFER_POOLED)
+		evbuffer_chain_pool_put(chain);
+	else if (chain->flags & EVBUFFER_ARENA)
+		evbuffer_arena_chain_put(chain);
+	else
+		mm_free(chain);
 }
 
 static void
@@ -330,7 +797,7 @@ static inline struct evbuffer_chain *
 evbuffer_chain_insert_new(struct evbuffer *buf, size_t datlen)
 {
 	struct evbuffer_chain *chain;
-	if ((chain = evbuffer_chain_new(datlen)) == NULL)
+	if ((chain = evbuffer_chain_new_membuf(buf, datlen)) == NULL)
 		return NULL;
 	evbuffer_chain_insert(buf, chain);
 	return chain;
@@ -374,6 +841,28 @@ evbuffer_new(void)
 	return (buffer);
 }
 
+struct evbuffer *
+evbuffer_new_arena(struct evbuffer_arena *arena)
+{
+	struct evbuffer *buffer;
+
+	EVLOCK_LOCK(arena->lock, 0);
+	buffer = evbuffer_arena_alloc_locked(arena, sizeof(struct evbuffer));
+	if (buffer)
+		++arena->refcnt;
+	EVLOCK_UNLOCK(arena->lock, 0);
+	if (buffer == NULL)
+		return (NULL);
+
+	memset(buffer, 0, sizeof(struct evbuffer));
+	LIST_INIT(&buffer->callbacks);
+	buffer->refcnt = 1;
+	buffer->last_with_datap = &buffer->first;
+	buffer->arena = arena;
+
+	return (buffer);
+}
+
 int
 evbuffer_set_flags(struct evbuffer *buf, ev_uint64_t flags)
 {
@@ -420,6 +909,48 @@ evbuffer_defer_callbacks(struct evbuffer *buffer, struct event_base *base)
 	return 0;
 }
 
+int
+evbuffer_use_chain_pool(struct evbuffer *buffer, struct event_base *base)
+{
+	struct evbuffer_chain_pool *pool = base ? base->chain_pool : NULL;
+
+	if (pool) {
+		EVLOCK_LOCK(pool->lock, 0);
+		++pool->refcnt;
+		EVLOCK_UNLOCK(pool->lock, 0);
+	}
+	EVBUFFER_LOCK(buffer);
+	if (buffer->chain_pool)
+		evbuffer_chain_pool_decref_(buffer->chain_pool);
+	buffer->chain_pool = pool;
+	EVBUFFER_UNLOCK(buffer);
+	return (base && !pool) ? -1 : 0;
+}
+
+int
+event_base_get_chain_pool_stats(struct event_base *base,
+    ev_uint64_t *hits, ev_uint64_t *misses, size_t *cached_bytes)
+{
+	struct evbuffer_chain_pool *pool = base->chain_pool;
+	int i;
+
+	if (!pool)
+		return -1;
+	EVLOCK_LOCK(pool->lock, 0);
+	if (hits)
+		*hits = pool->hits;
+	if (misses)
+		*misses = pool->misses;
+	if (cached_bytes) {
+		*cached_bytes = 0;
+		for (i = 0; i < EVBUFFER_POOL_N_CLASSES; ++i)
+			*cached_bytes +=
+			    pool->n_free[i] * ((size_t)MIN_BUFFER_SIZE << i);
+	}
+	EVLOCK_UNLOCK(pool->lock, 0);
+	return 0;
+}
+
 int
 evbuffer_enable_locking(struct evbuffer *buf, void *lock)
 {
@@ -561,6 +1092,7 @@ void
 evbuffer_decref_and_unlock_(struct evbuffer *buffer)
 {
 	struct evbuffer_chain *chain, *next;
+	struct evbuffer_arena *arena;
 	ASSERT_EVBUFFER_LOCKED(buffer);
 
 	EVUTIL_ASSERT(buffer->refcnt > 0);
@@ -574,14 +1106,24 @@ evbuffer_decref_and_unlock_(struct evbuffer *buffer)
 		next = chain->next;
 		evbuffer_chain_free(chain);
 	}
+#ifdef USE_ZEROCOPY
+	if (buffer->zerocopy)
+		evbuffer_zerocopy_orphan(buffer->zerocopy);
+#endif
 	evbuffer_remove_all_callbacks(buffer);
 	if (buffer->deferred_cbs)
 		event_deferred_cb_cancel_(buffer->cb_queue, &buffer->deferred);
+	if (buffer->chain_pool)
+		evbuffer_chain_pool_decref_(buffer->chain_pool);
 
 	EVBUFFER_UNLOCK(buffer);
 	if (buffer->own_lock)
 		EVTHREAD_FREE_LOCK(buffer->lock, EVTHREAD_LOCKTYPE_RECURSIVE);
-	mm_free(buffer);
+	if ((arena = buffer->arena) == NULL)
+		mm_free(buffer);
+	/* Only now may the arena go, since the buffer might live in it. */
+	if (arena)
+		evbuffer_arena_decref(arena);
 }
 
 void
@@ -836,7 +1378,7 @@ PRESERVE_PINNED(struct evbuffer *src, struct evbuffer_chain **first,
 		struct evbuffer_chain *tmp;
 
 		EVUTIL_ASSERT(pinned == src->last_with_datap);
-		tmp = evbuffer_chain_new(chain->off);
+		tmp = evbuffer_chain_new_membuf(src, chain->off);
 		if (!tmp)
 			return -1;
 		memcpy(tmp->buffer, chain->buffer + chain->misalign,
@@ -1405,7 +1947,7 @@ evbuffer_pullup(struct evbuffer *buf, ev_ssize_t size)
 		size -= old_off;
 		chain = chain->next;
 	} else {
-		if ((tmp = evbuffer_chain_new(size)) == NULL) {
+		if ((tmp = evbuffer_chain_new_membuf(buf, size)) == NULL) {
 			event_warn("%s: out of memory", __func__);
 			goto done;
 		}
@@ -1751,7 +2293,7 @@ evbuffer_add(struct evbuffer *buf, const void *data_in, size_t datlen)
 	/* If there are no chains allocated for this buffer, allocate one
 	 * big enough to hold all the data. */
 	if (chain == NULL) {
-		chain = evbuffer_chain_new(datlen);
+		chain = evbuffer_chain_new_membuf(buf, datlen);
 		if (!chain)
 			goto done;
 		evbuffer_chain_insert(buf, chain);
@@ -1793,7 +2335,7 @@ evbuffer_add(struct evbuffer *buf, const void *data_in, size_t datlen)
 		to_alloc <<= 1;
 	if (datlen > to_alloc)
 		to_alloc = datlen;
-	tmp = evbuffer_chain_new(to_alloc);
+	tmp = evbuffer_chain_new_membuf(buf, to_alloc);
 	if (tmp == NULL)
 		goto done;
 
@@ -1843,14 +2385,15 @@ evbuffer_prepend(struct evbuffer *buf, const void *data, size_t datlen)
 	chain = buf->first;
 
 	if (chain == NULL) {
-		chain = evbuffer_chain_new(datlen);
+		chain = evbuffer_chain_new_membuf(buf, datlen);
 		if (!chain)
 			goto done;
 		evbuffer_chain_insert(buf, chain);
 	}
 
-	/* we cannot touch immutable buffers */
-	if ((chain->flags & EVBUFFER_IMMUTABLE) == 0) {
+	/* we cannot touch immutable buffers, nor the space in front of a
+	 * chain that a zero-copy send may still be reading */
+	if ((chain->flags & (EVBUFFER_IMMUTABLE|EVBUFFER_MEM_PINNED_W)) == 0) {
 		/* Always true for mutable buffers */
 		EVUTIL_ASSERT(chain->misalign >= 0 &&
 		    (ev_uint64_t)chain->misalign <= EVBUFFER_CHAIN_MAX);
@@ -1883,7 +2426,7 @@ evbuffer_prepend(struct evbuffer *buf, const void *data, size_t datlen)
 	}
 
 	/* we need to add another chain */
-	if ((tmp = evbuffer_chain_new(datlen)) == NULL)
+	if ((tmp = evbuffer_chain_new_membuf(buf, datlen)) == NULL)
 		goto done;
 	buf->first = tmp;
 	if (buf->last_with_datap == &buf->first && chain->off)
@@ -2012,7 +2555,7 @@ evbuffer_expand_singlechain(struct evbuffer *buf, size_t datlen)
 		 * MAX_TO_COPY_IN_EXPAND bytes. */
 		/* figure out how much space we need */
 		size_t length = chain->off + datlen;
-		struct evbuffer_chain *tmp = evbuffer_chain_new(length);
+		struct evbuffer_chain *tmp = evbuffer_chain_new_membuf(buf, length);
 		if (tmp == NULL)
 			goto err;
 
@@ -2058,7 +2601,7 @@ evbuffer_expand_fast_(struct evbuffer *buf, size_t datlen, int n)
 	if (chain == NULL || (chain->flags & EVBUFFER_IMMUTABLE)) {
 		/* There is no last chunk, or we can't touch the last chunk.
 		 * Just add a new chunk. */
-		chain = evbuffer_chain_new(datlen);
+		chain = evbuffer_chain_new_membuf(buf, datlen);
 		if (chain == NULL)
 			return (-1);
 
@@ -2101,7 +2644,7 @@ evbuffer_expand_fast_(struct evbuffer *buf, size_t datlen, int n)
 		 * chains; we can add another. */
 		EVUTIL_ASSERT(chain == NULL);
 
-		tmp = evbuffer_chain_new(datlen - avail);
+		tmp = evbuffer_chain_new_membuf(buf, datlen - avail);
 		if (tmp == NULL)
 			return (-1);
 
@@ -2133,7 +2676,7 @@ evbuffer_expand_fast_(struct evbuffer *buf, size_t datlen, int n)
 			evbuffer_chain_free(chain);
 		}
 		EVUTIL_ASSERT(datlen >= avail);
-		tmp = evbuffer_chain_new(datlen - avail);
+		tmp = evbuffer_chain_new_membuf(buf, datlen - avail);
 		if (tmp == NULL) {
 			if (rmv_all) {
 				ZERO_CHAIN(buf);
@@ -2409,6 +2952,128 @@ done:
 	return result;
 }
 
+int
+evbuffer_pin_read_space_(struct evbuffer *buf, size_t howmuch,
+    struct evbuffer_iovec *vecs, int n_vecs)
+{
+	struct evbuffer_chain **chainp, *chain;
+	int i, nvecs = -1;
+
+	EVBUFFER_LOCK(buf);
+	if (buf->freeze_end)
+		goto done;
+	if (evbuffer_expand_fast_(buf, howmuch, n_vecs) == -1)
+		goto done;
+
+	nvecs = evbuffer_read_setup_vecs_(buf, howmuch, vecs, n_vecs,
+	    &chainp, 1);
+	for (i = 0, chain = *chainp; i < nvecs; ++i, chain = chain->next) {
+		EVUTIL_ASSERT(chain);
+		evbuffer_chain_pin_(chain, EVBUFFER_MEM_PINNED_R);
+	}
+	evbuffer_freeze(buf, 0);
+done:
+	EVBUFFER_UNLOCK(buf);
+	return nvecs;
+}
+
+void
+evbuffer_commit_pinned_read_(struct evbuffer *buf,
+    const struct evbuffer_iovec *vecs, int n_vecs, size_t nbytes)
+{
+	struct evbuffer_chain **chainp, *chain, *next;
+	size_t remaining, len;
+	int i;
+
+	EVBUFFER_LOCK(buf);
+	evbuffer_unfreeze(buf, 0);
+
+	/* Someone may have drained the buffer while the read was in flight,
+	 * but the chains we pinned are still where we left them: right after
+	 * the last chain with data, or at it if it had space left. */
+	chainp = buf->last_with_datap;
+	if (!((*chainp)->flags & EVBUFFER_MEM_PINNED_R))
+		chainp = &(*chainp)->next;
+	chain = *chainp;
+
+	remaining = nbytes;
+	for (i = 0; remaining > 0 && i < n_vecs; ++i) {
+		EVUTIL_ASSERT(*chainp);
+		len = vecs[i].iov_len;
+		if (remaining < len)
+			len = remaining;
+		(*chainp)->off += len;
+		buf->last_with_datap = chainp;
+		remaining -= len;
+		chainp = &(*chainp)->next;
+	}
+
+	for (i = 0; i < n_vecs; ++i) {
+		EVUTIL_ASSERT(chain);
+		next = chain->next;
+		evbuffer_chain_unpin_(chain, EVBUFFER_MEM_PINNED_R);
+		chain = next;
+	}
+
+	buf->total_len += nbytes;
+	buf->n_add_for_cb += nbytes;
+
+	evbuffer_invoke_callbacks_(buf);
+	EVBUFFER_UNLOCK(buf);
+}
+
+int
+evbuffer_pin_write_vecs_(struct evbuffer *buf, ev_ssize_t at_most,
+    struct evbuffer_iovec *vecs, int n_vecs)
+{
+	struct evbuffer_chain *chain;
+	int i = -1;
+
+	EVBUFFER_LOCK(buf);
+	if (buf->freeze_start)
+		goto done;
+	if (at_most < 0 || (size_t)at_most > buf->total_len)
+		at_most = buf->total_len;
+
+	for (i = 0, chain = buf->first; chain && i < n_vecs && at_most > 0;
+	     ++i, chain = chain->next) {
+		size_t len = chain->off;
+		/* File segments that we'd have to sendfile() can't be
+		 * written from memory. */
+		if (chain->flags & EVBUFFER_SENDFILE)
+			break;
+		if ((size_t)at_most < len)
+			len = at_most;
+		vecs[i].iov_base = (void *)(chain->buffer + chain->misalign);
+		vecs[i].iov_len = len;
+		at_most -= len;
+		evbuffer_chain_pin_(chain, EVBUFFER_MEM_PINNED_W);
+	}
+	if (i)
+		evbuffer_freeze(buf, 1);
+done:
+	EVBUFFER_UNLOCK(buf);
+	return i;
+}
+
+void
+evbuffer_commit_pinned_write_(struct evbuffer *buf, int n_vecs,
+    size_t nbytes)
+{
+	struct evbuffer_chain *chain, *next;
+	int i;
+
+	EVBUFFER_LOCK(buf);
+	evbuffer_unfreeze(buf, 1);
+	for (i = 0, chain = buf->first; i < n_vecs; ++i, chain = next) {
+		EVUTIL_ASSERT(chain);
+		next = chain->next;
+		evbuffer_chain_unpin_(chain, EVBUFFER_MEM_PINNED_W);
+	}
+	evbuffer_drain(buf, nbytes);
+	EVBUFFER_UNLOCK(buf);
+}
+
 #ifdef USE_IOVEC_IMPL
 static inline int
 evbuffer_write_iovec(struct evbuffer *buffer, evutil_socket_t fd,
@@ -2461,6 +3126,361 @@ evbuffer_write_iovec(struct evbuffer *buffer, evutil_socket_t fd,
 }
 #endif
 
+#ifdef USE_ZEROCOPY
+/** One sendmsg(MSG_ZEROCOPY) whose memory the kernel may still be reading. */
+struct evbuffer_zerocopy_send {
+	TAILQ_ENTRY(evbuffer_zerocopy_send) next;
+	/** The number the kernel gave this send in its completions. */
+	ev_uint32_t id;
+	/** True once the kernel has told us it is done with this send. */
+	int done;
+	/** The chains this send pinned.  An entry is NULL if a later send
+	 * pinned the same chain and took it over. */
+	int n_chains;
+	struct evbuffer_chain *chains[1];
+};
+
+struct evbuffer_zerocopy {
+	/** Writes smaller than this are copied; 0 means we copy them all. */
+	size_t threshold;
+	/** The number the kernel will give our next send. */
+	ev_uint32_t next_id;
+	/** Sends that are still pinning chains, oldest first. */
+	TAILQ_HEAD(evbuffer_zerocopy_sendq, evbuffer_zerocopy_send) sends;
+	int n_sends;
+	/** Our own duplicate of the socket we send on, or -1.  It lets us
+	 * hear about the sends in flight after the socket is closed or
+	 * replaced. */
+	evutil_socket_t fd;
+	/** An edge-triggered EV_READ event on 'fd'.  Completions make the
+	 * socket report an error, so this wakes us to reap them whether or
+	 * not the owner is reading or writing. */
+	struct event *reaper;
+	/** The buffer we send from, or NULL once its owner has gone away and
+	 * we are only finishing the sends in flight. */
+	struct evbuffer *buffer;
+	/** True iff 'fd' is a socket the buffer no longer sends on. */
+	int retired;
+};
+
+/** Once the buffer's owner is gone, how long we wait to hear from the
+ * kernel before we give back the memory of the sends in flight anyway. */
+static const struct timeval evbuffer_zerocopy_linger = { 30, 0 };
+
+/* Unpin the chains of 'send' and free it. */
+static void
+evbuffer_zerocopy_send_free(struct evbuffer_zerocopy_send *send)
+{
+	int i;
+	for (i = 0; i < send->n_chains; ++i) {
+		if (send->chains[i])
+			evbuffer_chain_unpin_(send->chains[i],
+			    EVBUFFER_MEM_PINNED_W);
+	}
+	mm_free(send);
+}
+
+/* Read every completion waiting on the error queue of our socket, and
+ * release the sends the kernel is done with.  Returns the number still in
+ * flight. */
+static int
+evbuffer_zerocopy_reap(struct evbuffer_zerocopy *zc)
+{
+	struct evbuffer_zerocopy_send *send;
+
+	for (;;) {
+		char control[128];
+		struct msghdr msg;
+		struct cmsghdr *cm;
+
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		if (recvmsg(zc->fd, &msg, MSG_ERRQUEUE|MSG_DONTWAIT) < 0)
+			break;
+		for (cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+			struct sock_extended_err *serr;
+			ev_uint32_t lo, hi;
+
+			if (!(cm->cmsg_level == IPPROTO_IP &&
+				cm->cmsg_type == IP_RECVERR) &&
+			    !(cm->cmsg_level == IPPROTO_IPV6 &&
+				cm->cmsg_type == IPV6_RECVERR))
+				continue;
+			serr = (struct sock_extended_err *)CMSG_DATA(cm);
+			if (serr->ee_errno != 0 ||
+			    serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+				continue;
+			/* The kernel finished sends lo..hi, inclusive and
+			 * modulo 2^32. */
+			lo = serr->ee_info;
+			hi = serr->ee_data;
+			TAILQ_FOREACH(send, &zc->sends, next) {
+				if (send->id - lo <= hi - lo)
+					send->done = 1;
+			}
+		}
+	}
+
+	/* Release in order, so that a chain shared by two sends stays
+	 * pinned until the later one is done. */
+	while ((send = TAILQ_FIRST(&zc->sends)) && send->done) {
+		TAILQ_REMOVE(&zc->sends, send, next);
+		--zc->n_sends;
+		evbuffer_zerocopy_send_free(send);
+	}
+	return zc->n_sends;
+}
+
+/* Stop listening on our duplicate of the socket, and close it. */
+static void
+evbuffer_zerocopy_close(struct evbuffer_zerocopy *zc)
+{
+	EVUTIL_ASSERT(zc->n_sends == 0);
+	if (zc->reaper) {
+		event_free(zc->reaper);
+		zc->reaper = NULL;
+	}
+	if (zc->fd >= 0) {
+		evutil_closesocket(zc->fd);
+		zc->fd = -1;
+	}
+	zc->next_id = 0;
+	zc->retired = 0;
+}
+
+/* Free 'zc'.  Sends the kernel hasn't confirmed are released anyway:
+ * their chains are unpinned, and freed if they are dangling. */
+static void
+evbuffer_zerocopy_free(struct evbuffer_zerocopy *zc)
+{
+	struct evbuffer_zerocopy_send *send;
+
+	if (zc->n_sends)
+		event_warnx("%s: releasing the memory of %d zero-copy sends "
+		    "the kernel has not confirmed", __func__, zc->n_sends);
+	while ((send = TAILQ_FIRST(&zc->sends))) {
+		TAILQ_REMOVE(&zc->sends, send, next);
+		--zc->n_sends;
+		evbuffer_zerocopy_send_free(send);
+	}
+	evbuffer_zerocopy_close(zc);
+	mm_free(zc);
+}
+
+/* The buffer's owner is going away.  Its chains go with it, except for
+ * those the kernel may still be reading: those are left dangling, and we
+ * keep reaping on our own until the kernel lets go of them. */
+static void
+evbuffer_zerocopy_orphan(struct evbuffer_zerocopy *zc)
+{
+	zc->buffer = NULL;
+	zc->threshold = 0;
+	if (zc->fd >= 0 && evbuffer_zerocopy_reap(zc) &&
+	    event_add(zc->reaper, &evbuffer_zerocopy_linger) == 0)
+		return;
+	evbuffer_zerocopy_free(zc);
+}
+
+static void
+evbuffer_zerocopy_reaper_cb(evutil_socket_t fd, short what, void *arg)
+{
+	struct evbuffer_zerocopy *zc = arg;
+	struct evbuffer *buf = zc->buffer;
+
+	if (buf) {
+		EVBUFFER_LOCK(buf);
+		if (!evbuffer_zerocopy_reap(zc) && zc->retired)
+			evbuffer_zerocopy_close(zc);
+		EVBUFFER_UNLOCK(buf);
+		return;
+	}
+
+	/* We are on our own, and either done or out of patience. */
+	if ((what & EV_TIMEOUT) || !evbuffer_zerocopy_reap(zc))
+		evbuffer_zerocopy_free(zc);
+}
+
+/* Start listening for the completions of sends on 'fd', through a
+ * duplicate of it. */
+static int
+evbuffer_zerocopy_open(struct evbuffer_zerocopy *zc,
+    struct event_base *base, evutil_socket_t fd)
+{
+	if ((zc->fd = fcntl(fd, F_DUPFD_CLOEXEC, 0)) < 0)
+		return -1;
+	zc->reaper = event_new(base, zc->fd, EV_READ|EV_ET|EV_PERSIST,
+	    evbuffer_zerocopy_reaper_cb, zc);
+	if (!zc->reaper || event_add(zc->reaper, NULL) < 0) {
+		evbuffer_zerocopy_close(zc);
+		return -1;
+	}
+	return 0;
+}
+
+static inline int
+evbuffer_write_zerocopy(struct evbuffer *buffer, evutil_socket_t fd,
+    ev_ssize_t howmuch)
+{
+	struct evbuffer_zerocopy *zc = buffer->zerocopy;
+	struct evbuffer_zerocopy_send *send, *prev;
+	struct evbuffer_chain *chain;
+	struct iovec iov[NUM_WRITE_IOVEC];
+	struct msghdr msg;
+	int n, i = 0;
+	size_t left;
+
+	ASSERT_EVBUFFER_LOCKED(buffer);
+	for (chain = buffer->first;
+	     chain != NULL && i < NUM_WRITE_IOVEC && howmuch;
+	     chain = chain->next) {
+		size_t len = chain->off;
+#ifdef USE_SENDFILE
+		if (chain->flags & EVBUFFER_SENDFILE)
+			break;
+#endif
+		if ((size_t)howmuch < len)
+			len = howmuch;
+		iov[i].iov_base = (void *)(chain->buffer + chain->misalign);
+		iov[i++].iov_len = len;
+		howmuch -= len;
+	}
+	if (! i)
+		return 0;
+
+	/* Allocate first: once the kernel has taken the data we have to be
+	 * able to keep it. */
+	send = mm_malloc(sizeof(*send) + (i - 1) * sizeof(send->chains[0]));
+	if (send == NULL)
+		return writev(fd, iov, i);
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = i;
+	n = sendmsg(fd, &msg, MSG_ZEROCOPY);
+	if (n <= 0) {
+		mm_free(send);
+		/* ENOBUFS means we're over the limit of memory the kernel
+		 * will lock for us; copy until some sends complete. */
+		if (n < 0 && errno == ENOBUFS)
+			return writev(fd, iov, i);
+		return n;
+	}
+
+	/* Pin every chain the kernel took data from, so that draining them
+	 * leaves them dangling until the kernel is done. */
+	prev = TAILQ_LAST(&zc->sends, evbuffer_zerocopy_sendq);
+	send->id = zc->next_id++;
+	send->done = 0;
+	send->n_chains = 0;
+	for (chain = buffer->first, left = n; left; chain = chain->next) {
+		EVUTIL_ASSERT(chain);
+		if (chain->flags & EVBUFFER_MEM_PINNED_W) {
+			/* Only the chain the last send stopped in can still
+			 * be pinned; this send keeps it pinned now. */
+			EVUTIL_ASSERT(prev && prev->n_chains &&
+			    prev->chains[prev->n_chains - 1] == chain);
+			prev->chains[prev->n_chains - 1] = NULL;
+		} else {
+			evbuffer_chain_pin_(chain, EVBUFFER_MEM_PINNED_W);
+		}
+		send->chains[send->n_chains++] = chain;
+		left -= left < chain->off ? left : chain->off;
+	}
+	TAILQ_INSERT_TAIL(&zc->sends, send, next);
+	++zc->n_sends;
+
+	return n;
+}
+
+int
+evbuffer_enable_zerocopy_(struct evbuffer *buf, struct event_base *base,
+    evutil_socket_t fd, size_t threshold)
+{
+	struct evbuffer_zerocopy *zc;
+	int r = -1;
+
+	EVBUFFER_LOCK(buf);
+	zc = buf->zerocopy;
+	if (!threshold) {
+		/* Sends in flight are still reaped as they finish. */
+		if (zc)
+			zc->threshold = 0;
+		r = 0;
+		goto done;
+	}
+	if (fd < 0 || !(event_base_get_features(base) & EV_FEATURE_ET))
+		goto done;
+	if (!zc) {
+		if (!(zc = mm_calloc(1, sizeof(*zc))))
+			goto done;
+		TAILQ_INIT(&zc->sends);
+		zc->fd = -1;
+		zc->buffer = buf;
+		buf->zerocopy = zc;
+	}
+	/* A new socket numbers its sends from 0, which we can't tell apart
+	 * from the ones still in flight on the old one. */
+	if (zc->retired) {
+		if (evbuffer_zerocopy_reap(zc))
+			goto done;
+		evbuffer_zerocopy_close(zc);
+	}
+	if (zc->fd < 0 && evbuffer_zerocopy_open(zc, base, fd) < 0)
+		goto done;
+	zc->threshold = threshold;
+	r = 0;
+done:
+	EVBUFFER_UNLOCK(buf);
+	return r;
+}
+
+void
+evbuffer_retire_zerocopy_(struct evbuffer *buf)
+{
+	struct evbuffer_zerocopy *zc;
+
+	EVBUFFER_LOCK(buf);
+	zc = buf->zerocopy;
+	if (zc && zc->fd >= 0) {
+		zc->threshold = 0;
+		if (evbuffer_zerocopy_reap(zc))
+			zc->retired = 1;
+		else
+			evbuffer_zerocopy_close(zc);
+	}
+	EVBUFFER_UNLOCK(buf);
+}
+
+void
+evbuffer_detach_zerocopy_(struct evbuffer *buf)
+{
+	EVBUFFER_LOCK(buf);
+	if (buf->zerocopy) {
+		evbuffer_zerocopy_orphan(buf->zerocopy);
+		buf->zerocopy = NULL;
+	}
+	EVBUFFER_UNLOCK(buf);
+}
+#else
+int
+evbuffer_enable_zerocopy_(struct evbuffer *buf, struct event_base *base,
+    evutil_socket_t fd, size_t threshold)
+{
+	return threshold ? -1 : 0;
+}
+
+void
+evbuffer_retire_zerocopy_(struct evbuffer *buf)
+{
+}
+
+void
+evbuffer_detach_zerocopy_(struct evbuffer *buf)
+{
+}
+#endif
+
 #ifdef USE_SENDFILE
 static inline int
 evbuffer_write_sendfile(struct evbuffer *buffer, evutil_socket_t dest_fd,
@@ -2540,6 +3560,12 @@ evbuffer_write_atmost(struct evbuffer *buffer, evutil_socket_t fd,
 			n = evbuffer_write_sendfile(buffer, fd, howmuch);
 		else {
 #endif
+#ifdef USE_ZEROCOPY
+		if (buffer->zerocopy && buffer->zerocopy->threshold &&
+		    (size_t)howmuch >= buffer->zerocopy->threshold)
+			n = evbuffer_write_zerocopy(buffer, fd, howmuch);
+		else
+#endif
 #ifdef USE_IOVEC_IMPL
 		n = evbuffer_write_iovec(buffer, fd, howmuch);
 #elif defined(_WIN32)
@@ -2720,7 +3746,6 @@ evbuffer_search_range(struct evbuffer *buffer, const char *what, size_t len, con
 {
 	struct evbuffer_ptr pos;
 	struct evbuffer_chain *chain, *last_chain = NULL;
-	const unsigned char *p;
 	char first;
 
 	EVBUFFER_LOCK(buffer);
@@ -2743,33 +3768,44 @@ evbuffer_search_range(struct evbuffer *buffer, const char *what, size_t len, con
 	first = what[0];
 
 	while (chain) {
-		const unsigned char *start_at =
-		    chain->buffer + chain->misalign +
-		    pos.internal_.pos_in_chain;
-		p = memchr(start_at, first,
-		    chain->off - pos.internal_.pos_in_chain);
-		if (p) {
-			pos.pos += p - start_at;
-			pos.internal_.pos_in_chain += p - start_at;
+		const char *buf = (const char *)chain->buffer + chain->misalign;
+		size_t i = pos.internal_.pos_in_chain;
+		const char *p;
+
+		/* Every match that starts at or before chain->off - len lies
+		 * entirely inside this chain, so it comes before any match
+		 * that runs into the next one. */
+		if (chain->off >= len && i + len <= chain->off) {
+			p = evutil_memmem_(buf + i, chain->off - i, what, len);
+			if (p) {
+				pos.pos += p - (buf + i);
+				pos.internal_.pos_in_chain = p - buf;
+				if (end && pos.pos + (ev_ssize_t)len > end->pos)
+					goto not_found;
+				goto done;
+			}
+			pos.pos += chain->off - len + 1 - i;
+			i = pos.internal_.pos_in_chain = chain->off - len + 1;
+		}
+
+		/* The rest can only match across the chain boundary. */
+		while (i < chain->off &&
+		    (p = memchr(buf + i, first, chain->off - i))) {
+			pos.pos += p - (buf + i);
+			i = pos.internal_.pos_in_chain = p - buf;
 			if (!evbuffer_ptr_memcmp(buffer, &pos, what, len)) {
 				if (end && pos.pos + (ev_ssize_t)len > end->pos)
 					goto not_found;
-				else
-					goto done;
+				goto done;
 			}
 			++pos.pos;
-			++pos.internal_.pos_in_chain;
-			if (pos.internal_.pos_in_chain == chain->off) {
-				chain = pos.internal_.chain = chain->next;
-				pos.internal_.pos_in_chain = 0;
-			}
-		} else {
-			if (chain == last_chain)
-				goto not_found;
-			pos.pos += chain->off - pos.internal_.pos_in_chain;
-			chain = pos.internal_.chain = chain->next;
-			pos.internal_.pos_in_chain = 0;
+			i = ++pos.internal_.pos_in_chain;
 		}
+		if (chain == last_chain)
+			goto not_found;
+		pos.pos += chain->off - i;
+		chain = pos.internal_.chain = chain->next;
+		pos.internal_.pos_in_chain = 0;
 	}
 
 not_found:
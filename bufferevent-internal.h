@@ -73,6 +73,9 @@ extern "C" {
 /* On a base bufferevent, for reading: used when a filter has choked this
  * (underlying) bufferevent because it has stopped reading from it. */
 #define BEV_SUSPEND_FILT_READ 0x10
+/* On a bufferevent that forwards to another one, for reading: used when the
+ * other bufferevent has as much to write as its watermarks allow. */
+#define BEV_SUSPEND_FORWARD 0x20
 
 typedef ev_uint16_t bufferevent_suspend_flags;
 
@@ -149,6 +152,28 @@ struct bufferevent_rate_limit {
 	struct event refill_bucket_event;
 };
 
+/** State for bufferevent_forward(): everything 'src' reads goes out on
+ * 'dst'. */
+struct bufferevent_forward {
+	struct bufferevent *src;
+	struct bufferevent *dst;
+	/** If both are socket bufferevents, the pipe that we splice() the
+	 * data through, read end first; otherwise -1s, and the data goes
+	 * through src's input buffer and dst's output buffer. */
+	int pipe[2];
+	/** How many bytes are in the pipe. */
+	size_t n_piped;
+	/** How many bytes went all the way through the pipe. */
+	ev_uint64_t n_spliced;
+	/** How many bytes went through the buffers. */
+	ev_uint64_t n_copied;
+	/** Callback on dst's output buffer, to resume reading from src. */
+	struct evbuffer_cb_entry *output_cb;
+	/** Set while we have suspended reading from src because dst is full.
+	 * Only changed with both locks held. */
+	int suspended;
+};
+
 /** Parts of the bufferevent structure that are shared among all bufferevent
  * types, but not exposed in bufferevent_struct.h. */
 struct bufferevent_private {
@@ -217,6 +242,12 @@ struct bufferevent_private {
 	/** Rate-limiting information for this bufferevent */
 	struct bufferevent_rate_limit *rate_limiting;
 
+	/** The read and write timeouts to pass to event_add(): the same
+	 * durations as bev.timeout_read and bev.timeout_write, but perhaps
+	 * on one of the base's common timeout queues. */
+	struct timeval ev_timeout_read;
+	struct timeval ev_timeout_write;
+
 	/* Saved conn_addr, to extract IP address from it.
 	 *
 	 * Because some servers may reset/close connection without waiting clients,
@@ -230,6 +261,14 @@ struct bufferevent_private {
 	} conn_address;
 
 	struct evdns_getaddrinfo_request *dns_request;
+
+	/** Set if we forward what we read to another bufferevent. */
+	struct bufferevent_forward *forward_out;
+	/** Set if another bufferevent forwards what it reads to us. */
+	struct bufferevent_forward *forward_in;
+	/** If we forward: scheduled when the other bufferevent has caught up,
+	 * so that we start reading again without it holding its lock. */
+	struct event_callback forward_resume;
 };
 
 /** Possible operations for a control callback. */
@@ -320,6 +359,13 @@ extern const struct bufferevent_ops bufferevent_ops_async;
 #define BEV_IS_ASYNC(bevp) 0
 #endif
 
+#ifdef EVENT__HAVE_IO_URING
+extern const struct bufferevent_ops bufferevent_ops_uring;
+#define BEV_IS_URING(bevp) ((bevp)->be_ops == &bufferevent_ops_uring)
+#else
+#define BEV_IS_URING(bevp) 0
+#endif
+
 /** Initialize the shared parts of a bufferevent. */
 EVENT2_EXPORT_SYMBOL
 int bufferevent_init_common_(struct bufferevent_private *, struct event_base *, const struct bufferevent_ops *, enum bufferevent_options options);
@@ -414,11 +460,40 @@ bufferevent_trigger_nolock_(struct bufferevent *bufev, short iotype, int options
 		bufferevent_run_writecb_(bufev, options);
 }
 
+/** Internal: move what 'fwd->src' has read to 'fwd->dst'.  Called instead
+ * of the read callback of a bufferevent that forwards.  Requires that we
+ * hold the lock on src. */
+void bufferevent_forward_copy_(struct bufferevent_forward *fwd);
+/** Internal: splice up to 'howmuch' bytes from the socket 'fd' of
+ * 'fwd->src' into the pipe.  Returns as evbuffer_read() does. */
+int bufferevent_forward_splice_in_(struct bufferevent_forward *fwd,
+    evutil_socket_t fd, ev_ssize_t howmuch);
+/** Internal: splice up to 'howmuch' bytes from the pipe to the socket 'fd'
+ * of 'fwd->dst'.  Returns as evbuffer_write_atmost() does. */
+int bufferevent_forward_splice_out_(struct bufferevent_forward *fwd,
+    evutil_socket_t fd, ev_ssize_t howmuch);
+/** Internal: run by 'forward_resume' on the bufferevent 'arg' to start
+ * reading from it again. */
+void bufferevent_forward_resume_cb_(struct event_callback *cb, void *arg);
+/** Internal: stop forwarding to or from 'bev', which is being finalized.
+ * Requires that we hold no locks, since it takes src's lock before dst's. */
+void bufferevent_forward_unlink_(struct bufferevent *bev);
+
+/** Internal: true iff 'fwd' moves its data through a pipe. */
+#define BEV_FORWARD_SPLICING(fwd) ((fwd) && (fwd)->pipe[0] >= 0)
+/** Internal: true iff 'fwd' has bytes in its pipe waiting to go out. */
+#define BEV_FORWARD_PIPED(fwd) ((fwd) && (fwd)->n_piped > 0)
+
 /** Internal: Add the event 'ev' with timeout tv, unless tv is set to 0, in
  * which case add ev with no timeout. */
 EVENT2_EXPORT_SYMBOL
 int bufferevent_add_event_(struct event *ev, const struct timeval *tv);
 
+/** Internal: Recompute the timeouts that BEV_EV_TIMEOUT_READ() and
+ * BEV_EV_TIMEOUT_WRITE() return, from bev->timeout_read, bev->timeout_write
+ * and bev->ev_base.  Call this whenever any of those change. */
+void bufferevent_update_ev_timeouts_(struct bufferevent *bev);
+
 /* =========
  * These next functions implement timeouts for bufferevents that aren't doing
  * anything else with ev_read and ev_write, to handle timeouts.
@@ -458,14 +533,14 @@ bufferevent_socket_set_conn_address_(struct bufferevent *bev, struct sockaddr *a
 #define BEV_RESET_GENERIC_READ_TIMEOUT(bev)				\
 	do {								\
 		if (evutil_timerisset(&(bev)->timeout_read))		\
-			event_add(&(bev)->ev_read, &(bev)->timeout_read); \
+			event_add(&(bev)->ev_read, BEV_EV_TIMEOUT_READ(bev)); \
 	} while (0)
 /** Internal use: We have just successfully written data from an inbuf, so
  * reset the read timeout (if any). */
 #define BEV_RESET_GENERIC_WRITE_TIMEOUT(bev)				\
 	do {								\
 		if (evutil_timerisset(&(bev)->timeout_write))		\
-			event_add(&(bev)->ev_write, &(bev)->timeout_write); \
+			event_add(&(bev)->ev_write, BEV_EV_TIMEOUT_WRITE(bev)); \
 	} while (0)
 #define BEV_DEL_GENERIC_READ_TIMEOUT(bev)	\
 		event_del(&(bev)->ev_read)
@@ -477,6 +552,11 @@ bufferevent_socket_set_conn_address_(struct bufferevent *bev, struct sockaddr *a
  * bufferevent_private. */
 #define BEV_UPCAST(b) EVUTIL_UPCAST((b), struct bufferevent_private, bev)
 
+/** Internal: Given a bufferevent, return the read or write timeout to pass
+ * to event_add() for it. */
+#define BEV_EV_TIMEOUT_READ(b) (&BEV_UPCAST(b)->ev_timeout_read)
+#define BEV_EV_TIMEOUT_WRITE(b) (&BEV_UPCAST(b)->ev_timeout_write)
+
 #ifdef EVENT__DISABLE_THREAD_SUPPORT
 #define BEV_LOCK(b) EVUTIL_NIL_STMT_
 #define BEV_UNLOCK(b) EVUTIL_NIL_STMT_
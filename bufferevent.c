@@ -242,6 +242,12 @@ bufferevent_run_readcb_(struct bufferevent *bufev, int options)
 {
 	/* Requires that we hold the lock and a reference */
 	struct bufferevent_private *p = BEV_UPCAST(bufev);
+	if (p->forward_out) {
+		/* Forwarding takes the place of the read callback. */
+		bufferevent_forward_copy_(p->forward_out);
+		bufferevent_inbuf_wm_check(bufev);
+		return;
+	}
 	if (bufev->readcb == NULL)
 		return;
 	if ((p->options|options) & BEV_OPT_DEFER_CALLBACKS) {
@@ -323,6 +329,11 @@ bufferevent_init_common_(struct bufferevent_private *bufev_private,
 			goto err;
 	}
 
+	if (base && base->chain_pool) {
+		evbuffer_use_chain_pool(bufev->input, base);
+		evbuffer_use_chain_pool(bufev->output, base);
+	}
+
 	bufev_private->refcnt = 1;
 	bufev->ev_base = base;
 
@@ -365,6 +376,9 @@ bufferevent_init_common_(struct bufferevent_private *bufev_private,
 		    event_base_get_npriorities(base) / 2,
 		    bufferevent_run_deferred_callbacks_locked,
 		    bufev_private);
+	event_deferred_cb_init_(&bufev_private->forward_resume,
+	    event_base_get_npriorities(base) / 2,
+	    bufferevent_forward_resume_cb_, bufev);
 
 	bufev_private->options = options;
 
@@ -519,6 +533,7 @@ bufferevent_set_timeouts(struct bufferevent *bufev,
 	} else {
 		evutil_timerclear(&bufev->timeout_write);
 	}
+	bufferevent_update_ev_timeouts_(bufev);
 
 	if (bufev->be_ops->adj_timeouts)
 		r = bufev->be_ops->adj_timeouts(bufev);
@@ -750,6 +765,10 @@ bufferevent_finalize_cb_(struct event_callback *evcb, void *arg_)
 	struct bufferevent *underlying;
 	struct bufferevent_private *bufev_private = BEV_UPCAST(bufev);
 
+	/* Only now, with no lock held, can we take the locks of both ends of
+	 * a forward in the right order. */
+	bufferevent_forward_unlink_(bufev);
+
 	BEV_LOCK(bufev);
 	underlying = bufferevent_get_underlying(bufev);
 
@@ -974,14 +993,14 @@ bufferevent_generic_adj_timeouts_(struct bufferevent *bev)
 	int r1=0, r2=0;
 	if ((enabled & EV_READ) && !bev_p->read_suspended &&
 	    evutil_timerisset(&bev->timeout_read))
-		r1 = event_add(&bev->ev_read, &bev->timeout_read);
+		r1 = event_add(&bev->ev_read, &bev_p->ev_timeout_read);
 	else
 		r1 = event_del(&bev->ev_read);
 
 	if ((enabled & EV_WRITE) && !bev_p->write_suspended &&
 	    evutil_timerisset(&bev->timeout_write) &&
 	    evbuffer_get_length(bev->output))
-		r2 = event_add(&bev->ev_write, &bev->timeout_write);
+		r2 = event_add(&bev->ev_write, &bev_p->ev_timeout_write);
 	else
 		r2 = event_del(&bev->ev_write);
 	if (r1 < 0 || r2 < 0)
@@ -995,7 +1014,7 @@ bufferevent_generic_adj_existing_timeouts_(struct bufferevent *bev)
 	int r = 0;
 	if (event_pending(&bev->ev_read, EV_READ, NULL)) {
 		if (evutil_timerisset(&bev->timeout_read)) {
-			    if (bufferevent_add_event_(&bev->ev_read, &bev->timeout_read) < 0)
+			    if (bufferevent_add_event_(&bev->ev_read, BEV_EV_TIMEOUT_READ(bev)) < 0)
 				    r = -1;
 		} else {
 			event_remove_timer(&bev->ev_read);
@@ -1003,7 +1022,7 @@ bufferevent_generic_adj_existing_timeouts_(struct bufferevent *bev)
 	}
 	if (event_pending(&bev->ev_write, EV_WRITE, NULL)) {
 		if (evutil_timerisset(&bev->timeout_write)) {
-			if (bufferevent_add_event_(&bev->ev_write, &bev->timeout_write) < 0)
+			if (bufferevent_add_event_(&bev->ev_write, BEV_EV_TIMEOUT_WRITE(bev)) < 0)
 				r = -1;
 		} else {
 			event_remove_timer(&bev->ev_write);
@@ -1012,6 +1031,19 @@ bufferevent_generic_adj_existing_timeouts_(struct bufferevent *bev)
 	return r;
 }
 
+void
+bufferevent_update_ev_timeouts_(struct bufferevent *bev)
+{
+	struct bufferevent_private *bev_p = BEV_UPCAST(bev);
+
+	/* Lots of bufferevents tend to share the same timeouts, so let the
+	 * base put them on a common timeout queue if it can. */
+	bev_p->ev_timeout_read =
+	    *event_base_auto_common_timeout_(bev->ev_base, &bev->timeout_read);
+	bev_p->ev_timeout_write =
+	    *event_base_auto_common_timeout_(bev->ev_base, &bev->timeout_write);
+}
+
 int
 bufferevent_add_event_(struct event *ev, const struct timeval *tv)
 {
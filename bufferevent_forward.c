@@ -0,0 +1,405 @@
+/*
+ * Copyright (c) 2009-2012 Niels Provos, Nick Mathewson
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * bufferevent_forward(): send everything one bufferevent reads out through
+ * another, the way a proxy does.
+ *
+ * When both ends are socket bufferevents, the data never comes up to user
+ * space: the reading socket's callback splice()s it into a pipe, and the
+ * writing socket's callback splice()s it out again.  Anything else goes the
+ * usual way, from the input buffer of one to the output buffer of the
+ * other.  Either way, the bytes waiting to go out on dst (in its output
+ * buffer or in the pipe) count against dst's write watermarks: we stop
+ * reading from src when they reach the high watermark, and start again
+ * when they fall to the low one.
+ */
+
+#include "event2/event-config.h"
+#include "evconfig-private.h"
+
+#include <sys/types.h>
+
+#include <errno.h>
+#include <limits.h>
+#ifdef EVENT__HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef EVENT__HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#ifdef _WIN32
+#include <winsock2.h>
+#endif
+
+#include "event2/util.h"
+#include "event2/buffer.h"
+#include "event2/buffer_compat.h"
+#include "event2/bufferevent.h"
+#include "event2/bufferevent_struct.h"
+#include "event2/event.h"
+#include "bufferevent-internal.h"
+#include "evbuffer-internal.h"
+#include "mm-internal.h"
+#include "util-internal.h"
+
+#if defined(EVENT__HAVE_SPLICE) && defined(EVENT__HAVE_PIPE2) && \
+    defined(SPLICE_F_NONBLOCK)
+#define USE_SPLICE 1
+#endif
+
+/* True iff dst has as much waiting to go out as its watermarks allow. */
+static int
+bufferevent_forward_full(struct bufferevent_forward *fwd)
+{
+	struct bufferevent *dst = fwd->dst;
+	return dst->wm_write.high &&
+	    evbuffer_get_length(dst->output) + fwd->n_piped >=
+	    dst->wm_write.high;
+}
+
+/* True iff we stopped reading from src and dst has caught up. */
+static int
+bufferevent_forward_can_resume(struct bufferevent_forward *fwd)
+{
+	struct bufferevent *dst = fwd->dst;
+	return fwd->suspended &&
+	    evbuffer_get_length(dst->output) + fwd->n_piped <=
+	    dst->wm_write.low;
+}
+
+static void
+bufferevent_forward_suspend(struct bufferevent_forward *fwd)
+{
+	bufferevent_suspend_read_(fwd->src, BEV_SUSPEND_FORWARD);
+	fwd->suspended = 1;
+}
+
+/* Start reading from src again, if dst has caught up.  We hold the lock on
+ * dst here, and everyone else takes src's lock first, so leave it to a
+ * callback that can take them both in that order. */
+static void
+bufferevent_forward_resume(struct bufferevent_forward *fwd)
+{
+	if (bufferevent_forward_can_resume(fwd))
+		event_deferred_cb_schedule_(fwd->dst->ev_base,
+		    &BEV_UPCAST(fwd->src)->forward_resume);
+}
+
+void
+bufferevent_forward_resume_cb_(struct event_callback *cb, void *arg)
+{
+	struct bufferevent *src = arg;
+	struct bufferevent_forward *fwd;
+
+	BEV_LOCK(src);
+	if ((fwd = BEV_UPCAST(src)->forward_out)) {
+		BEV_LOCK(fwd->dst);
+		if (bufferevent_forward_can_resume(fwd)) {
+			fwd->suspended = 0;
+			bufferevent_unsuspend_read_(src, BEV_SUSPEND_FORWARD);
+		}
+		BEV_UNLOCK(fwd->dst);
+	}
+	BEV_UNLOCK(src);
+}
+
+/* Take the locks on src and then dst.  Unlike the read path, our caller
+ * holds neither, so rather than wait for dst while holding src (dst may be
+ * forwarding to src, and reading, and so waiting for us) we back off. */
+static void
+bufferevent_forward_lock(struct bufferevent *src, struct bufferevent *dst)
+{
+	for (;;) {
+		BEV_LOCK(src);
+		if (EVLOCK_TRY_LOCK_(BEV_UPCAST(dst)->lock))
+			return;
+		BEV_UNLOCK(src);
+		BEV_LOCK(dst);
+		BEV_UNLOCK(dst);
+	}
+}
+
+static void
+bufferevent_forward_output_cb(struct evbuffer *buf,
+    const struct evbuffer_cb_info *cbinfo, void *arg)
+{
+	if (cbinfo->n_deleted)
+		bufferevent_forward_resume(arg);
+}
+
+/* Stop splicing: move what is still in the pipe to the front of dst's
+ * output buffer, ahead of anything written to dst since it went in. */
+static void
+bufferevent_forward_unpipe(struct bufferevent_forward *fwd)
+{
+	struct evbuffer *output = fwd->dst->output;
+	struct evbuffer *rest;
+
+	if (fwd->pipe[0] < 0)
+		return;
+	if (fwd->n_piped && (rest = evbuffer_new())) {
+		while (fwd->n_piped) {
+			int n = evbuffer_read(rest, fwd->pipe[0],
+			    fwd->n_piped > INT_MAX ? INT_MAX : (int)fwd->n_piped);
+			if (n <= 0)
+				break;
+			fwd->n_piped -= n;
+		}
+		fwd->n_copied += evbuffer_get_length(rest);
+		/* Only socket bufferevents splice, and those keep the start
+		 * of their output buffer frozen outside their write
+		 * callback. */
+		evbuffer_unfreeze(output, 1);
+		evbuffer_prepend_buffer(output, rest);
+		evbuffer_freeze(output, 1);
+		evbuffer_free(rest);
+	}
+	close(fwd->pipe[0]);
+	close(fwd->pipe[1]);
+	fwd->pipe[0] = fwd->pipe[1] = -1;
+	fwd->n_piped = 0;
+}
+
+/* Stop forwarding.  Requires that we hold both locks.  If 'resume' is
+ * false, src is being freed, so leave its reading alone. */
+static void
+bufferevent_forward_free(struct bufferevent_forward *fwd, int resume)
+{
+	struct bufferevent *src = fwd->src;
+
+	bufferevent_forward_unpipe(fwd);
+	evbuffer_remove_cb_entry(fwd->dst->output, fwd->output_cb);
+	BEV_UPCAST(src)->forward_out = NULL;
+	BEV_UPCAST(fwd->dst)->forward_in = NULL;
+	if (resume && fwd->suspended)
+		bufferevent_unsuspend_read_(src, BEV_SUSPEND_FORWARD);
+	mm_free(fwd);
+}
+
+void
+bufferevent_forward_copy_(struct bufferevent_forward *fwd)
+{
+	struct bufferevent *src = fwd->src, *dst = fwd->dst;
+	size_t len;
+
+	BEV_LOCK(dst);
+	len = evbuffer_get_length(src->input);
+	if (len && evbuffer_add_buffer(dst->output, src->input) == 0)
+		fwd->n_copied += len;
+	if (bufferevent_forward_full(fwd))
+		bufferevent_forward_suspend(fwd);
+	BEV_UNLOCK(dst);
+}
+
+int
+bufferevent_forward_splice_in_(struct bufferevent_forward *fwd,
+    evutil_socket_t fd, ev_ssize_t howmuch)
+{
+#ifdef USE_SPLICE
+	struct bufferevent *dst = fwd->dst;
+	ev_ssize_t n;
+
+	BEV_LOCK(dst);
+	/* Whatever dst already had to write goes out before this. */
+	if (evbuffer_get_length(dst->output) || bufferevent_forward_full(fwd))
+		goto stop;
+	if (dst->wm_write.high &&
+	    (size_t)howmuch > dst->wm_write.high - fwd->n_piped)
+		howmuch = dst->wm_write.high - fwd->n_piped;
+
+	n = splice(fd, NULL, fwd->pipe[1], NULL, howmuch,
+	    SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+	if (n < 0 && EVUTIL_ERR_RW_RETRIABLE(errno) && fwd->n_piped) {
+		/* The pipe may be what's full; wait for dst to empty it. */
+		goto stop;
+	} else if (n == 0) {
+		/* EOF: leave what's left where the EOF handler can see it. */
+		bufferevent_forward_unpipe(fwd);
+	} else if (n > 0) {
+		fwd->n_piped += n;
+		if ((dst->enabled & EV_WRITE) &&
+		    !BEV_UPCAST(dst)->write_suspended)
+			bufferevent_add_event_(&dst->ev_write,
+			    BEV_EV_TIMEOUT_WRITE(dst));
+	}
+	BEV_UNLOCK(dst);
+	return (int)n;
+
+stop:
+	bufferevent_forward_suspend(fwd);
+	BEV_UNLOCK(dst);
+	errno = EAGAIN;
+	return -1;
+#else
+	EVUTIL_ASSERT(0);
+	return -1;
+#endif
+}
+
+int
+bufferevent_forward_splice_out_(struct bufferevent_forward *fwd,
+    evutil_socket_t fd, ev_ssize_t howmuch)
+{
+#ifdef USE_SPLICE
+	ev_ssize_t n;
+
+	if (howmuch < 0 || (size_t)howmuch > fwd->n_piped)
+		howmuch = fwd->n_piped;
+	n = splice(fwd->pipe[0], NULL, fd, NULL, howmuch,
+	    SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+	if (n > 0) {
+		fwd->n_piped -= n;
+		fwd->n_spliced += n;
+		bufferevent_forward_resume(fwd);
+	}
+	return (int)n;
+#else
+	EVUTIL_ASSERT(0);
+	return -1;
+#endif
+}
+
+void
+bufferevent_forward_unlink_(struct bufferevent *bev)
+{
+	struct bufferevent_private *bev_p = BEV_UPCAST(bev);
+	struct bufferevent *other;
+
+	BEV_LOCK(bev);
+	if (bev_p->forward_out) {
+		other = bev_p->forward_out->dst;
+		BEV_LOCK(other);
+		bufferevent_forward_free(bev_p->forward_out, 0);
+		BEV_UNLOCK(other);
+	}
+	/* Nothing can schedule this once we stop forwarding. */
+	event_deferred_cb_cancel_(bev->ev_base, &bev_p->forward_resume);
+	other = bev_p->forward_in ? bev_p->forward_in->src : NULL;
+	BEV_UNLOCK(bev);
+
+	/* Finalizers only run in the loop, so 'other' can't be freed before
+	 * we're done, though it can stop forwarding to us. */
+	if (other) {
+		BEV_LOCK(other);
+		BEV_LOCK(bev);
+		if (bev_p->forward_in && bev_p->forward_in->src == other)
+			bufferevent_forward_free(bev_p->forward_in, 1);
+		BEV_UNLOCK(bev);
+		BEV_UNLOCK(other);
+	}
+}
+
+int
+bufferevent_forward(struct bufferevent *src, struct bufferevent *dst)
+{
+	struct bufferevent_private *src_p = BEV_UPCAST(src);
+	struct bufferevent_private *dst_p = BEV_UPCAST(dst);
+	struct bufferevent_forward *fwd;
+	int r = -1;
+
+	if (src == dst || src->ev_base != dst->ev_base)
+		return -1;
+
+	bufferevent_forward_lock(src, dst);
+	if (src_p->forward_out || dst_p->forward_in)
+		goto done;
+	if (!(fwd = mm_calloc(1, sizeof(*fwd))))
+		goto done;
+	fwd->src = src;
+	fwd->dst = dst;
+	fwd->pipe[0] = fwd->pipe[1] = -1;
+#ifdef USE_SPLICE
+	if (BEV_IS_SOCKET(src) && BEV_IS_SOCKET(dst) &&
+	    pipe2(fwd->pipe, O_NONBLOCK|O_CLOEXEC) < 0)
+		fwd->pipe[0] = fwd->pipe[1] = -1;
+#endif
+	fwd->output_cb = evbuffer_add_cb(dst->output,
+	    bufferevent_forward_output_cb, fwd);
+	if (!fwd->output_cb) {
+		if (fwd->pipe[0] >= 0) {
+			close(fwd->pipe[0]);
+			close(fwd->pipe[1]);
+		}
+		mm_free(fwd);
+		goto done;
+	}
+	src_p->forward_out = fwd;
+	dst_p->forward_in = fwd;
+
+	/* Anything src read before now goes out first. */
+	bufferevent_forward_copy_(fwd);
+	r = 0;
+done:
+	BEV_UNLOCK(dst);
+	BEV_UNLOCK(src);
+	return r;
+}
+
+int
+bufferevent_forward_stop(struct bufferevent *src)
+{
+	struct bufferevent_private *src_p = BEV_UPCAST(src);
+	struct bufferevent *dst;
+	int r = -1;
+
+	BEV_LOCK(src);
+	while (src_p->forward_out) {
+		dst = src_p->forward_out->dst;
+		/* Back off as bufferevent_forward_lock() does, except that
+		 * without src's lock dst might be freed, so we can't wait on
+		 * it. */
+		if (!EVLOCK_TRY_LOCK_(BEV_UPCAST(dst)->lock)) {
+			BEV_UNLOCK(src);
+			BEV_LOCK(src);
+			continue;
+		}
+		bufferevent_forward_free(src_p->forward_out, 1);
+		BEV_UNLOCK(dst);
+		r = 0;
+	}
+	BEV_UNLOCK(src);
+	return r;
+}
+
+int
+bufferevent_forward_get_counts(struct bufferevent *src,
+    ev_uint64_t *n_spliced, ev_uint64_t *n_copied)
+{
+	struct bufferevent_forward *fwd;
+	int r = -1;
+
+	BEV_LOCK(src);
+	if ((fwd = BEV_UPCAST(src)->forward_out)) {
+		if (n_spliced)
+			*n_spliced = fwd->n_spliced;
+		if (n_copied)
+			*n_copied = fwd->n_copied;
+		r = 0;
+	}
+	BEV_UNLOCK(src);
+	return r;
+}
@@ -389,10 +389,10 @@ start_reading(struct bufferevent_openssl *bev_ssl)
 	} else {
 		struct bufferevent *bev = &bev_ssl->bev.bev;
 		int r;
-		r = bufferevent_add_event_(&bev->ev_read, &bev->timeout_read);
+		r = bufferevent_add_event_(&bev->ev_read, BEV_EV_TIMEOUT_READ(bev));
 		if (r == 0 && bev_ssl->read_blocked_on_write)
 			r = bufferevent_add_event_(&bev->ev_write,
-			    &bev->timeout_write);
+			    BEV_EV_TIMEOUT_WRITE(bev));
 		return r;
 	}
 }
@@ -411,10 +411,10 @@ start_writing(struct bufferevent_openssl *bev_ssl)
 		}
 	} else {
 		struct bufferevent *bev = &bev_ssl->bev.bev;
-		r = bufferevent_add_event_(&bev->ev_write, &bev->timeout_write);
+		r = bufferevent_add_event_(&bev->ev_write, BEV_EV_TIMEOUT_WRITE(bev));
 		if (!r && bev_ssl->write_blocked_on_read)
 			r = bufferevent_add_event_(&bev->ev_read,
-			    &bev->timeout_read);
+			    BEV_EV_TIMEOUT_READ(bev));
 	}
 	return r;
 }
@@ -1007,9 +1007,9 @@ set_open_callbacks(struct bufferevent_openssl *bev_ssl, evutil_socket_t fd)
 		    be_openssl_writeeventcb, bev_ssl);
 
 		if (rpending)
-			r1 = bufferevent_add_event_(&bev->ev_read, &bev->timeout_read);
+			r1 = bufferevent_add_event_(&bev->ev_read, BEV_EV_TIMEOUT_READ(bev));
 		if (wpending)
-			r2 = bufferevent_add_event_(&bev->ev_write, &bev->timeout_write);
+			r2 = bufferevent_add_event_(&bev->ev_write, BEV_EV_TIMEOUT_WRITE(bev));
 
 		return (r1<0 || r2<0) ? -1 : 0;
 	}
@@ -1143,7 +1143,7 @@ be_openssl_outbuf_cb(struct evbuffer *buf,
 	if (cbinfo->n_added && bev_ssl->state == BUFFEREVENT_SSL_OPEN) {
 		if (cbinfo->orig_size == 0)
 			r = bufferevent_add_event_(&bev_ssl->bev.bev.ev_write,
-			    &bev_ssl->bev.bev.timeout_write);
+			    BEV_EV_TIMEOUT_WRITE(&bev_ssl->bev.bev));
 
 		if (bev_ssl->underlying)
 			consider_writing(bev_ssl);
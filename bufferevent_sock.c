@@ -70,10 +70,13 @@
 #include "log-internal.h"
 #include "mm-internal.h"
 #include "bufferevent-internal.h"
+#include "evbuffer-internal.h"
 #include "util-internal.h"
+#include "event-internal.h"
 #ifdef _WIN32
 #include "iocp-internal.h"
 #endif
+#include "uring-internal.h"
 
 /* prototypes */
 static int be_socket_enable(struct bufferevent *, short);
@@ -139,7 +142,7 @@ bufferevent_socket_outbuf_cb(struct evbuffer *buf,
 	    !bufev_p->write_suspended) {
 		/* Somebody added data to the buffer, and we would like to
 		 * write, and we were not writing.  So, start writing. */
-		if (bufferevent_add_event_(&bufev->ev_write, &bufev->timeout_write) == -1) {
+		if (bufferevent_add_event_(&bufev->ev_write, BEV_EV_TIMEOUT_WRITE(bufev)) == -1) {
 		    /* Should we log this? */
 		}
 	}
@@ -186,9 +189,14 @@ bufferevent_readcb(evutil_socket_t fd, short event, void *arg)
 	if (bufev_p->read_suspended)
 		goto done;
 
-	evbuffer_unfreeze(input, 0);
-	res = evbuffer_read(input, fd, (int)howmuch); /* XXXX evbuffer_read would do better to take and return ev_ssize_t */
-	evbuffer_freeze(input, 0);
+	if (BEV_FORWARD_SPLICING(bufev_p->forward_out)) {
+		res = bufferevent_forward_splice_in_(bufev_p->forward_out,
+		    fd, howmuch);
+	} else {
+		evbuffer_unfreeze(input, 0);
+		res = evbuffer_read(input, fd, (int)howmuch); /* XXXX evbuffer_read would do better to take and return ev_ssize_t */
+		evbuffer_freeze(input, 0);
+	}
 
 	if (res == -1) {
 		int err = evutil_socket_geterror(fd);
@@ -274,6 +282,14 @@ bufferevent_writecb(evutil_socket_t fd, short event, void *arg)
 						BEV_EVENT_CONNECTED, 0);
 				goto done;
 			}
+#endif
+#ifdef EVENT__HAVE_IO_URING
+			if (BEV_IS_URING(bufev)) {
+				bufferevent_uring_set_connected_(bufev);
+				bufferevent_run_eventcb_(bufev,
+						BEV_EVENT_CONNECTED, 0);
+				goto done;
+			}
 #endif
 			bufferevent_run_eventcb_(bufev,
 					BEV_EVENT_CONNECTED, 0);
@@ -290,7 +306,24 @@ bufferevent_writecb(evutil_socket_t fd, short event, void *arg)
 	if (bufev_p->write_suspended)
 		goto done;
 
-	if (evbuffer_get_length(bufev->output)) {
+	/* We only splice into the pipe while the output buffer is empty, so
+	 * what's in the pipe goes out before anything in the buffer. */
+	if (BEV_FORWARD_PIPED(bufev_p->forward_in)) {
+		res = bufferevent_forward_splice_out_(bufev_p->forward_in,
+		    fd, atmost);
+		if (res == -1) {
+			int err = evutil_socket_geterror(fd);
+			if (EVUTIL_ERR_RW_RETRIABLE(err))
+				goto reschedule;
+			what |= BEV_EVENT_ERROR;
+		} else if (res == 0) {
+			what |= BEV_EVENT_EOF;
+		}
+		if (res <= 0)
+			goto error;
+
+		bufferevent_decrement_write_buckets_(bufev_p, res);
+	} else if (evbuffer_get_length(bufev->output)) {
 		evbuffer_unfreeze(bufev->output, 1);
 		res = evbuffer_write_atmost(bufev->output, fd, atmost);
 		evbuffer_freeze(bufev->output, 1);
@@ -312,7 +345,8 @@ bufferevent_writecb(evutil_socket_t fd, short event, void *arg)
 		bufferevent_decrement_write_buckets_(bufev_p, res);
 	}
 
-	if (evbuffer_get_length(bufev->output) == 0) {
+	if (evbuffer_get_length(bufev->output) == 0 &&
+	    !BEV_FORWARD_PIPED(bufev_p->forward_in)) {
 		event_del(&bufev->ev_write);
 	}
 
@@ -327,7 +361,8 @@ bufferevent_writecb(evutil_socket_t fd, short event, void *arg)
 	goto done;
 
  reschedule:
-	if (evbuffer_get_length(bufev->output) == 0) {
+	if (evbuffer_get_length(bufev->output) == 0 &&
+	    !BEV_FORWARD_PIPED(bufev_p->forward_in)) {
 		event_del(&bufev->ev_write);
 	}
 	goto done;
@@ -351,6 +386,10 @@ bufferevent_socket_new(struct event_base *base, evutil_socket_t fd,
 	if (base && event_base_get_iocp_(base))
 		return bufferevent_async_new_(base, fd, options);
 #endif
+#ifdef EVENT__HAVE_IO_URING
+	if (base && event_base_uring_completion_enabled_(base))
+		return bufferevent_uring_new_(base, fd, options);
+#endif
 
 	if ((bufev_p = mm_calloc(1, sizeof(struct bufferevent_private)))== NULL)
 		return NULL;
@@ -423,6 +462,22 @@ bufferevent_socket_connect(struct bufferevent *bev,
 		event_assign(&bev->ev_write, bev->ev_base, fd,
 		    EV_WRITE|EV_PERSIST|EV_FINALIZE, bufferevent_writecb, bev);
 	}
+#endif
+#ifdef EVENT__HAVE_IO_URING
+	/* The io_uring bufferevent waits for the connect the same way.  Mark
+	 * it as connecting before we give it the fd, so that it doesn't
+	 * launch any reads or writes on a socket that isn't connected yet;
+	 * if the connect already finished, let writecb notice that too. */
+	if (BEV_IS_URING(bev)) {
+		/* ev_write may be pending as the generic write timeout. */
+		event_del(&bev->ev_write);
+		event_assign(&bev->ev_write, bev->ev_base, fd,
+		    EV_WRITE|EV_PERSIST|EV_FINALIZE, bufferevent_writecb, bev);
+		if (r == 1)
+			r = 0;
+		if (r == 0)
+			bufev_p->connecting = 1;
+	}
 #endif
 	bufferevent_setfd(bev, fd);
 	if (r == 0) {
@@ -537,6 +592,32 @@ bufferevent_socket_get_dns_error(struct bufferevent *bev)
 	return rv;
 }
 
+int
+bufferevent_socket_set_zerocopy(struct bufferevent *bev, size_t threshold)
+{
+	int r = -1;
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+	evutil_socket_t fd;
+	int on = 1;
+
+	BEV_LOCK(bev);
+	if (!BEV_IS_SOCKET(bev))
+		goto done;
+	fd = event_get_fd(&bev->ev_read);
+	if (threshold && (fd < 0 || setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY,
+		    (void *)&on, sizeof(on)) < 0))
+		goto done;
+	r = evbuffer_enable_zerocopy_(bev->output, bev->ev_base, fd,
+	    threshold);
+done:
+	BEV_UNLOCK(bev);
+#else
+	if (!threshold)
+		r = 0;
+#endif
+	return r;
+}
+
 /*
  * Create a new buffered event object.
  *
@@ -568,10 +649,10 @@ static int
 be_socket_enable(struct bufferevent *bufev, short event)
 {
 	if (event & EV_READ &&
-	    bufferevent_add_event_(&bufev->ev_read, &bufev->timeout_read) == -1)
+	    bufferevent_add_event_(&bufev->ev_read, BEV_EV_TIMEOUT_READ(bufev)) == -1)
 			return -1;
 	if (event & EV_WRITE &&
-	    bufferevent_add_event_(&bufev->ev_write, &bufev->timeout_write) == -1)
+	    bufferevent_add_event_(&bufev->ev_write, BEV_EV_TIMEOUT_WRITE(bufev)) == -1)
 			return -1;
 	return 0;
 }
@@ -601,6 +682,10 @@ be_socket_destruct(struct bufferevent *bufev)
 
 	fd = event_get_fd(&bufev->ev_read);
 
+	/* The kernel may still be sending from the output buffer. */
+	if (bufev->output->zerocopy)
+		evbuffer_detach_zerocopy_(bufev->output);
+
 	if ((bufev_p->options & BEV_OPT_CLOSE_ON_FREE) && fd >= 0)
 		EVUTIL_CLOSESOCKET(fd);
 
@@ -626,6 +711,10 @@ be_socket_setfd(struct bufferevent *bufev, evutil_socket_t fd)
 	event_del(&bufev->ev_read);
 	event_del(&bufev->ev_write);
 
+	/* Zero-copy sends belong to the socket they went out on. */
+	if (bufev->output->zerocopy && fd != event_get_fd(&bufev->ev_read))
+		evbuffer_retire_zerocopy_(bufev->output);
+
 	evbuffer_unfreeze(bufev->input, 0);
 	evbuffer_unfreeze(bufev->output, 1);
 
@@ -678,6 +767,9 @@ bufferevent_base_set(struct event_base *base, struct bufferevent *bufev)
 
 	bufev->ev_base = base;
 
+	/* A common timeout only means something to the base it came from. */
+	bufferevent_update_ev_timeouts_(bufev);
+
 	res = event_base_set(base, &bufev->ev_read);
 	if (res == -1)
 		goto done;
@@ -0,0 +1,696 @@
+/*
+ * Copyright (c) 2009-2012 Niels Provos and Nick Mathewson
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+   @file bufferevent_uring.c
+
+   A socket bufferevent whose reads and writes are io_uring operations
+   submitted straight into (and out of) the chains of its evbuffers, rather
+   than recv()/send() calls made when the socket becomes ready.  It is
+   created by bufferevent_socket_new() on bases that use the io_uring backend
+   with EVENT_BASE_FLAG_IO_URING_COMPLETION, the same way the IOCP
+   bufferevent is on Windows.
+*/
+
+#include "event2/event-config.h"
+#include "evconfig-private.h"
+
+#ifdef EVENT__HAVE_IO_URING
+
+#ifdef EVENT__HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef EVENT__HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <poll.h>
+
+#include <sys/queue.h>
+
+#include "event2/util.h"
+#include "event2/bufferevent.h"
+#include "event2/buffer.h"
+#include "event2/buffer_compat.h"
+#include "event2/bufferevent_struct.h"
+#include "event2/event.h"
+#include "event-internal.h"
+#include "log-internal.h"
+#include "mm-internal.h"
+#include "bufferevent-internal.h"
+#include "evbuffer-internal.h"
+#include "util-internal.h"
+#include "uring-internal.h"
+
+/* How many iovecs we'll read into or write from in one operation. */
+#define URING_READ_IOVEC 4
+#define URING_WRITE_IOVEC 16
+
+/* How much we try to read at once when there is no high watermark. */
+#define URING_READ_SIZE 16384
+
+/* prototypes */
+static int be_uring_enable(struct bufferevent *, short);
+static int be_uring_disable(struct bufferevent *, short);
+static void be_uring_unlink(struct bufferevent *);
+static void be_uring_destruct(struct bufferevent *);
+static int be_uring_flush(struct bufferevent *, short, enum bufferevent_flush_mode);
+static int be_uring_ctrl(struct bufferevent *, enum bufferevent_ctrl_op, union bufferevent_ctrl_data *);
+
+struct bufferevent_uring {
+	struct bufferevent_private bev;
+	evutil_socket_t fd;
+	struct event_uring_op read_op;
+	struct event_uring_op write_op;
+	/** The pinned evbuffer space that read_op/write_op are using. */
+	struct evbuffer_iovec read_vecs[URING_READ_IOVEC];
+	struct evbuffer_iovec write_vecs[URING_WRITE_IOVEC];
+	int n_read_vecs;
+	int n_write_vecs;
+	/** How many bytes the operation in flight may transfer, or 0. */
+	size_t read_in_progress;
+	size_t write_in_progress;
+	unsigned ok : 1;
+	/** True iff read_op/write_op is waiting for readiness rather than
+	 * transferring data. */
+	unsigned read_polling : 1;
+	unsigned write_polling : 1;
+	/** True iff the last transfer drained the socket (or filled its send
+	 * buffer), so that the next one should wait for readiness first. */
+	unsigned read_poll_first : 1;
+	unsigned write_poll_first : 1;
+	/** True iff a write poll has just told us that the socket is
+	 * writable. */
+	unsigned write_ready : 1;
+	unsigned read_added : 1;
+	unsigned write_added : 1;
+};
+
+const struct bufferevent_ops bufferevent_ops_uring = {
+	"socket_uring",
+	evutil_offsetof(struct bufferevent_uring, bev.bev),
+	be_uring_enable,
+	be_uring_disable,
+	be_uring_unlink,
+	be_uring_destruct,
+	bufferevent_generic_adj_timeouts_,
+	be_uring_flush,
+	be_uring_ctrl,
+};
+
+static inline void
+be_uring_run_eventcb(struct bufferevent *bev, short what, int options)
+{ bufferevent_run_eventcb_(bev, what, options|BEV_TRIG_DEFER_CALLBACKS); }
+
+static inline void
+be_uring_trigger_nolock(struct bufferevent *bev, short what, int options)
+{ bufferevent_trigger_nolock_(bev, what, options|BEV_TRIG_DEFER_CALLBACKS); }
+
+static inline struct bufferevent_uring *
+upcast(struct bufferevent *bev)
+{
+	struct bufferevent_uring *bev_u;
+	if (!BEV_IS_URING(bev))
+		return NULL;
+	bev_u = EVUTIL_UPCAST(bev, struct bufferevent_uring, bev.bev);
+	return bev_u;
+}
+
+static inline struct bufferevent_uring *
+upcast_read(struct event_uring_op *op)
+{
+	struct bufferevent_uring *bev_u;
+	bev_u = EVUTIL_UPCAST(op, struct bufferevent_uring, read_op);
+	EVUTIL_ASSERT(BEV_IS_URING(&bev_u->bev.bev));
+	return bev_u;
+}
+
+static inline struct bufferevent_uring *
+upcast_write(struct event_uring_op *op)
+{
+	struct bufferevent_uring *bev_u;
+	bev_u = EVUTIL_UPCAST(op, struct bufferevent_uring, write_op);
+	EVUTIL_ASSERT(BEV_IS_URING(&bev_u->bev.bev));
+	return bev_u;
+}
+
+#define READ_BUSY(bev_u) ((bev_u)->read_in_progress || (bev_u)->read_polling)
+#define WRITE_BUSY(bev_u) ((bev_u)->write_in_progress || (bev_u)->write_polling)
+
+/* While an operation is in flight there is no event to keep the loop
+ * running, so we hold a virtual event for it, as the IOCP code does. */
+static void
+bev_uring_del_write(struct bufferevent_uring *beu)
+{
+	struct bufferevent *bev = &beu->bev.bev;
+
+	if (beu->write_added) {
+		beu->write_added = 0;
+		event_base_del_virtual_(bev->ev_base);
+	}
+}
+
+static void
+bev_uring_del_read(struct bufferevent_uring *beu)
+{
+	struct bufferevent *bev = &beu->bev.bev;
+
+	if (beu->read_added) {
+		beu->read_added = 0;
+		event_base_del_virtual_(bev->ev_base);
+	}
+}
+
+static void
+bev_uring_add_write(struct bufferevent_uring *beu)
+{
+	struct bufferevent *bev = &beu->bev.bev;
+
+	if (!beu->write_added) {
+		beu->write_added = 1;
+		event_base_add_virtual_(bev->ev_base);
+	}
+}
+
+static void
+bev_uring_add_read(struct bufferevent_uring *beu)
+{
+	struct bufferevent *bev = &beu->bev.bev;
+
+	if (!beu->read_added) {
+		beu->read_added = 1;
+		event_base_add_virtual_(bev->ev_base);
+	}
+}
+
+static void
+bev_uring_consider_writing(struct bufferevent_uring *beu)
+{
+	size_t at_most;
+	int limit, n, res;
+	struct bufferevent *bev = &beu->bev.bev;
+
+again:
+	/* Don't write if there's a write in progress, or we do not
+	 * want to write, or when there's nothing left to write. */
+	if (WRITE_BUSY(beu) || beu->bev.connecting)
+		return;
+	if (!beu->ok || !(bev->enabled&EV_WRITE) ||
+	    !evbuffer_get_length(bev->output) || beu->bev.write_suspended) {
+		bev_uring_del_write(beu);
+		return;
+	}
+
+	if (beu->write_poll_first)
+		goto poll;
+
+	at_most = evbuffer_get_length(bev->output);
+	limit = (int)bufferevent_get_write_max_(&beu->bev);
+	if (at_most >= (size_t)limit && limit >= 0)
+		at_most = limit;
+
+	n = evbuffer_pin_write_vecs_(bev->output, at_most,
+	    beu->write_vecs, URING_WRITE_IOVEC);
+	if (n < 0)
+		goto err;
+	if (n == 0) {
+		/* The next chain is a file segment that needs sendfile().
+		 * Wait until the socket is writable, then send it the
+		 * ordinary way. */
+		if (!beu->write_ready)
+			goto poll;
+		beu->write_ready = 0;
+		res = evbuffer_write_atmost(bev->output, beu->fd, at_most);
+		if (res < 0 && !EVUTIL_ERR_RW_RETRIABLE(errno))
+			goto err;
+		beu->write_poll_first = 1;
+		if (res > 0) {
+			bufferevent_decrement_write_buckets_(&beu->bev, res);
+			BEV_RESET_GENERIC_WRITE_TIMEOUT(bev);
+			be_uring_trigger_nolock(bev, EV_WRITE, 0);
+		}
+		goto again;
+	}
+
+	bufferevent_incref_(bev);
+	if (event_uring_writev_(bev->ev_base, beu->fd,
+		beu->write_vecs, n, &beu->write_op) < 0) {
+		evbuffer_commit_pinned_write_(bev->output, n, 0);
+		bufferevent_decref_(bev);
+		goto err;
+	}
+	beu->write_ready = 0;
+	beu->n_write_vecs = n;
+	beu->write_in_progress = at_most;
+	bufferevent_decrement_write_buckets_(&beu->bev, at_most);
+	bev_uring_add_write(beu);
+	return;
+
+poll:
+	bufferevent_incref_(bev);
+	if (event_uring_poll_(bev->ev_base, beu->fd, EV_WRITE,
+		&beu->write_op) < 0) {
+		bufferevent_decref_(bev);
+		goto err;
+	}
+	beu->write_polling = 1;
+	bev_uring_add_write(beu);
+	return;
+
+err:
+	bev_uring_del_write(beu);
+	bufferevent_disable(bev, EV_WRITE);
+	be_uring_run_eventcb(bev, BEV_EVENT_WRITING|BEV_EVENT_ERROR, 0);
+}
+
+static void
+bev_uring_consider_reading(struct bufferevent_uring *beu)
+{
+	size_t cur_size;
+	size_t read_high;
+	size_t at_most;
+	int limit, n;
+	struct bufferevent *bev = &beu->bev.bev;
+
+	/* Don't read if there is a read in progress, or we do not
+	 * want to read. */
+	if (READ_BUSY(beu) || beu->bev.connecting)
+		return;
+	if (!beu->ok || !(bev->enabled&EV_READ) || beu->bev.read_suspended) {
+		bev_uring_del_read(beu);
+		return;
+	}
+
+	/* Don't read if we're full */
+	cur_size = evbuffer_get_length(bev->input);
+	read_high = bev->wm_read.high;
+	if (read_high) {
+		if (cur_size >= read_high) {
+			bev_uring_del_read(beu);
+			return;
+		}
+		at_most = read_high - cur_size;
+		if (at_most > URING_READ_SIZE)
+			at_most = URING_READ_SIZE;
+	} else {
+		at_most = URING_READ_SIZE;
+	}
+
+	limit = (int)bufferevent_get_read_max_(&beu->bev);
+	if (at_most >= (size_t)limit && limit >= 0)
+		at_most = limit;
+
+	bufferevent_incref_(bev);
+
+	if (beu->read_poll_first) {
+		if (event_uring_poll_(bev->ev_base, beu->fd, EV_READ,
+			&beu->read_op) < 0)
+			goto err;
+		beu->read_polling = 1;
+		bev_uring_add_read(beu);
+		return;
+	}
+
+	n = evbuffer_pin_read_space_(bev->input, at_most,
+	    beu->read_vecs, URING_READ_IOVEC);
+	if (n < 0)
+		goto err;
+	if (event_uring_readv_(bev->ev_base, beu->fd, beu->read_vecs, n,
+		&beu->read_op) < 0) {
+		evbuffer_commit_pinned_read_(bev->input, beu->read_vecs, n, 0);
+		goto err;
+	}
+	beu->n_read_vecs = n;
+	beu->read_in_progress = at_most;
+	bufferevent_decrement_read_buckets_(&beu->bev, at_most);
+	bev_uring_add_read(beu);
+	return;
+
+err:
+	bufferevent_decref_(bev);
+	bev_uring_del_read(beu);
+	bufferevent_disable(bev, EV_READ);
+	be_uring_run_eventcb(bev, BEV_EVENT_READING|BEV_EVENT_ERROR, 0);
+}
+
+static void
+be_uring_outbuf_callback(struct evbuffer *buf,
+    const struct evbuffer_cb_info *cbinfo,
+    void *arg)
+{
+	struct bufferevent *bev = arg;
+	struct bufferevent_uring *bev_uring = upcast(bev);
+
+	/* If we added data to the outbuf and were not writing before,
+	 * we may want to write now. */
+
+	bufferevent_incref_and_lock_(bev);
+
+	if (cbinfo->n_added)
+		bev_uring_consider_writing(bev_uring);
+
+	bufferevent_decref_and_unlock_(bev);
+}
+
+static void
+be_uring_inbuf_callback(struct evbuffer *buf,
+    const struct evbuffer_cb_info *cbinfo,
+    void *arg)
+{
+	struct bufferevent *bev = arg;
+	struct bufferevent_uring *bev_uring = upcast(bev);
+
+	/* If we drained data from the inbuf and were not reading before,
+	 * we may want to read now */
+
+	bufferevent_incref_and_lock_(bev);
+
+	if (cbinfo->n_deleted)
+		bev_uring_consider_reading(bev_uring);
+
+	bufferevent_decref_and_unlock_(bev);
+}
+
+static int
+be_uring_enable(struct bufferevent *buf, short what)
+{
+	struct bufferevent_uring *bev_uring = upcast(buf);
+
+	if (what & EV_READ)
+		BEV_RESET_GENERIC_READ_TIMEOUT(buf);
+	if (what & EV_WRITE)
+		BEV_RESET_GENERIC_WRITE_TIMEOUT(buf);
+
+	/* Until we have a socket, or while we're connecting, there's
+	 * nothing to launch; we'll be called again once there is. */
+	if (!bev_uring->ok || bev_uring->bev.connecting)
+		return 0;
+
+	/* If we newly enable reading or writing, and we aren't reading or
+	   writing already, consider launching a new read or write. */
+
+	if (what & EV_READ)
+		bev_uring_consider_reading(bev_uring);
+	if (what & EV_WRITE)
+		bev_uring_consider_writing(bev_uring);
+	return 0;
+}
+
+static int
+be_uring_disable(struct bufferevent *bev, short what)
+{
+	struct bufferevent_uring *bev_uring = upcast(bev);
+
+	/* A read in flight would keep adding to the input buffer, so we
+	 * cancel it.  A write that has been handed to the kernel may
+	 * already be partly done; we let it finish, and just don't launch
+	 * another. */
+	if (what & EV_READ) {
+		BEV_DEL_GENERIC_READ_TIMEOUT(bev);
+		if (READ_BUSY(bev_uring))
+			event_uring_cancel_(bev->ev_base, &bev_uring->read_op);
+	}
+	/* Don't actually disable the write if we are trying to connect. */
+	if ((what & EV_WRITE) && !bev_uring->bev.connecting) {
+		BEV_DEL_GENERIC_WRITE_TIMEOUT(bev);
+		if (bev_uring->write_polling)
+			event_uring_cancel_(bev->ev_base, &bev_uring->write_op);
+	}
+
+	return 0;
+}
+
+static void
+be_uring_unlink(struct bufferevent *bev)
+{
+	struct bufferevent_uring *bev_uring = upcast(bev);
+
+	/* Our operations hold references to the bufferevent, so it can't be
+	 * destroyed until they're done.  Make sure they finish soon. */
+	bev_uring->ok = 0;
+	if (READ_BUSY(bev_uring))
+		event_uring_cancel_(bev->ev_base, &bev_uring->read_op);
+	if (WRITE_BUSY(bev_uring))
+		event_uring_cancel_(bev->ev_base, &bev_uring->write_op);
+}
+
+static void
+be_uring_destruct(struct bufferevent *bev)
+{
+	struct bufferevent_uring *bev_uring = upcast(bev);
+	struct bufferevent_private *bev_p = BEV_UPCAST(bev);
+
+	EVUTIL_ASSERT(!READ_BUSY(bev_uring) && !WRITE_BUSY(bev_uring));
+
+	bev_uring_del_read(bev_uring);
+	bev_uring_del_write(bev_uring);
+
+	if (bev_uring->fd != EVUTIL_INVALID_SOCKET &&
+	    (bev_p->options & BEV_OPT_CLOSE_ON_FREE)) {
+		evutil_closesocket(bev_uring->fd);
+		bev_uring->fd = EVUTIL_INVALID_SOCKET;
+	}
+
+	evutil_getaddrinfo_cancel_async_(bev_p->dns_request);
+}
+
+static int
+be_uring_flush(struct bufferevent *bev, short what,
+    enum bufferevent_flush_mode mode)
+{
+	return 0;
+}
+
+static void
+read_complete(struct event_uring_op *op, int res)
+{
+	struct bufferevent_uring *bev_u = upcast_read(op);
+	struct bufferevent *bev = &bev_u->bev.bev;
+	short what = BEV_EVENT_READING;
+	size_t nbytes = res > 0 ? (size_t)res : 0;
+	int was_polling;
+
+	BEV_LOCK(bev);
+	EVUTIL_ASSERT(READ_BUSY(bev_u));
+
+	was_polling = bev_u->read_polling;
+	if (was_polling) {
+		bev_u->read_polling = 0;
+		if (res >= 0)
+			bev_u->read_poll_first = 0;
+	} else {
+		size_t requested = bev_u->read_in_progress;
+		evbuffer_commit_pinned_read_(bev->input, bev_u->read_vecs,
+		    bev_u->n_read_vecs, nbytes);
+		bev_u->read_in_progress = 0;
+		if (nbytes < requested)
+			bufferevent_decrement_read_buckets_(&bev_u->bev,
+			    -(ev_ssize_t)(requested - nbytes));
+		/* If we emptied the socket, wait for it to become readable
+		 * before asking again. */
+		bev_u->read_poll_first = res == -EAGAIN ||
+		    (res > 0 && nbytes < requested);
+	}
+
+	if (bev_u->ok) {
+		if (!was_polling && res > 0) {
+			if (bev->enabled & EV_READ) {
+				BEV_RESET_GENERIC_READ_TIMEOUT(bev);
+				be_uring_trigger_nolock(bev, EV_READ, 0);
+			}
+		} else if (!was_polling && res == 0) {
+			what |= BEV_EVENT_EOF;
+			bufferevent_disable(bev, EV_READ);
+			be_uring_run_eventcb(bev, what, 0);
+		} else if (res < 0 && res != -EAGAIN && res != -ECANCELED) {
+			what |= BEV_EVENT_ERROR;
+			errno = -res;
+			bufferevent_disable(bev, EV_READ);
+			be_uring_run_eventcb(bev, what, 0);
+		}
+	}
+
+	bev_uring_consider_reading(bev_u);
+
+	bufferevent_decref_and_unlock_(bev);
+}
+
+static void
+write_complete(struct event_uring_op *op, int res)
+{
+	struct bufferevent_uring *bev_u = upcast_write(op);
+	struct bufferevent *bev = &bev_u->bev.bev;
+	short what = BEV_EVENT_WRITING;
+	size_t nbytes = res > 0 ? (size_t)res : 0;
+	int was_polling;
+
+	BEV_LOCK(bev);
+	EVUTIL_ASSERT(WRITE_BUSY(bev_u));
+
+	was_polling = bev_u->write_polling;
+	if (was_polling) {
+		bev_u->write_polling = 0;
+		if (res >= 0) {
+			bev_u->write_poll_first = 0;
+			bev_u->write_ready = 1;
+		}
+	} else {
+		size_t requested = bev_u->write_in_progress;
+		evbuffer_commit_pinned_write_(bev->output,
+		    bev_u->n_write_vecs, nbytes);
+		bev_u->write_in_progress = 0;
+		if (nbytes < requested)
+			bufferevent_decrement_write_buckets_(&bev_u->bev,
+			    -(ev_ssize_t)(requested - nbytes));
+		/* If the send buffer filled up, wait for it to drain before
+		 * trying again. */
+		bev_u->write_poll_first = res == -EAGAIN ||
+		    (res > 0 && nbytes < requested);
+	}
+
+	if (bev_u->ok) {
+		if (!was_polling && res > 0) {
+			if (bev->enabled & EV_WRITE) {
+				BEV_RESET_GENERIC_WRITE_TIMEOUT(bev);
+				be_uring_trigger_nolock(bev, EV_WRITE, 0);
+			}
+		} else if (!was_polling && res == 0) {
+			what |= BEV_EVENT_EOF;
+			bufferevent_disable(bev, EV_WRITE);
+			be_uring_run_eventcb(bev, what, 0);
+		} else if (res < 0 && res != -EAGAIN && res != -ECANCELED) {
+			what |= BEV_EVENT_ERROR;
+			errno = -res;
+			bufferevent_disable(bev, EV_WRITE);
+			be_uring_run_eventcb(bev, what, 0);
+		}
+	}
+
+	bev_uring_consider_writing(bev_u);
+
+	bufferevent_decref_and_unlock_(bev);
+}
+
+struct bufferevent *
+bufferevent_uring_new_(struct event_base *base,
+    evutil_socket_t fd, int options)
+{
+	struct bufferevent_uring *bev_u;
+	struct bufferevent *bev;
+
+	if (!event_base_uring_completion_enabled_(base))
+		return NULL;
+
+	if (!(bev_u = mm_calloc(1, sizeof(struct bufferevent_uring))))
+		return NULL;
+
+	bev = &bev_u->bev.bev;
+	if (bufferevent_init_common_(&bev_u->bev, base, &bufferevent_ops_uring,
+		options)<0) {
+		mm_free(bev_u);
+		return NULL;
+	}
+
+	evbuffer_add_cb(bev->input, be_uring_inbuf_callback, bev);
+	evbuffer_add_cb(bev->output, be_uring_outbuf_callback, bev);
+
+	event_uring_op_init_(base, &bev_u->read_op, read_complete);
+	event_uring_op_init_(base, &bev_u->write_op, write_complete);
+
+	bufferevent_init_generic_timeout_cbs_(bev);
+
+	bev_u->fd = fd;
+	bev_u->ok = fd >= 0;
+
+	return bev;
+}
+
+void
+bufferevent_uring_set_connected_(struct bufferevent *bev)
+{
+	struct bufferevent_uring *bev_uring = upcast(bev);
+
+	/* The socket writecb borrowed ev_write to wait for the connect;
+	 * give it back to the timeout code. */
+	event_del(&bev->ev_read);
+	event_del(&bev->ev_write);
+	bufferevent_init_generic_timeout_cbs_(bev);
+	bev_uring->ok = bev_uring->fd >= 0;
+	/* Now's a good time to consider reading/writing */
+	be_uring_enable(bev, bev->enabled);
+}
+
+static int
+be_uring_ctrl(struct bufferevent *bev, enum bufferevent_ctrl_op op,
+    union bufferevent_ctrl_data *data)
+{
+	struct bufferevent_uring *bev_u = upcast(bev);
+
+	switch (op) {
+	case BEV_CTRL_GET_FD:
+		data->fd = bev_u->fd;
+		return 0;
+	case BEV_CTRL_SET_FD:
+		if (data->fd == bev_u->fd)
+			return 0;
+		/* Anything still in flight is on the old fd. */
+		if (READ_BUSY(bev_u))
+			event_uring_cancel_(bev->ev_base, &bev_u->read_op);
+		if (WRITE_BUSY(bev_u))
+			event_uring_cancel_(bev->ev_base, &bev_u->write_op);
+		bev_u->fd = data->fd;
+		bev_u->ok = data->fd >= 0;
+		bev_u->read_poll_first = bev_u->write_poll_first = 0;
+		if (bev_u->ok)
+			be_uring_enable(bev, bev->enabled);
+		return 0;
+	case BEV_CTRL_CANCEL_ALL:
+		BEV_DEL_GENERIC_READ_TIMEOUT(bev);
+		BEV_DEL_GENERIC_WRITE_TIMEOUT(bev);
+		if (READ_BUSY(bev_u))
+			event_uring_cancel_(bev->ev_base, &bev_u->read_op);
+		if (WRITE_BUSY(bev_u))
+			event_uring_cancel_(bev->ev_base, &bev_u->write_op);
+		if (bev_u->fd != EVUTIL_INVALID_SOCKET &&
+		    (bev_u->bev.options & BEV_OPT_CLOSE_ON_FREE)) {
+			evutil_closesocket(bev_u->fd);
+			bev_u->fd = EVUTIL_INVALID_SOCKET;
+		}
+		bev_u->ok = 0;
+		return 0;
+	case BEV_CTRL_GET_UNDERLYING:
+	default:
+		return -1;
+	}
+}
+
+#endif /* EVENT__HAVE_IO_URING */
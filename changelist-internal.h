@@ -77,6 +77,8 @@ struct event_change {
 #define EV_CHANGE_PERSIST EV_PERSIST
 /* Set for adding edge-triggered events. */
 #define EV_CHANGE_ET      EV_ET
+/* Set for events that want exclusive wakeups (EV_EXCLUSIVE). */
+#define EV_CHANGE_EXCLUSIVE 0x40
 
 /* The value of fdinfo_size that a backend should use if it is letting
  * changelist handle its add and delete functions. */
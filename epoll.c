@@ -87,6 +87,12 @@
 struct epollop {
 	struct epoll_event *events; //epoll_event数组
 	int nevents; //epoll_event数组长度
+	/* Bounds on nevents. */
+	int min_nevents;
+	int max_nevents;
+	/* How many dispatches in a row have used at most a quarter of
+	 * 'events'. */
+	int n_underused;
 	int epfd; //epoll的文件描述符
 #ifdef USING_TIMERFD
 	int timerfd;
@@ -129,6 +135,10 @@ const struct eventop epollops = {
 
 #define INITIAL_NEVENT 32
 #define MAX_NEVENT 4096
+/* The most events we'll ever ask epoll_wait for. */
+#define EPOLL_NEVENT_LIMIT (INT_MAX / (int)sizeof(struct epoll_event))
+/* How many underused dispatches in a row make us halve the array. */
+#define EPOLL_SHRINK_AFTER 64
 
 /* On Linux kernels at least up to 2.6.24.4, epoll can't handle timeout
  * values bigger than (LONG_MAX - 999ULL)/HZ.  HZ in the wild can be
@@ -168,14 +178,24 @@ epoll_init(struct event_base *base)
 	epollop->epfd = epfd;
 
 	/* Initialize fields */
-	//这里实际上开辟的是epoll_event的数组，数组元素为epoll_event类型，元素个数初始化为32
-	epollop->events = mm_calloc(INITIAL_NEVENT, sizeof(struct epoll_event));
+	epollop->min_nevents = base->backend_min_events ?
+	    base->backend_min_events : INITIAL_NEVENT;
+	epollop->max_nevents = base->backend_max_events ?
+	    base->backend_max_events : MAX_NEVENT;
+	if (epollop->max_nevents > EPOLL_NEVENT_LIMIT)
+		epollop->max_nevents = EPOLL_NEVENT_LIMIT;
+	if (epollop->min_nevents > epollop->max_nevents)
+		epollop->min_nevents = epollop->max_nevents;
+
+	//这里实际上开辟的是epoll_event的数组，数组元素为epoll_event类型，元素个数初始化为min_nevents
+	epollop->events = mm_calloc(epollop->min_nevents,
+	    sizeof(struct epoll_event));
 	if (epollop->events == NULL) {
 		mm_free(epollop);
 		close(epfd);
 		return (NULL);
 	}
-	epollop->nevents = INITIAL_NEVENT; //events数组大小
+	epollop->nevents = epollop->min_nevents; //events数组大小
 
 	if ((base->flags & EVENT_BASE_FLAG_EPOLL_USE_CHANGELIST) != 0 ||
 	    ((base->flags & EVENT_BASE_FLAG_IGNORE_ENV) == 0 &&
@@ -289,6 +309,23 @@ epoll_apply_one_change(struct event_base *base,
 
 	memset(&epev, 0, sizeof(epev));
 	epev.data.fd = ch->fd;
+
+#ifdef EPOLLEXCLUSIVE
+	if ((ch->read_change|ch->write_change|ch->close_change) &
+	    EV_CHANGE_EXCLUSIVE) {
+		/* epoll won't modify an exclusive fd in place, so take it out
+		 * and add it back.  Nor will it combine EPOLLEXCLUSIVE with
+		 * EPOLLRDHUP. */
+		if (op == EPOLL_CTL_MOD) {
+			(void) epoll_ctl(epollop->epfd, EPOLL_CTL_DEL, ch->fd,
+			    &epev);
+			op = EPOLL_CTL_ADD;
+		}
+		if (op == EPOLL_CTL_ADD && !(events & EPOLLRDHUP))
+			events |= EPOLLEXCLUSIVE;
+	}
+#endif
+
 	epev.events = events;
 	if (epoll_ctl(epollop->epfd, op, ch->fd, &epev) == 0) {
 		event_debug((PRINT_CHANGES(op, epev.events, ch, "okay")));
@@ -323,6 +360,19 @@ epoll_apply_one_change(struct event_base *base,
 			 * same file into the same fd gives you the same epitem
 			 * rather than a fresh one.  For the second case,
 			 * we must retry with MOD. */
+#ifdef EPOLLEXCLUSIVE
+			/* ...or, for an exclusive fd, with DEL and ADD. */
+			if ((epev.events & EPOLLEXCLUSIVE) &&
+			    epoll_ctl(epollop->epfd, EPOLL_CTL_DEL, ch->fd,
+				&epev) == 0 &&
+			    epoll_ctl(epollop->epfd, EPOLL_CTL_ADD, ch->fd,
+				&epev) == 0) {
+				event_debug(("Epoll ADD(%d) on %d retried as DEL and ADD; succeeded.",
+					(int)epev.events,
+					ch->fd));
+				return 0;
+			}
+#endif
 			if (epoll_ctl(epollop->epfd, EPOLL_CTL_MOD, ch->fd, &epev) == -1) {
 				event_warn("Epoll ADD(%d) on %d retried as MOD; that failed too",
 				    (int)epev.events, ch->fd);
@@ -392,6 +442,8 @@ epoll_nochangelist_add(struct event_base *base, evutil_socket_t fd,
 	if (events & EV_CLOSED)
 		ch.close_change = EV_CHANGE_ADD |
 		    (events & EV_ET);
+	if (events & EV_EXCLUSIVE)
+		ch.read_change |= EV_CHANGE_EXCLUSIVE;
 	//ch中的read_change和write_change用来告诉epoll_ctl，在读端和写端分别需要执行什么操作，
 	//ch中的old_event告诉epoll_ctl，fd对应的所有event有哪些感兴趣的事件类型
 
@@ -415,10 +467,93 @@ epoll_nochangelist_del(struct event_base *base, evutil_socket_t fd,
 	if (events & EV_CLOSED)
 		ch.close_change = EV_CHANGE_DEL |
 		    (events & EV_ET);
+	if (events & EV_EXCLUSIVE)
+		ch.read_change |= EV_CHANGE_EXCLUSIVE;
 
 	return epoll_apply_one_change(base, base->evbase, &ch);
 }
 
+/* The current time in microseconds, from a clock that suits spinning. */
+static ev_int64_t
+epoll_now_usec(void)
+{
+	struct timeval tv;
+#ifdef HAVE_POSIX_MONOTONIC
+	struct timespec ts;
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+		return (ev_int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+	evutil_gettimeofday(&tv, NULL);
+	return (ev_int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/* Poll without blocking for up to base->busy_poll_usec, or for *timeout
+ * msec if that is sooner, and take the time spent off *timeout.  Return
+ * what the last epoll_wait() did.  Called without the lock. */
+static int
+epoll_busy_poll(struct event_base *base, struct epollop *epollop,
+    long *timeout)
+{
+	ev_int64_t start, spent, limit = base->busy_poll_usec;
+	int res;
+
+	if (*timeout >= 0 && (ev_int64_t)*timeout * 1000 < limit)
+		limit = (ev_int64_t)*timeout * 1000;
+
+	start = epoll_now_usec();
+	do {
+		res = epoll_wait(epollop->epfd, epollop->events,
+		    epollop->nevents, 0);
+		if (res != 0)
+			return res;
+		spent = epoll_now_usec() - start;
+	} while (spent < limit);
+
+	if (*timeout > 0) {
+		*timeout -= (long)(spent / 1000);
+		if (*timeout < 0)
+			*timeout = 0;
+	}
+	return 0;
+}
+
+/* Grow or shrink epollop->events, now that a dispatch has filled 'res' of
+ * its slots. */
+static void
+epoll_resize_events(struct epollop *epollop, int res)
+{
+	int new_nevents;
+	struct epoll_event *new_events;
+
+	//如果epoll_wait返回的激活事件数量达到了设置的nevents，并且还没有达到设置的事件上限
+	//说明此时真正激活的事件数量可能超过nevents，那么就重新设置epollop中的nevents和events
+	if (res == epollop->nevents && epollop->nevents < epollop->max_nevents) {
+		/* We used all of the event space this time.  We should
+		   be ready for more events next time. */
+		new_nevents = epollop->nevents > epollop->max_nevents / 2 ?
+		    epollop->max_nevents : epollop->nevents * 2;
+	} else if (res <= epollop->nevents / 4 &&
+	    epollop->nevents > epollop->min_nevents) {
+		/* Only shrink after a long run of quiet dispatches, so that
+		   bursty traffic doesn't make us realloc back and forth. */
+		if (++epollop->n_underused < EPOLL_SHRINK_AFTER)
+			return;
+		new_nevents = epollop->nevents / 2 < epollop->min_nevents ?
+		    epollop->min_nevents : epollop->nevents / 2;
+	} else {
+		epollop->n_underused = 0;
+		return;
+	}
+
+	epollop->n_underused = 0;
+	new_events = mm_realloc(epollop->events,
+	    new_nevents * sizeof(struct epoll_event));
+	if (new_events) {
+		epollop->events = new_events;
+		epollop->nevents = new_nevents;
+	}
+}
+
 //事件监听，封装了epoll_wait()
 static int
 epoll_dispatch(struct event_base *base, struct timeval *tv)
@@ -469,7 +604,11 @@ epoll_dispatch(struct event_base *base, struct timeval *tv)
 
 	EVBASE_RELEASE_LOCK(base, th_base_lock);
 
-	res = epoll_wait(epollop->epfd, events, epollop->nevents, timeout); //epoll开始监听，激活事件结果保存在events中，最多接受nevents个激活事件
+	res = 0;
+	if (base->busy_poll_usec > 0 && timeout != 0)
+		res = epoll_busy_poll(base, epollop, &timeout);
+	if (res == 0)
+		res = epoll_wait(epollop->epfd, events, epollop->nevents, timeout); //epoll开始监听，激活事件结果保存在events中，最多接受nevents个激活事件
 
 	EVBASE_ACQUIRE_LOCK(base, th_base_lock);
 
@@ -509,21 +648,7 @@ epoll_dispatch(struct event_base *base, struct timeval *tv)
 
 		evmap_io_active_(base, events[i].data.fd, ev | EV_ET); //将所有发生了读/写事件的event插入到激活队列中
 	}
-	//如果epoll_wait返回的激活事件数量达到了设置的nevents，并且还没有达到设置的事件上限
-	//说明此时真正激活的事件数量可能超过nevents，那么就重新设置epollop中的nevents和events
-	if (res == epollop->nevents && epollop->nevents < MAX_NEVENT) {
-		/* We used all of the event space this time.  We should
-		   be ready for more events next time. */
-		int new_nevents = epollop->nevents * 2;
-		struct epoll_event *new_events;
-
-		new_events = mm_realloc(epollop->events,
-		    new_nevents * sizeof(struct epoll_event));
-		if (new_events) {
-			epollop->events = new_events;
-			epollop->nevents = new_nevents;
-		}
-	}
+	epoll_resize_events(epollop, res);
 
 	return (0);
 }
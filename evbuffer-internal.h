@@ -34,6 +34,7 @@ extern "C" {
 #include "event2/event-config.h"
 #include "evconfig-private.h"
 #include "event2/util.h"
+#include "event2/buffer_compat.h"
 #include "event2/event_struct.h"
 #include "util-internal.h"
 #include "defer-internal.h"
@@ -77,6 +78,7 @@ struct evbuffer_cb_entry {
 
 struct bufferevent;
 struct evbuffer_chain;
+struct evbuffer_zerocopy;
 struct evbuffer {
 	/** The first chain in this buffer's linked list of chains. */
 	struct evbuffer_chain *first;
@@ -153,6 +155,18 @@ struct evbuffer {
 	/** The parent bufferevent object this evbuffer belongs to.
 	 * NULL if the evbuffer stands alone. */
 	struct bufferevent *parent;
+
+	/** If set, new data chains are taken from (and given back to) this
+	 * pool instead of being malloc()ed and freed every time. */
+	struct evbuffer_chain_pool *chain_pool;
+
+	/** If set, this evbuffer was allocated from this arena, and takes its
+	 * small data chains from it too. */
+	struct evbuffer_arena *arena;
+
+	/** If set, large writes are sent with MSG_ZEROCOPY, and this tracks
+	 * the sends whose memory the kernel may still be reading. */
+	struct evbuffer_zerocopy *zerocopy;
 };
 
 #if EVENT__SIZEOF_OFF_T < EVENT__SIZEOF_SIZE_T
@@ -200,6 +214,10 @@ struct evbuffer_chain {
 #define EVBUFFER_DANGLING	0x0040
 	/** a chain that is a referenced copy of another chain */
 #define EVBUFFER_MULTICAST	0x0080
+	/** a chain whose memory belongs to an evbuffer_chain_pool */
+#define EVBUFFER_POOLED		0x0100
+	/** a chain whose memory belongs to an evbuffer_arena */
+#define EVBUFFER_ARENA		0x0200
 
 	/** number of references to this chain */
 	int refcnt;
@@ -213,6 +231,14 @@ struct evbuffer_chain {
 	unsigned char *buffer;
 };
 
+/** Everything handed out of an evbuffer_arena starts on a multiple of
+ * this. */
+#define EVBUFFER_ARENA_ALIGNMENT 16
+/** The arena space that an allocation of 'n' bytes takes up. */
+#define EVBUFFER_ARENA_ROUNDUP(n)					\
+	(((n) + EVBUFFER_ARENA_ALIGNMENT - 1) &				\
+	    ~(size_t)(EVBUFFER_ARENA_ALIGNMENT - 1))
+
 /** callback for a reference chain; lets us know what to do with it when
  * we're done with it. Lives at the end of an evbuffer_chain with the
  * EVBUFFER_REFERENCE flag set */
@@ -326,6 +352,48 @@ int evbuffer_read_setup_vecs_(struct evbuffer *buf, ev_ssize_t howmuch,
     struct evbuffer_iovec *vecs, int n_vecs, struct evbuffer_chain ***chainp,
     int exact);
 
+/** Helper for completion-based reads: make room for 'howmuch' bytes at the
+ * end of 'buf', fill in up to 'n_vecs' iovecs pointing to it, pin the chains
+ * that hold it, and freeze the end of the buffer.  Returns the number of
+ * iovecs used, or -1 on failure. */
+int evbuffer_pin_read_space_(struct evbuffer *buf, size_t howmuch,
+    struct evbuffer_iovec *vecs, int n_vecs);
+/** Finish a read set up with evbuffer_pin_read_space_: account for 'nbytes'
+ * bytes having been read into 'vecs', unpin the chains, and unfreeze the end
+ * of the buffer. */
+void evbuffer_commit_pinned_read_(struct evbuffer *buf,
+    const struct evbuffer_iovec *vecs, int n_vecs, size_t nbytes);
+/** Helper for completion-based writes: fill in up to 'n_vecs' iovecs pointing
+ * to the first 'at_most' bytes of 'buf' (or all of it, if 'at_most' is
+ * negative), pin the chains that hold them, and freeze the start of the
+ * buffer.  Stops early at a chain that can only be written with sendfile().
+ * Returns the number of iovecs used, or -1 if the start is already frozen. */
+int evbuffer_pin_write_vecs_(struct evbuffer *buf, ev_ssize_t at_most,
+    struct evbuffer_iovec *vecs, int n_vecs);
+/** Finish a write set up with evbuffer_pin_write_vecs_: unpin the chains,
+ * unfreeze the start of the buffer, and drain the 'nbytes' bytes written. */
+void evbuffer_commit_pinned_write_(struct evbuffer *buf, int n_vecs,
+    size_t nbytes);
+
+/** Have evbuffer_write_atmost() send writes of at least 'threshold' bytes
+ * from 'buf' to 'fd' with MSG_ZEROCOPY, or stop doing so if 'threshold' is
+ * 0.  The caller must already have set SO_ZEROCOPY on the socket.
+ * Completions are reaped from an edge-triggered event on 'base', so 'base'
+ * must support EV_ET.  Returns 0 on success, or -1 if this platform or
+ * 'base' can't send without copying, or if sends on a socket retired with
+ * evbuffer_retire_zerocopy_() are still in flight. */
+int evbuffer_enable_zerocopy_(struct evbuffer *buf, struct event_base *base,
+    evutil_socket_t fd, size_t threshold);
+/** Stop sending from 'buf' with MSG_ZEROCOPY because the socket we were
+ * sending on is about to be replaced.  Sends the kernel may still be
+ * reading go on being reaped through our duplicate of the old socket. */
+void evbuffer_retire_zerocopy_(struct evbuffer *buf);
+/** Stop sending from 'buf' with MSG_ZEROCOPY because its owner is going
+ * away.  Sends the kernel may still be reading are reaped on their own
+ * until the kernel is done with them, or for a bounded time after it last
+ * said anything, and then their chains are freed. */
+void evbuffer_detach_zerocopy_(struct evbuffer *buf);
+
 /* Helper macro: copies an evbuffer_iovec in ei to a win32 WSABUF in i. */
 #define WSABUF_FROM_EVBUFFER_IOV(i,ei) do {		\
 		(i)->buf = (ei)->iov_base;		\
@@ -337,6 +405,14 @@ int evbuffer_read_setup_vecs_(struct evbuffer *buf, ev_ssize_t howmuch,
 /** Set the parent bufferevent object for buf to bev */
 void evbuffer_set_parent_(struct evbuffer *buf, struct bufferevent *bev);
 
+/** Create a new chain pool that caches at most 'max_cached' bytes of free
+ * chains in each of its size classes.  The caller holds the only reference
+ * to it. */
+struct evbuffer_chain_pool *evbuffer_chain_pool_new_(size_t max_cached);
+/** Drop a reference to a chain pool, freeing it once evbuffers and chains
+ * are no longer using it. */
+void evbuffer_chain_pool_decref_(struct evbuffer_chain_pool *pool);
+
 void evbuffer_invoke_callbacks_(struct evbuffer *buf);
 
 
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2007-2012 Niels Provos and Nick Mathewson
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef EVDGRAM_INTERNAL_H_INCLUDED_
+#define EVDGRAM_INTERNAL_H_INCLUDED_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "event2/util.h"
+#include "event2/dgram.h"
+
+/** Space to read a batch of datagrams into, kept from one read to the
+ * next. */
+struct evdgram_slab;
+
+/** One datagram (or, with 'segment' set, a run of them) to send. */
+struct evdgram_out {
+	const void *data;
+	size_t len;
+	/** The destination, or NULL on a connected socket. */
+	const struct sockaddr *addr;
+	int socklen;
+	/** If nonzero, 'data' is to be sent as datagrams of this many bytes
+	 * each (but the last) using UDP generic segmentation offload. */
+	size_t segment;
+};
+
+/** Allocate room to read up to 'n_msgs' datagrams of up to 'max_size'
+ * bytes each.  Returns NULL on failure. */
+struct evdgram_slab *evdgram_slab_new_(int n_msgs, size_t max_size);
+void evdgram_slab_free_(struct evdgram_slab *slab);
+
+/** Read as many datagrams from 'fd' as will fit in 'slab', with one
+ * system call where we can.  On success, set *msgs_out to the datagrams
+ * read and return how many there are.  They stay valid until the next
+ * read into 'slab'.  Return -1 if nothing could be read; the socket error
+ * says why. */
+int evdgram_recv_(evutil_socket_t fd, struct evdgram_slab *slab,
+    struct evdgram_msg **msgs_out);
+
+/** Send the 'n' datagrams in 'out' on 'fd', with as few system calls as we
+ * can.  Return how many were sent, stopping at the first that couldn't
+ * be; or -1 if that was the first, in which case the socket error says
+ * why. */
+int evdgram_sendv_(evutil_socket_t fd, const struct evdgram_out *out, int n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EVDGRAM_INTERNAL_H_INCLUDED_ */
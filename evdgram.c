@@ -0,0 +1,704 @@
+/*
+ * Copyright (c) 2007-2012 Niels Provos and Nick Mathewson
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * evdgram: batched reads and writes on datagram sockets.
+ *
+ * Reading: each time the socket is readable we make one recvmmsg() call
+ * into a slab of batch * max_size bytes that lives as long as the evdgram,
+ * and pass whatever it returned to the read callback in one go.  We don't
+ * loop until EAGAIN; if there is more, the socket is still readable and
+ * we'll be back after the other active events have had a turn.
+ *
+ * Writing: evdgram_send() copies the datagram onto a queue and adds the
+ * write event, so everything sent from the callbacks of one pass through
+ * the loop goes out together in one sendmmsg() on the next.  With
+ * EVDGRAM_OPT_GSO, a datagram for the same address as the one queued
+ * before it, and no bigger, is appended to that one instead, and the
+ * kernel splits them apart again (UDP_SEGMENT).
+ *
+ * The helpers that do the system calls are shared with evdns.
+ */
+
+#include "event2/event-config.h"
+#include "evconfig-private.h"
+
+#include <sys/types.h>
+#include <sys/queue.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#endif
+#include <errno.h>
+#include <string.h>
+#ifdef EVENT__HAVE_SYS_SOCKET_H
+#include <sys/socket.h>
+#endif
+#ifdef EVENT__HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
+#ifdef EVENT__HAVE_NETINET_IN_H
+#include <netinet/in.h>
+#endif
+#ifdef EVENT__HAVE_NETINET_UDP_H
+#include <netinet/udp.h>
+#endif
+
+#include "event2/dgram.h"
+#include "event2/event.h"
+#include "event2/event_struct.h"
+#include "event2/util.h"
+#include "evdgram-internal.h"
+#include "evthread-internal.h"
+#include "mm-internal.h"
+#include "util-internal.h"
+
+#if defined(EVENT__HAVE_SENDMMSG) && defined(UDP_SEGMENT)
+#define USE_GSO 1
+/* What the kernel will take in one UDP_SEGMENT send. */
+#define EVDGRAM_GSO_MAX_SEGMENTS 64
+#define EVDGRAM_GSO_MAX_BYTES 65000
+#endif
+
+/* How many datagrams evdgram_sendv_() hands the kernel at once. */
+#define EVDGRAM_SEND_CHUNK 32
+
+struct evdgram_slab {
+	int n_msgs;
+	size_t max_size;
+	unsigned char *buf;
+	struct sockaddr_storage *addrs;
+	struct evdgram_msg *msgs;
+#ifdef EVENT__HAVE_RECVMMSG
+	struct mmsghdr *hdrs;
+	struct iovec *iovs;
+#endif
+};
+
+struct evdgram_queued {
+	TAILQ_ENTRY(evdgram_queued) next;
+	struct sockaddr_storage addr;
+	int socklen;
+	size_t len;
+	/* If nonzero, 'data' holds datagrams of this size sent as one. */
+	size_t segment;
+	unsigned char *data;
+};
+
+TAILQ_HEAD(evdgram_queue, evdgram_queued);
+
+struct evdgram {
+	struct event_base *base;
+	evutil_socket_t fd;
+	struct event ev_read;
+	struct event ev_write;
+	void *lock;
+	evdgram_read_cb cb;
+	evdgram_error_cb errorcb;
+	void *user_data;
+	unsigned flags;
+	short refcnt;
+	int batch;
+	struct evdgram_slab *slab;
+	struct evdgram_queue queue;
+	int n_queued;
+	/* The last error that made us drop a queued datagram, not yet
+	 * reported to errorcb. */
+	int send_error;
+	unsigned enabled : 1;
+};
+
+#define LOCK(dg) EVLOCK_LOCK((dg)->lock, 0)
+#define UNLOCK(dg) EVLOCK_UNLOCK((dg)->lock, 0)
+
+struct evdgram_slab *
+evdgram_slab_new_(int n_msgs, size_t max_size)
+{
+	struct evdgram_slab *slab;
+
+	if (!(slab = mm_calloc(1, sizeof(*slab))))
+		return NULL;
+	slab->n_msgs = n_msgs;
+	slab->max_size = max_size;
+	slab->buf = mm_malloc(n_msgs * max_size);
+	slab->addrs = mm_calloc(n_msgs, sizeof(*slab->addrs));
+	slab->msgs = mm_calloc(n_msgs, sizeof(*slab->msgs));
+	if (!slab->buf || !slab->addrs || !slab->msgs)
+		goto err;
+#ifdef EVENT__HAVE_RECVMMSG
+	slab->hdrs = mm_calloc(n_msgs, sizeof(*slab->hdrs));
+	slab->iovs = mm_calloc(n_msgs, sizeof(*slab->iovs));
+	if (!slab->hdrs || !slab->iovs)
+		goto err;
+#endif
+	return slab;
+err:
+	evdgram_slab_free_(slab);
+	return NULL;
+}
+
+void
+evdgram_slab_free_(struct evdgram_slab *slab)
+{
+	if (slab->buf)
+		mm_free(slab->buf);
+	if (slab->addrs)
+		mm_free(slab->addrs);
+	if (slab->msgs)
+		mm_free(slab->msgs);
+#ifdef EVENT__HAVE_RECVMMSG
+	if (slab->hdrs)
+		mm_free(slab->hdrs);
+	if (slab->iovs)
+		mm_free(slab->iovs);
+#endif
+	mm_free(slab);
+}
+
+int
+evdgram_recv_(evutil_socket_t fd, struct evdgram_slab *slab,
+    struct evdgram_msg **msgs_out)
+{
+	int n;
+#ifdef EVENT__HAVE_RECVMMSG
+	int i;
+
+	for (i = 0; i < slab->n_msgs; ++i) {
+		struct msghdr *m = &slab->hdrs[i].msg_hdr;
+		slab->iovs[i].iov_base = slab->buf + i * slab->max_size;
+		slab->iovs[i].iov_len = slab->max_size;
+		memset(m, 0, sizeof(*m));
+		m->msg_name = &slab->addrs[i];
+		m->msg_namelen = sizeof(slab->addrs[i]);
+		m->msg_iov = &slab->iovs[i];
+		m->msg_iovlen = 1;
+	}
+	n = recvmmsg(fd, slab->hdrs, slab->n_msgs, 0, NULL);
+	if (n < 0)
+		return -1;
+	for (i = 0; i < n; ++i) {
+		struct evdgram_msg *msg = &slab->msgs[i];
+		msg->data = slab->buf + i * slab->max_size;
+		msg->len = slab->hdrs[i].msg_len;
+		msg->addr = (struct sockaddr *)&slab->addrs[i];
+		msg->socklen = (int)slab->hdrs[i].msg_hdr.msg_namelen;
+		msg->truncated =
+		    (slab->hdrs[i].msg_hdr.msg_flags & MSG_TRUNC) != 0;
+	}
+#else
+	for (n = 0; n < slab->n_msgs; ++n) {
+		struct evdgram_msg *msg = &slab->msgs[n];
+		ev_socklen_t socklen = sizeof(slab->addrs[n]);
+		int r;
+
+		msg->data = slab->buf + n * slab->max_size;
+		msg->addr = (struct sockaddr *)&slab->addrs[n];
+		msg->truncated = 0;
+		r = recvfrom(fd, (void *)msg->data, (int)slab->max_size, 0,
+		    msg->addr, &socklen);
+#ifdef _WIN32
+		if (r < 0 && WSAGetLastError() == WSAEMSGSIZE) {
+			r = (int)slab->max_size;
+			msg->truncated = 1;
+		}
+#endif
+		if (r < 0) {
+			/* Report the error on the next read, if it's still
+			 * there, rather than lose what we have. */
+			if (n == 0)
+				return -1;
+			break;
+		}
+		msg->len = r;
+		msg->socklen = (int)socklen;
+	}
+#endif
+	*msgs_out = slab->msgs;
+	return n;
+}
+
+int
+evdgram_sendv_(evutil_socket_t fd, const struct evdgram_out *out, int n)
+{
+	int sent = 0;
+#ifdef EVENT__HAVE_SENDMMSG
+	struct mmsghdr hdrs[EVDGRAM_SEND_CHUNK];
+	struct iovec iovs[EVDGRAM_SEND_CHUNK];
+#ifdef USE_GSO
+	union {
+		char buf[CMSG_SPACE(sizeof(ev_uint16_t))];
+		struct cmsghdr align;
+	} ctl[EVDGRAM_SEND_CHUNK];
+#endif
+
+	while (sent < n) {
+		int i, r, k = n - sent;
+		if (k > EVDGRAM_SEND_CHUNK)
+			k = EVDGRAM_SEND_CHUNK;
+		memset(hdrs, 0, k * sizeof(hdrs[0]));
+		for (i = 0; i < k; ++i) {
+			const struct evdgram_out *o = &out[sent + i];
+			struct msghdr *m = &hdrs[i].msg_hdr;
+			iovs[i].iov_base = (void *)o->data;
+			iovs[i].iov_len = o->len;
+			m->msg_name = (void *)o->addr;
+			m->msg_namelen = o->addr ? o->socklen : 0;
+			m->msg_iov = &iovs[i];
+			m->msg_iovlen = 1;
+#ifdef USE_GSO
+			if (o->segment && o->segment < o->len) {
+				ev_uint16_t segment = (ev_uint16_t)o->segment;
+				struct cmsghdr *cm;
+				m->msg_control = ctl[i].buf;
+				m->msg_controllen = sizeof(ctl[i].buf);
+				cm = CMSG_FIRSTHDR(m);
+				cm->cmsg_level = IPPROTO_UDP;
+				cm->cmsg_type = UDP_SEGMENT;
+				cm->cmsg_len = CMSG_LEN(sizeof(segment));
+				memcpy(CMSG_DATA(cm), &segment, sizeof(segment));
+			}
+#endif
+		}
+		r = sendmmsg(fd, hdrs, k, 0);
+		if (r < 0)
+			return sent ? sent : -1;
+		sent += r;
+		if (r < k)
+			break;
+	}
+#else
+	for (; sent < n; ++sent) {
+		const struct evdgram_out *o = &out[sent];
+		if (sendto(fd, (const char *)o->data, (int)o->len, 0,
+			o->addr, o->addr ? o->socklen : 0) < 0)
+			return sent ? sent : -1;
+	}
+#endif
+	return sent;
+}
+
+static void evdgram_read_cb_(evutil_socket_t, short, void *);
+static void evdgram_write_cb_(evutil_socket_t, short, void *);
+
+static void
+evdgram_queued_free(struct evdgram *dg, struct evdgram_queued *q)
+{
+	TAILQ_REMOVE(&dg->queue, q, next);
+	--dg->n_queued;
+	mm_free(q->data);
+	mm_free(q);
+}
+
+static int
+evdgram_decref_and_unlock(struct evdgram *dg)
+{
+	struct evdgram_queued *q;
+
+	if (--dg->refcnt) {
+		UNLOCK(dg);
+		return 0;
+	}
+	event_del(&dg->ev_read);
+	event_del(&dg->ev_write);
+	event_debug_unassign(&dg->ev_read);
+	event_debug_unassign(&dg->ev_write);
+	while ((q = TAILQ_FIRST(&dg->queue)))
+		evdgram_queued_free(dg, q);
+	if (dg->flags & EVDGRAM_OPT_CLOSE_ON_FREE)
+		evutil_closesocket(dg->fd);
+	if (dg->slab)
+		evdgram_slab_free_(dg->slab);
+	UNLOCK(dg);
+	EVTHREAD_FREE_LOCK(dg->lock, EVTHREAD_LOCKTYPE_RECURSIVE);
+	mm_free(dg);
+	return 1;
+}
+
+struct evdgram *
+evdgram_new(struct event_base *base, evutil_socket_t fd, unsigned flags,
+    int batch, size_t max_size, evdgram_read_cb cb, void *ptr)
+{
+	struct evdgram *dg;
+
+	if (batch < 0)
+		return NULL;
+	if (!batch)
+		batch = EVDGRAM_DEFAULT_BATCH;
+	if (!max_size)
+		max_size = EVDGRAM_DEFAULT_SIZE;
+	if (max_size > EV_SIZE_MAX / batch)
+		return NULL;
+
+	if (!(dg = mm_calloc(1, sizeof(*dg))))
+		return NULL;
+	if (!(dg->slab = evdgram_slab_new_(batch, max_size))) {
+		mm_free(dg);
+		return NULL;
+	}
+	dg->base = base;
+	dg->fd = fd;
+	dg->cb = cb;
+	dg->user_data = ptr;
+	dg->flags = flags;
+	dg->refcnt = 1;
+	dg->batch = batch;
+	TAILQ_INIT(&dg->queue);
+
+#ifdef USE_GSO
+	if (flags & EVDGRAM_OPT_GSO) {
+		/* Old kernels don't know the option at all. */
+		int seg;
+		ev_socklen_t seglen = sizeof(seg);
+		if (getsockopt(fd, IPPROTO_UDP, UDP_SEGMENT, &seg, &seglen) < 0)
+			dg->flags &= ~EVDGRAM_OPT_GSO;
+	}
+#else
+	dg->flags &= ~EVDGRAM_OPT_GSO;
+#endif
+
+	if (flags & EVDGRAM_OPT_THREADSAFE) {
+		EVTHREAD_ALLOC_LOCK(dg->lock, EVTHREAD_LOCKTYPE_RECURSIVE);
+	}
+
+	event_assign(&dg->ev_read, base, fd, EV_READ|EV_PERSIST,
+	    evdgram_read_cb_, dg);
+	event_assign(&dg->ev_write, base, fd, EV_WRITE|EV_PERSIST,
+	    evdgram_write_cb_, dg);
+
+	evdgram_enable(dg);
+	return dg;
+}
+
+void
+evdgram_free(struct evdgram *dg)
+{
+	LOCK(dg);
+	dg->cb = NULL;
+	dg->errorcb = NULL;
+	dg->enabled = 0;
+	event_del(&dg->ev_read);
+	evdgram_decref_and_unlock(dg);
+}
+
+void
+evdgram_set_error_cb(struct evdgram *dg, evdgram_error_cb errorcb)
+{
+	LOCK(dg);
+	dg->errorcb = errorcb;
+	UNLOCK(dg);
+}
+
+int
+evdgram_enable(struct evdgram *dg)
+{
+	int r = 0;
+	LOCK(dg);
+	dg->enabled = 1;
+	if (dg->cb)
+		r = event_add(&dg->ev_read, NULL);
+	UNLOCK(dg);
+	return r;
+}
+
+int
+evdgram_disable(struct evdgram *dg)
+{
+	int r;
+	LOCK(dg);
+	dg->enabled = 0;
+	r = event_del(&dg->ev_read);
+	UNLOCK(dg);
+	return r;
+}
+
+struct event_base *
+evdgram_get_base(struct evdgram *dg)
+{
+	return dg->base;
+}
+
+evutil_socket_t
+evdgram_get_fd(struct evdgram *dg)
+{
+	return dg->fd;
+}
+
+#ifdef USE_GSO
+/* Append 'data' to the last datagram queued, if they can go out as one
+ * UDP_SEGMENT send.  Return 0 if we did, -1 if not. */
+static int
+evdgram_queue_append(struct evdgram *dg, const void *data, size_t len,
+    const struct sockaddr *addr, int socklen)
+{
+	struct evdgram_queued *q = TAILQ_LAST(&dg->queue, evdgram_queue);
+	size_t segment;
+	unsigned char *p;
+
+	if (!q || !len)
+		return -1;
+	segment = q->segment ? q->segment : q->len;
+	/* Every segment but the last must be full-sized. */
+	if (len > segment || q->len % segment)
+		return -1;
+	if (q->len / segment >= EVDGRAM_GSO_MAX_SEGMENTS ||
+	    q->len + len > EVDGRAM_GSO_MAX_BYTES)
+		return -1;
+	if (socklen != q->socklen ||
+	    (addr && memcmp(addr, &q->addr, socklen)))
+		return -1;
+	if (!(p = mm_realloc(q->data, q->len + len)))
+		return -1;
+	memcpy(p + q->len, data, len);
+	q->data = p;
+	q->len += len;
+	q->segment = segment;
+	return 0;
+}
+
+/* The kernel wouldn't segment 'q' for us: turn it back into one queued
+ * datagram per segment.  Return 0 on success, -1 on failure. */
+static int
+evdgram_queued_split(struct evdgram *dg, struct evdgram_queued *q)
+{
+	struct evdgram_queued *after = q;
+	size_t off;
+
+	for (off = q->segment; off < q->len; off += q->segment) {
+		struct evdgram_queued *s;
+		size_t len = q->len - off < q->segment ?
+		    q->len - off : q->segment;
+		if (!(s = mm_calloc(1, sizeof(*s))))
+			return -1;
+		if (!(s->data = mm_malloc(len))) {
+			mm_free(s);
+			return -1;
+		}
+		memcpy(s->data, q->data + off, len);
+		memcpy(&s->addr, &q->addr, sizeof(q->addr));
+		s->socklen = q->socklen;
+		s->len = len;
+		TAILQ_INSERT_AFTER(&dg->queue, after, s, next);
+		++dg->n_queued;
+		after = s;
+	}
+	q->len = q->segment;
+	q->segment = 0;
+	return 0;
+}
+#endif
+
+/* Send what we can of the queue.  Requires that we hold the lock. */
+static void
+evdgram_flush_(struct evdgram *dg)
+{
+	struct evdgram_out out[EVDGRAM_SEND_CHUNK];
+	struct evdgram_queued *q;
+
+	while (!TAILQ_EMPTY(&dg->queue)) {
+		int i = 0, n;
+		TAILQ_FOREACH(q, &dg->queue, next) {
+			if (i == EVDGRAM_SEND_CHUNK || i == dg->batch)
+				break;
+			out[i].data = q->data;
+			out[i].len = q->len;
+			out[i].addr = q->socklen ?
+			    (struct sockaddr *)&q->addr : NULL;
+			out[i].socklen = q->socklen;
+			out[i].segment = q->segment;
+			++i;
+		}
+		n = evdgram_sendv_(dg->fd, out, i);
+		if (n < 0) {
+			int err = evutil_socket_geterror(dg->fd);
+			if (EVUTIL_ERR_RW_RETRIABLE(err))
+				return;
+			q = TAILQ_FIRST(&dg->queue);
+#ifdef USE_GSO
+			/* EIO: the device can't do the segmentation and
+			 * the checksums for us.  Stop asking. */
+			if (q->segment && err == EIO) {
+				dg->flags &= ~EVDGRAM_OPT_GSO;
+				if (evdgram_queued_split(dg, q) == 0)
+					continue;
+			}
+#endif
+			/* Drop the datagram that failed and carry on. */
+			dg->send_error = err;
+			n = 1;
+		}
+		while (n--)
+			evdgram_queued_free(dg, TAILQ_FIRST(&dg->queue));
+	}
+}
+
+/* Wait for the socket to be writable if there's something left to send,
+ * or an error to report.  Requires that we hold the lock. */
+static void
+evdgram_schedule_write(struct evdgram *dg)
+{
+	if (!TAILQ_EMPTY(&dg->queue) || dg->send_error)
+		event_add(&dg->ev_write, NULL);
+	else
+		event_del(&dg->ev_write);
+}
+
+int
+evdgram_send(struct evdgram *dg, const void *data, size_t len,
+    const struct sockaddr *addr, int socklen)
+{
+	struct evdgram_queued *q;
+	int r = -1;
+
+	if (addr && (socklen <= 0 ||
+		(size_t)socklen > sizeof(struct sockaddr_storage)))
+		return -1;
+	if (!addr)
+		socklen = 0;
+
+	LOCK(dg);
+#ifdef USE_GSO
+	if ((dg->flags & EVDGRAM_OPT_GSO) &&
+	    evdgram_queue_append(dg, data, len, addr, socklen) == 0) {
+		r = 0;
+		goto done;
+	}
+#endif
+	if (!(q = mm_calloc(1, sizeof(*q))))
+		goto done;
+	if (!(q->data = mm_malloc(len ? len : 1))) {
+		mm_free(q);
+		goto done;
+	}
+	memcpy(q->data, data, len);
+	q->len = len;
+	if (addr)
+		memcpy(&q->addr, addr, socklen);
+	q->socklen = socklen;
+	TAILQ_INSERT_TAIL(&dg->queue, q, next);
+	++dg->n_queued;
+	r = 0;
+
+	/* A full batch goes now; waiting won't make it any bigger. */
+	if (dg->n_queued >= dg->batch)
+		evdgram_flush_(dg);
+done:
+	evdgram_schedule_write(dg);
+	UNLOCK(dg);
+	return r;
+}
+
+int
+evdgram_flush(struct evdgram *dg)
+{
+	int r;
+	LOCK(dg);
+	evdgram_flush_(dg);
+	evdgram_schedule_write(dg);
+	r = dg->n_queued;
+	UNLOCK(dg);
+	return r;
+}
+
+int
+evdgram_get_n_queued(struct evdgram *dg)
+{
+	int r;
+	LOCK(dg);
+	r = dg->n_queued;
+	UNLOCK(dg);
+	return r;
+}
+
+/* Run the error callback for 'what' with socket error 'err'.  Requires
+ * that we hold the lock; releases it.  */
+static void
+evdgram_run_errorcb(struct evdgram *dg, short what, int err)
+{
+	evdgram_error_cb errorcb = dg->errorcb;
+	void *user_data = dg->user_data;
+
+	if (!errorcb) {
+		UNLOCK(dg);
+		return;
+	}
+	++dg->refcnt;
+	UNLOCK(dg);
+	EVUTIL_SET_SOCKET_ERROR(err);
+	errorcb(dg, what, user_data);
+	LOCK(dg);
+	evdgram_decref_and_unlock(dg);
+}
+
+static void
+evdgram_read_cb_(evutil_socket_t fd, short what, void *arg)
+{
+	struct evdgram *dg = arg;
+	struct evdgram_msg *msgs;
+	evdgram_read_cb cb;
+	void *user_data;
+	int n;
+
+	LOCK(dg);
+	if (!dg->cb || !dg->enabled) {
+		UNLOCK(dg);
+		return;
+	}
+	n = evdgram_recv_(fd, dg->slab, &msgs);
+	if (n < 0) {
+		int err = evutil_socket_geterror(fd);
+		if (EVUTIL_ERR_RW_RETRIABLE(err)) {
+			UNLOCK(dg);
+			return;
+		}
+		evdgram_run_errorcb(dg, EV_READ, err);
+		return;
+	}
+	++dg->refcnt;
+	cb = dg->cb;
+	user_data = dg->user_data;
+	UNLOCK(dg);
+	cb(dg, msgs, n, user_data);
+	LOCK(dg);
+	evdgram_decref_and_unlock(dg);
+}
+
+static void
+evdgram_write_cb_(evutil_socket_t fd, short what, void *arg)
+{
+	struct evdgram *dg = arg;
+	int err;
+
+	LOCK(dg);
+	evdgram_flush_(dg);
+	err = dg->send_error;
+	dg->send_error = 0;
+	evdgram_schedule_write(dg);
+	if (err)
+		evdgram_run_errorcb(dg, EV_WRITE, err);
+	else
+		UNLOCK(dg);
+}
@@ -100,6 +100,7 @@
 #include "ipv6-internal.h"
 #include "util-internal.h"
 #include "evthread-internal.h"
+#include "evdgram-internal.h"
 #ifdef _WIN32
 #include <ctype.h>
 #include <winsock2.h>
@@ -142,6 +143,10 @@
 #define MAX_V4_ADDRS 32
 #define MAX_V6_ADDRS 32
 
+/* how many packets we read, or replies we send, per system call */
+#define EVDNS_READ_BATCH 16
+/* the largest packet we read in full */
+#define EVDNS_MAX_UDP_SIZE 1500
 
 #define TYPE_A	       EVDNS_TYPE_A
 #define TYPE_CNAME     5
@@ -253,6 +258,8 @@ struct evdns_server_port {
 	/* circular list of replies that we want to write. */
 	struct server_request *pending_replies;
 	struct event_base *event_base;
+	/* Where we read queries, allocated on first use. */
+	struct evdgram_slab *read_slab;
 
 #ifndef EVENT__DISABLE_THREAD_SUPPORT
 	void *lock;
@@ -315,6 +322,9 @@ struct evdns_base {
 	int n_req_heads;
 
 	struct event_base *event_base;
+	/* Where every nameserver socket reads replies, allocated on first
+	 * use. */
+	struct evdgram_slab *read_slab;
 
 	/* The number of good nameservers that we have */
 	int global_good_nameservers;
@@ -1381,20 +1391,52 @@ nameserver_pick(struct evdns_base *base) {
 	}
 }
 
+/* Read a single datagram from 'fd' into 'packet' with recvfrom, for when
+ * we couldn't allocate a slab to read a batch into.  Describe it in *msg,
+ * which points into 'packet' and 'ss'.  Returns 1, or -1 on error. */
+static int
+evdns_recv_one(evutil_socket_t fd, u8 *packet, size_t packet_len,
+    struct sockaddr_storage *ss, struct evdgram_msg *msg)
+{
+	ev_socklen_t addrlen = sizeof(*ss);
+	const int r = recvfrom(fd, (void*)packet, packet_len, 0,
+	    (struct sockaddr*)ss, &addrlen);
+	if (r < 0)
+		return -1;
+	msg->data = packet;
+	msg->len = r;
+	msg->addr = (struct sockaddr*)ss;
+	msg->socklen = (int)addrlen;
+	msg->truncated = 0;
+	return 1;
+}
+
 /* this is called when a namesever socket is ready for reading */
 static void
 nameserver_read(struct nameserver *ns) {
+	struct evdgram_msg *msgs, one;
+	u8 packet[EVDNS_MAX_UDP_SIZE];
 	struct sockaddr_storage ss;
-	ev_socklen_t addrlen = sizeof(ss);
-	u8 packet[1500];
 	char addrbuf[128];
+	int i, n, batched;
 	ASSERT_LOCKED(ns->base);
 
+	/* If we can't get a slab, read one packet the slow way rather than
+	 * leaving it on the socket to wake us again right away. */
+	batched = ns->base->read_slab ||
+	    (ns->base->read_slab = evdgram_slab_new_(EVDNS_READ_BATCH,
+		EVDNS_MAX_UDP_SIZE)) != NULL;
+
 	for (;;) {
-		const int r = recvfrom(ns->socket, (void*)packet,
-		    sizeof(packet), 0,
-		    (struct sockaddr*)&ss, &addrlen);
-		if (r < 0) {
+		if (batched) {
+			n = evdgram_recv_(ns->socket, ns->base->read_slab,
+			    &msgs);
+		} else {
+			n = evdns_recv_one(ns->socket, packet, sizeof(packet),
+			    &ss, &one);
+			msgs = &one;
+		}
+		if (n < 0) {
 			int err = evutil_socket_geterror(ns->socket);
 			if (EVUTIL_ERR_RW_RETRIABLE(err))
 				return;
@@ -1402,18 +1444,22 @@ nameserver_read(struct nameserver *ns) {
 			    evutil_socket_error_to_string(err));
 			return;
 		}
-		if (evutil_sockaddr_cmp((struct sockaddr*)&ss,
-			(struct sockaddr*)&ns->address, 0)) {
-			log(EVDNS_LOG_WARN, "Address mismatch on received "
-			    "DNS packet.  Apparent source was %s",
-			    evutil_format_sockaddr_port_(
-				    (struct sockaddr *)&ss,
-				    addrbuf, sizeof(addrbuf)));
-			return;
-		}
+		for (i = 0; i < n; ++i) {
+			if (evutil_sockaddr_cmp(msgs[i].addr,
+				(struct sockaddr*)&ns->address, 0)) {
+				log(EVDNS_LOG_WARN, "Address mismatch on "
+				    "received DNS packet.  Apparent source "
+				    "was %s",
+				    evutil_format_sockaddr_port_(msgs[i].addr,
+					addrbuf, sizeof(addrbuf)));
+				continue;
+			}
 
-		ns->timedout = 0;
-		reply_parse(ns->base, packet, r);
+			ns->timedout = 0;
+			reply_parse(ns->base, msgs[i].data, (int)msgs[i].len);
+		}
+		if (!batched)
+			return;
 	}
 }
 
@@ -1421,17 +1467,25 @@ nameserver_read(struct nameserver *ns) {
 /* act accordingly. */
 static void
 server_port_read(struct evdns_server_port *s) {
-	u8 packet[1500];
-	struct sockaddr_storage addr;
-	ev_socklen_t addrlen;
-	int r;
+	struct evdgram_msg *msgs, one;
+	u8 packet[EVDNS_MAX_UDP_SIZE];
+	struct sockaddr_storage ss;
+	int i, n, batched;
 	ASSERT_LOCKED(s);
 
+	batched = s->read_slab ||
+	    (s->read_slab = evdgram_slab_new_(EVDNS_READ_BATCH,
+		EVDNS_MAX_UDP_SIZE)) != NULL;
+
 	for (;;) {
-		addrlen = sizeof(struct sockaddr_storage);
-		r = recvfrom(s->socket, (void*)packet, sizeof(packet), 0,
-					 (struct sockaddr*) &addr, &addrlen);
-		if (r < 0) {
+		if (batched) {
+			n = evdgram_recv_(s->socket, s->read_slab, &msgs);
+		} else {
+			n = evdns_recv_one(s->socket, packet, sizeof(packet),
+			    &ss, &one);
+			msgs = &one;
+		}
+		if (n < 0) {
 			int err = evutil_socket_geterror(s->socket);
 			if (EVUTIL_ERR_RW_RETRIABLE(err))
 				return;
@@ -1440,7 +1494,11 @@ server_port_read(struct evdns_server_port *s) {
 			    evutil_socket_error_to_string(err), err);
 			return;
 		}
-		request_parse(packet, r, s, (struct sockaddr*) &addr, addrlen);
+		for (i = 0; i < n; ++i)
+			request_parse(msgs[i].data, (int)msgs[i].len, s,
+			    msgs[i].addr, (ev_socklen_t)msgs[i].socklen);
+		if (!batched)
+			return;
 	}
 }
 
@@ -1448,23 +1506,36 @@ server_port_read(struct evdns_server_port *s) {
 static void
 server_port_flush(struct evdns_server_port *port)
 {
-	struct server_request *req = port->pending_replies;
+	struct evdgram_out out[EVDNS_READ_BATCH];
+	struct server_request *req;
 	ASSERT_LOCKED(port);
-	while (req) {
-		int r = sendto(port->socket, req->response, (int)req->response_len, 0,
-			   (struct sockaddr*) &req->addr, (ev_socklen_t)req->addrlen);
-		if (r < 0) {
+	while (port->pending_replies) {
+		int i = 0, n;
+		req = port->pending_replies;
+		do {
+			out[i].data = req->response;
+			out[i].len = req->response_len;
+			out[i].addr = (struct sockaddr*) &req->addr;
+			out[i].socklen = (int)req->addrlen;
+			out[i].segment = 0;
+			req = req->next_pending;
+		} while (++i < EVDNS_READ_BATCH && req != port->pending_replies);
+
+		n = evdgram_sendv_(port->socket, out, i);
+		if (n < 0) {
 			int err = evutil_socket_geterror(port->socket);
 			if (EVUTIL_ERR_RW_RETRIABLE(err))
 				return;
 			log(EVDNS_LOG_WARN, "Error %s (%d) while writing response to port; dropping", evutil_socket_error_to_string(err), err);
+			n = 1;
 		}
-		if (server_request_free(req)) {
-			/* we released the last reference to req->port. */
-			return;
-		} else {
-			EVUTIL_ASSERT(req != port->pending_replies);
+		while (n--) {
 			req = port->pending_replies;
+			if (server_request_free(req)) {
+				/* we released the last reference to req->port. */
+				return;
+			}
+			EVUTIL_ASSERT(req != port->pending_replies);
 		}
 	}
 
@@ -2144,6 +2215,8 @@ server_port_free(struct evdns_server_port *port)
 	}
 	(void) event_del(&port->event);
 	event_debug_unassign(&port->event);
+	if (port->read_slab)
+		evdgram_slab_free_(port->read_slab);
 	EVTHREAD_FREE_LOCK(port->lock, EVTHREAD_LOCKTYPE_RECURSIVE);
 	mm_free(port);
 }
@@ -4149,6 +4222,8 @@ evdns_base_free_and_unlock(struct evdns_base *base, int fail_requests)
 	}
 
 	mm_free(base->req_heads);
+	if (base->read_slab)
+		evdgram_slab_free_(base->read_slab);
 
 	EVDNS_UNLOCK(base);
 	EVTHREAD_FREE_LOCK(base->lock, EVTHREAD_LOCKTYPE_RECURSIVE);
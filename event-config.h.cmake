@@ -166,6 +166,9 @@
 /* Define to 1 if you have the <inttypes.h> header file. */
 #cmakedefine EVENT__HAVE_INTTYPES_H 1
 
+/* Define if your system supports the io_uring system calls */
+#cmakedefine EVENT__HAVE_IO_URING 1
+
 /* Define to 1 if you have the `issetugid' function. */
 #cmakedefine EVENT__HAVE_ISSETUGID 1
 
@@ -175,6 +178,12 @@
 /* Define if the system has zlib */
 #cmakedefine EVENT__HAVE_LIBZ 1
 
+/* Define to 1 if you have the <linux/errqueue.h> header file. */
+#cmakedefine EVENT__HAVE_LINUX_ERRQUEUE_H 1
+
+/* Define to 1 if you have the <linux/io_uring.h> header file. */
+#cmakedefine EVENT__HAVE_LINUX_IO_URING_H 1
+
 /* Define to 1 if you have the `mach_absolute_time' function. */
 #cmakedefine EVENT__HAVE_MACH_ABSOLUTE_TIME 1
 
@@ -202,6 +211,9 @@
 /* Define to 1 if you have the <netinet/tcp.h> header file. */
 #cmakedefine EVENT__HAVE_NETINET_TCP_H 1
 
+/* Define to 1 if you have the <netinet/udp.h> header file. */
+#cmakedefine EVENT__HAVE_NETINET_UDP_H 1
+
 /* Define to 1 if you have the <sys/un.h> header file. */
 #cmakedefine EVENT__HAVE_SYS_UN_H 1
 
@@ -250,9 +262,15 @@
 /* Define to 1 if you have the `setrlimit' function. */
 #cmakedefine EVENT__HAVE_SETRLIMIT 1
 
+/* Define to 1 if you have the `recvmmsg' function. */
+#cmakedefine EVENT__HAVE_RECVMMSG 1
+
 /* Define to 1 if you have the `sendfile' function. */
 #cmakedefine EVENT__HAVE_SENDFILE 1
 
+/* Define to 1 if you have the `sendmmsg' function. */
+#cmakedefine EVENT__HAVE_SENDMMSG 1
+
 /* Define to 1 if you have the `sigaction' function. */
 #cmakedefine EVENT__HAVE_SIGACTION 1
 
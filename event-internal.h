@@ -38,6 +38,7 @@ extern "C" {
 #include <sys/queue.h>
 #include "event2/event_struct.h"
 #include "minheap-internal.h"
+#include "timerwheel-internal.h"
 #include "evsignal-internal.h"
 #include "mm-internal.h"
 #include "defer-internal.h"
@@ -82,6 +83,11 @@ extern "C" {
 #define EV_CLOSURE_EVENT_FINALIZE_FREE 6
 /** @} */
 
+/** Internal-only flag for evcb_flags: set along with EVLIST_TIMEOUT when
+ * the event's timeout is stored in its base's timer_wheel rather than in
+ * the timeheap. */
+#define EVLIST_X_TIMER_WHEEL 0x100
+
 /** Structure to define the backend of a given event_base. */
 //存放一个IO复用模型（无论selecct,epoll,kqueue）的所有函数（增、删、监听）和相关数据
 struct eventop {
@@ -145,18 +151,25 @@ struct eventop {
 struct event_map_entry;
 HT_HEAD(event_io_map, event_map_entry);
 #else
-#define event_io_map event_signal_map
+/* Used to map fds to the events pending on them.  The record for each fd is
+   stored inline, so that looking one up is a single index. */
+struct event_io_map {
+	/* An array of nentries records of entry_size bytes each, indexed by
+	 * fd: a struct evmap_io, then the backend's fdinfo.  An all-zero
+	 * record has no events. */
+	void *entries;
+	/* The number of entries available in entries */
+	int nentries;
+	/* The size of each record, or 0 if none have been allocated. */
+	int entry_size;
+};
 #endif
 
-/* Used to map signal numbers to a list of events.  If EVMAP_USE_HT is not
-   defined, this structure is also used as event_io_map, which maps fds to a
-   list of events.
+/* Used to map signal numbers to a list of events.
    用于将信号编号映射到事件列表。
-   在linux系统下，event_signal_map既可以存放evmap_signal*也可以存放evmap_io*
 */
 struct event_signal_map {
-	/* An array of evmap_io * or of evmap_signal *; empty entries are
-	 * set to NULL. */
+	/* An array of evmap_signal *; empty entries are set to NULL. */
 	void **entries; //存放已启用事件链表的地址的数组，数组的下标是fd或sig（映射），根据对应的下标向对应的双向链表增加已启用事件，如果是io event元素则为evmap_io *，如果是signal event元素则为evmap_signal*
 	/* The number of entries available in entries */
 	int nentries; //entries数组的容量大小
@@ -203,12 +216,56 @@ extern int event_debug_mode_on_;
 TAILQ_HEAD(evcallback_list, event_callback);
 
 /* Sets up an event for processing once */
+/* Whether EVENT_BASE_FLAG_ACTIVATION_QUEUE does anything: we need threads
+ * to want it and compare-and-swap to build it. */
+#if !defined(EVENT__DISABLE_THREAD_SUPPORT) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define EVENT_HAVE_ACTIVATION_QUEUE_
+#endif
+
+/* An activation that another thread submitted through
+ * base->activation_queue. */
+struct event_activation {
+	struct event_activation *next;
+	struct event *ev;
+	/* If ev belongs to an event_base_once(), the event_once, which still
+	 * has to go on base->once_events. */
+	struct event_once *eonce;
+	int res;
+	short ncalls;
+};
+
+/* What an event_base configured with EVENT_BASE_FLAG_COLLECT_STATS
+ * counts. */
+struct event_base_stats_internal {
+	struct event_base_stats totals;
+	/* cb_hist[pri][bucket]: callback durations at each priority. */
+	ev_uint64_t (*cb_hist)[EVENT_BASE_STATS_N_BUCKETS];
+	int n_priorities;
+};
+
+/* The callbacks that ran for longer than a threshold, as set with
+ * event_base_set_slow_callback_threshold(). */
+struct event_slow_log {
+	ev_uint64_t threshold_usec;
+	event_slow_callback_cb hook;
+	void *hook_arg;
+	/* How many slow callbacks we have seen; the newest is at
+	 * ring[(n_recorded - 1) % EVENT_SLOW_CALLBACK_LOG_SIZE]. */
+	ev_uint64_t n_recorded;
+	struct event_slow_callback ring[EVENT_SLOW_CALLBACK_LOG_SIZE];
+};
+
 struct event_once {
 	LIST_ENTRY(event_once) next_once;
 	struct event ev;
 
 	void (*cb)(evutil_socket_t, short, void *);
 	void *arg;
+#ifdef EVENT_HAVE_ACTIVATION_QUEUE_
+	/* Our entry on base->activation_queue, if we went through it. */
+	struct event_activation activation;
+#endif
 };
 
 struct event_base {
@@ -299,6 +356,16 @@ struct event_base {
 	int n_common_timeouts;
 	/** The total size of common_timeout_queues. */
 	int n_common_timeouts_allocated;
+	/** The most common timeouts event_base_auto_common_timeout_() may
+	 * create. */
+	int max_auto_common_timeouts;
+	/** The number of common timeouts it has created so far. */
+	int n_auto_common_timeouts;
+	/** Durations it has been asked about once, and will create a common
+	 * timeout for if asked again. */
+	struct timeval auto_common_timeout_seen[8];
+	/** The slot in auto_common_timeout_seen to overwrite next. */
+	int next_auto_common_timeout_seen;
 
 	/** Mapping from file descriptors to enabled (added) events */
 	//io事件映射
@@ -311,6 +378,9 @@ struct event_base {
 	/** Priority queue of events with timeouts. */
 	//定时器
 	struct min_heap timeheap;
+	/** Timing wheel for coarse timeouts, if EVENT_BASE_FLAG_TIMER_WHEEL
+	 * is set. */
+	struct timer_wheel *timer_wheel;
 
 	/** Stored timeval: used to avoid calling gettimeofday/clock_gettime
 	 * too often. */
@@ -351,6 +421,16 @@ struct event_base {
 	struct timeval max_dispatch_time; //最长监听时间
 	int max_dispatch_callbacks; //最大回调函数数量
 	int limit_callbacks_after_prio; //每个优先级下激活事件的限制个数，每个优先级包含个激活事件链表
+	/** How many microseconds the backend polls without blocking before it
+	 * waits; see event_config_set_busy_poll(). */
+	int busy_poll_usec;
+	/** Bounds on the size of the backend's array of returned events, or 0
+	 * for the backend's defaults; see event_config_set_backend_events(). */
+	int backend_min_events;
+	int backend_max_events;
+	/** How many callbacks the highest priority may run before we poll
+	 * again, or 0 for no budget; see event_config_set_dispatch_budget(). */
+	int dispatch_budget;
 
 	/* Notify main thread to wake up break, etc.
 	 * 通知主线程唤醒和停止*/
@@ -369,6 +449,22 @@ struct event_base {
 	/** A function used to wake up the main thread from another thread. */
 	//从另一个线程唤醒主线程的函数
 	int (*th_notify_fn)(struct event_base *base);
+	/** With EVENT_BASE_FLAG_ACTIVATION_QUEUE: activations submitted by
+	 * other threads without taking th_base_lock, newest first.  Pushed
+	 * with compare-and-swap; taken all at once by whoever holds
+	 * th_base_lock. */
+	struct event_activation *activation_queue;
+
+	/** With EVENT_BASE_FLAG_COLLECT_STATS: the counters behind
+	 * event_base_get_stats().  Protected by th_base_lock. */
+	struct event_base_stats_internal *stats;
+	/** If we're looking for slow callbacks, the ones we found.  Protected
+	 * by th_base_lock. */
+	struct event_slow_log *slow_log;
+	/** A precise clock for timing callbacks, set up when stats or
+	 * slow_log need it: monotonic_timer is usually the coarse one, which
+	 * ticks too seldom. */
+	struct evutil_monotonic_timer cb_timer;
 
 	/** Saved seed for weak random number generator. Some backends use
 	 * this to produce fairness among sockets. Protected by th_base_lock. */
@@ -379,6 +475,9 @@ struct event_base {
 	//尚未触发的事件？？
 	LIST_HEAD(once_event_list, event_once) once_events;
 
+	/** Freed evbuffer chains kept for reuse by this base's evbuffers, or
+	 * NULL if the base was not configured with a chain pool. */
+	struct evbuffer_chain_pool *chain_pool;
 };
 
 struct event_config_entry {
@@ -400,6 +499,13 @@ struct event_config {
 	int limit_callbacks_after_prio;
 	enum event_method_feature require_features; //要求满足的特征：ET、O1、FDS
 	enum event_base_config_flag flags; //其他配置要求：无锁、不检查环境变量、...
+	/** Per-size-class limit for the evbuffer chain pool; 0 for none. */
+	size_t chain_pool_max;
+	int max_auto_common_timeouts;
+	int busy_poll_usec;
+	int backend_min_events;
+	int backend_max_events;
+	int dispatch_budget;
 };
 
 /* Internal use only: Functions that might be missing from <sys/queue.h> */
@@ -486,6 +592,7 @@ void event_callback_init_(struct event_base *base,
 /* FIXME document. */
 EVENT2_EXPORT_SYMBOL
 void event_base_add_virtual_(struct event_base *base);
+EVENT2_EXPORT_SYMBOL
 void event_base_del_virtual_(struct event_base *base);
 
 /** For debugging: unless assertions are disabled, verify the referential
@@ -510,6 +617,14 @@ void event_base_assert_ok_nolock_(struct event_base *base);
 int event_base_foreach_event_nolock_(struct event_base *base,
     event_base_foreach_event_cb cb, void *arg);
 
+/* Return a common timeout with the same duration as 'duration' that events
+ * on 'base' can use, or 'duration' itself if there is none.  A new common
+ * timeout is created for a duration the second time it is asked for, unless
+ * max_auto_common_timeouts have been created already.  Used to schedule
+ * bufferevent timeouts. */
+const struct timeval *event_base_auto_common_timeout_(struct event_base *base,
+    const struct timeval *duration);
+
 /* Cleanup function to reset debug mode during shutdown.
  *
  * Calling this function doesn't mean it'll be possible to re-enable
@@ -59,6 +59,8 @@
 #include "event2/event.h"
 #include "event2/event_struct.h"
 #include "event2/event_compat.h"
+#include "event2/buffer.h"
+#include "event2/buffer_compat.h"
 #include "event-internal.h"
 #include "defer-internal.h"
 #include "evthread-internal.h"
@@ -68,6 +70,7 @@
 #include "evmap-internal.h"
 #include "iocp-internal.h"
 #include "changelist-internal.h"
+#include "evbuffer-internal.h"
 #define HT_NO_CACHE_HASH_VALUES
 #include "ht-internal.h"
 #include "util-internal.h"
@@ -89,6 +92,9 @@ extern const struct eventop pollops;
 #ifdef EVENT__HAVE_EPOLL
 extern const struct eventop epollops;
 #endif
+#ifdef EVENT__HAVE_IO_URING
+extern const struct eventop uringops;
+#endif
 #ifdef EVENT__HAVE_WORKING_KQUEUE
 extern const struct eventop kqops;
 #endif
@@ -111,6 +117,9 @@ static const struct eventop *eventops[] = {
 #ifdef EVENT__HAVE_EPOLL
 	&epollops,
 #endif
+#ifdef EVENT__HAVE_IO_URING
+	&uringops,
+#endif
 #ifdef EVENT__HAVE_DEVPOLL
 	&devpollops,
 #endif
@@ -405,6 +414,10 @@ static void event_debug_assert_socket_nonblocking_(evutil_socket_t fd) { (void)f
  * to monotonic time?  Set this to -1 for 'never.' */
 #define CLOCK_SYNC_INTERVAL 5
 
+/* How many common timeouts a base may create for bufferevent timeouts
+ * unless told otherwise. */
+#define DEFAULT_MAX_AUTO_COMMON_TIMEOUTS 16
+
 /** Set 'tp' to the current time according to 'base'.  We must hold the lock
  * on 'base'.  If there is a cached time, return it.  Otherwise, use
  * clock_gettime or gettimeofday as appropriate to find out the right time.
@@ -608,6 +621,20 @@ event_disable_debug_mode(void)
 #endif
 }
 
+/* Make room for the callback histograms of n priorities. */
+static int
+event_stats_set_priorities(struct event_base_stats_internal *st, int n)
+{
+	void *hist = mm_calloc(n, sizeof(*st->cb_hist));
+	if (!hist)
+		return -1;
+	if (st->cb_hist)
+		mm_free(st->cb_hist);
+	st->cb_hist = hist;
+	st->n_priorities = n;
+	return 0;
+}
+
 //根据event_config初始化event_base，决定event_base使用哪种IO复用模型、是否支持多线程、是否忽略环境变量等
 //如果传入的是NULL，那么就相当于没有设定任何的features、avoid_method和flags，那么就会直接使用eventops中的第一个元素对应的IO复用模型作为默认的IO复用模型。
 struct event_base *
@@ -629,6 +656,8 @@ event_base_new_with_config(const struct event_config *cfg)
 
 	if (cfg)
 		base->flags = cfg->flags;
+	base->max_auto_common_timeouts = cfg ?
+	    cfg->max_auto_common_timeouts : DEFAULT_MAX_AUTO_COMMON_TIMEOUTS;
 
 	//如果cfg不为空并且cfg设置了忽略环境变量，则should_check_environment为0,其他情况为1(包括cfg为空的情况)
 	should_check_environment =
@@ -653,6 +682,17 @@ event_base_new_with_config(const struct event_config *cfg)
 	}
 
 	min_heap_ctor_(&base->timeheap);
+	if (cfg && (cfg->flags & EVENT_BASE_FLAG_TIMER_WHEEL)) {
+		struct timeval now;
+		base->timer_wheel = mm_malloc(sizeof(struct timer_wheel));
+		if (!base->timer_wheel) {
+			event_warn("%s: malloc", __func__);
+			mm_free(base);
+			return NULL;
+		}
+		gettime(base, &now);
+		timer_wheel_ctor_(base->timer_wheel, &now);
+	}
 
 	base->sig.ev_signal_pair[0] = -1;
 	base->sig.ev_signal_pair[1] = -1;
@@ -684,6 +724,12 @@ event_base_new_with_config(const struct event_config *cfg)
 	if (base->max_dispatch_callbacks == INT_MAX &&
 	    base->max_dispatch_time.tv_sec == -1)
 		base->limit_callbacks_after_prio = INT_MAX;
+	base->busy_poll_usec = cfg ? cfg->busy_poll_usec : 0;
+	if (cfg) {
+		base->backend_min_events = cfg->backend_min_events;
+		base->backend_max_events = cfg->backend_max_events;
+		base->dispatch_budget = cfg->dispatch_budget;
+	}
 
 	//eventops存放着所有IO复用模型，每个event_base都只能使用一种IO复用模型
 	for (i = 0; eventops[i] && !base->evbase; i++) { //!base->evbase表示event_base只能使用一种IO复用模型，若不为空则已经使用了一种IO复用模型
@@ -753,6 +799,28 @@ event_base_new_with_config(const struct event_config *cfg)
 		event_base_start_iocp_(base, cfg->n_cpus_hint);
 #endif
 
+	if (cfg && cfg->chain_pool_max) {
+		base->chain_pool = evbuffer_chain_pool_new_(cfg->chain_pool_max);
+		if (!base->chain_pool) {
+			event_warnx("%s: Unable to allocate a chain pool.",
+			    __func__);
+			event_base_free(base);
+			return NULL;
+		}
+	}
+
+	if (cfg && (cfg->flags & EVENT_BASE_FLAG_COLLECT_STATS)) {
+		base->stats = mm_calloc(1, sizeof(*base->stats));
+		if (!base->stats || event_stats_set_priorities(base->stats,
+			base->nactivequeues) < 0) {
+			event_warn("%s: calloc", __func__);
+			event_base_free(base);
+			return NULL;
+		}
+		evutil_configure_monotonic_time_(&base->cb_timer,
+		    EV_MONOT_PRECISE);
+	}
+
 	return (base);
 }
 
@@ -850,6 +918,73 @@ static int event_base_free_queues_(struct event_base *base, int run_finalizers)
 	return deleted;
 }
 
+#ifdef EVENT_HAVE_ACTIVATION_QUEUE_
+/* Hand an activation to the loop without taking th_base_lock.  Return 0 if
+ * it was queued, or -1 if the caller should activate the event the usual
+ * way: the base doesn't use the queue, we're in the loop's own thread, or
+ * we're out of memory.  An event_once brings its own queue entry. */
+static int
+event_activation_push(struct event_base *base, struct event *ev,
+    struct event_once *eonce, int res, short ncalls)
+{
+	struct event_activation *act, *head;
+
+	if (!(base->flags & EVENT_BASE_FLAG_ACTIVATION_QUEUE) ||
+	    base->th_base_lock == NULL || EVBASE_IN_THREAD(base))
+		return -1;
+	if (eonce)
+		act = &eonce->activation;
+	else if ((act = mm_malloc(sizeof(*act))) == NULL)
+		return -1;
+	act->ev = ev;
+	act->eonce = eonce;
+	act->res = res;
+	act->ncalls = ncalls;
+
+	head = __atomic_load_n(&base->activation_queue, __ATOMIC_RELAXED);
+	do {
+		act->next = head;
+	} while (!__atomic_compare_exchange_n(&base->activation_queue, &head,
+		act, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+	/* Whoever finds the queue empty wakes the loop; everyone after that
+	 * rides along until the loop takes the queue. */
+	if (head == NULL && base->th_notify_fn != NULL)
+		base->th_notify_fn(base);
+	return 0;
+}
+
+/* Activate everything on base->activation_queue, in the order it was
+ * submitted. */
+static void
+event_activation_drain_nolock_(struct event_base *base)
+{
+	struct event_activation *act, *next, *fifo = NULL;
+
+	EVENT_BASE_ASSERT_LOCKED(base);
+	if (__atomic_load_n(&base->activation_queue, __ATOMIC_RELAXED) == NULL)
+		return;
+	act = __atomic_exchange_n(&base->activation_queue, NULL,
+	    __ATOMIC_ACQUIRE);
+	for (; act; act = next) {
+		next = act->next;
+		act->next = fifo;
+		fifo = act;
+	}
+	for (act = fifo; act; act = next) {
+		next = act->next;
+		event_active_nolock_(act->ev, act->res, act->ncalls);
+		if (act->eonce)
+			LIST_INSERT_HEAD(&base->once_events, act->eonce,
+			    next_once);
+		else
+			mm_free(act);
+	}
+}
+#else
+#define event_activation_drain_nolock_(base) ((void)0)
+#endif
+
 static void
 event_base_free_(struct event_base *base, int run_finalizers)
 {
@@ -884,6 +1019,12 @@ event_base_free_(struct event_base *base, int run_finalizers)
 		event_debug_unassign(&base->th_notify);
 	}
 
+	/* Anything still waiting to be activated is freed along with the
+	 * other active events below. */
+	EVBASE_ACQUIRE_LOCK(base, th_base_lock);
+	event_activation_drain_nolock_(base);
+	EVBASE_RELEASE_LOCK(base, th_base_lock);
+
 	/* Delete all non-internal events. */
 	evmap_delete_all_(base);
 
@@ -891,6 +1032,19 @@ event_base_free_(struct event_base *base, int run_finalizers)
 		event_del(ev);
 		++n_deleted;
 	}
+	if (base->timer_wheel) {
+		int l, slot;
+		for (l = 0; l < TIMER_WHEEL_LEVELS; ++l) {
+			for (slot = 0; slot < TIMER_WHEEL_SLOTS; ++slot) {
+				struct event_list *list =
+				    &base->timer_wheel->slots[l][slot];
+				while ((ev = TAILQ_FIRST(list)) != NULL) {
+					event_del(ev);
+					++n_deleted;
+				}
+			}
+		}
+	}
 	for (i = 0; i < base->n_common_timeouts; ++i) {
 		struct common_timeout_list *ctl =
 		    base->common_timeout_queues[i];
@@ -945,6 +1099,10 @@ event_base_free_(struct event_base *base, int run_finalizers)
 
 	EVUTIL_ASSERT(min_heap_empty_(&base->timeheap));
 	min_heap_dtor_(&base->timeheap);
+	if (base->timer_wheel) {
+		EVUTIL_ASSERT(base->timer_wheel->n == 0);
+		mm_free(base->timer_wheel);
+	}
 
 	mm_free(base->activequeues);
 
@@ -952,6 +1110,17 @@ event_base_free_(struct event_base *base, int run_finalizers)
 	evmap_signal_clear_(&base->sigmap);
 	event_changelist_freemem_(&base->changelist);
 
+	if (base->chain_pool)
+		evbuffer_chain_pool_decref_(base->chain_pool);
+
+	if (base->stats) {
+		if (base->stats->cb_hist)
+			mm_free(base->stats->cb_hist);
+		mm_free(base->stats);
+	}
+	if (base->slow_log)
+		mm_free(base->slow_log);
+
 	EVTHREAD_FREE_LOCK(base->th_base_lock, 0);
 	EVTHREAD_FREE_COND(base->current_event_cond);
 
@@ -1168,6 +1337,7 @@ event_config_new(void)
 	cfg->max_dispatch_interval.tv_sec = -1;
 	cfg->max_dispatch_callbacks = INT_MAX;
 	cfg->limit_callbacks_after_prio = 1;
+	cfg->max_auto_common_timeouts = DEFAULT_MAX_AUTO_COMMON_TIMEOUTS;
 
 	return (cfg);
 }
@@ -1255,6 +1425,56 @@ event_config_set_max_dispatch_interval(struct event_config *cfg,
 	return (0);
 }
 
+int
+event_config_set_max_auto_common_timeouts(struct event_config *cfg,
+    int max_queues)
+{
+	if (!cfg || max_queues < 0)
+		return -1;
+	cfg->max_auto_common_timeouts = max_queues;
+	return 0;
+}
+
+int
+event_config_set_busy_poll(struct event_config *cfg, int usec)
+{
+	if (!cfg || usec < 0)
+		return -1;
+	cfg->busy_poll_usec = usec;
+	return 0;
+}
+
+int
+event_config_set_backend_events(struct event_config *cfg,
+    int min_events, int max_events)
+{
+	if (!cfg || min_events < 0 || max_events < 0)
+		return -1;
+	if (min_events && max_events && min_events > max_events)
+		return -1;
+	cfg->backend_min_events = min_events;
+	cfg->backend_max_events = max_events;
+	return 0;
+}
+
+int
+event_config_set_dispatch_budget(struct event_config *cfg, int budget)
+{
+	if (!cfg || budget < 0)
+		return -1;
+	cfg->dispatch_budget = budget;
+	return 0;
+}
+
+int
+event_config_set_chain_pool(struct event_config *cfg, size_t max_cached_bytes)
+{
+	if (!cfg)
+		return -1;
+	cfg->chain_pool_max = max_cached_bytes;
+	return 0;
+}
+
 int
 event_priority_init(int npriorities)
 {
@@ -1294,6 +1514,12 @@ event_base_priority_init(struct event_base *base, int npriorities)
 		TAILQ_INIT(&base->activequeues[i]);
 	}
 
+	if (base->stats &&
+	    event_stats_set_priorities(base->stats, npriorities) < 0) {
+		event_warn("%s: calloc", __func__);
+		goto err;
+	}
+
 ok:
 	r = 0;
 err:
@@ -1508,16 +1734,35 @@ common_timeout_callback(evutil_socket_t fd, short what, void *arg)
 
 #define MAX_COMMON_TIMEOUTS 256
 
-const struct timeval *
-event_base_init_common_timeout(struct event_base *base,
-    const struct timeval *duration)
+/* Return the common timeout on 'base' whose duration is 'duration', if there
+ * is one.  Requires that 'base' be locked. */
+static const struct timeval *
+find_common_timeout(struct event_base *base, const struct timeval *duration)
 {
 	int i;
+	for (i = 0; i < base->n_common_timeouts; ++i) {
+		const struct common_timeout_list *ctl =
+		    base->common_timeout_queues[i];
+		if (duration->tv_sec == ctl->duration.tv_sec &&
+		    duration->tv_usec ==
+		    (ctl->duration.tv_usec & MICROSECONDS_MASK)) {
+			EVUTIL_ASSERT(is_common_timeout(&ctl->duration, base));
+			return &ctl->duration;
+		}
+	}
+	return NULL;
+}
+
+/* Helper for event_base_init_common_timeout; requires that 'base' be
+ * locked. */
+static const struct timeval *
+init_common_timeout_nolock(struct event_base *base,
+    const struct timeval *duration)
+{
 	struct timeval tv;
 	const struct timeval *result=NULL;
 	struct common_timeout_list *new_ctl;
 
-	EVBASE_ACQUIRE_LOCK(base, th_base_lock);
 	if (duration->tv_usec > 1000000) {
 		memcpy(&tv, duration, sizeof(struct timeval));
 		if (is_common_timeout(duration, base))
@@ -1526,17 +1771,8 @@ event_base_init_common_timeout(struct event_base *base,
 		tv.tv_usec %= 1000000;
 		duration = &tv;
 	}
-	for (i = 0; i < base->n_common_timeouts; ++i) {
-		const struct common_timeout_list *ctl =
-		    base->common_timeout_queues[i];
-		if (duration->tv_sec == ctl->duration.tv_sec &&
-		    duration->tv_usec ==
-		    (ctl->duration.tv_usec & MICROSECONDS_MASK)) {
-			EVUTIL_ASSERT(is_common_timeout(&ctl->duration, base));
-			result = &ctl->duration;
-			goto done;
-		}
-	}
+	if ((result = find_common_timeout(base, duration)))
+		goto done;
 	if (base->n_common_timeouts == MAX_COMMON_TIMEOUTS) {
 		event_warnx("%s: Too many common timeouts already in use; "
 		    "we only support %d per event_base", __func__,
@@ -1577,7 +1813,70 @@ event_base_init_common_timeout(struct event_base *base,
 done:
 	if (result)
 		EVUTIL_ASSERT(is_common_timeout(result, base));
+	return result;
+}
 
+const struct timeval *
+event_base_init_common_timeout(struct event_base *base,
+    const struct timeval *duration)
+{
+	const struct timeval *result;
+
+	EVBASE_ACQUIRE_LOCK(base, th_base_lock);
+	result = init_common_timeout_nolock(base, duration);
+	EVBASE_RELEASE_LOCK(base, th_base_lock);
+	return result;
+}
+
+const struct timeval *
+event_base_auto_common_timeout_(struct event_base *base,
+    const struct timeval *duration)
+{
+	const struct timeval *result = duration;
+	const int n_seen = (int)(sizeof(base->auto_common_timeout_seen) /
+	    sizeof(base->auto_common_timeout_seen[0]));
+	int i;
+
+	if (!base || base->max_auto_common_timeouts <= 0)
+		return duration;
+	/* Only take plain, positive, normalized durations. */
+	if (duration->tv_sec < 0 || duration->tv_usec < 0 ||
+	    duration->tv_usec >= 1000000 || !evutil_timerisset(duration))
+		return duration;
+
+	EVBASE_ACQUIRE_LOCK(base, th_base_lock);
+	if ((result = find_common_timeout(base, duration)))
+		goto done;
+	result = duration;
+	if (base->n_auto_common_timeouts >= base->max_auto_common_timeouts)
+		goto done;
+
+	/* A duration that only ever shows up once isn't worth a queue of its
+	 * own, so just remember it the first time around. */
+	for (i = 0; i < n_seen; ++i) {
+		if (evutil_timercmp(&base->auto_common_timeout_seen[i],
+			duration, ==))
+			break;
+	}
+	if (i == n_seen) {
+		base->auto_common_timeout_seen[
+		    base->next_auto_common_timeout_seen] = *duration;
+		base->next_auto_common_timeout_seen =
+		    (base->next_auto_common_timeout_seen + 1) % n_seen;
+		goto done;
+	}
+	evutil_timerclear(&base->auto_common_timeout_seen[i]);
+
+	if (base->n_common_timeouts < MAX_COMMON_TIMEOUTS) {
+		const struct timeval *common =
+		    init_common_timeout_nolock(base, duration);
+		if (common) {
+			++base->n_auto_common_timeouts;
+			result = common;
+		}
+	}
+
+done:
 	EVBASE_RELEASE_LOCK(base, th_base_lock);
 	return result;
 }
@@ -1648,6 +1947,98 @@ event_persist_closure(struct event_base *base, struct event *ev)
         (evcb_callback)(evcb_fd, evcb_res, evcb_arg);
 }
 
+/* Microseconds on the precise monotonic clock, for timing callbacks. */
+static ev_uint64_t
+event_stats_now(struct event_base *base)
+{
+	struct timeval tv;
+	evutil_gettime_monotonic_(&base->cb_timer, &tv);
+	return (ev_uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/* Describe the callback we're about to run, in case it turns out slow:
+ * it may be gone by the time it returns. */
+static void
+event_slow_note_callback(struct event_callback *evcb,
+    struct event_slow_callback *slow)
+{
+	/* All the members of the union are function pointers; any of them
+	 * gives us the address. */
+	slow->fn = (void (*)(void))evcb->evcb_cb_union.evcb_callback;
+	slow->arg = evcb->evcb_arg;
+	slow->priority = evcb->evcb_pri;
+	if (evcb->evcb_flags & EVLIST_INIT) {
+		struct event *ev = event_callback_to_event(evcb);
+		slow->fd = ev->ev_fd;
+		slow->events = ev->ev_res;
+	} else {
+		slow->fd = EVUTIL_INVALID_SOCKET;
+		slow->events = 0;
+	}
+}
+
+/* Count a callback at priority 'pri' that started at 'start'.  If it was
+ * slow and there is a hook to tell, return the hook and set *hook_arg. */
+static event_slow_callback_cb
+event_stats_count_callback(struct event_base *base, int pri,
+    ev_uint64_t start, struct event_slow_callback *slow, void **hook_arg)
+{
+	struct event_base_stats_internal *st = base->stats;
+	struct event_slow_log *log = base->slow_log;
+	ev_uint64_t usec = event_stats_now(base) - start;
+	int bucket = 0;
+
+	if (st) {
+		st->totals.callback_usec += usec;
+		++st->totals.n_callbacks;
+		while ((usec >> bucket) &&
+		    bucket < EVENT_BASE_STATS_N_BUCKETS - 1)
+			++bucket;
+		/* A callback may have changed the number of priorities. */
+		if (pri >= 0 && pri < st->n_priorities)
+			++st->cb_hist[pri][bucket];
+	}
+
+	/* slow_log may have been set up while the callback ran, and then
+	 * 'slow' was never filled in. */
+	if (!log || !slow->fn || usec < log->threshold_usec)
+		return NULL;
+	slow->usec = usec;
+	evutil_gettimeofday(&slow->when, NULL);
+	log->ring[log->n_recorded++ % EVENT_SLOW_CALLBACK_LOG_SIZE] = *slow;
+	*hook_arg = log->hook_arg;
+	return log->hook;
+}
+
+/* The backend returned after waiting since 'start': count the wait, and
+ * return the time the rest of the iteration starts. */
+static ev_uint64_t
+event_stats_count_wait(struct event_base *base, ev_uint64_t start)
+{
+	struct event_base_stats_internal *st = base->stats;
+	ev_uint64_t now = event_stats_now(base);
+	ev_uint64_t n_active = (ev_uint64_t)N_ACTIVE_CALLBACKS(base);
+
+	++st->totals.n_loops;
+	st->totals.wait_usec += now - start;
+	st->totals.active_sum += n_active;
+	if (n_active > st->totals.max_active)
+		st->totals.max_active = n_active;
+	return now;
+}
+
+/* Count the end of an iteration that was busy since 'start'. */
+static void
+event_stats_count_busy(struct event_base *base, ev_uint64_t start)
+{
+	struct event_base_stats_internal *st = base->stats;
+	ev_uint64_t usec = event_stats_now(base) - start;
+
+	st->totals.busy_usec += usec;
+	if (usec > st->totals.max_busy_usec)
+		st->totals.max_busy_usec = usec;
+}
+
 /*
   Helper for event_process_active to process all the events in a single queue,
   releasing the lock as we go.  This function requires that the lock be held
@@ -1663,6 +2054,11 @@ event_process_active_single_queue(struct event_base *base,
 {
 	struct event_callback *evcb;
 	int count = 0;
+	ev_uint64_t cb_start = 0;
+	struct event_slow_callback slow;
+	event_slow_callback_cb slow_hook = NULL;
+	void *slow_hook_arg = NULL;
+	int timed;
 
 	EVUTIL_ASSERT(activeq != NULL);
 
@@ -1697,6 +2093,13 @@ event_process_active_single_queue(struct event_base *base,
 #ifndef EVENT__DISABLE_THREAD_SUPPORT //若支持多线程
 		base->current_event_waiters = 0;
 #endif
+		timed = base->stats || base->slow_log;
+		if (timed) {
+			slow.fn = NULL;
+			if (base->slow_log)
+				event_slow_note_callback(evcb, &slow);
+			cb_start = event_stats_now(base);
+		}
 
 		switch (evcb->evcb_closure) {
 		case EV_CLOSURE_EVENT_SIGNAL: //信号事件
@@ -1751,6 +2154,10 @@ event_process_active_single_queue(struct event_base *base,
 		}
 
 		EVBASE_ACQUIRE_LOCK(base, th_base_lock);
+		if (timed)
+			slow_hook = event_stats_count_callback(base,
+			    base->event_running_priority, cb_start, &slow,
+			    &slow_hook_arg);
 		base->current_event = NULL;
 #ifndef EVENT__DISABLE_THREAD_SUPPORT
 		if (base->current_event_waiters) {
@@ -1758,6 +2165,12 @@ event_process_active_single_queue(struct event_base *base,
 			EVTHREAD_COND_BROADCAST(base->current_event_cond);
 		}
 #endif
+		if (slow_hook) {
+			EVBASE_RELEASE_LOCK(base, th_base_lock);
+			slow_hook(base, &slow, slow_hook_arg);
+			EVBASE_ACQUIRE_LOCK(base, th_base_lock);
+			slow_hook = NULL;
+		}
 
 		if (base->event_break)
 			return -1;
@@ -1782,6 +2195,17 @@ event_process_active_single_queue(struct event_base *base,
  * priority ones.
  */
 
+/* How many callbacks priority 'pri' may run before we poll again: the
+ * base's budget scaled down linearly with the priority, so that the lowest
+ * priority gets 1/nactivequeues of it, but never less than one. */
+static int
+event_dispatch_budget(struct event_base *base, int pri)
+{
+	int n = base->nactivequeues;
+	ev_int64_t budget = (ev_int64_t)base->dispatch_budget * (n - pri) / n;
+	return budget > 0 ? (int)budget : 1;
+}
+
 static int
 event_process_active(struct event_base *base)
 {
@@ -1803,14 +2227,17 @@ event_process_active(struct event_base *base)
 
 	for (i = 0; i < base->nactivequeues; ++i) { //遍历激活队列中的事件
 		if (TAILQ_FIRST(&base->activequeues[i]) != NULL) { //同一个优先级下可以有多个事件
+			int budget = INT_MAX;
 			base->event_running_priority = i; //设置当前的优先级
 			activeq = &base->activequeues[i]; //获取优先级i下的所有event组成的链表
+			if (base->dispatch_budget)
+				budget = event_dispatch_budget(base, i);
 			if (i < limit_after_prio)
 				c = event_process_active_single_queue(base, activeq,
-				    INT_MAX, NULL); //遍历activeq链表，调用其中每个event的回调函数，无限制个数
+				    budget, NULL); //遍历activeq链表，调用其中每个event的回调函数，只受budget限制
 			else
 				c = event_process_active_single_queue(base, activeq,
-				    maxcb, endtime); //遍历activeq链表，调用其中每个event的回调函数，限制个数为maxcb
+				    maxcb < budget ? maxcb : budget, endtime); //遍历activeq链表，调用其中每个event的回调函数，限制个数为maxcb
 			if (c < 0) {
 				goto done;
 			} else if (c > 0)
@@ -1959,6 +2386,7 @@ event_base_loop(struct event_base *base, int flags)
 	struct timeval tv; //timeval是系统的时间库中的一个结构体，直接获得当前时间
 	struct timeval *tv_p; //还有多长时间第一个event超时
 	int res, done, retval = 0;
+	ev_uint64_t stats_start = 0;
 
 	/* Grab the lock.  We will release it inside evsel.dispatch, and again
 	 * as we invoke user callbacks. */
@@ -1991,6 +2419,8 @@ event_base_loop(struct event_base *base, int flags)
 		base->event_continue = 0;
 		base->n_deferreds_queued = 0;
 
+		event_activation_drain_nolock_(base);
+
 		/* Terminate the loop if we have been asked to */
 		if (base->event_gotterm) {
 			break;
@@ -2034,6 +2464,9 @@ event_base_loop(struct event_base *base, int flags)
 
 		clear_time_cache(base); //清空计时缓存
 
+		if (base->stats)
+			stats_start = event_stats_now(base);
+
 		//dispatch是在第一个event超时发生之前去监听所有event感兴趣的非超时事件。
 		//根据前面，如果希望dispatch是非阻塞的，那么这里的tv_p就是0，该函数就会立即返回；
 		//如果希望dispatch是阻塞的，那么这里的tv_p就是距离第一个超时event的剩余时长，就让dispatch阻塞tv_p这么长的时间去监听所有已添加但未激活的event
@@ -2051,8 +2484,13 @@ event_base_loop(struct event_base *base, int flags)
 
 		update_time_cache(base);
 
+		event_activation_drain_nolock_(base);
+
 		timeout_process(base); //将base的min_heap中所有超时的事件以超时激活类型添加到激活队列中
 
+		if (base->stats)
+			stats_start = event_stats_count_wait(base, stats_start);
+
 		if (N_ACTIVE_CALLBACKS(base)) { //如果激活队列中有事件
 			int n = event_process_active(base); //执行激活队列中的event相应的回调函数，返回的n是成功执行的非内部事件数目
 			if ((flags & EVLOOP_ONCE) //如果设置了EVLOOP_ONCE，并且所有激活的事件都处理完了，那么就退出event_loop
@@ -2061,6 +2499,9 @@ event_base_loop(struct event_base *base, int flags)
 				done = 1;
 		} else if (flags & EVLOOP_NONBLOCK) //如果设置了EVLOOP_NONBLOCK那么也会退出event_loop循环
 			done = 1;
+
+		if (base->stats)
+			event_stats_count_busy(base, stats_start);
 	}
 	event_debug(("%s: asked to terminate loop.", __func__));
 
@@ -2139,6 +2580,11 @@ event_base_once(struct event_base *base, evutil_socket_t fd, short events,
 	}
 
 	if (res == 0) {
+#ifdef EVENT_HAVE_ACTIVATION_QUEUE_
+		if (activate && event_activation_push(base, &eonce->ev, eonce,
+			EV_TIMEOUT, 1) == 0)
+			return (0);
+#endif
 		EVBASE_ACQUIRE_LOCK(base, th_base_lock);
 		if (activate)
 			event_active_nolock_(&eonce->ev, EV_TIMEOUT, 1);
@@ -2435,6 +2881,7 @@ event_pending(const struct event *ev, short event, struct timeval *tv)
 
 	EVBASE_ACQUIRE_LOCK(ev->ev_base, th_base_lock); //加锁，防止中途其他线程修改了事件状态
 	event_debug_assert_is_setup_(ev);
+	event_activation_drain_nolock_(ev->ev_base);
 
 	if (ev->ev_flags & EVLIST_INSERTED) //是等待添加至事件链表，还是已添加至事件链表
 		flags |= (ev->ev_events & (EV_READ|EV_WRITE|EV_CLOSED|EV_SIGNAL));
@@ -2642,6 +3089,42 @@ event_remove_timer(struct event *ev)
 	return (res);
 }
 
+/* Helper for event_add_nolock_ on a base with EVENT_BASE_FLAG_LAZY_TIMEOUTS:
+ * if 'ev' already has a timeout in the heap that 'tv' moves later, just
+ * record the new deadline in ev_timeout and leave the heap entry where it
+ * is; timeout_process puts it right when the old deadline comes due.
+ * Return 1 if that worked, or 0 if the timeout must be rescheduled. */
+static int
+event_timeout_extend_lazily(struct event_base *base, struct event *ev,
+    const struct timeval *tv, int tv_is_absolute)
+{
+	struct timeval now, deadline;
+
+	if (!(ev->ev_flags & EVLIST_TIMEOUT) ||
+	    (ev->ev_flags & EVLIST_X_TIMER_WHEEL) ||
+	    is_common_timeout(&ev->ev_timeout, base) ||
+	    is_common_timeout(tv, base))
+		return 0;
+	/* Rescheduling has to take it off the active list. */
+	if ((ev->ev_flags & EVLIST_ACTIVE) && (ev->ev_res & EV_TIMEOUT))
+		return 0;
+
+	if (tv_is_absolute) {
+		deadline = *tv;
+	} else {
+		gettime(base, &now);
+		evutil_timeradd(&now, tv, &deadline);
+	}
+	if ((ev_int64_t)deadline.tv_sec * 1000000 + deadline.tv_usec <
+	    min_heap_elt_deadline_(&base->timeheap, ev))
+		return 0;
+
+	if (ev->ev_closure == EV_CLOSURE_EVENT_PERSIST && !tv_is_absolute)
+		ev->ev_io_timeout = *tv;
+	ev->ev_timeout = deadline;
+	return 1;
+}
+
 /* Implementation function to add an event.  Works just like event_add,
  * except: 1) it requires that we have the lock.  2) if tv_is_absolute is set,
  * we treat tv as an absolute time, not as an interval to add to the current
@@ -2668,7 +3151,7 @@ event_add_nolock_(struct event *ev, const struct timeval *tv,
 		 tv ? "EV_TIMEOUT " : " ",
 		 ev->ev_callback));
 
-	EVUTIL_ASSERT(!(ev->ev_flags & ~EVLIST_ALL)); //确保event的flags是给定的几种的合法组合
+	EVUTIL_ASSERT(!(ev->ev_flags & ~(EVLIST_ALL|EVLIST_X_TIMER_WHEEL))); //确保event的flags是给定的几种的合法组合
 
 	if (ev->ev_flags & EVLIST_FINALIZING) {
 		/* XXXX debug */
@@ -2729,7 +3212,9 @@ event_add_nolock_(struct event *ev, const struct timeval *tv,
 	 * we should change the timeout state only if the previous event
 	 * addition succeeded.
 	 */
-	if (res != -1 && tv != NULL) { //如果设置了超时
+	if (res != -1 && tv != NULL && //如果设置了超时
+	    !((base->flags & EVENT_BASE_FLAG_LAZY_TIMEOUTS) &&
+		event_timeout_extend_lazily(base, ev, tv, tv_is_absolute))) {
 		struct timeval now; //调用gettime(base, &now);获得系统时间
 		int common_timeout;
 #ifdef USE_REINSERT_TIMEOUT
@@ -2809,6 +3294,11 @@ event_add_nolock_(struct event *ev, const struct timeval *tv,
 			if (ev == TAILQ_FIRST(&ctl->events)) {
 				common_timeout_schedule(ctl, &now, ev);
 			}
+		} else if (ev->ev_flags & EVLIST_X_TIMER_WHEEL) {
+			/* Working out whether this is now the first thing the
+			 * wheel will need to do costs more than the occasional
+			 * extra wakeup from another thread. */
+			notify = 1;
 		} else {
 			struct event* top = NULL;
 			/* See if the earliest timeout is now earlier than it
@@ -2870,6 +3360,102 @@ event_del_noblock(struct event *ev)
 	return event_del_(ev, EVENT_DEL_NOBLOCK);
 }
 
+/* A batch that changes at least 1/TIMEOUT_BATCH_HEAPIFY_RATIO of the timeout
+ * heap is applied without sifting, and the heap rebuilt once afterwards. */
+#define TIMEOUT_BATCH_HEAPIFY_RATIO 8
+
+/* Check that every event in a batch shares one base, and return it. */
+static struct event_base *
+event_batch_base(struct event **evs, int n_events, const char *fn)
+{
+	struct event_base *base = evs[0]->ev_base;
+	int i;
+
+	if (EVUTIL_FAILURE_CHECK(!base)) {
+		event_warnx("%s: event has no event_base set.", fn);
+		return NULL;
+	}
+	for (i = 1; i < n_events; ++i) {
+		if (evs[i]->ev_base != base) {
+			event_warnx("%s: events belong to different event_bases.",
+			    fn);
+			return NULL;
+		}
+	}
+	return base;
+}
+
+/* Decide whether a batch of n_events should suspend the heap property of
+ * the timeout heap until it is done.  Called with th_base_lock held. */
+static int
+event_batch_begin(struct event_base *base, int n_events)
+{
+	ev_uint64_t size = min_heap_size_(&base->timeheap);
+
+	if ((ev_uint64_t)n_events * TIMEOUT_BATCH_HEAPIFY_RATIO < size + n_events)
+		return 0;
+	/* Adding or deleting the event whose callback is running in another
+	 * thread can drop the lock to wait for it, and the loop mustn't see
+	 * the heap half-built. */
+	if (base->current_event && !EVBASE_IN_THREAD(base))
+		return 0;
+	min_heap_set_unordered_(&base->timeheap);
+	return 1;
+}
+
+int
+event_add_batch(struct event **evs, int n_events, const struct timeval *tv)
+{
+	struct event_base *base;
+	int i, unordered, res = 0;
+
+	if (n_events <= 0)
+		return 0;
+	if (!(base = event_batch_base(evs, n_events, __func__)))
+		return -1;
+
+	EVBASE_ACQUIRE_LOCK(base, th_base_lock);
+	unordered = tv && event_batch_begin(base, n_events);
+	for (i = 0; i < n_events; ++i) {
+		if (event_add_nolock_(evs[i], tv, 0) < 0)
+			res = -1;
+	}
+	if (unordered) {
+		min_heap_heapify_(&base->timeheap);
+		/* event_add_nolock_ couldn't tell whether the earliest
+		 * timeout moved, so assume it did. */
+		if (EVBASE_NEED_NOTIFY(base))
+			evthread_notify_base(base);
+	}
+	EVBASE_RELEASE_LOCK(base, th_base_lock);
+
+	return (res);
+}
+
+int
+event_del_batch(struct event **evs, int n_events)
+{
+	struct event_base *base;
+	int i, unordered, res = 0;
+
+	if (n_events <= 0)
+		return 0;
+	if (!(base = event_batch_base(evs, n_events, __func__)))
+		return -1;
+
+	EVBASE_ACQUIRE_LOCK(base, th_base_lock);
+	unordered = event_batch_begin(base, n_events);
+	for (i = 0; i < n_events; ++i) {
+		if (event_del_nolock_(evs[i], EVENT_DEL_AUTOBLOCK) < 0)
+			res = -1;
+	}
+	if (unordered)
+		min_heap_heapify_(&base->timeheap);
+	EVBASE_RELEASE_LOCK(base, th_base_lock);
+
+	return (res);
+}
+
 /** Helper for event_del: always called with th_base_lock held.
  *
  * "blocking" must be one of the EVENT_DEL_{BLOCK, NOBLOCK, AUTOBLOCK,
@@ -2890,6 +3476,10 @@ event_del_nolock_(struct event *ev, int blocking)
 
 	EVENT_BASE_ASSERT_LOCKED(ev->ev_base);
 
+	/* The event may be waiting on the activation queue; make sure it's on
+	 * the active queue instead, where we can take it off. */
+	event_activation_drain_nolock_(ev->ev_base);
+
 	if (blocking != EVENT_DEL_EVEN_IF_FINALIZING) {
 		if (ev->ev_flags & EVLIST_FINALIZING) {
 			/* XXXX Debug */
@@ -2899,7 +3489,7 @@ event_del_nolock_(struct event *ev, int blocking)
 
 	base = ev->ev_base;
 
-	EVUTIL_ASSERT(!(ev->ev_flags & ~EVLIST_ALL));
+	EVUTIL_ASSERT(!(ev->ev_flags & ~(EVLIST_ALL|EVLIST_X_TIMER_WHEEL)));
 
 	/* See if we are just active executing this event in a loop */
 	if (ev->ev_events & EV_SIGNAL) {
@@ -2975,6 +3565,15 @@ event_active(struct event *ev, int res, short ncalls)
 		return;
 	}
 
+#ifdef EVENT_HAVE_ACTIVATION_QUEUE_
+	if (ev->ev_base->flags & EVENT_BASE_FLAG_ACTIVATION_QUEUE) {
+		event_debug_assert_is_setup_(ev);
+		if (event_activation_push(ev->ev_base, ev, NULL, res,
+			ncalls) == 0)
+			return;
+	}
+#endif
+
 	EVBASE_ACQUIRE_LOCK(ev->ev_base, th_base_lock); //获取锁
 
 	event_debug_assert_is_setup_(ev);
@@ -3217,11 +3816,25 @@ timeout_next(struct event_base *base, struct timeval **tv_p) //tv_p中保存了
 	struct timeval now;
 	struct event *ev;
 	struct timeval *tv = *tv_p;
+	struct timeval next;
+	ev_uint64_t tick;
 	int res = 0;
 
 	ev = min_heap_top_(&base->timeheap); //获取最先超时的event
-
-	if (ev == NULL) { //说明timeheap中没有event，也就是没有事件激活
+	if (ev != NULL) {
+		/* Wake for the heap entry, which a lazily extended timeout
+		 * leaves ahead of ev_timeout. */
+		ev_int64_t deadline = min_heap_elt_deadline_(&base->timeheap, ev);
+		next.tv_sec = (time_t)(deadline / 1000000);
+		next.tv_usec = (long)(deadline % 1000000);
+	}
+
+	if (base->timer_wheel && timer_wheel_next_(base->timer_wheel, &tick)) {
+		struct timeval wheel_next;
+		timer_wheel_tick_to_tv_(tick, &wheel_next);
+		if (ev == NULL || evutil_timercmp(&wheel_next, &next, <))
+			next = wheel_next;
+	} else if (ev == NULL) { //说明timeheap中没有event，也就是没有事件激活
 		/* if no time-based events are active wait for I/O */
 		*tv_p = NULL;
 		goto out;
@@ -3234,12 +3847,12 @@ timeout_next(struct event_base *base, struct timeval **tv_p) //tv_p中保存了
 	//比较最先超时的event的超时时间与获取到的时间，
 	//如果最先超时的时间都已经小于等于当前获取到的时间，说明此时可能已经超过了设置的时间，就清空tv，并且立即返回
 
-	if (evutil_timercmp(&ev->ev_timeout, &now, <=)) {
+	if (evutil_timercmp(&next, &now, <=)) {
 		evutil_timerclear(tv);
 		goto out;
 	}
 	//到这里说明最先超时的event还没有超时
-	evutil_timersub(&ev->ev_timeout, &now, tv); //计算剩余的超时时间，保存到tv中
+	evutil_timersub(&next, &now, tv); //计算剩余的超时时间，保存到tv中
 
 	EVUTIL_ASSERT(tv->tv_sec >= 0);
 	EVUTIL_ASSERT(tv->tv_usec >= 0);
@@ -3258,16 +3871,25 @@ timeout_process(struct event_base *base)
 	/* Caller must hold lock. */
 	struct timeval now;
 	struct event *ev;
+	ev_int64_t now_usec;
 
-	if (min_heap_empty_(&base->timeheap)) {
+	if (min_heap_empty_(&base->timeheap) &&
+	    (!base->timer_wheel || !base->timer_wheel->n)) {
 		return;
 	}
 
 	gettime(base, &now);
 
+	now_usec = (ev_int64_t)now.tv_sec * 1000000 + now.tv_usec;
 	while ((ev = min_heap_top_(&base->timeheap))) { //ev等于最先超时的事件
-		if (evutil_timercmp(&ev->ev_timeout, &now, >)) //若未超时则退出循环
+		if (min_heap_elt_deadline_(&base->timeheap, ev) > now_usec) //若未超时则退出循环
 			break;
+		if (evutil_timercmp(&ev->ev_timeout, &now, >)) {
+			/* Its timeout was extended lazily; file it under the
+			 * real deadline. */
+			min_heap_adjust_(&base->timeheap, ev);
+			continue;
+		}
 
 		/* delete this event from the I/O queues */
 		//从IO事件队列中删除
@@ -3277,6 +3899,17 @@ timeout_process(struct event_base *base)
 			 ev, ev->ev_callback));
 		event_active_nolock_(ev, EV_TIMEOUT, 1); //将事件插入激活事件队列
 	}
+
+	if (base->timer_wheel) {
+		ev_uint64_t tick = timer_wheel_tick_floor_(&now);
+		while ((ev = timer_wheel_expired_(base->timer_wheel, tick))) {
+			event_del_nolock_(ev, EVENT_DEL_NOBLOCK);
+
+			event_debug(("timeout_process: event: %p, call %p",
+				 ev, ev->ev_callback));
+			event_active_nolock_(ev, EV_TIMEOUT, 1);
+		}
+	}
 }
 
 #ifndef MAX
@@ -3358,6 +3991,9 @@ event_queue_remove_timeout(struct event_base *base, struct event *ev)
 		    get_common_timeout_list(base, &ev->ev_timeout);
 		TAILQ_REMOVE(&ctl->events, ev,
 		    ev_timeout_pos.ev_next_with_common_timeout);
+	} else if (ev->ev_flags & EVLIST_X_TIMER_WHEEL) {
+		ev->ev_flags &= ~EVLIST_X_TIMER_WHEEL;
+		timer_wheel_erase_(base->timer_wheel, ev);
 	} else {
 		min_heap_erase_(&base->timeheap, ev);
 	}
@@ -3435,6 +4071,27 @@ insert_common_timeout_inorder(struct common_timeout_list *ctl,
 	    ev_timeout_pos.ev_next_with_common_timeout);
 }
 
+/* Timeouts at least this many seconds away are coarse enough for the
+ * timing wheel. */
+#define TIMER_WHEEL_MIN_TIMEOUT_SEC 1
+
+/* Try to put 'ev' in the timing wheel of 'base'.  Return -1 if it belongs
+ * in the timeheap instead. */
+static int
+event_queue_insert_timer_wheel(struct event_base *base, struct event *ev)
+{
+	struct timeval now, delta;
+
+	gettime(base, &now);
+	evutil_timersub(&ev->ev_timeout, &now, &delta);
+	if (delta.tv_sec < TIMER_WHEEL_MIN_TIMEOUT_SEC)
+		return -1;
+	if (timer_wheel_push_(base->timer_wheel, ev, &now) < 0)
+		return -1;
+	ev->ev_flags |= EVLIST_X_TIMER_WHEEL;
+	return 0;
+}
+
 //
 static void
 event_queue_insert_inserted(struct event_base *base, struct event *ev)
@@ -3511,6 +4168,9 @@ event_queue_insert_timeout(struct event_base *base, struct event *ev)
 		struct common_timeout_list *ctl =
 		    get_common_timeout_list(base, &ev->ev_timeout);
 		insert_common_timeout_inorder(ctl, ev);
+	} else if (base->timer_wheel &&
+	    event_queue_insert_timer_wheel(base, ev) == 0) {
+		/* It's in the wheel. */
 	} else {
 		min_heap_push_(&base->timeheap, ev);
 	}
@@ -3528,6 +4188,8 @@ event_queue_make_later_events_active(struct event_base *base)
 		EVUTIL_ASSERT(evcb->evcb_pri < base->nactivequeues);
 		TAILQ_INSERT_TAIL(&base->activequeues[evcb->evcb_pri], evcb, evcb_active_next);
 		base->n_deferreds_queued += (evcb->evcb_closure == EV_CLOSURE_CB_SELF);
+		if (base->stats)
+			++base->stats->totals.n_deferred;
 	}
 }
 
@@ -3779,7 +4441,7 @@ event_base_foreach_event_nolock_(struct event_base *base,
 	/* Okay, now we deal with those events that have timeouts and are in
 	 * the min-heap. */
 	for (u = 0; u < base->timeheap.n; ++u) {
-		ev = base->timeheap.p[u];
+		ev = base->timeheap.p[u].ev;
 		if (ev->ev_flags & EVLIST_INSERTED) {
 			/* we already processed this one */
 			continue;
@@ -3788,6 +4450,23 @@ event_base_foreach_event_nolock_(struct event_base *base,
 			return r;
 	}
 
+	/* Then the ones in the timing wheel. */
+	if (base->timer_wheel) {
+		int l, slot;
+		for (l = 0; l < TIMER_WHEEL_LEVELS; ++l) {
+			for (slot = 0; slot < TIMER_WHEEL_SLOTS; ++slot) {
+				TAILQ_FOREACH(ev,
+				    &base->timer_wheel->slots[l][slot],
+				    ev_timeout_pos.ev_next_with_common_timeout) {
+					if (ev->ev_flags & EVLIST_INSERTED)
+						continue;
+					if ((r = fn(base, ev, arg)))
+						return r;
+				}
+			}
+		}
+	}
+
 	/* Now for the events in one of the timeout queues.
 	 * the min-heap. */
 	for (i = 0; i < base->n_common_timeouts; ++i) {
@@ -3910,6 +4589,179 @@ event_base_dump_events(struct event_base *base, FILE *output)
 	EVBASE_RELEASE_LOCK(base, th_base_lock);
 }
 
+int
+event_base_get_stats(struct event_base *base, struct event_base_stats *stats)
+{
+	int r = -1;
+
+	EVBASE_ACQUIRE_LOCK(base, th_base_lock);
+	if (base->stats) {
+		memcpy(stats, &base->stats->totals, sizeof(*stats));
+		r = 0;
+	}
+	EVBASE_RELEASE_LOCK(base, th_base_lock);
+	return r;
+}
+
+int
+event_base_get_callback_histogram(struct event_base *base, int priority,
+    ev_uint64_t *buckets, int n_buckets)
+{
+	int r = -1;
+
+	if (n_buckets > EVENT_BASE_STATS_N_BUCKETS)
+		n_buckets = EVENT_BASE_STATS_N_BUCKETS;
+	EVBASE_ACQUIRE_LOCK(base, th_base_lock);
+	if (base->stats && priority >= 0 &&
+	    priority < base->stats->n_priorities && n_buckets >= 0) {
+		memcpy(buckets, base->stats->cb_hist[priority],
+		    n_buckets * sizeof(ev_uint64_t));
+		r = n_buckets;
+	}
+	EVBASE_RELEASE_LOCK(base, th_base_lock);
+	return r;
+}
+
+void
+event_base_reset_stats(struct event_base *base)
+{
+	struct event_base_stats_internal *st;
+
+	EVBASE_ACQUIRE_LOCK(base, th_base_lock);
+	if ((st = base->stats)) {
+		memset(&st->totals, 0, sizeof(st->totals));
+		memset(st->cb_hist, 0, st->n_priorities * sizeof(*st->cb_hist));
+	}
+	EVBASE_RELEASE_LOCK(base, th_base_lock);
+}
+
+int
+event_base_set_slow_callback_threshold(struct event_base *base,
+    const struct timeval *threshold, event_slow_callback_cb hook, void *arg)
+{
+	int r = 0;
+
+	EVBASE_ACQUIRE_LOCK(base, th_base_lock);
+	if (!threshold) {
+		if (base->slow_log) {
+			mm_free(base->slow_log);
+			base->slow_log = NULL;
+		}
+		goto done;
+	}
+	if (threshold->tv_sec < 0 || threshold->tv_usec < 0 ||
+	    threshold->tv_usec >= 1000000) {
+		r = -1;
+		goto done;
+	}
+	if (!base->slow_log) {
+		if (!(base->slow_log = mm_calloc(1, sizeof(*base->slow_log)))) {
+			r = -1;
+			goto done;
+		}
+		evutil_configure_monotonic_time_(&base->cb_timer,
+		    EV_MONOT_PRECISE);
+	}
+	base->slow_log->threshold_usec =
+	    (ev_uint64_t)threshold->tv_sec * 1000000 + threshold->tv_usec;
+	base->slow_log->hook = hook;
+	base->slow_log->hook_arg = arg;
+done:
+	EVBASE_RELEASE_LOCK(base, th_base_lock);
+	return r;
+}
+
+int
+event_base_get_slow_callbacks(struct event_base *base,
+    struct event_slow_callback *slow, int n_slow)
+{
+	struct event_slow_log *log;
+	int i, r = -1;
+
+	EVBASE_ACQUIRE_LOCK(base, th_base_lock);
+	if ((log = base->slow_log)) {
+		for (i = 0; i < n_slow && i < EVENT_SLOW_CALLBACK_LOG_SIZE &&
+			 (ev_uint64_t)i < log->n_recorded; ++i)
+			slow[i] = log->ring[(log->n_recorded - 1 - i) %
+			    EVENT_SLOW_CALLBACK_LOG_SIZE];
+		r = i;
+	}
+	EVBASE_RELEASE_LOCK(base, th_base_lock);
+	return r;
+}
+
+static void
+dump_slow_callbacks(const struct event_slow_log *log, FILE *output)
+{
+	ev_uint64_t i;
+
+	fprintf(output, "Slow callbacks (at least %lu us): %lu\n",
+	    (unsigned long)log->threshold_usec,
+	    (unsigned long)log->n_recorded);
+	for (i = 0; i < log->n_recorded && i < EVENT_SLOW_CALLBACK_LOG_SIZE;
+	     ++i) {
+		const struct event_slow_callback *slow = &log->ring[
+		    (log->n_recorded - 1 - i) % EVENT_SLOW_CALLBACK_LOG_SIZE];
+		fprintf(output, "  %p(fd %d, %s%s%s%s, arg %p), priority %d: "
+		    "%lu us at %ld.%06d\n",
+		    (void *)slow->fn, (int)slow->fd,
+		    slow->events & EV_READ ? "R" : "",
+		    slow->events & EV_WRITE ? "W" : "",
+		    slow->events & EV_SIGNAL ? "S" : "",
+		    slow->events & EV_TIMEOUT ? "T" : "",
+		    slow->arg, slow->priority, (unsigned long)slow->usec,
+		    (long)slow->when.tv_sec, (int)slow->when.tv_usec);
+	}
+}
+
+void
+event_base_dump_stats(struct event_base *base, FILE *output)
+{
+	struct event_base_stats_internal *st;
+	struct event_callback *evcb;
+	const struct event_base_stats *t;
+	int i, j, n;
+
+	EVBASE_ACQUIRE_LOCK(base, th_base_lock);
+	if (base->slow_log)
+		dump_slow_callbacks(base->slow_log, output);
+	if (!(st = base->stats)) {
+		fprintf(output, "Statistics are not enabled.\n");
+		goto done;
+	}
+	t = &st->totals;
+	fprintf(output, "Loops: %lu, waiting %lu us, busy %lu us "
+	    "(longest %lu us)\n", (unsigned long)t->n_loops,
+	    (unsigned long)t->wait_usec, (unsigned long)t->busy_usec,
+	    (unsigned long)t->max_busy_usec);
+	fprintf(output, "Callbacks: %lu in %lu us, %lu deferred\n",
+	    (unsigned long)t->n_callbacks, (unsigned long)t->callback_usec,
+	    (unsigned long)t->n_deferred);
+	fprintf(output, "Active after polling: mean %.2f, most %lu\n",
+	    t->n_loops ? (double)t->active_sum / t->n_loops : 0.0,
+	    (unsigned long)t->max_active);
+	for (i = 0; i < base->nactivequeues; ++i) {
+		n = 0;
+		TAILQ_FOREACH(evcb, &base->activequeues[i], evcb_active_next)
+			++n;
+		fprintf(output, "Priority %d: %d active; callback usec:", i, n);
+		for (j = 0; i < st->n_priorities &&
+			 j < EVENT_BASE_STATS_N_BUCKETS; ++j) {
+			if (!st->cb_hist[i][j])
+				continue;
+			if (j < EVENT_BASE_STATS_N_BUCKETS - 1)
+				fprintf(output, " <%lu:%lu", 1UL << j,
+				    (unsigned long)st->cb_hist[i][j]);
+			else
+				fprintf(output, " >=%lu:%lu", 1UL << (j - 1),
+				    (unsigned long)st->cb_hist[i][j]);
+		}
+		fprintf(output, "\n");
+	}
+done:
+	EVBASE_RELEASE_LOCK(base, th_base_lock);
+}
+
 void
 event_base_active_by_fd(struct event_base *base, evutil_socket_t fd, short events)
 {
@@ -3926,7 +4778,7 @@ event_base_active_by_fd(struct event_base *base, evutil_socket_t fd, short event
 		struct event *ev;
 
 		for (u = 0; u < base->timeheap.n; ++u) {
-			ev = base->timeheap.p[u];
+			ev = base->timeheap.p[u].ev;
 			if (ev->ev_fd == fd) {
 				event_active_nolock_(ev, EV_TIMEOUT, 1);
 			}
@@ -3941,6 +4793,20 @@ event_base_active_by_fd(struct event_base *base, evutil_socket_t fd, short event
 				}
 			}
 		}
+
+		if (base->timer_wheel) {
+			int l, slot;
+			for (l = 0; l < TIMER_WHEEL_LEVELS; ++l) {
+				for (slot = 0; slot < TIMER_WHEEL_SLOTS; ++slot) {
+					TAILQ_FOREACH(ev,
+					    &base->timer_wheel->slots[l][slot],
+					    ev_timeout_pos.ev_next_with_common_timeout) {
+						if (ev->ev_fd == fd)
+							event_active_nolock_(ev, EV_TIMEOUT, 1);
+					}
+				}
+			}
+		}
 	}
 
 	EVBASE_RELEASE_LOCK(base, th_base_lock);
@@ -4058,14 +4924,50 @@ event_base_assert_ok_nolock_(struct event_base *base)
 	evmap_check_integrity_(base);
 
 	/* Check the heap property */
-	for (i = 1; i < (int)base->timeheap.n; ++i) {
-		int parent = (i - 1) / 2;
-		struct event *ev, *p_ev;
-		ev = base->timeheap.p[i];
-		p_ev = base->timeheap.p[parent];
+	for (i = 0; i < (int)base->timeheap.n; ++i) {
+		struct event *ev = base->timeheap.p[i].ev;
 		EVUTIL_ASSERT(ev->ev_flags & EVLIST_TIMEOUT);
-		EVUTIL_ASSERT(evutil_timercmp(&p_ev->ev_timeout, &ev->ev_timeout, <=));
 		EVUTIL_ASSERT(ev->ev_timeout_pos.min_heap_idx == i);
+		if (base->flags & EVENT_BASE_FLAG_LAZY_TIMEOUTS)
+			EVUTIL_ASSERT(base->timeheap.p[i].deadline <=
+			    min_heap_deadline_(ev));
+		else
+			EVUTIL_ASSERT(base->timeheap.p[i].deadline ==
+			    min_heap_deadline_(ev));
+		if (i) {
+			int parent = MIN_HEAP_PARENT(i);
+			EVUTIL_ASSERT(base->timeheap.p[parent].deadline <=
+			    base->timeheap.p[i].deadline);
+		}
+	}
+
+	/* Check that every event in the timing wheel is where it should be */
+	if (base->timer_wheel) {
+		struct timer_wheel *w = base->timer_wheel;
+		int l, slot;
+		unsigned n = 0;
+		for (l = 0; l < TIMER_WHEEL_LEVELS; ++l) {
+			for (slot = 0; slot < TIMER_WHEEL_SLOTS; ++slot) {
+				struct event *ev;
+				struct event_list *list = &w->slots[l][slot];
+				int occupied = (w->occupied[l][slot/64] >>
+				    (slot%64)) & 1;
+				EVUTIL_ASSERT_TAILQ_OK(list, event,
+				    ev_timeout_pos.ev_next_with_common_timeout);
+				EVUTIL_ASSERT(occupied == !TAILQ_EMPTY(list));
+				TAILQ_FOREACH(ev, list,
+				    ev_timeout_pos.ev_next_with_common_timeout) {
+					int ev_l, ev_slot;
+					EVUTIL_ASSERT(ev->ev_flags & EVLIST_TIMEOUT);
+					EVUTIL_ASSERT(ev->ev_flags & EVLIST_X_TIMER_WHEEL);
+					EVUTIL_ASSERT(timer_wheel_slot_(w,
+					    timer_wheel_tick_ceil_(&ev->ev_timeout),
+					    &ev_l, &ev_slot) == list);
+					++n;
+				}
+			}
+		}
+		EVUTIL_ASSERT(n == w->n);
 	}
 
 	/* Check that the common timeouts are fine */
@@ -0,0 +1,400 @@
+/*
+ * Copyright (c) 2007-2012 Niels Provos and Nick Mathewson
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * event_channel: a bounded queue of pointers between threads.
+ *
+ * The ring is the bounded queue from Dmitry Vyukov: every cell carries a
+ * sequence number that tells a sender whether the cell is free for the
+ * position it claimed, and tells the receiver whether the message in it has
+ * been written yet.  Senders claim positions with a compare-and-swap; there
+ * is only one receiver, the callback on the receiving base, so it needs no
+ * atomic read-modify-write at all.
+ *
+ * The receiving base is woken through an ordinary event that we activate
+ * only when 'recv_pending' goes from 0 to 1, so a stream of sends costs one
+ * event_active() (and at most one notification syscall) per batch that the
+ * receiver takes, not one per message.
+ *
+ * Compilers without the __atomic builtins get the same ring behind a lock.
+ */
+
+#include "event2/event-config.h"
+#include "evconfig-private.h"
+
+#include <sys/types.h>
+
+#include "event2/event.h"
+#include "event2/thread.h"
+#include "event2/util.h"
+#include "evthread-internal.h"
+#include "log-internal.h"
+#include "mm-internal.h"
+#include "util-internal.h"
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CHANNEL_LOCK_FREE
+#endif
+
+/* The most messages we hand to one call of the receive callback. */
+#define CHANNEL_BATCH_MAX 64
+/* Keep the senders' and the receiver's positions on separate cache
+ * lines. */
+#define CHANNEL_CACHELINE 64
+
+struct channel_cell {
+	ev_uint32_t seq;
+	void *msg;
+};
+
+struct event_channel {
+	/** The next position to send into; shared by the senders. */
+	ev_uint32_t enqueue_pos;
+	char pad0_[CHANNEL_CACHELINE - sizeof(ev_uint32_t)];
+	/** The next position to receive from; only the receiver writes it. */
+	ev_uint32_t dequeue_pos;
+	char pad1_[CHANNEL_CACHELINE - sizeof(ev_uint32_t)];
+
+	/** True if recv_ev is active, or is about to be made active. */
+	ev_uint32_t recv_pending;
+	/** True if a send failed and nobody has activated space_ev since. */
+	ev_uint32_t space_wanted;
+
+	/** The number of cells, minus one. */
+	ev_uint32_t mask;
+	struct channel_cell *cells;
+
+	struct event *recv_ev;
+	event_channel_recv_cb recv_cb;
+	void *recv_arg;
+
+	struct event *space_ev;
+	event_channel_space_cb space_cb;
+	void *space_arg;
+
+#ifndef CHANNEL_LOCK_FREE
+	void *lock;
+#endif
+};
+
+#ifdef CHANNEL_LOCK_FREE
+static int
+channel_push(struct event_channel *ch, void *msg)
+{
+	struct channel_cell *cell;
+	ev_uint32_t pos, seq;
+	ev_int32_t dif;
+
+	pos = __atomic_load_n(&ch->enqueue_pos, __ATOMIC_RELAXED);
+	for (;;) {
+		cell = &ch->cells[pos & ch->mask];
+		seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+		dif = (ev_int32_t)(seq - pos);
+		if (dif == 0) {
+			/* The cell is free: try to claim its position. On
+			 * failure, pos is reloaded for us. */
+			if (__atomic_compare_exchange_n(&ch->enqueue_pos,
+				&pos, pos + 1, 1, __ATOMIC_RELAXED,
+				__ATOMIC_RELAXED))
+				break;
+		} else if (dif < 0) {
+			/* The cell still holds a message from the last lap. */
+			return -1;
+		} else {
+			/* Another sender claimed this position first. */
+			pos = __atomic_load_n(&ch->enqueue_pos,
+			    __ATOMIC_RELAXED);
+		}
+	}
+	cell->msg = msg;
+	__atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+static int
+channel_pop(struct event_channel *ch, void **msg)
+{
+	ev_uint32_t pos = ch->dequeue_pos;
+	struct channel_cell *cell = &ch->cells[pos & ch->mask];
+
+	if (__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) != pos + 1)
+		return -1;
+	*msg = cell->msg;
+	/* Hand the cell to whoever sends into it on the next lap. */
+	__atomic_store_n(&cell->seq, pos + ch->mask + 1, __ATOMIC_RELEASE);
+	__atomic_store_n(&ch->dequeue_pos, pos + 1, __ATOMIC_SEQ_CST);
+	return 0;
+}
+
+static ev_uint32_t
+channel_count(struct event_channel *ch)
+{
+	return __atomic_load_n(&ch->enqueue_pos, __ATOMIC_SEQ_CST) -
+	    __atomic_load_n(&ch->dequeue_pos, __ATOMIC_SEQ_CST);
+}
+
+/* The flags are a Dekker-style handshake between a sender and the
+ * receiver: each side stores, then loads what the other side stores, so
+ * these are sequentially consistent. */
+static ev_uint32_t
+channel_flag_get(struct event_channel *ch, ev_uint32_t *flag)
+{
+	return __atomic_load_n(flag, __ATOMIC_SEQ_CST);
+}
+
+static ev_uint32_t
+channel_flag_swap(struct event_channel *ch, ev_uint32_t *flag, ev_uint32_t v)
+{
+	return __atomic_exchange_n(flag, v, __ATOMIC_SEQ_CST);
+}
+#else
+static int
+channel_push(struct event_channel *ch, void *msg)
+{
+	struct channel_cell *cell;
+	int r = -1;
+
+	EVLOCK_LOCK(ch->lock, 0);
+	cell = &ch->cells[ch->enqueue_pos & ch->mask];
+	if (cell->seq == ch->enqueue_pos) {
+		cell->msg = msg;
+		cell->seq = ++ch->enqueue_pos;
+		r = 0;
+	}
+	EVLOCK_UNLOCK(ch->lock, 0);
+	return r;
+}
+
+static int
+channel_pop(struct event_channel *ch, void **msg)
+{
+	struct channel_cell *cell;
+	int r = -1;
+
+	EVLOCK_LOCK(ch->lock, 0);
+	cell = &ch->cells[ch->dequeue_pos & ch->mask];
+	if (cell->seq == ch->dequeue_pos + 1) {
+		*msg = cell->msg;
+		cell->seq = ch->dequeue_pos + ch->mask + 1;
+		++ch->dequeue_pos;
+		r = 0;
+	}
+	EVLOCK_UNLOCK(ch->lock, 0);
+	return r;
+}
+
+static ev_uint32_t
+channel_count(struct event_channel *ch)
+{
+	ev_uint32_t n;
+	EVLOCK_LOCK(ch->lock, 0);
+	n = ch->enqueue_pos - ch->dequeue_pos;
+	EVLOCK_UNLOCK(ch->lock, 0);
+	return n;
+}
+
+static ev_uint32_t
+channel_flag_get(struct event_channel *ch, ev_uint32_t *flag)
+{
+	ev_uint32_t v;
+	EVLOCK_LOCK(ch->lock, 0);
+	v = *flag;
+	EVLOCK_UNLOCK(ch->lock, 0);
+	return v;
+}
+
+static ev_uint32_t
+channel_flag_swap(struct event_channel *ch, ev_uint32_t *flag, ev_uint32_t v)
+{
+	ev_uint32_t old;
+	EVLOCK_LOCK(ch->lock, 0);
+	old = *flag;
+	*flag = v;
+	EVLOCK_UNLOCK(ch->lock, 0);
+	return old;
+}
+#endif
+
+/* True if a full channel has drained far enough to wake its sender. */
+#define CHANNEL_BELOW_LOWAT(ch) (channel_count(ch) <= ((ch)->mask + 1) / 2)
+
+static void
+channel_wake_receiver(struct event_channel *ch)
+{
+	if (!channel_flag_swap(ch, &ch->recv_pending, 1))
+		event_active(ch->recv_ev, EV_READ, 1);
+}
+
+static void
+channel_wake_sender(struct event_channel *ch)
+{
+	if (ch->space_ev && channel_flag_get(ch, &ch->space_wanted) &&
+	    CHANNEL_BELOW_LOWAT(ch) &&
+	    channel_flag_swap(ch, &ch->space_wanted, 0))
+		event_active(ch->space_ev, EV_WRITE, 1);
+}
+
+static void
+channel_want_space(struct event_channel *ch)
+{
+	if (!ch->space_ev)
+		return;
+	channel_flag_swap(ch, &ch->space_wanted, 1);
+	/* The receiver may have drained the channel before it could see the
+	 * flag; if so, nobody else is going to wake us. */
+	if (CHANNEL_BELOW_LOWAT(ch) &&
+	    channel_flag_swap(ch, &ch->space_wanted, 0))
+		event_active(ch->space_ev, EV_WRITE, 1);
+}
+
+static void
+channel_recv_event_cb(evutil_socket_t fd, short what, void *arg)
+{
+	struct event_channel *ch = arg;
+	void *msgs[CHANNEL_BATCH_MAX];
+	ev_uint32_t budget = ch->mask + 1;
+	int n;
+
+	/* Clear the flag before we look at the ring: a sender that finds it
+	 * clear after this will wake us again. */
+	channel_flag_swap(ch, &ch->recv_pending, 0);
+	while (budget) {
+		for (n = 0; n < CHANNEL_BATCH_MAX && (ev_uint32_t)n < budget;
+		     ++n) {
+			if (channel_pop(ch, &msgs[n]) < 0)
+				break;
+		}
+		if (!n)
+			return;
+		budget -= n;
+		channel_wake_sender(ch);
+		ch->recv_cb(ch, msgs, n, ch->recv_arg);
+	}
+	/* We took a channel's worth of messages.  Give the other events on
+	 * this base a turn before we take more. */
+	channel_wake_receiver(ch);
+}
+
+static void
+channel_space_event_cb(evutil_socket_t fd, short what, void *arg)
+{
+	struct event_channel *ch = arg;
+	ch->space_cb(ch, ch->space_arg);
+}
+
+struct event_channel *
+event_channel_new(struct event_base *base, unsigned capacity,
+    event_channel_recv_cb cb, void *arg)
+{
+	struct event_channel *ch;
+	ev_uint32_t size, i;
+
+	if (!base || !cb || capacity > 0x40000000U)
+		return NULL;
+	for (size = 2; size < capacity; size <<= 1)
+		;
+
+	if (evthread_make_base_notifiable(base) < 0)
+		return NULL;
+	if (!(ch = mm_calloc(1, sizeof(struct event_channel))))
+		return NULL;
+	if (!(ch->cells = mm_calloc(size, sizeof(struct channel_cell))))
+		goto err;
+	for (i = 0; i < size; ++i)
+		ch->cells[i].seq = i;
+	ch->mask = size - 1;
+	ch->recv_cb = cb;
+	ch->recv_arg = arg;
+	ch->recv_ev = event_new(base, -1, 0, channel_recv_event_cb, ch);
+	if (!ch->recv_ev)
+		goto err;
+#ifndef CHANNEL_LOCK_FREE
+	EVTHREAD_ALLOC_LOCK(ch->lock, 0);
+#endif
+	return ch;
+err:
+	if (ch->cells)
+		mm_free(ch->cells);
+	mm_free(ch);
+	return NULL;
+}
+
+int
+event_channel_set_space_cb(struct event_channel *ch, struct event_base *base,
+    event_channel_space_cb cb, void *arg)
+{
+	if (ch->space_ev) {
+		event_free(ch->space_ev);
+		ch->space_ev = NULL;
+	}
+	ch->space_cb = NULL;
+	ch->space_arg = NULL;
+	ch->space_wanted = 0;
+	if (!base || !cb)
+		return 0;
+
+	ch->space_ev = event_new(base, -1, 0, channel_space_event_cb, ch);
+	if (!ch->space_ev)
+		return -1;
+	ch->space_cb = cb;
+	ch->space_arg = arg;
+	return 0;
+}
+
+int
+event_channel_send(struct event_channel *ch, void *msg)
+{
+	return event_channel_send_batch(ch, &msg, 1) == 1 ? 0 : -1;
+}
+
+int
+event_channel_send_batch(struct event_channel *ch, void **msgs, int n_msgs)
+{
+	int i;
+
+	for (i = 0; i < n_msgs; ++i) {
+		if (channel_push(ch, msgs[i]) < 0)
+			break;
+	}
+	if (i)
+		channel_wake_receiver(ch);
+	if (i < n_msgs)
+		channel_want_space(ch);
+	return i;
+}
+
+void
+event_channel_free(struct event_channel *ch)
+{
+	if (ch->space_ev)
+		event_free(ch->space_ev);
+	event_free(ch->recv_ev);
+#ifndef CHANNEL_LOCK_FREE
+	EVTHREAD_FREE_LOCK(ch->lock, 0);
+#endif
+	mm_free(ch->cells);
+	mm_free(ch);
+}
@@ -55,8 +55,14 @@
 
 /** An entry for an evmap_io list: notes all the events that want to read or
 	write on a given fd, and the number of each.
+
+	The first two events go in inline_evs, since one reader and one writer
+	(or a single event for both) is by far the most common case; only the
+	rest go on the list.  The slots are filled in order, and the list is
+	only used when both are full.
   */
 struct evmap_io {
+	struct event *inline_evs[2];
 	struct event_dlist events; //存放感兴趣IO事件的双向链表
 	ev_uint16_t nread; //感兴趣的读事件个数
 	ev_uint16_t nwrite; //感兴趣的写事件个数
@@ -71,8 +77,8 @@ struct evmap_signal {
 
 /* On some platforms, fds start at 0 and increment by 1 as they are
    allocated, and old numbers get used.  For these platforms, we
-   implement io maps just like signal maps: as an array of pointers to
-   struct evmap_io.  But on other platforms (windows), sockets are not
+   implement io maps as a flat array of struct evmap_io records, each
+   followed by the backend's fdinfo.  But on other platforms (windows), sockets are not
    0-indexed, not necessarily consecutive, and not necessarily reused.
    There, we use a hashtable to implement evmap_io.
 */
@@ -178,22 +184,83 @@ void evmap_io_clear_(struct event_io_map *ctx)
 		(x) = (struct type *)((map)->entries[slot]);		\
 	} while (0)
 
-/* If we aren't using hashtables, then define the IO_SLOT macros and functions
-   as thin aliases over the SIGNAL_SLOT versions. */
+/* If we aren't using hashtables, the record for each fd lives in a flat
+   array; a zeroed record is a constructed, empty one, so the IO_SLOT macros
+   just index it.  Does no bounds-checking. */
 #ifndef EVMAP_USE_HT
-#define GET_IO_SLOT(x,map,slot,type) GET_SIGNAL_SLOT(x,map,slot,type)
+#define GET_IO_SLOT(x,map,slot,type)					\
+	(x) = (struct type *)((char *)(map)->entries +			\
+	    (size_t)(slot) * (map)->entry_size)
 #define GET_IO_SLOT_AND_CTOR(x,map,slot,type,ctor,fdinfo_len)	\
-	GET_SIGNAL_SLOT_AND_CTOR(x,map,slot,type,ctor,fdinfo_len)
+	GET_IO_SLOT(x,map,slot,type)
 #define FDINFO_OFFSET sizeof(struct evmap_io)
+
+/* Records are padded to this, so that every fdinfo is aligned. */
+#define EVMAP_IO_ALIGN 8
+
 void
 evmap_io_initmap_(struct event_io_map* ctx)
 {
-	evmap_signal_initmap_(ctx);
+	ctx->entries = NULL;
+	ctx->nentries = 0;
+	ctx->entry_size = 0;
 }
 void
 evmap_io_clear_(struct event_io_map* ctx)
 {
-	evmap_signal_clear_(ctx);
+	if (ctx->entries != NULL)
+		mm_free(ctx->entries);
+	evmap_io_initmap_(ctx);
+}
+
+/** Expand 'map' until it is big enough to store a record for 'slot', with
+	fdinfo_len bytes of fdinfo after each struct evmap_io.
+ */
+static int
+evmap_io_make_space(struct event_io_map *map, int slot, size_t fdinfo_len)
+{
+	if (map->nentries <= slot) {
+		int nentries = map->nentries ? map->nentries : 32;
+		size_t entry_size = map->entry_size;
+		char *tmp;
+		int i;
+
+		if (!entry_size)
+			entry_size = (sizeof(struct evmap_io) + fdinfo_len +
+			    EVMAP_IO_ALIGN - 1) & ~(size_t)(EVMAP_IO_ALIGN - 1);
+
+		if (slot > INT_MAX / 2)
+			return (-1);
+
+		while (nentries <= slot)
+			nentries <<= 1;
+
+		if ((size_t)nentries > EV_SIZE_MAX / entry_size)
+			return (-1);
+
+		tmp = mm_realloc(map->entries, (size_t)nentries * entry_size);
+		if (tmp == NULL)
+			return (-1);
+
+		memset(tmp + (size_t)map->nentries * entry_size, 0,
+		    (size_t)(nentries - map->nentries) * entry_size);
+
+		/* The first event on each list points back at its head, which
+		 * has just moved. */
+		for (i = 0; i < map->nentries; ++i) {
+			struct evmap_io *ctx =
+			    (struct evmap_io *)(tmp + (size_t)i * entry_size);
+			struct event *ev = LIST_FIRST(&ctx->events);
+			if (ev)
+				ev->ev_io_next.le_prev = &LIST_FIRST(&ctx->events);
+		}
+
+		map->nentries = nentries;
+		map->entries = tmp;
+		map->entry_size = (int)entry_size;
+	}
+
+	return (0);
 }
 #endif
 
@@ -257,15 +324,63 @@ evmap_signal_clear_(struct event_signal_map *ctx)
 
 /* code specific to file descriptors */
 
-/** Constructor for struct evmap_io */
+#ifdef EVMAP_USE_HT
+/** Constructor for struct evmap_io.  The flat array doesn't need one: its
+    records start out zeroed, which is empty. */
 static void
 evmap_io_init(struct evmap_io *entry)
 {
+	entry->inline_evs[0] = entry->inline_evs[1] = NULL;
 	LIST_INIT(&entry->events);
 	entry->nread = 0;
 	entry->nwrite = 0;
 	entry->nclose = 0;
 }
+#endif
+
+/* Iterate over every event pending on 'ctx': the inline ones, then the
+ * list.  Nothing may be added to or removed from 'ctx' meanwhile. */
+#define EVMAP_IO_FOREACH(ev, ctx)					\
+	for ((ev) = (ctx)->inline_evs[0]; (ev);				\
+	     (ev) = evmap_io_next_event((ctx), (ev)))
+
+static inline struct event *
+evmap_io_next_event(struct evmap_io *ctx, struct event *ev)
+{
+	if (ev == ctx->inline_evs[0])
+		return ctx->inline_evs[1];
+	if (ev == ctx->inline_evs[1])
+		return LIST_FIRST(&ctx->events);
+	return LIST_NEXT(ev, ev_io_next);
+}
+
+static void
+evmap_io_insert_event(struct evmap_io *ctx, struct event *ev)
+{
+	if (!ctx->inline_evs[0])
+		ctx->inline_evs[0] = ev;
+	else if (!ctx->inline_evs[1])
+		ctx->inline_evs[1] = ev;
+	else
+		LIST_INSERT_HEAD(&ctx->events, ev, ev_io_next);
+}
+
+static void
+evmap_io_remove_event(struct evmap_io *ctx, struct event *ev)
+{
+	struct event *next;
+
+	if (ev == ctx->inline_evs[0]) {
+		ctx->inline_evs[0] = ctx->inline_evs[1];
+	} else if (ev != ctx->inline_evs[1]) {
+		LIST_REMOVE(ev, ev_io_next);
+		return;
+	}
+	/* Keep the slots full while the list has anything to fill them. */
+	if ((next = LIST_FIRST(&ctx->events)))
+		LIST_REMOVE(next, ev_io_next);
+	ctx->inline_evs[1] = next;
+}
 
 
 /* return -1 on error, 0 on success if nothing changed in the event backend,
@@ -289,11 +404,11 @@ evmap_io_add_(struct event_base *base, evutil_socket_t fd, struct event *ev)
 	if (fd < 0)
 		return 0;
 
-#ifndef EVMAP_USE_HT //如果不使用哈希，那么用的就是signal_map
-	//判断是否是非映射之外的sig
+#ifndef EVMAP_USE_HT //如果不使用哈希，那么用的就是平坦数组
+	//判断是否是非映射之外的fd
 	if (fd >= io->nentries) {
 		//若是的话分配新空间添加到映射中
-		if (evmap_make_space(io, fd, sizeof(struct evmap_io *)) == -1)
+		if (evmap_io_make_space(io, fd, evsel->fdinfo_len) == -1)
 			return (-1);
 	}
 #endif
@@ -331,7 +446,7 @@ evmap_io_add_(struct event_base *base, evutil_socket_t fd, struct event *ev)
 	}
 	//保证fd下的链表中所有event要么都是ET要么都不是ET，不能混合使用
 	if (EVENT_DEBUG_MODE_IS_ON() &&
-	    (old_ev = LIST_FIRST(&ctx->events)) &&
+	    (old_ev = ctx->inline_evs[0]) &&
 	    (old_ev->ev_events&EV_ET) != (ev->ev_events&EV_ET)) {
 		event_warnx("Tried to mix edge-triggered and non-edge-triggered"
 		    " events on fd %d", (int)fd);
@@ -345,7 +460,8 @@ evmap_io_add_(struct event_base *base, evutil_socket_t fd, struct event *ev)
 		 * this. */
 		//注册新的感兴趣的事件，如让epoll监听该事件，若是linux系统下则调用epoll.c下的epoll_nochangelist_add(struct event_base *base, evutil_socket_t fd,short old, short events, void *p)
 		if (evsel->add(base, ev->ev_fd,
-			old, (ev->ev_events & EV_ET) | res, extra) == -1)
+			old, (ev->ev_events & (EV_ET|EV_EXCLUSIVE)) | res,
+			extra) == -1)
 			return (-1);
 		retval = 1;
 	}
@@ -354,7 +470,7 @@ evmap_io_add_(struct event_base *base, evutil_socket_t fd, struct event *ev)
 	ctx->nread = (ev_uint16_t) nread;
 	ctx->nwrite = (ev_uint16_t) nwrite;
 	ctx->nclose = (ev_uint16_t) nclose;
-	LIST_INSERT_HEAD(&ctx->events, ev, ev_io_next); //将event插入到fd对应的事件链表中
+	evmap_io_insert_event(ctx, ev); //将event插入到fd对应的事件链表中
 
 	return (retval);
 }
@@ -413,7 +529,8 @@ evmap_io_del_(struct event_base *base, evutil_socket_t fd, struct event *ev)
 	if (res) {
 		void *extra = ((char*)ctx) + sizeof(struct evmap_io);
 		if (evsel->del(base, ev->ev_fd,
-			old, (ev->ev_events & EV_ET) | res, extra) == -1) {
+			old, (ev->ev_events & (EV_ET|EV_EXCLUSIVE)) | res,
+			extra) == -1) {
 			retval = -1;
 		} else {
 			retval = 1;
@@ -423,7 +540,7 @@ evmap_io_del_(struct event_base *base, evutil_socket_t fd, struct event *ev)
 	ctx->nread = nread;
 	ctx->nwrite = nwrite;
 	ctx->nclose = nclose;
-	LIST_REMOVE(ev, ev_io_next);
+	evmap_io_remove_event(ctx, ev);
 
 	return (retval);
 }
@@ -446,8 +563,8 @@ evmap_io_active_(struct event_base *base, evutil_socket_t fd, short events)
 
 	if (NULL == ctx)
 		return;
-	//遍历该双向链表，ev指向遍历到的事件
-	LIST_FOREACH(ev, &ctx->events, ev_io_next) {
+	//遍历该fd上的事件，ev指向遍历到的事件
+	EVMAP_IO_FOREACH(ev, ctx) {
 		if (ev->ev_events & events) //若该事件是我们感兴趣的事件，则添加到激活队列中
 			event_active_nolock_(ev, ev->ev_events & events, 1);
 	}
@@ -553,6 +670,10 @@ void *
 evmap_io_get_fdinfo_(struct event_io_map *map, evutil_socket_t fd)
 {
 	struct evmap_io *ctx;
+#ifndef EVMAP_USE_HT
+	if (fd < 0 || fd >= map->nentries)
+		return NULL;
+#endif
 	GET_IO_SLOT(ctx, map, fd, evmap_io);
 	if (ctx)
 		return ((char*)ctx) + sizeof(struct evmap_io);
@@ -592,9 +713,8 @@ evmap_io_foreach_fd(struct event_base *base,
 		fd = (*mapent)->fd;
 #else
 	for (fd = 0; fd < iomap->nentries; ++fd) {
-		struct evmap_io *ctx = iomap->entries[fd];
-		if (!ctx)
-			continue;
+		struct evmap_io *ctx;
+		GET_IO_SLOT(ctx, iomap, fd, evmap_io);
 #endif
 		if ((r = fn(base, fd, ctx, arg)))
 			break;
@@ -658,11 +778,9 @@ evmap_io_reinit_iter_fn(struct event_base *base, evutil_socket_t fd,
 		events |= EV_CLOSED;
 	if (evsel->fdinfo_len)
 		memset(extra, 0, evsel->fdinfo_len);
-	if (events &&
-	    (ev = LIST_FIRST(&ctx->events)) &&
-	    (ev->ev_events & EV_ET))
-		events |= EV_ET;
-	if (evsel->add(base, fd, 0, events, extra) == -1)
+	if (events && (ev = ctx->inline_evs[0]))
+		events |= ev->ev_events & (EV_ET|EV_EXCLUSIVE);
+	if (events && evsel->add(base, fd, 0, events, extra) == -1)
 		*result = -1;
 
 	return 0;
@@ -713,7 +831,10 @@ static int
 evmap_io_delete_all_iter_fn(struct event_base *base, evutil_socket_t fd,
     struct evmap_io *io_info, void *arg)
 {
-	return delete_all_in_dlist(&io_info->events);
+	struct event *ev;
+	while ((ev = io_info->inline_evs[0]))
+		event_del(ev);
+	return 0;
 }
 
 /* Helper for evmap_delete_all_: delete every event pending on a signal. */
@@ -905,6 +1026,8 @@ event_changelist_add_(struct event_base *base, evutil_socket_t fd, short old, sh
 	struct event_changelist_fdinfo *fdinfo = p;
 	struct event_change *change;
 	ev_uint8_t evchange = EV_CHANGE_ADD | (events & (EV_ET|EV_PERSIST|EV_SIGNAL));
+	if (events & EV_EXCLUSIVE)
+		evchange |= EV_CHANGE_EXCLUSIVE;
 
 	event_changelist_check(base);
 
@@ -935,6 +1058,8 @@ event_changelist_del_(struct event_base *base, evutil_socket_t fd, short old, sh
 	struct event_changelist_fdinfo *fdinfo = p;
 	struct event_change *change;
 	ev_uint8_t del = EV_CHANGE_DEL | (events & EV_ET);
+	if (events & EV_EXCLUSIVE)
+		del |= EV_CHANGE_EXCLUSIVE;
 
 	event_changelist_check(base);
 	change = event_changelist_get_or_construct(changelist, fd, old, fdinfo);
@@ -994,7 +1119,11 @@ evmap_io_check_integrity_fn(struct event_base *base, evutil_socket_t fd,
 	 * running LIST_FOREACH could be an exciting adventure. */
 	EVUTIL_ASSERT_LIST_OK(&io_info->events, event, ev_io_next);
 
-	LIST_FOREACH(ev, &io_info->events, ev_io_next) {
+	/* The inline slots fill up before the list is used. */
+	EVUTIL_ASSERT(!io_info->inline_evs[1] || io_info->inline_evs[0]);
+	EVUTIL_ASSERT(LIST_EMPTY(&io_info->events) || io_info->inline_evs[1]);
+
+	EVMAP_IO_FOREACH(ev, io_info) {
 		EVUTIL_ASSERT(ev->ev_flags & EVLIST_INSERTED);
 		EVUTIL_ASSERT(ev->ev_fd == fd);
 		EVUTIL_ASSERT(!(ev->ev_events & EV_SIGNAL));
@@ -1059,7 +1188,7 @@ evmap_io_foreach_event_fn(struct event_base *base, evutil_socket_t fd,
 	struct evmap_foreach_event_helper *h = arg;
 	struct event *ev;
 	int r;
-	LIST_FOREACH(ev, &io_info->events, ev_io_next) {
+	EVMAP_IO_FOREACH(ev, io_info) {
 		if ((r = h->fn(base, ev, h->arg)))
 			return r;
 	}
@@ -0,0 +1,286 @@
+/*
+ * Copyright (c) 2007-2012 Niels Provos and Nick Mathewson
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * evthread_pool: worker threads for callbacks too slow to run on an event
+ * loop.
+ *
+ * Every worker has a deque of tasks.  A task goes onto the deque picked by
+ * the id of the thread that submitted it, so two loops submitting at once
+ * seldom touch the same lock.  A worker takes the newest task from its own
+ * deque, and when that is empty it steals the oldest task from the others.
+ * Idle workers sleep on one condition variable; a submitter only takes the
+ * pool lock to signal it when some worker is asleep.
+ *
+ * When a task's work is done, its completion runs as an event_callback on
+ * the base that submitted it.  Each outstanding task holds a virtual event
+ * on that base, so its loop doesn't exit while the task is in flight.
+ *
+ * The locks and condition variables come from whatever evthread callbacks
+ * the application installed; only the threads themselves are pthreads.
+ */
+
+#include "event2/event-config.h"
+#include "evconfig-private.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "event2/event.h"
+#include "event2/thread.h"
+#include "event2/util.h"
+#include "event-internal.h"
+#include "defer-internal.h"
+#include "evthread-internal.h"
+#include "mm-internal.h"
+
+struct evthread_pool_task {
+	TAILQ_ENTRY(evthread_pool_task) next;
+	/* Runs done_cb on 'base' once the work is done. */
+	struct event_callback done;
+	struct event_base *base;
+	evthread_pool_work_cb work_cb;
+	evthread_pool_done_cb done_cb;
+	void *arg;
+};
+
+TAILQ_HEAD(evthread_pool_deque, evthread_pool_task);
+
+struct evthread_pool_worker {
+	struct evthread_pool *pool;
+	pthread_t thread;
+	/* True iff 'thread' has been started. */
+	int running;
+	/* Protects 'tasks'. */
+	void *lock;
+	/* The owner takes tasks from the tail, thieves from the head. */
+	struct evthread_pool_deque tasks;
+};
+
+struct evthread_pool {
+	int n_workers;
+	struct evthread_pool_worker *workers;
+	/* Protects n_idle and stopping, and goes with 'cond'. */
+	void *lock;
+	void *cond;
+	/* The number of workers waiting on 'cond'. */
+	int n_idle;
+	/* Set when the pool is being freed. */
+	int stopping;
+};
+
+static void
+evthread_pool_task_done(struct event_callback *evcb, void *arg)
+{
+	struct evthread_pool_task *task = arg;
+	struct event_base *base = task->base;
+
+	if (task->done_cb)
+		task->done_cb(task->arg);
+	mm_free(task);
+	event_base_del_virtual_(base);
+}
+
+/* Take a task from worker 'w': its newest if 'own', else its oldest. */
+static struct evthread_pool_task *
+evthread_pool_take(struct evthread_pool_worker *w, int own)
+{
+	struct evthread_pool_task *task;
+
+	EVLOCK_LOCK(w->lock, 0);
+	if (own)
+		task = TAILQ_LAST(&w->tasks, evthread_pool_deque);
+	else
+		task = TAILQ_FIRST(&w->tasks);
+	if (task)
+		TAILQ_REMOVE(&w->tasks, task, next);
+	EVLOCK_UNLOCK(w->lock, 0);
+	return task;
+}
+
+/* Find a task for worker 'w', from its own deque or by stealing. */
+static struct evthread_pool_task *
+evthread_pool_find(struct evthread_pool_worker *w)
+{
+	struct evthread_pool *pool = w->pool;
+	struct evthread_pool_task *task;
+	int i, self = (int)(w - pool->workers);
+
+	if ((task = evthread_pool_take(w, 1)))
+		return task;
+	for (i = 1; i < pool->n_workers; ++i) {
+		struct evthread_pool_worker *victim =
+		    &pool->workers[(self + i) % pool->n_workers];
+		if ((task = evthread_pool_take(victim, 0)))
+			return task;
+	}
+	return NULL;
+}
+
+static void *
+evthread_pool_loop(void *arg)
+{
+	struct evthread_pool_worker *w = arg;
+	struct evthread_pool *pool = w->pool;
+	struct evthread_pool_task *task;
+
+	for (;;) {
+		if (!(task = evthread_pool_find(w))) {
+			EVLOCK_LOCK(pool->lock, 0);
+			++pool->n_idle;
+			/* Look again now that submitters can see we're idle:
+			 * anything pushed before they could is ours to find. */
+			while (!(task = evthread_pool_find(w)) &&
+			    !pool->stopping)
+				EVTHREAD_COND_WAIT(pool->cond, pool->lock);
+			--pool->n_idle;
+			EVLOCK_UNLOCK(pool->lock, 0);
+			if (!task)
+				break;
+		}
+		task->work_cb(task->arg);
+		event_callback_activate_(task->base, &task->done);
+	}
+	return NULL;
+}
+
+struct evthread_pool *
+evthread_pool_new(int n_threads)
+{
+	struct evthread_pool *pool;
+	int i;
+
+	/* The pool's locks come from the installed callbacks. */
+	if (!EVTHREAD_LOCKING_ENABLED())
+		return NULL;
+
+	if (n_threads <= 0) {
+#ifdef _SC_NPROCESSORS_ONLN
+		n_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+		if (n_threads <= 0)
+			n_threads = 1;
+	}
+
+	if (!(pool = mm_calloc(1, sizeof(*pool))))
+		return NULL;
+	if (!(pool->workers = mm_calloc(n_threads, sizeof(*pool->workers))))
+		goto err;
+	EVTHREAD_ALLOC_LOCK(pool->lock, 0);
+	EVTHREAD_ALLOC_COND(pool->cond);
+	if (!pool->lock || !pool->cond)
+		goto err;
+
+	for (i = 0; i < n_threads; ++i) {
+		struct evthread_pool_worker *w = &pool->workers[i];
+		w->pool = pool;
+		TAILQ_INIT(&w->tasks);
+		EVTHREAD_ALLOC_LOCK(w->lock, 0);
+		++pool->n_workers;
+		if (!w->lock)
+			goto err;
+	}
+
+	for (i = 0; i < n_threads; ++i) {
+		struct evthread_pool_worker *w = &pool->workers[i];
+		if (pthread_create(&w->thread, NULL, evthread_pool_loop, w))
+			goto err;
+		w->running = 1;
+	}
+
+	return pool;
+err:
+	evthread_pool_free(pool);
+	return NULL;
+}
+
+int
+evthread_pool_get_n_threads(struct evthread_pool *pool)
+{
+	return pool->n_workers;
+}
+
+int
+evthread_pool_submit(struct evthread_pool *pool, struct event_base *base,
+    evthread_pool_work_cb work_cb, evthread_pool_done_cb done_cb, void *arg)
+{
+	struct evthread_pool_task *task;
+	struct evthread_pool_worker *w;
+	int wake;
+
+	if (!base || !work_cb)
+		return -1;
+	if (!(task = mm_malloc(sizeof(*task))))
+		return -1;
+	event_deferred_cb_init_(&task->done,
+	    event_base_get_npriorities(base) / 2,
+	    evthread_pool_task_done, task);
+	task->base = base;
+	task->work_cb = work_cb;
+	task->done_cb = done_cb;
+	task->arg = arg;
+	event_base_add_virtual_(base);
+
+	w = &pool->workers[EVTHREAD_GET_ID() % pool->n_workers];
+	EVLOCK_LOCK(w->lock, 0);
+	TAILQ_INSERT_TAIL(&w->tasks, task, next);
+	/* A worker that went idle after we read this will search our deque
+	 * under its lock, so it can't miss the task. */
+	wake = pool->n_idle > 0;
+	EVLOCK_UNLOCK(w->lock, 0);
+
+	if (wake) {
+		EVLOCK_LOCK(pool->lock, 0);
+		EVTHREAD_COND_SIGNAL(pool->cond);
+		EVLOCK_UNLOCK(pool->lock, 0);
+	}
+	return 0;
+}
+
+void
+evthread_pool_free(struct evthread_pool *pool)
+{
+	int i;
+
+	if (pool->lock) {
+		EVLOCK_LOCK(pool->lock, 0);
+		pool->stopping = 1;
+		EVTHREAD_COND_BROADCAST(pool->cond);
+		EVLOCK_UNLOCK(pool->lock, 0);
+	}
+	for (i = 0; i < pool->n_workers; ++i) {
+		struct evthread_pool_worker *w = &pool->workers[i];
+		if (w->running)
+			pthread_join(w->thread, NULL);
+	}
+	for (i = 0; i < pool->n_workers; ++i)
+		EVTHREAD_FREE_LOCK(pool->workers[i].lock, 0);
+	EVTHREAD_FREE_COND(pool->cond);
+	EVTHREAD_FREE_LOCK(pool->lock, 0);
+	if (pool->workers)
+		mm_free(pool->workers);
+	mm_free(pool);
+}
@@ -36,9 +36,14 @@
  * This comes from evconfig-private.h
  */
 #include <pthread.h>
+#include <sched.h>
+#ifdef EVENT__HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 
 struct event_base;
 #include "event2/thread.h"
+#include "event2/event.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -212,3 +217,179 @@ evthread_use_pthreads(void)
 	evthread_set_id_callback(evthread_posix_get_id); //evthread_posix_get_id指向获取线程id函数
 	return 0;
 }
+
+/* One thread of an event_base_group, and the base it runs. */
+struct event_base_group_thread {
+	struct event_base *base;
+	pthread_t thread;
+	/* The CPU to run on, or -1 to leave it to the scheduler. */
+	int cpu;
+	/* True iff 'thread' has been started. */
+	int running;
+};
+
+struct event_base_group {
+	int n_bases;
+	/* The bases of all the threads, for event_base_group_get_bases(). */
+	struct event_base **bases;
+	struct event_base_group_thread *threads;
+};
+
+#ifdef CPU_SET
+/* Return the n'th CPU that is set in 'mask', or -1. */
+static int
+evthread_group_nth_cpu(const cpu_set_t *mask, int n)
+{
+	int cpu;
+	for (cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+		if (CPU_ISSET(cpu, mask) && n-- == 0)
+			return cpu;
+	}
+	return -1;
+}
+#endif
+
+static void *
+evthread_group_loop(void *arg)
+{
+	struct event_base_group_thread *th = arg;
+
+#ifdef CPU_SET
+	if (th->cpu >= 0) {
+		cpu_set_t mask;
+		CPU_ZERO(&mask);
+		CPU_SET(th->cpu, &mask);
+		/* If this fails, the base still works; it just isn't pinned. */
+		(void)pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
+	}
+#endif
+
+	event_base_loop(th->base, EVLOOP_NO_EXIT_ON_EMPTY);
+	return NULL;
+}
+
+static void
+evthread_group_stop_cb(evutil_socket_t fd, short what, void *arg)
+{
+	event_base_loopbreak(arg);
+}
+
+struct event_base_group *
+event_base_group_new(const struct event_config *cfg, int n_bases,
+    unsigned flags)
+{
+	struct event_base_group *grp;
+	int i, n_cpus = 0;
+#ifdef CPU_SET
+	cpu_set_t mask;
+
+	CPU_ZERO(&mask);
+	if (sched_getaffinity(0, sizeof(mask), &mask) == 0)
+		n_cpus = CPU_COUNT(&mask);
+#endif
+
+	/* The bases are used from more than one thread, so they need
+	 * locking. */
+	if (evthread_use_pthreads() < 0)
+		return NULL;
+
+	if (n_bases <= 0) {
+		n_bases = n_cpus;
+#ifdef _SC_NPROCESSORS_ONLN
+		if (n_bases <= 0)
+			n_bases = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+		if (n_bases <= 0)
+			n_bases = 1;
+	}
+
+	if (!(grp = mm_calloc(1, sizeof(*grp))))
+		return NULL;
+	grp->bases = mm_calloc(n_bases, sizeof(*grp->bases));
+	grp->threads = mm_calloc(n_bases, sizeof(*grp->threads));
+	if (!grp->bases || !grp->threads)
+		goto err;
+
+	for (i = 0; i < n_bases; ++i) {
+		struct event_base_group_thread *th = &grp->threads[i];
+		if (!(th->base = event_base_new_with_config(cfg)))
+			goto err;
+		grp->bases[i] = th->base;
+		++grp->n_bases;
+		th->cpu = -1;
+#ifdef CPU_SET
+		if (n_cpus > 0 && !(flags & EVENT_BASE_GROUP_NO_AFFINITY))
+			th->cpu = evthread_group_nth_cpu(&mask, i % n_cpus);
+#endif
+	}
+
+	for (i = 0; i < n_bases; ++i) {
+		struct event_base_group_thread *th = &grp->threads[i];
+		if (pthread_create(&th->thread, NULL, evthread_group_loop, th))
+			goto err;
+		th->running = 1;
+	}
+
+	return grp;
+err:
+	event_base_group_free(grp);
+	return NULL;
+}
+
+int
+event_base_group_get_n_bases(struct event_base_group *grp)
+{
+	return grp->n_bases;
+}
+
+struct event_base *
+event_base_group_get_base(struct event_base_group *grp, int idx)
+{
+	if (idx < 0 || idx >= grp->n_bases)
+		return NULL;
+	return grp->bases[idx];
+}
+
+struct event_base **
+event_base_group_get_bases(struct event_base_group *grp)
+{
+	return grp->bases;
+}
+
+void
+event_base_group_stop(struct event_base_group *grp)
+{
+	static const struct timeval immediately = { 0, 0 };
+	int i;
+
+	/* Ask each loop to stop from inside its own thread: a loopbreak
+	 * sent before the loop had started would be lost. */
+	for (i = 0; i < grp->n_bases; ++i) {
+		struct event_base_group_thread *th = &grp->threads[i];
+		if (th->running)
+			event_base_once(th->base, -1, EV_TIMEOUT,
+			    evthread_group_stop_cb, th->base, &immediately);
+	}
+	for (i = 0; i < grp->n_bases; ++i) {
+		struct event_base_group_thread *th = &grp->threads[i];
+		if (th->running) {
+			pthread_join(th->thread, NULL);
+			th->running = 0;
+		}
+	}
+}
+
+void
+event_base_group_free(struct event_base_group *grp)
+{
+	int i;
+
+	event_base_group_stop(grp);
+	for (i = 0; i < grp->n_bases; ++i)
+		event_base_free(grp->threads[i].base);
+	if (grp->threads)
+		mm_free(grp->threads);
+	if (grp->bases)
+		mm_free(grp->bases);
+	mm_free(grp);
+}
@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2007-2012 Niels Provos and Nick Mathewson
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * The substring search used by evbuffer_search_range().
+ *
+ * There is a portable scalar version.  On x86 we also build SSE2 and AVX2
+ * versions and pick the widest one the CPU supports the first time the
+ * search is called.  Setting EVENT_NOSIMD in the environment forces the
+ * scalar version.
+ */
+
+#include "event2/event-config.h"
+#include "evconfig-private.h"
+
+#include <sys/types.h>
+#include <string.h>
+
+#include "event2/util.h"
+#include "util-internal.h"
+
+#if defined(__GNUC__) && \
+    (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define MEMSCAN_HAVE_SSE2
+#if defined(__clang__) || __GNUC__ >= 5
+#define MEMSCAN_HAVE_AVX2
+#endif
+#endif
+
+#ifdef MEMSCAN_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef MEMSCAN_HAVE_AVX2
+#include <immintrin.h>
+#endif
+
+struct memscan_impl {
+	int level;
+	const char *(*memmem)(const char *hay, size_t hlen,
+	    const char *needle, size_t nlen);
+};
+
+static const char *
+memmem_scalar(const char *hay, size_t hlen, const char *needle, size_t nlen)
+{
+	const char *end, *p;
+
+	if (!nlen || nlen > hlen)
+		return NULL;
+	end = hay + (hlen - nlen) + 1;
+	while (hay < end && (p = memchr(hay, needle[0], end - hay))) {
+		if (!memcmp(p + 1, needle + 1, nlen - 1))
+			return p;
+		hay = p + 1;
+	}
+	return NULL;
+}
+
+static const struct memscan_impl memscan_scalar = {
+	EVUTIL_MEMSCAN_SCALAR, memmem_scalar
+};
+
+#ifdef MEMSCAN_HAVE_SSE2
+/* The first/last byte filter: a position can only start a match if both
+ * the first byte of the needle and its last byte are in the right place,
+ * so we test 16 positions with two compares and only call memcmp on the
+ * survivors. */
+static const char *
+memmem_sse2(const char *hay, size_t hlen, const char *needle, size_t nlen)
+{
+	__m128i first, last;
+	size_t i, npos;
+
+	if (nlen < 2 || nlen > hlen)
+		return memmem_scalar(hay, hlen, needle, nlen);
+
+	first = _mm_set1_epi8(needle[0]);
+	last = _mm_set1_epi8(needle[nlen - 1]);
+	npos = hlen - nlen + 1;
+	for (i = 0; i + 16 <= npos; i += 16) {
+		__m128i f = _mm_loadu_si128((const __m128i *)(hay + i));
+		__m128i l = _mm_loadu_si128(
+		    (const __m128i *)(hay + i + nlen - 1));
+		unsigned m = (unsigned)_mm_movemask_epi8(_mm_and_si128(
+		    _mm_cmpeq_epi8(f, first), _mm_cmpeq_epi8(l, last)));
+		while (m) {
+			unsigned bit = __builtin_ctz(m);
+			if (!memcmp(hay + i + bit + 1, needle + 1, nlen - 2))
+				return hay + i + bit;
+			m &= m - 1;
+		}
+	}
+	return memmem_scalar(hay + i, hlen - i, needle, nlen);
+}
+
+static const struct memscan_impl memscan_sse2 = {
+	EVUTIL_MEMSCAN_SSE2, memmem_sse2
+};
+#endif
+
+#ifdef MEMSCAN_HAVE_AVX2
+__attribute__((target("avx2")))
+static const char *
+memmem_avx2(const char *hay, size_t hlen, const char *needle, size_t nlen)
+{
+	__m256i first, last;
+	size_t i, npos;
+
+	if (nlen < 2 || nlen > hlen)
+		return memmem_scalar(hay, hlen, needle, nlen);
+
+	first = _mm256_set1_epi8(needle[0]);
+	last = _mm256_set1_epi8(needle[nlen - 1]);
+	npos = hlen - nlen + 1;
+	for (i = 0; i + 32 <= npos; i += 32) {
+		__m256i f = _mm256_loadu_si256((const __m256i *)(hay + i));
+		__m256i l = _mm256_loadu_si256(
+		    (const __m256i *)(hay + i + nlen - 1));
+		unsigned m = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(
+		    _mm256_cmpeq_epi8(f, first), _mm256_cmpeq_epi8(l, last)));
+		while (m) {
+			unsigned bit = __builtin_ctz(m);
+			if (!memcmp(hay + i + bit + 1, needle + 1, nlen - 2))
+				return hay + i + bit;
+			m &= m - 1;
+		}
+	}
+	return memmem_sse2(hay + i, hlen - i, needle, nlen);
+}
+
+static const struct memscan_impl memscan_avx2 = {
+	EVUTIL_MEMSCAN_AVX2, memmem_avx2
+};
+#endif
+
+static const struct memscan_impl *
+memscan_lookup(int level)
+{
+	switch (level) {
+	case EVUTIL_MEMSCAN_SCALAR:
+		return &memscan_scalar;
+#ifdef MEMSCAN_HAVE_SSE2
+	case EVUTIL_MEMSCAN_SSE2:
+		return &memscan_sse2;
+#endif
+#ifdef MEMSCAN_HAVE_AVX2
+	case EVUTIL_MEMSCAN_AVX2:
+		if (__builtin_cpu_supports("avx2"))
+			return &memscan_avx2;
+		break;
+#endif
+	default:
+		break;
+	}
+	return NULL;
+}
+
+/* Chosen lazily.  Two threads racing on the first call both store the same
+ * pointer, so this doesn't need a lock. */
+static const struct memscan_impl *memscan_impl = NULL;
+
+static const struct memscan_impl *
+memscan_get(void)
+{
+	const struct memscan_impl *impl = memscan_impl;
+	int level;
+
+	if (impl)
+		return impl;
+	if (evutil_getenv_("EVENT_NOSIMD")) {
+		impl = &memscan_scalar;
+	} else {
+		for (level = EVUTIL_MEMSCAN_AVX2; !impl; --level)
+			impl = memscan_lookup(level);
+	}
+	memscan_impl = impl;
+	return impl;
+}
+
+int
+evutil_memscan_set_impl_(int level)
+{
+	const struct memscan_impl *impl = memscan_lookup(level);
+	if (!impl)
+		return -1;
+	memscan_impl = impl;
+	return 0;
+}
+
+int
+evutil_memscan_get_impl_(void)
+{
+	return memscan_get()->level;
+}
+
+const char *
+evutil_memmem_(const char *hay, size_t hlen, const char *needle, size_t nlen)
+{
+	return memscan_get()->memmem(hay, hlen, needle, nlen);
+}
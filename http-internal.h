@@ -33,6 +33,10 @@ struct evhttp_request;
 /* Indicates an unknown request method. */
 #define EVHTTP_REQ_UNKNOWN_ (1<<15)
 
+/* struct evkeyval flags */
+/* The key and value live in the allocation of the evkeyval itself. */
+#define EVHTTP_HEADER_PACKED	0x0001
+
 enum evhttp_connection_state {
 	EVCON_DISCONNECTED,	/**< not currently connected not trying either*/
 	EVCON_CONNECTING,	/**< tries to currently connect */
@@ -67,6 +71,10 @@ struct evhttp_connection {
 	size_t max_headers_size;
 	ev_uint64_t max_body_size;
 
+	/* With EVHTTP_CON_INPLACE_HEADERS: how far into the input buffer the
+	 * header block has been scanned, in whole lines. */
+	size_t header_scan_off;
+
 	int flags;
 #define EVHTTP_CON_INCOMING	0x0001       /* only one request on it ever */
 #define EVHTTP_CON_OUTGOING	0x0002       /* multiple requests possible */
@@ -131,6 +139,18 @@ struct evhttp_server_alias {
 	char *alias; /* the server alias. */
 };
 
+/* an accepted connection on its way to a worker base */
+struct evhttp_handoff {
+	TAILQ_ENTRY(evhttp_handoff) next;
+	/* Made active on the worker base to set the connection up there. */
+	struct event ev;
+	struct evhttp *http;
+	struct event_base *base;
+	evutil_socket_t fd;
+	ev_socklen_t salen;
+	struct sockaddr_storage ss;
+};
+
 struct evhttp {
 	/* Next vhost, if this is a vhost. */
 	TAILQ_ENTRY(evhttp) next_vhost;
@@ -169,6 +189,18 @@ struct evhttp {
 	void *bevcbarg;
 
 	struct event_base *base;
+
+	/* Bases that accepted connections are handed to round-robin, or NULL
+	 * if they stay on 'base'. */
+	struct event_base **worker_bases;
+	int n_worker_bases;
+	int next_worker;
+	/* Accepted connections queued for a worker base but not yet set
+	 * up there. */
+	TAILQ_HEAD(handoffq, evhttp_handoff) handoffs;
+	/* Protects 'connections' and 'handoffs' when there are worker
+	 * bases. */
+	void *lock;
 };
 
 /* XXX most of these functions could be static. */
@@ -111,6 +111,8 @@
 #include "http-internal.h"
 #include "mm-internal.h"
 #include "bufferevent-internal.h"
+#include "evbuffer-internal.h"
+#include "evthread-internal.h"
 
 #ifndef EVENT__HAVE_GETNAMEINFO
 #define NI_MAXSERV 32
@@ -1231,7 +1233,9 @@ evhttp_connection_free(struct evhttp_connection *evcon)
 
 	if (evcon->http_server != NULL) {
 		struct evhttp *http = evcon->http_server;
+		EVLOCK_LOCK(http->lock, 0);
 		TAILQ_REMOVE(&http->connections, evcon, next);
+		EVLOCK_UNLOCK(http->lock, 0);
 	}
 
 	if (event_initialized(&evcon->retry_ev)) {
@@ -1353,8 +1357,14 @@ evhttp_connection_reset_(struct evhttp_connection *evcon)
 	err = bufferevent_setfd(evcon->bufev, -1);
 	EVUTIL_ASSERT(!err && "setfd");
 
+	evcon->header_scan_off = 0;
+
 	/* we need to clean up any buffered data */
 	tmp = bufferevent_get_output(evcon->bufev);
+	/* evhttp_connection_read_on_write_error() froze it; writes on the
+	 * next connection have to be able to drain it again. */
+	if (evcon->flags & EVHTTP_CON_READING_ERROR)
+		evbuffer_unfreeze(tmp, 1);
 	err = evbuffer_drain(tmp, -1);
 	EVUTIL_ASSERT(!err && "drain output");
 	tmp = bufferevent_get_input(evcon->bufev);
@@ -1451,6 +1461,7 @@ evhttp_connection_read_on_write_error(struct evhttp_connection *evcon,
 	/** Second time, we can't read anything */
 	if (evcon->flags & EVHTTP_CON_READING_ERROR) {
 		evcon->flags &= ~EVHTTP_CON_READING_ERROR;
+		evbuffer_unfreeze(bufferevent_get_output(evcon->bufev), 1);
 		evhttp_connection_fail_(evcon, EVREQ_HTTP_EOF);
 		return;
 	}
@@ -1886,6 +1897,27 @@ evhttp_parse_request_line(struct evhttp_request *req, char *line, size_t len)
 	return 0;
 }
 
+/*
+ * Headers parsed with EVHTTP_CON_INPLACE_HEADERS are a single allocation,
+ * with the key right behind the evkeyval and the value right behind the
+ * key; evhttp_header_new_inplace() makes them and marks them
+ * EVHTTP_HEADER_PACKED.  Every other header has its key and value
+ * allocated on their own.
+ */
+static void
+evhttp_header_free(struct evkeyval *header)
+{
+	if (!(header->flags & EVHTTP_HEADER_PACKED)) {
+		mm_free(header->key);
+		mm_free(header->value);
+	} else if (header->value !=
+	    header->key + strlen(header->key) + 1) {
+		/* Somebody gave it a value of their own. */
+		mm_free(header->value);
+	}
+	mm_free(header);
+}
+
 const char *
 evhttp_find_header(const struct evkeyvalq *headers, const char *key)
 {
@@ -1908,9 +1940,7 @@ evhttp_clear_headers(struct evkeyvalq *headers)
 	    header != NULL;
 	    header = TAILQ_FIRST(headers)) {
 		TAILQ_REMOVE(headers, header, next);
-		mm_free(header->key);
-		mm_free(header->value);
-		mm_free(header);
+		evhttp_header_free(header);
 	}
 }
 
@@ -1934,9 +1964,7 @@ evhttp_remove_header(struct evkeyvalq *headers, const char *key)
 
 	/* Free and remove the header that we found */
 	TAILQ_REMOVE(headers, header, next);
-	mm_free(header->key);
-	mm_free(header->value);
-	mm_free(header);
+	evhttp_header_free(header);
 
 	return (0);
 }
@@ -1976,6 +2004,35 @@ evhttp_add_header(struct evkeyvalq *headers,
 	return (evhttp_add_header_internal(headers, key, value));
 }
 
+/*
+ * Allocates a header for EVHTTP_CON_INPLACE_HEADERS, with its key and
+ * value stored right behind it, so that the whole thing is a single
+ * allocation.  A NULL value just reserves value_len bytes for it.
+ */
+static struct evkeyval *
+evhttp_header_new_inplace(const char *key, size_t key_len,
+    const char *value, size_t value_len)
+{
+	struct evkeyval *header;
+
+	if (key_len > EV_SIZE_MAX - sizeof(*header) - 2 ||
+	    value_len > EV_SIZE_MAX - sizeof(*header) - 2 - key_len)
+		return (NULL);
+	header = mm_malloc(sizeof(*header) + key_len + value_len + 2);
+	if (header == NULL)
+		return (NULL);
+	header->flags = EVHTTP_HEADER_PACKED;
+	header->key = (char *)(header + 1);
+	memcpy(header->key, key, key_len);
+	header->key[key_len] = '\0';
+	header->value = header->key + key_len + 1;
+	if (value)
+		memcpy(header->value, value, value_len);
+	header->value[value_len] = '\0';
+
+	return (header);
+}
+
 static int
 evhttp_add_header_internal(struct evkeyvalq *headers,
     const char *key, const char *value)
@@ -2054,35 +2111,192 @@ evhttp_parse_firstline_(struct evhttp_request *req, struct evbuffer *buffer)
 }
 
 static int
-evhttp_append_to_last_header(struct evkeyvalq *headers, char *line)
+evhttp_append_to_last_header(struct evkeyvalq *headers, const char *line,
+    size_t line_len)
 {
 	struct evkeyval *header = TAILQ_LAST(headers, evkeyvalq);
+	struct evkeyval *newheader;
+	size_t key_len, old_len;
 	char *newval;
-	size_t old_len, line_len;
 
 	if (header == NULL)
 		return (-1);
 
-	old_len = strlen(header->value);
-
 	/* Strip space from start and end of line. */
-	while (*line == ' ' || *line == '\t')
+	while (line_len && (*line == ' ' || *line == '\t')) {
 		++line;
-	evutil_rtrim_lws_(line);
-
-	line_len = strlen(line);
+		--line_len;
+	}
+	while (line_len && (line[line_len-1] == ' ' ||
+		line[line_len-1] == '\t'))
+		--line_len;
 
-	newval = mm_realloc(header->value, old_len + line_len + 2);
-	if (newval == NULL)
+	old_len = strlen(header->value);
+	if (line_len > EV_SIZE_MAX - old_len - 2)
 		return (-1);
 
+	if (!(header->flags & EVHTTP_HEADER_PACKED)) {
+		newval = mm_realloc(header->value, old_len + line_len + 2);
+		if (newval == NULL)
+			return (-1);
+		newval[old_len] = ' ';
+		memcpy(newval + old_len + 1, line, line_len);
+		newval[old_len + 1 + line_len] = '\0';
+		header->value = newval;
+		return (0);
+	}
+
+	/* The value lives in the same allocation as the header, so grow the
+	 * whole thing and put the copy where the old one was. */
+	key_len = strlen(header->key);
+	newheader = evhttp_header_new_inplace(header->key, key_len,
+	    NULL, old_len + 1 + line_len);
+	if (newheader == NULL)
+		return (-1);
+	newval = newheader->value;
+	memcpy(newval, header->value, old_len);
 	newval[old_len] = ' ';
-	memcpy(newval + old_len + 1, line, line_len + 1);
-	header->value = newval;
+	memcpy(newval + old_len + 1, line, line_len);
+
+	TAILQ_INSERT_AFTER(headers, header, newheader, next);
+	TAILQ_REMOVE(headers, header, next);
+	mm_free(header);
 
 	return (0);
 }
 
+/* Like evhttp_header_is_valid_value(), for a value that is not
+ * NUL-terminated. */
+static int
+evhttp_header_is_valid_value_len(const char *p, size_t len)
+{
+	const char *end = p + len;
+
+	while ((p = memchr(p, '\r', end - p)) != NULL) {
+		while (p < end && (*p == '\r' || *p == '\n'))
+			++p;
+		if (p == end || (*p != ' ' && *p != '\t'))
+			return (0);
+	}
+	return (1);
+}
+
+/*
+ * The EVHTTP_CON_INPLACE_HEADERS version of evhttp_parse_headers_().
+ * Instead of copying every line out with evbuffer_readln(), wait until the
+ * whole header block has arrived, pull it up once and parse the lines
+ * where they are, copying each key and value straight into its header.
+ */
+static enum message_read_status
+evhttp_parse_headers_inplace(struct evhttp_request *req,
+    struct evbuffer *buffer)
+{
+	struct evhttp_connection *evcon = req->evcon;
+	struct evkeyvalq *headers = req->input_headers;
+	size_t max_headers_size = evcon->max_headers_size;
+	size_t line_start = evcon->header_scan_off;
+	size_t eol_len, block_len;
+	struct evbuffer_ptr it;
+	const char *line, *end;
+
+	/* Find the empty line that ends the block, picking up where the last
+	 * call left off: the lines before header_scan_off have already been
+	 * counted in headers_size. */
+	if (evbuffer_ptr_set(buffer, &it, line_start, EVBUFFER_PTR_SET) < 0)
+		goto corrupted;
+	for (;;) {
+		it = evbuffer_search_eol(buffer, &it, &eol_len,
+		    EVBUFFER_EOL_CRLF);
+		if (it.pos < 0) {
+			if (req->headers_size + evbuffer_get_length(buffer) -
+			    line_start > max_headers_size) {
+				evcon->header_scan_off = 0;
+				return (DATA_TOO_LONG);
+			}
+			evcon->header_scan_off = line_start;
+			return (MORE_DATA_EXPECTED);
+		}
+		if ((size_t)it.pos == line_start)
+			break;
+		req->headers_size += it.pos - line_start;
+		if (req->headers_size > max_headers_size) {
+			evcon->header_scan_off = 0;
+			return (DATA_TOO_LONG);
+		}
+		line_start = it.pos + eol_len;
+		if (evbuffer_ptr_set(buffer, &it, eol_len,
+			EVBUFFER_PTR_ADD) < 0)
+			goto corrupted;
+	}
+	evcon->header_scan_off = 0;
+	block_len = it.pos + eol_len;
+
+	line = (const char *)evbuffer_pullup(buffer, block_len);
+	if (line == NULL)
+		return (DATA_CORRUPTED);
+	end = line + block_len;
+
+	for (;;) {
+		const char *eol = memchr(line, '\n', end - line);
+		const char *next = eol + 1;
+		size_t len = eol - line;
+
+		if (len && line[len-1] == '\r')
+			--len;
+		if (len == 0) /* Last header - Done */
+			break;
+		/* evbuffer_readln() would have cut the line short here; no
+		 * legal header has one anyway. */
+		if (memchr(line, '\0', len))
+			return (DATA_CORRUPTED);
+
+		if (*line == ' ' || *line == '\t') {
+			/* Continuation line */
+			if (evhttp_append_to_last_header(headers, line,
+				len) == -1)
+				return (DATA_CORRUPTED);
+		} else {
+			const char *colon = memchr(line, ':', len);
+			const char *value;
+			size_t key_len, value_len;
+			struct evkeyval *header;
+
+			if (colon == NULL)
+				return (DATA_CORRUPTED);
+			key_len = colon - line;
+			value = colon + 1;
+			value_len = len - key_len - 1;
+			while (value_len && *value == ' ') {
+				++value;
+				--value_len;
+			}
+			while (value_len && (value[value_len-1] == ' ' ||
+				value[value_len-1] == '\t'))
+				--value_len;
+
+			/* The same checks evhttp_add_header() does. */
+			if (memchr(line, '\r', key_len) ||
+			    !evhttp_header_is_valid_value_len(value,
+				value_len))
+				return (DATA_CORRUPTED);
+
+			header = evhttp_header_new_inplace(line, key_len,
+			    value, value_len);
+			if (header == NULL)
+				return (DATA_CORRUPTED);
+			TAILQ_INSERT_TAIL(headers, header, next);
+		}
+		line = next;
+	}
+
+	evbuffer_drain(buffer, block_len);
+	return (ALL_DATA_READ);
+
+ corrupted:
+	evcon->header_scan_off = 0;
+	return (DATA_CORRUPTED);
+}
+
 enum message_read_status
 evhttp_parse_headers_(struct evhttp_request *req, struct evbuffer* buffer)
 {
@@ -2092,6 +2306,11 @@ evhttp_parse_headers_(struct evhttp_request *req, struct evbuffer* buffer)
 
 	struct evkeyvalq* headers = req->input_headers;
 	size_t len;
+
+	if (req->evcon != NULL &&
+	    (req->evcon->flags & EVHTTP_CON_INPLACE_HEADERS))
+		return (evhttp_parse_headers_inplace(req, buffer));
+
 	while ((line = evbuffer_readln(buffer, &len, EVBUFFER_EOL_CRLF))
 	       != NULL) {
 		char *skey, *svalue;
@@ -2112,7 +2331,8 @@ evhttp_parse_headers_(struct evhttp_request *req, struct evbuffer* buffer)
 
 		/* Check if this is a continuation line */
 		if (*line == ' ' || *line == '\t') {
-			if (evhttp_append_to_last_header(headers, line) == -1)
+			if (evhttp_append_to_last_header(headers, line,
+				strlen(line)) == -1)
 				goto error;
 			mm_free(line);
 			continue;
@@ -2461,6 +2681,7 @@ int evhttp_connection_set_flags(struct evhttp_connection *evcon,
 	int avail_flags = 0;
 	avail_flags |= EVHTTP_CON_REUSE_CONNECTED_ADDR;
 	avail_flags |= EVHTTP_CON_READ_ON_WRITE_ERROR;
+	avail_flags |= EVHTTP_CON_INPLACE_HEADERS;
 
 	if (flags & ~avail_flags || flags > EVHTTP_CON_PUBLIC_FLAGS_END)
 		return 1;
@@ -2729,6 +2950,7 @@ evhttp_start_read_(struct evhttp_connection *evcon)
 	bufferevent_enable(evcon->bufev, EV_READ);
 
 	evcon->state = EVCON_READING_FIRSTLINE;
+	evcon->header_scan_off = 0;
 	/* Reset the bufferevent callbacks */
 	bufferevent_setcb(evcon->bufev,
 	    evhttp_read_cb,
@@ -3678,6 +3900,7 @@ evhttp_new_object(void)
 	TAILQ_INIT(&http->connections);
 	TAILQ_INIT(&http->virtualhosts);
 	TAILQ_INIT(&http->aliases);
+	TAILQ_INIT(&http->handoffs);
 
 	return (http);
 }
@@ -3723,6 +3946,7 @@ evhttp_free(struct evhttp* http)
 	struct evhttp_bound_socket *bound;
 	struct evhttp* vhost;
 	struct evhttp_server_alias *alias;
+	struct evhttp_handoff *handoff;
 
 	/* Remove the accepting part */
 	while ((bound = TAILQ_FIRST(&http->sockets)) != NULL) {
@@ -3733,6 +3957,14 @@ evhttp_free(struct evhttp* http)
 		mm_free(bound);
 	}
 
+	/* Drop the connections that no worker has picked up yet */
+	while ((handoff = TAILQ_FIRST(&http->handoffs)) != NULL) {
+		TAILQ_REMOVE(&http->handoffs, handoff, next);
+		event_del(&handoff->ev);
+		evutil_closesocket(handoff->fd);
+		mm_free(handoff);
+	}
+
 	while ((evcon = TAILQ_FIRST(&http->connections)) != NULL) {
 		/* evhttp_connection_free removes the connection */
 		evhttp_connection_free(evcon);
@@ -3759,9 +3991,45 @@ evhttp_free(struct evhttp* http)
 		mm_free(alias);
 	}
 
+	if (http->worker_bases != NULL)
+		mm_free(http->worker_bases);
+	EVTHREAD_FREE_LOCK(http->lock, 0);
+
 	mm_free(http);
 }
 
+int
+evhttp_set_worker_bases(struct evhttp *http, struct event_base **bases,
+    int n_bases)
+{
+	struct event_base **copy = NULL;
+
+	if (n_bases < 0)
+		return (-1);
+	if (n_bases) {
+		/* Connections get handed to other threads' bases. */
+		if (!EVTHREAD_LOCKING_ENABLED())
+			return (-1);
+		if (http->lock == NULL) {
+			EVTHREAD_ALLOC_LOCK(http->lock, 0);
+			if (http->lock == NULL)
+				return (-1);
+		}
+		copy = mm_calloc(n_bases, sizeof(*copy));
+		if (copy == NULL)
+			return (-1);
+		memcpy(copy, bases, n_bases * sizeof(*copy));
+	}
+
+	if (http->worker_bases != NULL)
+		mm_free(http->worker_bases);
+	http->worker_bases = copy;
+	http->n_worker_bases = n_bases;
+	http->next_worker = 0;
+
+	return (0);
+}
+
 int
 evhttp_add_virtual_host(struct evhttp* http, const char *pattern,
     struct evhttp* vhost)
@@ -3858,6 +4126,7 @@ int evhttp_set_flags(struct evhttp *http, int flags)
 {
 	int avail_flags = 0;
 	avail_flags |= EVHTTP_SERVER_LINGERING_CLOSE;
+	avail_flags |= EVHTTP_SERVER_INPLACE_HEADERS;
 
 	if (flags & ~avail_flags)
 		return 1;
@@ -3967,42 +4236,65 @@ evhttp_set_bevcb(struct evhttp *http,
  * Request related functions
  */
 
+/* A request's arena starts out holding just the request, its header lists
+ * and its two evbuffers.  Idle keep-alive connections each hold a request,
+ * so the arena must not be much bigger than those; body chains get blocks
+ * of their own as they are needed, and are reused once drained. */
+#define EVHTTP_REQ_ARENA_SIZE						\
+	(EVBUFFER_ARENA_ROUNDUP(sizeof(struct evhttp_request)) +	\
+	    2 * EVBUFFER_ARENA_ROUNDUP(sizeof(struct evkeyvalq)) +	\
+	    2 * EVBUFFER_ARENA_ROUNDUP(sizeof(struct evbuffer)))
+
 struct evhttp_request *
 evhttp_request_new(void (*cb)(struct evhttp_request *, void *), void *arg)
 {
+	struct evbuffer_arena *arena;
 	struct evhttp_request *req = NULL;
 
+	/* Everything that lives exactly as long as the request comes out of
+	 * one arena, which is freed along with it. */
+	if ((arena = evbuffer_arena_new(EVHTTP_REQ_ARENA_SIZE)) == NULL) {
+		event_warn("%s: evbuffer_arena_new", __func__);
+		return (NULL);
+	}
+
 	/* Allocate request structure */
-	if ((req = mm_calloc(1, sizeof(struct evhttp_request))) == NULL) {
-		event_warn("%s: calloc", __func__);
-		goto error;
+	if ((req = evbuffer_arena_alloc(arena,
+		    sizeof(struct evhttp_request))) == NULL) {
+		event_warn("%s: evbuffer_arena_alloc", __func__);
+		evbuffer_arena_free(arena);
+		return (NULL);
 	}
+	memset(req, 0, sizeof(struct evhttp_request));
+	req->arena = arena;
 
 	req->headers_size = 0;
 	req->body_size = 0;
 
 	req->kind = EVHTTP_RESPONSE;
-	req->input_headers = mm_calloc(1, sizeof(struct evkeyvalq));
+	req->input_headers = evbuffer_arena_alloc(arena,
+	    sizeof(struct evkeyvalq));
 	if (req->input_headers == NULL) {
-		event_warn("%s: calloc", __func__);
+		event_warn("%s: evbuffer_arena_alloc", __func__);
 		goto error;
 	}
 	TAILQ_INIT(req->input_headers);
 
-	req->output_headers = mm_calloc(1, sizeof(struct evkeyvalq));
+	req->output_headers = evbuffer_arena_alloc(arena,
+	    sizeof(struct evkeyvalq));
 	if (req->output_headers == NULL) {
-		event_warn("%s: calloc", __func__);
+		event_warn("%s: evbuffer_arena_alloc", __func__);
 		goto error;
 	}
 	TAILQ_INIT(req->output_headers);
 
-	if ((req->input_buffer = evbuffer_new()) == NULL) {
-		event_warn("%s: evbuffer_new", __func__);
+	if ((req->input_buffer = evbuffer_new_arena(arena)) == NULL) {
+		event_warn("%s: evbuffer_new_arena", __func__);
 		goto error;
 	}
 
-	if ((req->output_buffer = evbuffer_new()) == NULL) {
-		event_warn("%s: evbuffer_new", __func__);
+	if ((req->output_buffer = evbuffer_new_arena(arena)) == NULL) {
+		event_warn("%s: evbuffer_new_arena", __func__);
 		goto error;
 	}
 
@@ -4036,11 +4328,10 @@ evhttp_request_free(struct evhttp_request *req)
 	if (req->host_cache != NULL)
 		mm_free(req->host_cache);
 
-	evhttp_clear_headers(req->input_headers);
-	mm_free(req->input_headers);
-
-	evhttp_clear_headers(req->output_headers);
-	mm_free(req->output_headers);
+	if (req->input_headers != NULL)
+		evhttp_clear_headers(req->input_headers);
+	if (req->output_headers != NULL)
+		evhttp_clear_headers(req->output_headers);
 
 	if (req->input_buffer != NULL)
 		evbuffer_free(req->input_buffer);
@@ -4048,7 +4339,8 @@ evhttp_request_free(struct evhttp_request *req)
 	if (req->output_buffer != NULL)
 		evbuffer_free(req->output_buffer);
 
-	mm_free(req);
+	/* The request itself lives in the arena, so this must come last. */
+	evbuffer_arena_free(req->arena);
 }
 
 void
@@ -4210,7 +4502,7 @@ struct evbuffer *evhttp_request_get_output_buffer(struct evhttp_request *req)
 
 static struct evhttp_connection*
 evhttp_get_request_connection(
-	struct evhttp* http,
+	struct evhttp* http, struct event_base *base,
 	evutil_socket_t fd, struct sockaddr *sa, ev_socklen_t salen)
 {
 	struct evhttp_connection *evcon;
@@ -4236,10 +4528,10 @@ evhttp_get_request_connection(
 
 	/* we need a connection object to put the http request on */
 	if (http->bevcb != NULL) {
-		bev = (*http->bevcb)(http->base, http->bevcbarg);
+		bev = (*http->bevcb)(base, http->bevcbarg);
 	}
 	evcon = evhttp_connection_base_bufferevent_new(
-		http->base, NULL, bev, hostname, atoi(portname));
+		base, NULL, bev, hostname, atoi(portname));
 	mm_free(hostname);
 	mm_free(portname);
 	if (evcon == NULL)
@@ -4249,6 +4541,8 @@ evhttp_get_request_connection(
 	evcon->max_body_size = http->default_max_body_size;
 	if (http->flags & EVHTTP_SERVER_LINGERING_CLOSE)
 		evcon->flags |= EVHTTP_CON_LINGERING_CLOSE;
+	if (http->flags & EVHTTP_SERVER_INPLACE_HEADERS)
+		evcon->flags |= EVHTTP_CON_INPLACE_HEADERS;
 
 	evcon->flags |= EVHTTP_CON_INCOMING;
 	evcon->state = EVCON_READING_FIRSTLINE;
@@ -4306,12 +4600,12 @@ evhttp_associate_new_request_with_connection(struct evhttp_connection *evcon)
 }
 
 static void
-evhttp_get_request(struct evhttp *http, evutil_socket_t fd,
-    struct sockaddr *sa, ev_socklen_t salen)
+evhttp_get_request_on_base(struct evhttp *http, struct event_base *base,
+    evutil_socket_t fd, struct sockaddr *sa, ev_socklen_t salen)
 {
 	struct evhttp_connection *evcon;
 
-	evcon = evhttp_get_request_connection(http, fd, sa, salen);
+	evcon = evhttp_get_request_connection(http, base, fd, sa, salen);
 	if (evcon == NULL) {
 		event_sock_warn(fd, "%s: cannot get connection on "EV_SOCK_FMT,
 		    __func__, EV_SOCK_ARG(fd));
@@ -4328,12 +4622,68 @@ evhttp_get_request(struct evhttp *http, evutil_socket_t fd,
 	 * we need to know which http server it belongs to.
 	 */
 	evcon->http_server = http;
+	EVLOCK_LOCK(http->lock, 0);
 	TAILQ_INSERT_TAIL(&http->connections, evcon, next);
+	EVLOCK_UNLOCK(http->lock, 0);
 
 	if (evhttp_associate_new_request_with_connection(evcon) == -1)
 		evhttp_connection_free(evcon);
 }
 
+static void
+evhttp_handoff_cb(evutil_socket_t fd, short what, void *arg)
+{
+	struct evhttp_handoff *handoff = arg;
+	struct evhttp *http = handoff->http;
+
+	EVLOCK_LOCK(http->lock, 0);
+	TAILQ_REMOVE(&http->handoffs, handoff, next);
+	EVLOCK_UNLOCK(http->lock, 0);
+
+	evhttp_get_request_on_base(http, handoff->base, handoff->fd,
+	    (struct sockaddr *)&handoff->ss, handoff->salen);
+	mm_free(handoff);
+}
+
+static void
+evhttp_get_request(struct evhttp *http, evutil_socket_t fd,
+    struct sockaddr *sa, ev_socklen_t salen)
+{
+	struct evhttp_handoff *handoff;
+
+	if (!http->n_worker_bases) {
+		evhttp_get_request_on_base(http, http->base, fd, sa, salen);
+		return;
+	}
+
+	/* Set the connection up from inside the worker's own loop, so that
+	 * nothing about it is ever touched from two threads. */
+	if ((handoff = mm_calloc(1, sizeof(*handoff))) == NULL ||
+	    salen > (ev_socklen_t)sizeof(handoff->ss)) {
+		event_warn("%s: cannot hand off "EV_SOCK_FMT,
+		    __func__, EV_SOCK_ARG(fd));
+		if (handoff)
+			mm_free(handoff);
+		evutil_closesocket(fd);
+		return;
+	}
+	handoff->http = http;
+	handoff->base = http->worker_bases[http->next_worker];
+	http->next_worker = (http->next_worker + 1) % http->n_worker_bases;
+	handoff->fd = fd;
+	handoff->salen = salen;
+	memcpy(&handoff->ss, sa, salen);
+
+	/* Keep track of it, so that evhttp_free() can close it if the
+	 * worker never gets to it. */
+	event_assign(&handoff->ev, handoff->base, -1, 0,
+	    evhttp_handoff_cb, handoff);
+	EVLOCK_LOCK(http->lock, 0);
+	TAILQ_INSERT_TAIL(&http->handoffs, handoff, next);
+	EVLOCK_UNLOCK(http->lock, 0);
+	event_active(&handoff->ev, EV_TIMEOUT, 1);
+}
+
 
 /*
  * Network helper functions that we do not want to export to the rest of
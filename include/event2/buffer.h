@@ -1053,6 +1053,120 @@ struct event_base;
 EVENT2_EXPORT_SYMBOL
 int evbuffer_defer_callbacks(struct evbuffer *buffer, struct event_base *base);
 
+/**
+   Allocate the chains of an evbuffer from the chain pool of an event_base,
+   as set up with event_config_set_chain_pool().  The input and output
+   buffers of bufferevents do this automatically.
+
+   @param buffer the evbuffer to change
+   @param base the event_base whose pool to use, or NULL to stop using a pool
+   @return 0 on success, -1 if the base has no chain pool.
+ */
+EVENT2_EXPORT_SYMBOL
+int evbuffer_use_chain_pool(struct evbuffer *buffer, struct event_base *base);
+
+/**
+   Report how the chain pool of an event_base has been doing.
+
+   @param base the event_base to inspect
+   @param hits set to the number of chains allocated from the pool without
+      calling the allocator, if not NULL
+   @param misses set to the number of chains that had to be allocated, if
+      not NULL
+   @param cached_bytes set to the number of bytes currently held in free
+      chains, if not NULL
+   @return 0 on success, -1 if the base has no chain pool.
+ */
+EVENT2_EXPORT_SYMBOL
+int event_base_get_chain_pool_stats(struct event_base *base,
+    ev_uint64_t *hits, ev_uint64_t *misses, size_t *cached_bytes);
+
+/**
+   An evbuffer_arena hands out memory by bumping a pointer through a few
+   large blocks, and gets it all back at once when it is reset or freed.
+
+   It is meant for evbuffers (and other objects) that live and die
+   together, such as everything that belongs to one HTTP request: each
+   allocation is nearly free, and nothing is given back one piece at a
+   time.  An evbuffer allocated from an arena takes its small data chains
+   from it too; a chain that is drained goes back to the arena, which hands
+   it out again for the next chain that fits.  So that a buffer which lives
+   longer than expected can't make its arena grow without bound, new chains
+   come from the allocator as usual once the arena has handed out sixteen
+   blocks' worth.
+
+   Chains that move from such an evbuffer to another one (with
+   evbuffer_add_buffer(), say) keep their arena alive until they are
+   freed, so the arena may outlive evbuffer_arena_free().
+ */
+struct evbuffer_arena;
+
+/** The block size that evbuffer_arena_new() uses when given 0. */
+#define EVBUFFER_ARENA_DEFAULT_BLOCK 4096
+
+/**
+   Allocate a new evbuffer_arena.
+
+   @param block_size the number of bytes to get from the allocator at a
+      time, or 0 for EVBUFFER_ARENA_DEFAULT_BLOCK.  The first block is
+      allocated along with the arena itself.
+   @return the new arena, or NULL on failure.
+ */
+EVENT2_EXPORT_SYMBOL
+struct evbuffer_arena *evbuffer_arena_new(size_t block_size);
+
+/**
+   Release an evbuffer_arena and everything allocated from it.
+
+   Memory from evbuffer_arena_alloc() is invalid afterwards.  Evbuffers and
+   chains still using the arena keep it alive until they are freed.
+ */
+EVENT2_EXPORT_SYMBOL
+void evbuffer_arena_free(struct evbuffer_arena *arena);
+
+/**
+   Give back everything allocated from an evbuffer_arena at once, keeping
+   only its first block.
+
+   @return 0 on success, -1 if an evbuffer or chain still uses the arena.
+ */
+EVENT2_EXPORT_SYMBOL
+int evbuffer_arena_reset(struct evbuffer_arena *arena);
+
+/**
+   Allocate memory from an evbuffer_arena, aligned for any type.
+
+   The memory is released by evbuffer_arena_reset() or
+   evbuffer_arena_free(), never on its own.
+
+   @return the memory, or NULL on failure.
+ */
+EVENT2_EXPORT_SYMBOL
+void *evbuffer_arena_alloc(struct evbuffer_arena *arena, size_t size);
+
+/**
+   Allocate an evbuffer from an evbuffer_arena, along with the data chains
+   it will need.
+
+   Free it with evbuffer_free() as usual, before resetting the arena.
+
+   @return the new evbuffer, or NULL on failure.
+ */
+EVENT2_EXPORT_SYMBOL
+struct evbuffer *evbuffer_new_arena(struct evbuffer_arena *arena);
+
+/**
+   Report how much an evbuffer_arena has handed out.
+
+   @param arena the arena to inspect
+   @param n_blocks set to the number of blocks the arena has allocated
+      since it was created or last reset, if not NULL
+   @param used set to the number of bytes it has handed out, if not NULL
+ */
+EVENT2_EXPORT_SYMBOL
+void evbuffer_arena_get_stats(struct evbuffer_arena *arena,
+    size_t *n_blocks, size_t *used);
+
 /**
   Append data from 1 or more iovec's to an evbuffer
 
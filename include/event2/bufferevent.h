@@ -253,6 +253,93 @@ int bufferevent_socket_connect_hostname(struct bufferevent *,
 EVENT2_EXPORT_SYMBOL
 int bufferevent_socket_get_dns_error(struct bufferevent *bev);
 
+/**
+   Send large writes from a socket bufferevent without copying them into
+   the kernel.
+
+   Writes of at least 'threshold' bytes are sent with MSG_ZEROCOPY: the
+   kernel sends straight from the output buffer's memory, and the chains
+   that memory lives in are kept, even after they are drained, until the
+   kernel reports that it is done with them.  Those reports are read by
+   an edge-triggered event on a duplicate of the socket, whether or not
+   the bufferevent is reading or writing.  Smaller writes are copied as
+   usual, since for them the bookkeeping costs more than the copy; a
+   threshold of around 16 KiB is a reasonable start.
+
+   If the bufferevent is freed while the kernel is still sending, the
+   duplicate of the socket is kept open, and the memory is given back once
+   the kernel is done with it.  If the kernel says nothing for 30 seconds,
+   the memory is given back anyway.  The base must outlive those sends; if
+   it is freed first, that memory is never given back.  After
+   bufferevent_setfd(), call this again to send from the new socket
+   without copying; that fails until the sends on the old socket are done.
+
+   This is only available on Linux 4.14 and later, for TCP sockets, with
+   a backend that supports EV_ET, such as epoll.  Call it after the
+   bufferevent has its socket.
+
+   @param bev A socket bufferevent.
+   @param threshold The smallest write to send without copying, or 0 to
+      go back to copying every write.
+   @return 0 on success, or -1 if the socket can't send without copying.
+*/
+EVENT2_EXPORT_SYMBOL
+int bufferevent_socket_set_zerocopy(struct bufferevent *bev,
+    size_t threshold);
+
+/**
+   Send everything one bufferevent reads out through another.
+
+   While forwarding, whatever 'src' reads is added to the output of 'dst'
+   in place of running the read callback of 'src'; anything 'src' had
+   already read goes first.  When both are socket bufferevents and the
+   system has splice(), the data goes from one socket to the other through
+   a pipe, without being copied into user space.  Otherwise it is moved
+   from one buffer to the other as bufferevent_write_buffer() would.
+
+   'src' stops reading once 'dst' has as much waiting to go out as its
+   high write watermark allows, and starts again when that falls to the
+   low write watermark.  Data still in the pipe counts as waiting to go
+   out, but isn't in the output buffer of 'dst' until forwarding stops or
+   'src' reaches end of file, when it is moved to the front of that
+   buffer.
+
+   Both bufferevents must use the same event_base, and their callbacks
+   must run in the thread of that base.  Forwarding stops once either of
+   them is freed and the base has run its pending callbacks.  To forward
+   in both directions, call this once each way.
+
+   @param src the bufferevent to read from
+   @param dst the bufferevent to write to
+   @return 0 on success, or -1 if the bufferevents use different bases or
+     'src' already forwards or 'dst' is already forwarded to.
+   @see bufferevent_forward_stop(), bufferevent_forward_get_counts()
+*/
+EVENT2_EXPORT_SYMBOL
+int bufferevent_forward(struct bufferevent *src, struct bufferevent *dst);
+
+/**
+   Stop forwarding what 'src' reads, and run its read callback again.
+
+   @return 0 on success, or -1 if 'src' wasn't forwarding.
+*/
+EVENT2_EXPORT_SYMBOL
+int bufferevent_forward_stop(struct bufferevent *src);
+
+/**
+   Report how many bytes 'src' has forwarded so far.
+
+   @param src a bufferevent that forwards
+   @param n_spliced if not NULL, set to the number of bytes sent through
+     the pipe without being copied
+   @param n_copied if not NULL, set to the number of bytes moved between
+     buffers instead
+   @return 0 on success, or -1 if 'src' isn't forwarding.
+*/
+EVENT2_EXPORT_SYMBOL
+int bufferevent_forward_get_counts(struct bufferevent *src,
+    ev_uint64_t *n_spliced, ev_uint64_t *n_copied);
+
 /**
   Assign a bufferevent to a specific event_base.
 
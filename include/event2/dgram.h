@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2007-2012 Niels Provos and Nick Mathewson
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef EVENT2_DGRAM_H_INCLUDED_
+#define EVENT2_DGRAM_H_INCLUDED_
+
+/** @file event2/dgram.h
+
+  Batched reading and writing of datagram sockets.
+
+  An evdgram wraps a datagram socket.  When the socket is readable, it
+  reads as many datagrams as it can in one system call (recvmmsg() where
+  available) into a buffer it keeps for the purpose, and hands them all to
+  a single callback.  Datagrams sent with evdgram_send() are queued until
+  the next time the socket is writable, and the whole queue goes out in one
+  system call (sendmmsg() where available).
+
+  Where the system lacks recvmmsg() or sendmmsg(), the same thing happens
+  one datagram per system call.
+ */
+
+#include <event2/visibility.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <event2/event.h>
+
+struct sockaddr;
+struct evdgram;
+
+/**
+   One datagram received by an evdgram, as passed to an evdgram_read_cb.
+ */
+struct evdgram_msg {
+	/** The contents of the datagram.  They belong to the evdgram and are
+	    only valid until the callback returns. */
+	unsigned char *data;
+	/** The length of data */
+	size_t len;
+	/** The address the datagram came from; it too belongs to the
+	    evdgram. */
+	struct sockaddr *addr;
+	/** The length of addr */
+	int socklen;
+	/** True iff the datagram was longer than the evdgram's maximum
+	    size, and was cut short. */
+	int truncated;
+};
+
+/**
+   A callback that we invoke with all the datagrams an evdgram read in one
+   go.
+
+   @param dgram The evdgram
+   @param msgs The datagrams, oldest first
+   @param n_msgs The number of entries in msgs; at least 1
+   @param user_arg the pointer passed to evdgram_new()
+ */
+typedef void (*evdgram_read_cb)(struct evdgram *dgram,
+    struct evdgram_msg *msgs, int n_msgs, void *user_arg);
+
+/**
+   A callback that we invoke when reading or sending fails.  Use
+   EVUTIL_SOCKET_ERROR() to find out what went wrong.  A datagram that
+   can't be sent is dropped.
+
+   @param dgram The evdgram
+   @param what EV_READ or EV_WRITE, for the operation that failed
+   @param user_arg the pointer passed to evdgram_new()
+ */
+typedef void (*evdgram_error_cb)(struct evdgram *dgram, short what,
+    void *user_arg);
+
+/** Flag: Indicates that we should close the underlying socket when the
+ * evdgram is freed. */
+#define EVDGRAM_OPT_CLOSE_ON_FREE		(1u<<0)
+/** Flag: Indicates that we should allocate a lock for the evdgram, so that
+ * it's safe to use from multiple threads. */
+#define EVDGRAM_OPT_THREADSAFE			(1u<<1)
+/** Flag: Indicates that queued datagrams of the same size for the same
+ * address should be sent as one buffer that the kernel (or the network
+ * card) splits up again, using UDP generic segmentation offload.  Ignored
+ * where that isn't available. */
+#define EVDGRAM_OPT_GSO				(1u<<2)
+
+/** The number of datagrams evdgram_new() reads at once by default. */
+#define EVDGRAM_DEFAULT_BATCH 32
+/** The largest datagram evdgram_new() reads in full by default. */
+#define EVDGRAM_DEFAULT_SIZE 2048
+
+/**
+   Allocate a new evdgram object to read and write a datagram socket.
+
+   The evdgram starts out enabled for reading.
+
+   @param base The event base to associate the evdgram with.
+   @param fd A nonblocking datagram socket.  It may be bound, connected,
+      or both.
+   @param flags Any number of EVDGRAM_OPT_* flags
+   @param batch The largest number of datagrams to read at once, or 0 for
+      EVDGRAM_DEFAULT_BATCH.  This is also how many queued datagrams we
+      send in one system call.
+   @param max_size The largest datagram to read in full, or 0 for
+      EVDGRAM_DEFAULT_SIZE.  The evdgram keeps batch * max_size bytes to
+      read into.
+   @param cb A callback to be invoked with the datagrams read.
+   @param ptr A user-supplied pointer to give to the callbacks.
+   @return The new evdgram, or NULL on failure.
+ */
+EVENT2_EXPORT_SYMBOL
+struct evdgram *evdgram_new(struct event_base *base, evutil_socket_t fd,
+    unsigned flags, int batch, size_t max_size, evdgram_read_cb cb,
+    void *ptr);
+
+/**
+   Disable and deallocate an evdgram.  Datagrams still queued are dropped.
+ */
+EVENT2_EXPORT_SYMBOL
+void evdgram_free(struct evdgram *dgram);
+
+/**
+   Set the callback to invoke when reading or sending fails.
+ */
+EVENT2_EXPORT_SYMBOL
+void evdgram_set_error_cb(struct evdgram *dgram, evdgram_error_cb errorcb);
+
+/**
+   Re-enable an evdgram that has been disabled.
+ */
+EVENT2_EXPORT_SYMBOL
+int evdgram_enable(struct evdgram *dgram);
+
+/**
+   Stop reading datagrams.  Queued datagrams are still sent.
+ */
+EVENT2_EXPORT_SYMBOL
+int evdgram_disable(struct evdgram *dgram);
+
+/** Return an evdgram's associated event_base. */
+EVENT2_EXPORT_SYMBOL
+struct event_base *evdgram_get_base(struct evdgram *dgram);
+
+/** Return the socket that an evdgram reads and writes. */
+EVENT2_EXPORT_SYMBOL
+evutil_socket_t evdgram_get_fd(struct evdgram *dgram);
+
+/**
+   Queue a copy of a datagram to send.
+
+   It goes out, along with everything else queued by then, the next time
+   the socket is writable; or at once if this fills a batch.
+
+   @param dgram The evdgram
+   @param data The contents of the datagram
+   @param len The length of data
+   @param addr The address to send to, or NULL if the socket is connected
+   @param socklen The length of addr
+   @return 0 on success, -1 on failure.
+ */
+EVENT2_EXPORT_SYMBOL
+int evdgram_send(struct evdgram *dgram, const void *data, size_t len,
+    const struct sockaddr *addr, int socklen);
+
+/**
+   Send as much of what is queued as the socket will take right now.
+
+   @return the number of datagrams still queued.
+ */
+EVENT2_EXPORT_SYMBOL
+int evdgram_flush(struct evdgram *dgram);
+
+/** Return the number of datagrams queued to send. */
+EVENT2_EXPORT_SYMBOL
+int evdgram_get_n_queued(struct evdgram *dgram);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
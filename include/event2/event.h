@@ -49,7 +49,7 @@
 
 
   Currently, Libevent supports /dev/poll, kqueue(2), select(2), poll(2),
-  epoll(4), and evports. The internal event mechanism is completely
+  epoll(4), io_uring(7), and evports. The internal event mechanism is completely
   independent of the exposed event API, and a simple update of Libevent can
   provide new functionality without having to redesign the applications. As a
   result, Libevent allows for portable application development and provides
@@ -580,7 +580,74 @@ enum event_base_config_flag {
 	    however, we use less efficient more precise timer, assuming one is
 	    present.
 	 */
-	EVENT_BASE_FLAG_PRECISE_TIMER = 0x20
+	EVENT_BASE_FLAG_PRECISE_TIMER = 0x20,
+
+	/** If we are using the io_uring backend, this flag says that socket
+	    bufferevents should hand their reads and writes to the kernel as
+	    io_uring operations, and be told when they have finished, rather
+	    than waiting for readiness and then calling recv() and send()
+	    themselves.
+
+	    This flag can also be activated by setting the
+	    EVENT_IO_URING_COMPLETION environment variable.
+
+	    This flag has no effect if you wind up using a backend other than
+	    io_uring.
+	 */
+	EVENT_BASE_FLAG_IO_URING_COMPLETION = 0x40,
+
+	/** Keep coarse timeouts in a hierarchical timing wheel instead of
+	    in the event_base's binary heap of timeouts.
+
+	    A relative timeout of at least one second is coarse: adding and
+	    deleting it take constant time, but it fires on the first
+	    millisecond boundary at or after it expires, and coarse timeouts
+	    that expire during the same millisecond fire in the order they
+	    were added.  This suits large numbers of idle-connection timeouts
+	    that are reset all the time.  Shorter timeouts, and common
+	    timeouts, are ordered exactly as before.
+	 */
+	EVENT_BASE_FLAG_TIMER_WHEEL = 0x80,
+
+	/** Let other threads activate events without taking the event_base's
+	    lock.
+
+	    When a thread other than the one running the loop calls
+	    event_active() or schedules an immediate event_base_once(), the
+	    activation goes on a lock-free queue that the loop drains on its
+	    next pass.  Only the activation that finds the queue empty wakes the
+	    loop, so a burst of them costs a single wakeup.  The event counts
+	    as active once the loop (or any call that deletes or inspects it)
+	    has drained the queue.
+
+	    This flag has no effect when Libevent is built without thread
+	    support or for a compiler without atomic builtins.
+	 */
+	EVENT_BASE_FLAG_ACTIVATION_QUEUE = 0x100,
+
+	/** Keep the counters that event_base_get_stats() reports.
+
+	    This reads a precise monotonic clock twice for every callback the
+	    loop runs, and twice more per loop iteration.  Without this flag,
+	    the loop only tests a pointer.
+	 */
+	EVENT_BASE_FLAG_COLLECT_STATS = 0x200,
+
+	/** Let timeouts on the heap be pushed later without touching the heap.
+
+	    When event_add() moves an event's pending timeout later, as a
+	    persistent event with a timeout or a bufferevent with read or
+	    write timeouts does on every bit of activity, only the new
+	    deadline is recorded.  The timeout heap keeps the old one, and when
+	    that comes due the loop puts the event back for its real deadline
+	    instead of running it.  A busy connection then costs a heap
+	    operation once per timeout period instead of once per read.
+
+	    Callbacks never run early; the cost is an extra wakeup of the loop
+	    when an old deadline comes due.  Common timeouts and timeouts in
+	    the timing wheel are rescheduled as before.
+	 */
+	EVENT_BASE_FLAG_LAZY_TIMEOUTS = 0x400
 };
 
 /**
@@ -672,6 +739,109 @@ int event_config_set_max_dispatch_interval(struct event_config *cfg,
     const struct timeval *max_interval, int max_callbacks,
     int min_priority);
 
+/**
+ * Limit the number of common timeouts that an event_base creates on its
+ * own for the timeouts of bufferevents (and so of evhttp connections).
+ *
+ * When the same duration is passed to bufferevent_set_timeouts() more than
+ * once, the event_base sets up a common timeout for it, as if it had been
+ * passed to event_base_init_common_timeout(), and the bufferevents use that
+ * from then on.  This keeps large numbers of connections with the same
+ * timeouts off the timeout heap.  Once max_queues common timeouts have been
+ * created this way, other durations are scheduled as usual.
+ *
+ * @param cfg The event_base configuration object.
+ * @param max_queues The most common timeouts to create automatically, or 0
+ *     to turn the feature off.  The default is 16.
+ * @return 0 on success, -1 on failure.
+ * @see event_base_init_common_timeout()
+ */
+EVENT2_EXPORT_SYMBOL
+int event_config_set_max_auto_common_timeouts(struct event_config *cfg,
+    int max_queues);
+
+/**
+ * Give the event base a pool of evbuffer chains, so that evbuffers used by
+ * its bufferevents reuse freed chains instead of going to the allocator for
+ * each one.  Chains up to 64 KiB are cached by size class; each class keeps
+ * at most max_cached_bytes worth of free chains, and anything beyond that
+ * is freed as usual.
+ *
+ * Other evbuffers can be attached to the pool with evbuffer_use_chain_pool().
+ * Use event_base_get_chain_pool_stats() to see how well it is working.
+ *
+ * @param cfg The event_base configuration object.
+ * @param max_cached_bytes The high-water mark for each size class, or 0 to
+ *     disable the pool (the default).
+ * @return 0 on success, -1 on failure.
+ */
+EVENT2_EXPORT_SYMBOL
+int event_config_set_chain_pool(struct event_config *cfg,
+    size_t max_cached_bytes);
+
+/**
+ * Have the event base poll without blocking for a while before it goes to
+ * sleep waiting for events.
+ *
+ * Each time the loop would wait, the backend polls with a zero timeout
+ * for up to 'usec' microseconds (or until the loop's next timeout, if that
+ * comes sooner), and only blocks if nothing turned up.  This trades a
+ * busy CPU for not having to be woken by the kernel when events arrive
+ * close together.  The lock on the event base is not held while spinning.
+ *
+ * Only the epoll backend implements this; other backends ignore it.
+ *
+ * @param cfg The event_base configuration object.
+ * @param usec How long to spin for, or 0 to never spin (the default).
+ * @return 0 on success, -1 on failure.
+ */
+EVENT2_EXPORT_SYMBOL
+int event_config_set_busy_poll(struct event_config *cfg, int usec);
+
+/**
+ * Bound the array in which the backend receives ready events.
+ *
+ * The backend starts with room for 'min_events' events and doubles the
+ * array whenever one poll fills it, up to 'max_events'.  When a long run of
+ * polls has used no more than a quarter of it, the array is halved again,
+ * down to 'min_events', so that one burst doesn't pin a large array for
+ * the life of the base.  A larger maximum means fewer system calls under
+ * load; a smaller one means each loop iteration has less to do.
+ *
+ * Only the epoll backend implements this; other backends ignore it.
+ *
+ * @param cfg The event_base configuration object.
+ * @param min_events The smallest size of the array, or 0 for the default.
+ * @param max_events The largest size of the array, or 0 for the default.
+ * @return 0 on success, -1 on failure.
+ */
+EVENT2_EXPORT_SYMBOL
+int event_config_set_backend_events(struct event_config *cfg,
+    int min_events, int max_events);
+
+/**
+ * Limit how many callbacks the event base runs before it checks for new
+ * events, with a share that shrinks as the priority gets lower.
+ *
+ * Callbacks of priority 0 may run up to 'budget' of them before the base
+ * polls again; lower priorities get a linearly smaller share, down to
+ * budget/npriorities for the lowest (but always at least one).  Anything
+ * left over runs in the next iteration of the loop, after a poll that
+ * doesn't block.  This keeps a large burst of activity from making any one
+ * iteration of the loop long.
+ *
+ * Unlike the limits from event_config_set_max_dispatch_interval(), the
+ * budget applies to every priority.  Where both apply, the smaller limit
+ * wins.
+ *
+ * @param cfg The event_base configuration object.
+ * @param budget The number of callbacks that priority 0 may run, or 0 for
+ *     no budget (the default).
+ * @return 0 on success, -1 on failure.
+ */
+EVENT2_EXPORT_SYMBOL
+int event_config_set_dispatch_budget(struct event_config *cfg, int budget);
+
 /**
   Initialize the event API.
 
@@ -962,6 +1132,17 @@ int event_base_got_break(struct event_base *);
  * feature flag EV_FEATURE_EARLY_CLOSE.
  **/
 #define EV_CLOSED	0x80
+/**
+ * Wake only one of the event_bases waiting on this fd when it becomes ready,
+ * rather than all of them.  This is meant for a listening socket that
+ * several event_bases in different threads all accept on.
+ *
+ * Only the epoll backend implements this, with EPOLLEXCLUSIVE, on Linux 4.5
+ * and later; other backends ignore it.  As with EV_ET, all the events on
+ * one fd should agree about it.  It is ignored for an fd that has an
+ * EV_CLOSED event, since epoll can't combine the two.
+ **/
+#define EV_EXCLUSIVE	0x100
 /**@}*/
 
 /**
@@ -1283,6 +1464,49 @@ int event_del_noblock(struct event *ev);
 EVENT2_EXPORT_SYMBOL
 int event_del_block(struct event *ev);
 
+/**
+  Add, or reschedule, many events with the same timeout at once.
+
+  This behaves like calling event_add() on each of the n_events events in
+  'evs' with the same 'timeout', but takes the event_base's lock only once.
+  When the batch is large next to the number of timeouts already pending,
+  the timeout heap is rebuilt once at the end instead of being adjusted for
+  every event.
+
+  All the events must belong to the same event_base.  An event that fails
+  to add doesn't stop the others from being added.
+
+  @param evs an array of events initialized via event_assign() or
+         event_new()
+  @param n_events the number of events in evs
+  @param timeout the maximum amount of time to wait for each event, or NULL
+         to wait forever
+  @return 0 if every event was added, or -1 if any of them failed or the
+         events don't share an event_base
+  @see event_add(), event_del_batch()
+ */
+EVENT2_EXPORT_SYMBOL
+int event_add_batch(struct event **evs, int n_events,
+    const struct timeval *timeout);
+
+/**
+  Remove many events from the set of monitored events at once.
+
+  This behaves like calling event_del() on each of the n_events events in
+  'evs', but takes the event_base's lock only once, and rebuilds the timeout
+  heap once at the end when that is cheaper than removing them one by one.
+
+  All the events must belong to the same event_base.
+
+  @param evs an array of events to be removed from the working set
+  @param n_events the number of events in evs
+  @return 0 if every event was removed, or -1 if any of them failed or the
+         events don't share an event_base
+  @see event_del(), event_add_batch()
+ */
+EVENT2_EXPORT_SYMBOL
+int event_del_batch(struct event **evs, int n_events);
+
 /**
   Make an event active.
 
@@ -1569,6 +1793,161 @@ void event_set_mem_functions(
 EVENT2_EXPORT_SYMBOL
 void event_base_dump_events(struct event_base *, FILE *);
 
+/** The number of buckets in a callback duration histogram.
+
+    Bucket 0 counts callbacks that took less than a microsecond, bucket i
+    those that took from 2^(i-1) up to 2^i microseconds, and the last
+    bucket everything slower than that.
+ */
+#define EVENT_BASE_STATS_N_BUCKETS 20
+
+/**
+   Counters kept by an event_base configured with
+   EVENT_BASE_FLAG_COLLECT_STATS.  Times are in microseconds of the
+   monotonic clock.
+
+   @see event_base_get_stats()
+ */
+struct event_base_stats {
+	/** How many times the loop has polled its backend. */
+	ev_uint64_t n_loops;
+	/** Time spent waiting in the backend. */
+	ev_uint64_t wait_usec;
+	/** Time from the backend returning to the end of each iteration:
+	    timeouts, callbacks, and the loop's own work.  The latency the
+	    loop adds to an event that is ready is at most one of these. */
+	ev_uint64_t busy_usec;
+	/** The longest busy time of a single iteration. */
+	ev_uint64_t max_busy_usec;
+	/** Time spent in callbacks. */
+	ev_uint64_t callback_usec;
+	/** How many callbacks have run, internal ones included. */
+	ev_uint64_t n_callbacks;
+	/** How many callbacks were deferred to a later iteration. */
+	ev_uint64_t n_deferred;
+	/** The sum over iterations of the number of active callbacks found
+	    after polling; divide by n_loops for the mean queue depth. */
+	ev_uint64_t active_sum;
+	/** The most active callbacks found after polling. */
+	ev_uint64_t max_active;
+};
+
+/**
+   Read the counters of an event_base.
+
+   @param base An event_base configured with EVENT_BASE_FLAG_COLLECT_STATS.
+   @param stats Set to the base's counters.
+   @return 0 on success, or -1 if the base doesn't collect statistics.
+ */
+EVENT2_EXPORT_SYMBOL
+int event_base_get_stats(struct event_base *base,
+    struct event_base_stats *stats);
+
+/**
+   Read the histogram of callback durations for one priority.
+
+   @param base An event_base configured with EVENT_BASE_FLAG_COLLECT_STATS.
+   @param priority The priority whose callbacks to look at.
+   @param buckets Set to the counts; see EVENT_BASE_STATS_N_BUCKETS.
+   @param n_buckets The number of entries in buckets.  At most
+      EVENT_BASE_STATS_N_BUCKETS are filled in.
+   @return the number of buckets filled in, or -1 if the base doesn't
+      collect statistics or has no such priority.
+ */
+EVENT2_EXPORT_SYMBOL
+int event_base_get_callback_histogram(struct event_base *base, int priority,
+    ev_uint64_t *buckets, int n_buckets);
+
+/** Clear the counters of an event_base that collects statistics. */
+EVENT2_EXPORT_SYMBOL
+void event_base_reset_stats(struct event_base *base);
+
+/**
+   Writes a human-readable summary of the counters of an event_base, of
+   how many callbacks are active at each priority, and of the slow
+   callbacks it has recorded, to a provided stdio stream.
+
+   This is intended for debugging; its format is not guaranteed to be the same
+   between libevent versions.
+
+   @param base An event_base configured with EVENT_BASE_FLAG_COLLECT_STATS.
+   @param output A stdio file to write on.
+ */
+EVENT2_EXPORT_SYMBOL
+void event_base_dump_stats(struct event_base *base, FILE *output);
+
+/** How many slow callbacks an event_base remembers. */
+#define EVENT_SLOW_CALLBACK_LOG_SIZE 64
+
+/**
+   A callback that ran for longer than the threshold given to
+   event_base_set_slow_callback_threshold().
+ */
+struct event_slow_callback {
+	/** The function that ran, cast to a generic function pointer.  For
+	    an event, this is the callback passed to event_new() or
+	    event_assign(). */
+	void (*fn)(void);
+	/** The argument it was passed. */
+	void *arg;
+	/** For an event, its file descriptor or signal number; otherwise,
+	    EVUTIL_INVALID_SOCKET. */
+	evutil_socket_t fd;
+	/** For an event, the EV_* flags it was run with; otherwise 0. */
+	short events;
+	/** The priority it ran at. */
+	int priority;
+	/** How long it ran, in microseconds. */
+	ev_uint64_t usec;
+	/** The wall-clock time at which it returned. */
+	struct timeval when;
+};
+
+/**
+   A hook that we invoke, from the event loop, after a slow callback.
+
+   @param base The event_base that ran the callback.
+   @param slow What ran, and for how long.
+   @param arg The pointer passed to event_base_set_slow_callback_threshold().
+ */
+typedef void (*event_slow_callback_cb)(struct event_base *base,
+    const struct event_slow_callback *slow, void *arg);
+
+/**
+   Watch an event_base for callbacks that hold up its loop.
+
+   From now on, each callback that runs for at least 'threshold' is recorded
+   in a log of the last EVENT_SLOW_CALLBACK_LOG_SIZE, which
+   event_base_get_slow_callbacks() reads.  If a hook is given, it is also
+   invoked right after each of them.
+
+   This reads a precise monotonic clock twice for every callback the loop
+   runs.
+
+   @param base The event_base to watch.
+   @param threshold How long a callback must run to be recorded, or NULL
+      to stop watching and forget the log.
+   @param hook A function to invoke after each slow callback, or NULL.
+   @param arg An argument to pass to the hook.
+   @return 0 on success, -1 on failure.
+ */
+EVENT2_EXPORT_SYMBOL
+int event_base_set_slow_callback_threshold(struct event_base *base,
+    const struct timeval *threshold, event_slow_callback_cb hook, void *arg);
+
+/**
+   Read the log of slow callbacks of an event_base.
+
+   @param base The event_base.
+   @param slow Set to the slow callbacks, newest first.
+   @param n_slow The number of entries in slow.
+   @return the number of entries filled in, or -1 if the base isn't being
+      watched for slow callbacks.
+ */
+EVENT2_EXPORT_SYMBOL
+int event_base_get_slow_callbacks(struct event_base *base,
+    struct event_slow_callback *slow, int n_slow);
+
 
 /**
    Activates all pending events for the given fd and event mask.
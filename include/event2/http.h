@@ -298,6 +298,37 @@ EVENT2_EXPORT_SYMBOL
 void evhttp_set_bevcb(struct evhttp *http,
     struct bufferevent *(*cb)(struct event_base *, void *), void *arg);
 
+/**
+   Spread the connections accepted by an evhttp object over a set of worker
+   event bases.
+
+   Connections are still accepted on the base that the evhttp object was
+   created with, but each new connection is then handed to one of the
+   worker bases, round-robin, and lives there until it is closed: every
+   request callback for it runs in the thread that runs that base's loop,
+   one request at a time, in order.  This is meant for running one
+   event_base per core, as with event_base_group_new().
+
+   The callbacks, virtual hosts, aliases and settings of the evhttp object
+   are shared by all the workers and must not be changed once connections
+   are being accepted.  The worker loops must not be running when
+   evhttp_free() is called, and the worker bases must not be freed before
+   it: connections that were accepted but not yet picked up by a worker
+   are closed by evhttp_free().
+
+   Locking must have been enabled with evthread_use_pthreads() or
+   evthread_use_windows_threads() before the worker bases were created.
+
+   @param http the evhttp server object
+   @param bases the worker event bases; the array is copied
+   @param n_bases the number of worker bases, or 0 to handle connections
+      on the evhttp object's own base again
+   @return 0 on success, -1 on failure
+ */
+EVENT2_EXPORT_SYMBOL
+int evhttp_set_worker_bases(struct evhttp *http, struct event_base **bases,
+    int n_bases);
+
 /**
    Adds a virtual host to the http server.
 
@@ -377,6 +408,10 @@ void evhttp_set_timeout_tv(struct evhttp *http, const struct timeval* tv);
 /* Read all the clients body, and only after this respond with an error if the
  * clients body exceed max_body_size */
 #define EVHTTP_SERVER_LINGERING_CLOSE	0x0001
+/* Parse each request's header block in one pass once all of it has
+ * arrived, instead of copying it out line by line.
+ * @see EVHTTP_CON_INPLACE_HEADERS */
+#define EVHTTP_SERVER_INPLACE_HEADERS	0x0002
 /**
  * Set connection flags for HTTP server.
  *
@@ -661,6 +696,13 @@ void evhttp_connection_set_family(struct evhttp_connection *evcon,
 #define EVHTTP_CON_READ_ON_WRITE_ERROR	0x0010
 /* @see EVHTTP_SERVER_LINGERING_CLOSE */
 #define EVHTTP_CON_LINGERING_CLOSE	0x0020
+/* Wait for the whole header block and parse it in place, with a single
+ * evbuffer_pullup() and one allocation per header.  Headers containing
+ * NUL bytes are rejected rather than truncated.  The key and value of each
+ * header parsed this way share the allocation of its struct evkeyval: the
+ * value may be replaced with one from malloc(), but the key must not be;
+ * use evhttp_remove_header() and evhttp_add_header() instead. */
+#define EVHTTP_CON_INPLACE_HEADERS	0x0040
 /* Padding for public flags, @see EVHTTP_CON_* in http-internal.h */
 #define EVHTTP_CON_PUBLIC_FLAGS_END	0x100000
 /**
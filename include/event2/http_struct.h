@@ -142,6 +142,10 @@ struct {
 	 */
 	void (*on_complete_cb)(struct evhttp_request *, void *);
 	void *on_complete_cb_arg;
+
+	/* The arena that this request, its header lists and its buffers
+	 * were allocated from */
+	struct evbuffer_arena *arena;
 };
 
 #ifdef __cplusplus
@@ -60,6 +60,10 @@ struct evkeyval {
 
 	char *key;
 	char *value;
+
+	/* How libevent allocated this pair; leave it zero in pairs that you
+	 * allocate yourself. */
+	unsigned flags;
 };
 
 TAILQ_HEAD (evkeyvalq, evkeyval);
@@ -49,6 +49,34 @@ struct evconnlistener;
  */
 typedef void (*evconnlistener_cb)(struct evconnlistener *, evutil_socket_t, struct sockaddr *, int socklen, void *);
 
+/**
+   One connection accepted by an evconnlistener, as passed to an
+   evconnlistener_batch_cb.
+ */
+struct evconnlistener_conn {
+	/** The new file descriptor */
+	evutil_socket_t fd;
+	/** The source address of the connection.  It belongs to the listener
+	    and is only valid until the callback returns. */
+	struct sockaddr *addr;
+	/** The length of addr */
+	int socklen;
+};
+
+/**
+   A callback that we invoke with all the connections a listener accepted
+   in one go.
+
+   The callback owns the file descriptors, but not the 'conns' array.
+
+   @param listener The evconnlistener
+   @param conns The new connections
+   @param n_conns The number of entries in conns; at least 1
+   @param user_arg the pointer passed to evconnlistener_set_batch_cb()
+ */
+typedef void (*evconnlistener_batch_cb)(struct evconnlistener *,
+    struct evconnlistener_conn *conns, int n_conns, void *);
+
 /**
    A callback that we invoke when a listener encounters a non-retriable error.
 
@@ -180,11 +208,97 @@ EVENT2_EXPORT_SYMBOL
 void evconnlistener_set_cb(struct evconnlistener *lev,
     evconnlistener_cb cb, void *arg);
 
+/**
+   Replace the callback on the listener with a batch callback.
+
+   Rather than calling a callback for every connection, the listener
+   accepts as many connections as are waiting (up to 64, and up to the
+   accept budget) and hands them all to cb at once.  Setting a callback
+   with evconnlistener_set_cb() turns batching off again.
+
+   @return 0 on success, -1 if we couldn't allocate space for the batch.
+ */
+EVENT2_EXPORT_SYMBOL
+int evconnlistener_set_batch_cb(struct evconnlistener *lev,
+    evconnlistener_batch_cb cb, void *arg);
+
+/**
+   Limit how many connections the listener accepts each time its socket
+   becomes readable.
+
+   Without a limit, a flood of connections keeps the listener accepting
+   until the backlog is empty, and no other event on the base runs in the
+   meantime.  With one, the rest of the backlog waits for the next pass
+   through the event loop.
+
+   @param budget The most connections to accept per wakeup, or 0 for no
+      limit (the default).
+ */
+EVENT2_EXPORT_SYMBOL
+void evconnlistener_set_accept_budget(struct evconnlistener *lev,
+    int budget);
+
 /** Set an evconnlistener's error callback. */
 EVENT2_EXPORT_SYMBOL
 void evconnlistener_set_error_cb(struct evconnlistener *lev,
     evconnlistener_errorcb errorcb);
 
+/**
+   A set of evconnlistener objects, one per event_base, that all listen on
+   the same address.
+ */
+struct evconnlistener_group;
+
+/**
+   Allocate one evconnlistener on each of a set of event bases, all bound to
+   the same address.
+
+   Each listener has its own socket with SO_REUSEPORT set, so the kernel
+   balances incoming connections between them: there's no shared accept
+   lock, and a connection wakes up only one of the bases.  This is meant
+   for running one event_base per core, as with event_base_group_new().
+   The callback for a connection runs in the thread of the base whose
+   listener accepted it.
+
+   LEV_OPT_REUSEABLE_PORT and LEV_OPT_THREADSAFE are always set.  If the
+   port in 'sa' is 0, every listener uses the port picked for the first.
+   This fails on platforms that don't support SO_REUSEPORT load balancing.
+
+   @param bases The event bases to listen on.
+   @param n_bases The number of bases in 'bases'.
+   @param cb, ptr, flags, backlog, sa, socklen As for
+      evconnlistener_new_bind().
+   @return a new evconnlistener_group, or NULL on error.
+ */
+EVENT2_EXPORT_SYMBOL
+struct evconnlistener_group *evconnlistener_group_new_bind(
+    struct event_base **bases, int n_bases, evconnlistener_cb cb, void *ptr,
+    unsigned flags, int backlog, const struct sockaddr *sa, int socklen);
+/**
+   Disable and deallocate every listener in an evconnlistener_group.
+ */
+EVENT2_EXPORT_SYMBOL
+void evconnlistener_group_free(struct evconnlistener_group *lg);
+/**
+   Re-enable every listener in an evconnlistener_group.
+ */
+EVENT2_EXPORT_SYMBOL
+int evconnlistener_group_enable(struct evconnlistener_group *lg);
+/**
+   Stop listening for connections on every listener in an
+   evconnlistener_group.
+ */
+EVENT2_EXPORT_SYMBOL
+int evconnlistener_group_disable(struct evconnlistener_group *lg);
+/** Return the number of listeners in an evconnlistener_group. */
+EVENT2_EXPORT_SYMBOL
+int evconnlistener_group_get_n_listeners(struct evconnlistener_group *lg);
+/** Return the idx'th listener in an evconnlistener_group, or NULL if there
+    is no such listener. */
+EVENT2_EXPORT_SYMBOL
+struct evconnlistener *evconnlistener_group_get_listener(
+    struct evconnlistener_group *lg, int idx);
+
 #ifdef __cplusplus
 }
 #endif
@@ -234,6 +234,123 @@ int evthread_use_pthreads(void);
 /** Defined if Libevent was built with support for evthread_use_pthreads() */
 #define EVTHREAD_USE_PTHREADS_IMPLEMENTED 1
 
+/**
+   A set of event bases, each run by its own thread.
+
+   @see event_base_group_new()
+ */
+struct event_base_group;
+struct event_base;
+struct event_config;
+
+/** Flag for event_base_group_new(): don't pin the threads to CPUs. */
+#define EVENT_BASE_GROUP_NO_AFFINITY 0x01
+
+/**
+   Create a group of event bases, each with a thread of its own that runs
+   event_base_loop() on it until the group is freed.
+
+   Unless EVENT_BASE_GROUP_NO_AFFINITY is given, the threads are pinned
+   round-robin to the CPUs that this process may run on, where the platform
+   supports it.  This calls evthread_use_pthreads(), since the bases are
+   shared between threads.
+
+   To spread a listening socket across the group, see
+   evconnlistener_group_new_bind().
+
+   @param cfg The configuration for every base, or NULL.  It must not set
+      EVENT_BASE_FLAG_NOLOCK.
+   @param n_bases The number of bases and threads, or 0 for one per CPU.
+   @param flags Zero or more EVENT_BASE_GROUP_* flags.
+   @return a new event_base_group, or NULL on error.
+ */
+EVENT2_EXPORT_SYMBOL
+struct event_base_group *event_base_group_new(const struct event_config *cfg,
+    int n_bases, unsigned flags);
+/** Return the number of event bases in an event_base_group. */
+EVENT2_EXPORT_SYMBOL
+int event_base_group_get_n_bases(struct event_base_group *grp);
+/** Return the idx'th event base of an event_base_group, or NULL if there is
+    no such base. */
+EVENT2_EXPORT_SYMBOL
+struct event_base *event_base_group_get_base(struct event_base_group *grp,
+    int idx);
+/** Return an array of the event_base_group_get_n_bases() event bases in an
+    event_base_group.  The array belongs to the group. */
+EVENT2_EXPORT_SYMBOL
+struct event_base **event_base_group_get_bases(struct event_base_group *grp);
+/**
+   Stop the threads of an event_base_group and wait for them to exit.  The
+   event bases stay allocated, but nothing runs their loops any more, so
+   objects that use them can be freed safely from this thread.
+ */
+EVENT2_EXPORT_SYMBOL
+void event_base_group_stop(struct event_base_group *grp);
+/**
+   Stop the threads of an event_base_group if they are still running, wait
+   for them to exit, and free the group and its event bases.  Free anything
+   else that uses the bases, such as listeners, first.
+ */
+EVENT2_EXPORT_SYMBOL
+void event_base_group_free(struct event_base_group *grp);
+
+/**
+   A set of worker threads that run slow callbacks off the event loop.
+
+   @see evthread_pool_new()
+ */
+struct evthread_pool;
+
+/** A function that an evthread_pool runs on one of its worker threads. */
+typedef void (*evthread_pool_work_cb)(void *arg);
+/** A function that an evthread_pool runs on the submitting event base once
+    the work for the same task is done. */
+typedef void (*evthread_pool_done_cb)(void *arg);
+
+/**
+   Create a pool of worker threads.
+
+   Each worker keeps its own queue of tasks, and idle workers steal tasks
+   from the others, so threads that submit at the same time seldom contend
+   for a lock.  The pool uses the lock and condition callbacks that were
+   installed with evthread_use_pthreads() or evthread_set_lock_callbacks();
+   it fails if there are none.
+
+   @param n_threads The number of worker threads, or 0 for one per CPU.
+   @return a new evthread_pool, or NULL on error.
+ */
+EVENT2_EXPORT_SYMBOL
+struct evthread_pool *evthread_pool_new(int n_threads);
+/** Return the number of worker threads in an evthread_pool. */
+EVENT2_EXPORT_SYMBOL
+int evthread_pool_get_n_threads(struct evthread_pool *pool);
+/**
+   Run a task on an evthread_pool.
+
+   work_cb runs on a worker thread.  When it returns, done_cb runs on
+   'base', from its event loop.  Until then, the task counts as an event
+   on 'base', so event_base_dispatch() doesn't return while it is pending.
+
+   @param pool The pool to run the task.
+   @param base The event base to run done_cb on.
+   @param work_cb The function to run on a worker thread.
+   @param done_cb The function to run on 'base' afterwards, or NULL.
+   @param arg The argument for both functions.
+   @return 0 on success, -1 on failure.
+ */
+EVENT2_EXPORT_SYMBOL
+int evthread_pool_submit(struct evthread_pool *pool, struct event_base *base,
+    evthread_pool_work_cb work_cb, evthread_pool_done_cb done_cb, void *arg);
+/**
+   Wait for an evthread_pool to finish the work it was given, stop its
+   threads, and free it.
+
+   The done callbacks of the tasks that finish during the wait still run on
+   their event bases, so those must outlive the pool's last tasks.
+ */
+EVENT2_EXPORT_SYMBOL
+void evthread_pool_free(struct evthread_pool *pool);
+
 #endif
 
 /** Enable debugging wrappers around the current lock callbacks.  If Libevent
@@ -264,6 +381,106 @@ struct event_base;
 EVENT2_EXPORT_SYMBOL
 int evthread_make_base_notifiable(struct event_base *base);
 
+/**
+   A bounded queue of pointers, sent from any thread and delivered in
+   batches by the event base of the receiving thread.
+
+   Sending takes no lock and makes no syscall unless the queue was empty
+   and the receiving base has to be woken up.  Each sender's messages are
+   delivered in the order it sent them.
+
+   @see event_channel_new()
+ */
+struct event_channel;
+
+/**
+   A callback that we invoke on the receiving event base with messages
+   taken off an event_channel.
+
+   @param chan The event_channel
+   @param msgs The messages, oldest first.  The array belongs to the channel
+      and is only valid until the callback returns.
+   @param n_msgs The number of entries in msgs; at least 1
+   @param arg the pointer passed to event_channel_new()
+ */
+typedef void (*event_channel_recv_cb)(struct event_channel *chan,
+    void **msgs, int n_msgs, void *arg);
+
+/**
+   A callback that we invoke on a sending event base once a full
+   event_channel has drained enough to take messages again.
+
+   @param chan The event_channel
+   @param arg the pointer passed to event_channel_set_space_cb()
+ */
+typedef void (*event_channel_space_cb)(struct event_channel *chan, void *arg);
+
+/**
+   Create an event_channel that delivers its messages on a given event base.
+
+   The receiving base is made notifiable, so it needs thread support if the
+   messages come from other threads.
+
+   @param base The event base that runs the receive callback.
+   @param capacity The most messages that can wait in the channel.  It is
+      rounded up to a power of two, and to at least 2.
+   @param cb The callback to invoke with the messages.
+   @param arg An argument to pass to the callback.
+   @return a new event_channel, or NULL on error.
+ */
+EVENT2_EXPORT_SYMBOL
+struct event_channel *event_channel_new(struct event_base *base,
+    unsigned capacity, event_channel_recv_cb cb, void *arg);
+
+/**
+   Ask for a callback on a sending event base when a full channel drains.
+
+   After a send fails because the channel is full, cb runs on 'base' once
+   the receiver has taken at least half of the messages out.  Senders that
+   aren't run by an event base can poll instead.  Set this up before
+   anything sends on the channel.  Waiting for the callback does not by
+   itself keep event_base_dispatch() on 'base' from returning.
+
+   @param chan The event_channel
+   @param base The event base of the sending thread, or NULL to remove the
+      callback.
+   @param cb The callback to invoke.
+   @param arg An argument to pass to the callback.
+   @return 0 on success, -1 on failure.
+ */
+EVENT2_EXPORT_SYMBOL
+int event_channel_set_space_cb(struct event_channel *chan,
+    struct event_base *base, event_channel_space_cb cb, void *arg);
+
+/**
+   Send one message on an event_channel.
+
+   @return 0 on success, or -1 if the channel is full.
+ */
+EVENT2_EXPORT_SYMBOL
+int event_channel_send(struct event_channel *chan, void *msg);
+
+/**
+   Send several messages on an event_channel, waking its receiver at most
+   once.
+
+   @return the number of messages from the front of 'msgs' that were sent.
+      If it is less than n_msgs, the channel is full.
+ */
+EVENT2_EXPORT_SYMBOL
+int event_channel_send_batch(struct event_channel *chan, void **msgs,
+    int n_msgs);
+
+/**
+   Free an event_channel.
+
+   Nothing may send on the channel any more, and this must not be called
+   from one of its callbacks.  Messages that were never delivered are
+   dropped.
+ */
+EVENT2_EXPORT_SYMBOL
+void event_channel_free(struct event_channel *chan);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,642 @@
+/*
+ * Copyright 2000-2007 Niels Provos <provos@citi.umich.edu>
+ * Copyright 2007-2012 Niels Provos, Nick Mathewson
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "event2/event-config.h"
+#include "evconfig-private.h"
+
+#ifdef EVENT__HAVE_IO_URING
+
+#include <stdint.h>
+#include <sys/types.h>
+#ifdef EVENT__HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+#include <sys/queue.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <endian.h>
+
+#include "event-internal.h"
+#include "evsignal-internal.h"
+#include "event2/thread.h"
+#include "evthread-internal.h"
+#include "log-internal.h"
+#include "evmap-internal.h"
+#include "changelist-internal.h"
+#include "defer-internal.h"
+#include "uring-internal.h"
+
+#ifndef POLLRDHUP
+#define POLLRDHUP 0
+#endif
+
+/*
+  This backend uses io_uring(7) as a readiness notifier: every fd with
+  enabled events has one one-shot IORING_OP_POLL_ADD request in flight.
+  Interest changes are collected in the base's changelist, turned into
+  POLL_REMOVE/POLL_ADD submission entries at dispatch time, and handed to
+  the kernel together with the wait in a single io_uring_enter() call.
+
+  One-shot polls give us level-triggered semantics: when a poll completes,
+  we queue a fresh POLL_ADD for the same fd, which will go to the kernel
+  with the next io_uring_enter() -- after the callbacks have had a chance
+  to consume the data.
+
+  The same ring also carries the completion-based operations described in
+  uring-internal.h.  Their user_data is the address of their struct
+  event_uring_op, which is always even; the user_data of our own poll
+  requests always has its low bit set.
+ */
+
+/* Number of submission queue entries we ask the kernel for.  If we need more
+ * than this in a single dispatch, we flush the queue early. */
+#define URING_NENTRIES 1024
+
+/* user_data value for requests whose completions we don't care about. */
+#define URING_UDATA_IGNORE (~(ev_uint64_t)0)
+
+#define URING_UDATA(fd, gen)						\
+	((((ev_uint64_t)(ev_uint32_t)(fd)) << 32) |			\
+	    (((ev_uint64_t)(gen) << 1) & 0xffffffff) | 1)
+#define URING_UDATA_IS_OP(ud) (((ud) & 1) == 0)
+#define URING_UDATA_FD(ud) ((evutil_socket_t)((ud) >> 32))
+#define URING_UDATA_GEN(ud) ((ev_uint32_t)(((ud) & 0xffffffff) >> 1))
+#define URING_GEN_MASK 0x7fffffff
+
+/* Per-fd information, stored in the evmap after the struct evmap_io. */
+struct uring_fdinfo {
+	/* Used by the changelist code; it must come first, since the
+	 * changelist treats our fdinfo as a struct event_changelist_fdinfo. */
+	int changelist_idxplus1;
+	/* Generation number (31 bits) of the poll request we currently have
+	 * armed for this fd.  Completions for any other generation are
+	 * stale. */
+	ev_uint32_t gen;
+	/* True iff a poll request of generation 'gen' is in flight. */
+	ev_uint8_t armed;
+	/* The EV_READ/EV_WRITE/EV_CLOSED events enabled on this fd. */
+	short events;
+};
+
+//io_uring实例：共享的提交队列(SQ)和完成队列(CQ)
+struct uringop {
+	int ring_fd;
+
+	/* Submission queue, shared with the kernel. */
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_array;
+	unsigned sq_mask;
+	unsigned sq_entries;
+	struct io_uring_sqe *sqes;
+	/* Number of entries we have queued but not yet given to the kernel */
+	unsigned sq_pending;
+
+	/* Completion queue, shared with the kernel. */
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned cq_mask;
+	struct io_uring_cqe *cqes;
+
+	void *sq_ring;
+	size_t sq_ring_sz;
+	void *cq_ring;
+	size_t cq_ring_sz;
+	size_t sqes_sz;
+};
+
+static void *uring_init(struct event_base *);
+static int uring_dispatch(struct event_base *, struct timeval *);
+static void uring_dealloc(struct event_base *);
+
+const struct eventop uringops = {
+	"io_uring",
+	uring_init,
+	event_changelist_add_,
+	event_changelist_del_,
+	uring_dispatch,
+	uring_dealloc,
+	1, /* need reinit */
+	EV_FEATURE_O1|EV_FEATURE_EARLY_CLOSE,
+	sizeof(struct uring_fdinfo)
+};
+
+static int
+sys_io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+	return (int) syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int
+sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+    unsigned flags, void *arg, size_t argsz)
+{
+	return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+	    flags, arg, argsz);
+}
+
+static void
+uring_unmap(struct uringop *uop)
+{
+	if (uop->sqes)
+		munmap(uop->sqes, uop->sqes_sz);
+	if (uop->cq_ring && uop->cq_ring != uop->sq_ring)
+		munmap(uop->cq_ring, uop->cq_ring_sz);
+	if (uop->sq_ring)
+		munmap(uop->sq_ring, uop->sq_ring_sz);
+}
+
+static void *
+uring_init(struct event_base *base)
+{
+	struct io_uring_params p;
+	struct uringop *uop;
+	char *sq_ring, *cq_ring;
+	unsigned i;
+	int fd;
+
+	memset(&p, 0, sizeof(p));
+	if ((fd = sys_io_uring_setup(URING_NENTRIES, &p)) == -1) {
+		if (errno != ENOSYS && errno != EPERM)
+			event_warn("io_uring_setup");
+		return (NULL);
+	}
+
+	/* We rely on the kernel never dropping completions, and on being
+	 * able to pass a timeout to io_uring_enter directly. */
+	if (!(p.features & IORING_FEAT_NODROP) ||
+	    !(p.features & IORING_FEAT_EXT_ARG)) {
+		event_debug(("%s: kernel io_uring is too old", __func__));
+		close(fd);
+		return (NULL);
+	}
+
+	if (!(uop = mm_calloc(1, sizeof(struct uringop)))) {
+		close(fd);
+		return (NULL);
+	}
+	uop->ring_fd = fd;
+
+	uop->sq_ring_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	uop->cq_ring_sz = p.cq_off.cqes +
+	    p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (uop->cq_ring_sz > uop->sq_ring_sz)
+			uop->sq_ring_sz = uop->cq_ring_sz;
+		uop->cq_ring_sz = uop->sq_ring_sz;
+	}
+
+	uop->sq_ring = mmap(NULL, uop->sq_ring_sz, PROT_READ|PROT_WRITE,
+	    MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (uop->sq_ring == MAP_FAILED) {
+		uop->sq_ring = NULL;
+		goto err;
+	}
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		uop->cq_ring = uop->sq_ring;
+	} else {
+		uop->cq_ring = mmap(NULL, uop->cq_ring_sz,
+		    PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd,
+		    IORING_OFF_CQ_RING);
+		if (uop->cq_ring == MAP_FAILED) {
+			uop->cq_ring = NULL;
+			goto err;
+		}
+	}
+	uop->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+	uop->sqes = mmap(NULL, uop->sqes_sz, PROT_READ|PROT_WRITE,
+	    MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (uop->sqes == MAP_FAILED) {
+		uop->sqes = NULL;
+		goto err;
+	}
+
+	sq_ring = uop->sq_ring;
+	uop->sq_head = (unsigned *)(sq_ring + p.sq_off.head);
+	uop->sq_tail = (unsigned *)(sq_ring + p.sq_off.tail);
+	uop->sq_array = (unsigned *)(sq_ring + p.sq_off.array);
+	uop->sq_mask = *(unsigned *)(sq_ring + p.sq_off.ring_mask);
+	uop->sq_entries = *(unsigned *)(sq_ring + p.sq_off.ring_entries);
+
+	cq_ring = uop->cq_ring;
+	uop->cq_head = (unsigned *)(cq_ring + p.cq_off.head);
+	uop->cq_tail = (unsigned *)(cq_ring + p.cq_off.tail);
+	uop->cq_mask = *(unsigned *)(cq_ring + p.cq_off.ring_mask);
+	uop->cqes = (struct io_uring_cqe *)(cq_ring + p.cq_off.cqes);
+
+	/* We always fill the SQEs in ring order, so the indirection array
+	 * can be the identity mapping. */
+	for (i = 0; i < uop->sq_entries; ++i)
+		uop->sq_array[i] = i;
+
+	if ((base->flags & EVENT_BASE_FLAG_IGNORE_ENV) == 0 &&
+	    evutil_getenv_("EVENT_IO_URING_COMPLETION") != NULL)
+		base->flags |= EVENT_BASE_FLAG_IO_URING_COMPLETION;
+
+	evsig_init_(base);
+
+	return (uop);
+err:
+	event_warn("mmap(io_uring)");
+	uring_unmap(uop);
+	close(fd);
+	mm_free(uop);
+	return (NULL);
+}
+
+/* Hand every queued submission entry to the kernel without waiting for any
+ * completions.  Returns 0 on success, -1 on failure. */
+static int
+uring_flush(struct uringop *uop)
+{
+	while (uop->sq_pending) {
+		int n = sys_io_uring_enter(uop->ring_fd, uop->sq_pending, 0,
+		    0, NULL, 0);
+		if (n == -1) {
+			if (errno == EINTR)
+				continue;
+			event_warn("io_uring_enter");
+			return (-1);
+		}
+		uop->sq_pending -= n;
+	}
+	return (0);
+}
+
+/* Return a zeroed submission queue entry, flushing the queue to the kernel
+ * if it is full.  Returns NULL on failure. */
+static struct io_uring_sqe *
+uring_get_sqe(struct uringop *uop)
+{
+	struct io_uring_sqe *sqe;
+	unsigned tail = *uop->sq_tail;
+
+	if (tail - __atomic_load_n(uop->sq_head, __ATOMIC_ACQUIRE) >=
+	    uop->sq_entries) {
+		if (uring_flush(uop) < 0)
+			return (NULL);
+	}
+
+	sqe = &uop->sqes[tail & uop->sq_mask];
+	memset(sqe, 0, sizeof(*sqe));
+	__atomic_store_n(uop->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	++uop->sq_pending;
+	return (sqe);
+}
+
+static ev_uint32_t
+events_to_poll_mask(short events)
+{
+	ev_uint32_t mask = 0;
+	if (events & EV_READ)
+		mask |= POLLIN;
+	if (events & EV_WRITE)
+		mask |= POLLOUT;
+	if (events & EV_CLOSED)
+		mask |= POLLRDHUP;
+#if __BYTE_ORDER == __BIG_ENDIAN
+	/* The kernel reads poll32_events as two swapped 16-bit halves. */
+	mask = (mask << 16) | (mask >> 16);
+#endif
+	return mask;
+}
+
+/* Queue a poll request for the events enabled on 'fd'. */
+static int
+uring_arm(struct uringop *uop, evutil_socket_t fd, struct uring_fdinfo *fdi)
+{
+	struct io_uring_sqe *sqe;
+
+	EVUTIL_ASSERT(!fdi->armed);
+	if (!(sqe = uring_get_sqe(uop)))
+		return (-1);
+	fdi->gen = (fdi->gen + 1) & URING_GEN_MASK;
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = fd;
+	sqe->poll32_events = events_to_poll_mask(fdi->events);
+	sqe->user_data = URING_UDATA(fd, fdi->gen);
+	fdi->armed = 1;
+	return (0);
+}
+
+/* Queue the cancellation of the poll request currently armed for 'fd'. */
+static int
+uring_disarm(struct uringop *uop, evutil_socket_t fd, struct uring_fdinfo *fdi)
+{
+	struct io_uring_sqe *sqe;
+
+	EVUTIL_ASSERT(fdi->armed);
+	if (!(sqe = uring_get_sqe(uop)))
+		return (-1);
+	sqe->opcode = IORING_OP_POLL_REMOVE;
+	sqe->fd = -1;
+	sqe->addr = URING_UDATA(fd, fdi->gen);
+	sqe->user_data = URING_UDATA_IGNORE;
+	fdi->armed = 0;
+	return (0);
+}
+
+static int
+uring_apply_one_change(struct event_base *base, struct uringop *uop,
+    const struct event_change *ch)
+{
+	struct uring_fdinfo *fdi;
+	short events = ch->old_events;
+
+	if (ch->read_change & EV_CHANGE_ADD)
+		events |= EV_READ;
+	else if (ch->read_change & EV_CHANGE_DEL)
+		events &= ~EV_READ;
+	if (ch->write_change & EV_CHANGE_ADD)
+		events |= EV_WRITE;
+	else if (ch->write_change & EV_CHANGE_DEL)
+		events &= ~EV_WRITE;
+	if (ch->close_change & EV_CHANGE_ADD)
+		events |= EV_CLOSED;
+	else if (ch->close_change & EV_CHANGE_DEL)
+		events &= ~EV_CLOSED;
+
+	fdi = evmap_io_get_fdinfo_(&base->io, ch->fd);
+	EVUTIL_ASSERT(fdi);
+
+	/* A poll request holds a reference to the file it was armed on, not
+	 * to the fd number.  Since an add may mean that the fd was closed and
+	 * reopened since we armed it, we always rearm on any change. */
+	if (fdi->armed && uring_disarm(uop, ch->fd, fdi) < 0)
+		return (-1);
+	fdi->events = events & (EV_READ|EV_WRITE|EV_CLOSED);
+	if (fdi->events && uring_arm(uop, ch->fd, fdi) < 0)
+		return (-1);
+	return (0);
+}
+
+static int
+uring_apply_changes(struct event_base *base)
+{
+	struct event_changelist *changelist = &base->changelist;
+	struct uringop *uop = base->evbase;
+	int i, r = 0;
+
+	for (i = 0; i < changelist->n_changes; ++i) {
+		const struct event_change *ch = &changelist->changes[i];
+		if (!(ch->read_change|ch->write_change|ch->close_change))
+			continue;
+		if (uring_apply_one_change(base, uop, ch) < 0)
+			r = -1;
+	}
+
+	return (r);
+}
+
+static void
+uring_process_cqe(struct event_base *base, struct uringop *uop,
+    const struct io_uring_cqe *cqe)
+{
+	struct uring_fdinfo *fdi;
+	evutil_socket_t fd;
+	ev_uint32_t what;
+	short ev = 0;
+
+	if (cqe->user_data == URING_UDATA_IGNORE)
+		return;
+
+	if (URING_UDATA_IS_OP(cqe->user_data)) {
+		struct event_uring_op *op =
+		    (struct event_uring_op *)(ev_uintptr_t)cqe->user_data;
+		op->res = cqe->res;
+		event_callback_activate_nolock_(base, &op->cb);
+		return;
+	}
+
+	fd = URING_UDATA_FD(cqe->user_data);
+	if (fd < 0 || fd >= base->io.nentries)
+		return;
+	fdi = evmap_io_get_fdinfo_(&base->io, fd);
+	if (!fdi || !fdi->armed || fdi->gen != URING_UDATA_GEN(cqe->user_data))
+		return; /* stale: it was cancelled or superseded. */
+	fdi->armed = 0;
+
+	if (cqe->res < 0) {
+		/* Don't rearm: the fd is probably closed.  The next change
+		 * on this fd will try again. */
+		if (cqe->res != -ECANCELED)
+			event_debug(("%s: poll on fd %d failed: %s", __func__,
+				(int)fd, strerror(-cqe->res)));
+		return;
+	}
+
+	what = (ev_uint32_t)cqe->res;
+	if (what & (POLLHUP|POLLERR|POLLNVAL)) {
+		ev = EV_READ | EV_WRITE;
+	} else {
+		if (what & POLLIN)
+			ev |= EV_READ;
+		if (what & POLLOUT)
+			ev |= EV_WRITE;
+		if (what & POLLRDHUP)
+			ev |= EV_CLOSED;
+	}
+
+	if (fdi->events && uring_arm(uop, fd, fdi) < 0)
+		event_warnx("%s: couldn't rearm poll on fd %d", __func__, (int)fd);
+
+	if (ev)
+		evmap_io_active_(base, fd, ev);
+}
+
+static int
+uring_dispatch(struct event_base *base, struct timeval *tv)
+{
+	struct uringop *uop = base->evbase;
+	struct io_uring_getevents_arg arg;
+	struct __kernel_timespec ts;
+	unsigned head, tail, to_submit;
+	int res;
+
+	uring_apply_changes(base);
+	event_changelist_remove_all_(&base->changelist, base);
+
+	memset(&arg, 0, sizeof(arg));
+	arg.sigmask_sz = _NSIG / 8;
+	if (tv != NULL) {
+		ts.tv_sec = tv->tv_sec;
+		ts.tv_nsec = tv->tv_usec * 1000;
+		arg.ts = (ev_uint64_t)(uintptr_t)&ts;
+	}
+
+	/* Submit all queued changes and wait, all in one system call. */
+	to_submit = uop->sq_pending;
+	uop->sq_pending = 0;
+
+	EVBASE_RELEASE_LOCK(base, th_base_lock);
+
+	res = sys_io_uring_enter(uop->ring_fd, to_submit, 1,
+	    IORING_ENTER_GETEVENTS|IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+
+	EVBASE_ACQUIRE_LOCK(base, th_base_lock);
+
+	if (res == -1) {
+		/* ETIME means the timeout expired; EBUSY means that the
+		 * kernel wants us to reap completions before it will take
+		 * more submissions. */
+		if (errno != EINTR && errno != ETIME && errno != EBUSY &&
+		    errno != EAGAIN) {
+			event_warn("io_uring_enter");
+			return (-1);
+		}
+		if (errno != ETIME)
+			uop->sq_pending += to_submit;
+	} else if ((unsigned)res < to_submit) {
+		uop->sq_pending += to_submit - res;
+	}
+
+	head = *uop->cq_head;
+	tail = __atomic_load_n(uop->cq_tail, __ATOMIC_ACQUIRE);
+	event_debug(("%s: io_uring reports %u completions", __func__,
+		tail - head));
+
+	for (; head != tail; ++head)
+		uring_process_cqe(base, uop, &uop->cqes[head & uop->cq_mask]);
+
+	__atomic_store_n(uop->cq_head, head, __ATOMIC_RELEASE);
+
+	return (0);
+}
+
+static void
+uring_op_done_cb(struct event_callback *cb, void *arg)
+{
+	struct event_uring_op *op = arg;
+	op->complete(op, op->res);
+}
+
+void
+event_uring_op_init_(struct event_base *base, struct event_uring_op *op,
+    uring_callback cb)
+{
+	memset(op, 0, sizeof(*op));
+	event_deferred_cb_init_(&op->cb, event_base_get_npriorities(base) / 2,
+	    uring_op_done_cb, op);
+	op->complete = cb;
+}
+
+int
+event_base_uring_completion_enabled_(struct event_base *base)
+{
+	return base->evsel == &uringops &&
+	    (base->flags & EVENT_BASE_FLAG_IO_URING_COMPLETION);
+}
+
+/* Helper: queue a submission for 'op', filled in by 'prep'.  If the loop is
+ * running in another thread, hand the request to the kernel right away;
+ * otherwise, it goes out with the next dispatch. */
+static int
+uring_submit_op(struct event_base *base, struct event_uring_op *op,
+    ev_uint8_t opcode, evutil_socket_t fd, ev_uint64_t addr, ev_uint32_t len,
+    ev_uint32_t flags)
+{
+	struct uringop *uop;
+	struct io_uring_sqe *sqe;
+	int r = -1;
+
+	EVBASE_ACQUIRE_LOCK(base, th_base_lock);
+	if (base->evsel != &uringops)
+		goto done;
+	uop = base->evbase;
+	if (!(sqe = uring_get_sqe(uop)))
+		goto done;
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->addr = addr;
+	sqe->len = len;
+	if (opcode == IORING_OP_POLL_ADD)
+		sqe->poll32_events = flags;
+	else if (opcode == IORING_OP_READV || opcode == IORING_OP_WRITEV)
+		sqe->off = (ev_uint64_t)-1; /* use (and update) the file position */
+	sqe->user_data = op ? (ev_uint64_t)(ev_uintptr_t)op :
+	    URING_UDATA_IGNORE;
+	r = 0;
+	if (EVBASE_NEED_NOTIFY(base))
+		r = uring_flush(uop);
+done:
+	EVBASE_RELEASE_LOCK(base, th_base_lock);
+	return r;
+}
+
+int
+event_uring_readv_(struct event_base *base, evutil_socket_t fd,
+    struct evbuffer_iovec *vecs, int n_vecs, struct event_uring_op *op)
+{
+	return uring_submit_op(base, op, IORING_OP_READV, fd,
+	    (ev_uint64_t)(ev_uintptr_t)vecs, n_vecs, 0);
+}
+
+int
+event_uring_writev_(struct event_base *base, evutil_socket_t fd,
+    struct evbuffer_iovec *vecs, int n_vecs, struct event_uring_op *op)
+{
+	return uring_submit_op(base, op, IORING_OP_WRITEV, fd,
+	    (ev_uint64_t)(ev_uintptr_t)vecs, n_vecs, 0);
+}
+
+int
+event_uring_poll_(struct event_base *base, evutil_socket_t fd,
+    short what, struct event_uring_op *op)
+{
+	return uring_submit_op(base, op, IORING_OP_POLL_ADD, fd, 0, 0,
+	    events_to_poll_mask(what & (EV_READ|EV_WRITE)));
+}
+
+int
+event_uring_cancel_(struct event_base *base, struct event_uring_op *op)
+{
+	return uring_submit_op(base, NULL, IORING_OP_ASYNC_CANCEL, -1,
+	    (ev_uint64_t)(ev_uintptr_t)op, 0, 0);
+}
+
+static void
+uring_dealloc(struct event_base *base)
+{
+	struct uringop *uop = base->evbase;
+
+	evsig_dealloc_(base);
+	uring_unmap(uop);
+	if (uop->ring_fd >= 0)
+		close(uop->ring_fd);
+
+	memset(uop, 0, sizeof(struct uringop));
+	mm_free(uop);
+}
+
+#endif /* EVENT__HAVE_IO_URING */
@@ -73,18 +73,29 @@ struct evconnlistener_ops {
 	struct event_base *(*getbase)(struct evconnlistener *);
 };
 
+/* How many connections we hand to a batch callback at once. */
+#define LISTENER_BATCH_MAX 64
+
 struct evconnlistener {
 	const struct evconnlistener_ops *ops;
 	void *lock;
 	evconnlistener_cb cb;
+	evconnlistener_batch_cb batch_cb;
 	evconnlistener_errorcb errorcb;
 	void *user_data;
 	unsigned flags;
 	short refcnt;
 	int accept4_flags;
+	/* Most connections to accept per wakeup, or 0 for no limit. */
+	int accept_budget;
+	/* LISTENER_BATCH_MAX slots for batch_cb, allocated with it. */
+	struct evconnlistener_conn *batch;
+	struct sockaddr_storage *batch_addrs;
 	unsigned enabled : 1;
 };
 
+#define LISTENER_HAS_CB(lev) ((lev)->cb != NULL || (lev)->batch_cb != NULL)
+
 struct evconnlistener_event {
 	struct evconnlistener base;
 	struct event listener;
@@ -134,6 +145,8 @@ listener_decref_and_unlock(struct evconnlistener *listener)
 		listener->ops->destroy(listener);
 		UNLOCK(listener);
 		EVTHREAD_FREE_LOCK(listener->lock, EVTHREAD_LOCKTYPE_RECURSIVE);
+		mm_free(listener->batch);
+		mm_free(listener->batch_addrs);
 		mm_free(listener);
 		return 1;
 	} else {
@@ -271,6 +284,7 @@ evconnlistener_free(struct evconnlistener *lev)
 {
 	LOCK(lev);
 	lev->cb = NULL;
+	lev->batch_cb = NULL;
 	lev->errorcb = NULL;
 	if (lev->ops->shutdown)
 		lev->ops->shutdown(lev);
@@ -295,7 +309,7 @@ evconnlistener_enable(struct evconnlistener *lev)
 	int r;
 	LOCK(lev);
 	lev->enabled = 1;
-	if (lev->cb)
+	if (LISTENER_HAS_CB(lev))
 		r = lev->ops->enable(lev);
 	else
 		r = 0;
@@ -372,13 +386,53 @@ evconnlistener_set_cb(struct evconnlistener *lev,
 {
 	int enable = 0;
 	LOCK(lev);
-	if (lev->enabled && !lev->cb)
+	if (lev->enabled && !LISTENER_HAS_CB(lev))
 		enable = 1;
 	lev->cb = cb;
+	lev->batch_cb = NULL;
+	lev->user_data = arg;
+	if (enable)
+		evconnlistener_enable(lev);
+	UNLOCK(lev);
+}
+
+int
+evconnlistener_set_batch_cb(struct evconnlistener *lev,
+    evconnlistener_batch_cb cb, void *arg)
+{
+	int enable = 0;
+	LOCK(lev);
+	if (cb && !lev->batch) {
+		lev->batch = mm_calloc(LISTENER_BATCH_MAX,
+		    sizeof(struct evconnlistener_conn));
+		lev->batch_addrs = mm_calloc(LISTENER_BATCH_MAX,
+		    sizeof(struct sockaddr_storage));
+		if (!lev->batch || !lev->batch_addrs) {
+			mm_free(lev->batch);
+			mm_free(lev->batch_addrs);
+			lev->batch = NULL;
+			lev->batch_addrs = NULL;
+			UNLOCK(lev);
+			return -1;
+		}
+	}
+	if (lev->enabled && !LISTENER_HAS_CB(lev))
+		enable = 1;
+	lev->cb = NULL;
+	lev->batch_cb = cb;
 	lev->user_data = arg;
 	if (enable)
 		evconnlistener_enable(lev);
 	UNLOCK(lev);
+	return 0;
+}
+
+void
+evconnlistener_set_accept_budget(struct evconnlistener *lev, int budget)
+{
+	LOCK(lev);
+	lev->accept_budget = budget > 0 ? budget : 0;
+	UNLOCK(lev);
 }
 
 void
@@ -390,21 +444,193 @@ evconnlistener_set_error_cb(struct evconnlistener *lev,
 	UNLOCK(lev);
 }
 
+struct evconnlistener_group {
+	int n_listeners;
+	struct evconnlistener **listeners;
+};
+
+struct evconnlistener_group *
+evconnlistener_group_new_bind(struct event_base **bases, int n_bases,
+    evconnlistener_cb cb, void *ptr, unsigned flags, int backlog,
+    const struct sockaddr *sa, int socklen)
+{
+	struct evconnlistener_group *lg;
+	struct sockaddr_storage ss;
+	ev_socklen_t sslen;
+	int i;
+
+	if (n_bases <= 0 || !sa)
+		return NULL;
+
+	/* Every base gets its own socket, and the kernel spreads incoming
+	 * connections between them. */
+	flags |= LEV_OPT_REUSEABLE_PORT | LEV_OPT_THREADSAFE;
+
+	if (!(lg = mm_calloc(1, sizeof(*lg))))
+		return NULL;
+	if (!(lg->listeners = mm_calloc(n_bases, sizeof(*lg->listeners))))
+		goto err;
+
+	for (i = 0; i < n_bases; ++i) {
+		lg->listeners[i] = evconnlistener_new_bind(bases[i], cb, ptr,
+		    flags, backlog, sa, socklen);
+		if (!lg->listeners[i])
+			goto err;
+		++lg->n_listeners;
+		if (i == 0) {
+			/* If we were asked to bind to port 0, the rest of
+			 * the sockets need the port that the kernel picked. */
+			sslen = sizeof(ss);
+			if (getsockname(evconnlistener_get_fd(lg->listeners[0]),
+				(struct sockaddr *)&ss, &sslen) < 0)
+				goto err;
+			sa = (struct sockaddr *)&ss;
+			socklen = (int)sslen;
+		}
+	}
+
+	return lg;
+err:
+	evconnlistener_group_free(lg);
+	return NULL;
+}
+
+void
+evconnlistener_group_free(struct evconnlistener_group *lg)
+{
+	int i;
+
+	for (i = 0; i < lg->n_listeners; ++i)
+		evconnlistener_free(lg->listeners[i]);
+	mm_free(lg->listeners);
+	mm_free(lg);
+}
+
+int
+evconnlistener_group_enable(struct evconnlistener_group *lg)
+{
+	int i, r = 0;
+
+	for (i = 0; i < lg->n_listeners; ++i)
+		if (evconnlistener_enable(lg->listeners[i]) < 0)
+			r = -1;
+	return r;
+}
+
+int
+evconnlistener_group_disable(struct evconnlistener_group *lg)
+{
+	int i, r = 0;
+
+	for (i = 0; i < lg->n_listeners; ++i)
+		if (evconnlistener_disable(lg->listeners[i]) < 0)
+			r = -1;
+	return r;
+}
+
+int
+evconnlistener_group_get_n_listeners(struct evconnlistener_group *lg)
+{
+	return lg->n_listeners;
+}
+
+struct evconnlistener *
+evconnlistener_group_get_listener(struct evconnlistener_group *lg, int idx)
+{
+	if (idx < 0 || idx >= lg->n_listeners)
+		return NULL;
+	return lg->listeners[idx];
+}
+
+/* Accept up to LISTENER_BATCH_MAX connections (and no more than 'max') into
+ * lev->batch.  Return how many we got; if that's fewer than 'max', set
+ * *err to the error from the accept() that stopped us.  Called with the
+ * lock held. */
+static int
+listener_accept_batch(struct evconnlistener *lev, evutil_socket_t fd,
+    int max, int *err)
+{
+	int n = 0;
+
+	if (max > LISTENER_BATCH_MAX)
+		max = LISTENER_BATCH_MAX;
+	while (n < max) {
+		struct sockaddr *sa = (struct sockaddr *)&lev->batch_addrs[n];
+		ev_socklen_t socklen = sizeof(struct sockaddr_storage);
+		evutil_socket_t new_fd =
+		    evutil_accept4_(fd, sa, &socklen, lev->accept4_flags);
+		if (new_fd < 0) {
+			*err = evutil_socket_geterror(fd);
+			break;
+		}
+		if (socklen == 0) {
+			/* This can happen with some older linux kernels in
+			 * response to nmap. */
+			evutil_closesocket(new_fd);
+			continue;
+		}
+		lev->batch[n].fd = new_fd;
+		lev->batch[n].addr = sa;
+		lev->batch[n].socklen = (int)socklen;
+		++n;
+	}
+	return n;
+}
+
 static void
 listener_read_cb(evutil_socket_t fd, short what, void *p)
 {
 	struct evconnlistener *lev = p;
-	int err;
+	int err = 0, left;
 	evconnlistener_cb cb;
+	evconnlistener_batch_cb batch_cb;
 	evconnlistener_errorcb errorcb;
 	void *user_data;
 	LOCK(lev);
-	while (1) {
+	/* With a budget, we leave whatever is still queued after 'left'
+	 * accepts for the next pass through the loop, so that other events
+	 * get to run in between. */
+	left = lev->accept_budget ? lev->accept_budget : -1;
+	while (left != 0) {
 		struct sockaddr_storage ss;
 		ev_socklen_t socklen = sizeof(ss);
-		evutil_socket_t new_fd = evutil_accept4_(fd, (struct sockaddr*)&ss, &socklen, lev->accept4_flags);
-		if (new_fd < 0)
-			break;
+		evutil_socket_t new_fd;
+		int n, max;
+
+		if (lev->batch_cb) {
+			max = (left < 0 || left > LISTENER_BATCH_MAX) ?
+			    LISTENER_BATCH_MAX : left;
+			n = listener_accept_batch(lev, fd, max, &err);
+			if (n == 0)
+				goto accept_failed;
+			++lev->refcnt;
+			batch_cb = lev->batch_cb;
+			user_data = lev->user_data;
+			UNLOCK(lev);
+			batch_cb(lev, lev->batch, n, user_data);
+			LOCK(lev);
+			if (lev->refcnt == 1) {
+				int freed = listener_decref_and_unlock(lev);
+				EVUTIL_ASSERT(freed);
+				return;
+			}
+			--lev->refcnt;
+			if (!lev->enabled) {
+				UNLOCK(lev);
+				return;
+			}
+			if (left > 0)
+				left -= n;
+			if (n < max)
+				goto accept_failed;
+			continue;
+		}
+
+		new_fd = evutil_accept4_(fd, (struct sockaddr*)&ss, &socklen, lev->accept4_flags);
+		if (new_fd < 0) {
+			err = evutil_socket_geterror(fd);
+			goto accept_failed;
+		}
 		if (socklen == 0) {
 			/* This can happen with some older linux kernels in
 			 * response to nmap. */
@@ -435,8 +661,14 @@ listener_read_cb(evutil_socket_t fd, short what, void *p)
 			UNLOCK(lev);
 			return;
 		}
+		if (left > 0)
+			--left;
 	}
-	err = evutil_socket_geterror(fd);
+	/* Out of budget. */
+	UNLOCK(lev);
+	return;
+
+accept_failed:
 	if (EVUTIL_ERR_ACCEPT_RETRIABLE(err)) {
 		UNLOCK(lev);
 		return;
@@ -614,6 +846,7 @@ accepted_socket_invoke_user_cb(struct event_callback *dcb, void *arg)
 	evutil_socket_t sock=-1;
 	void *data;
 	evconnlistener_cb cb=NULL;
+	evconnlistener_batch_cb batch_cb=NULL;
 	evconnlistener_errorcb errorcb=NULL;
 	int error;
 
@@ -640,6 +873,7 @@ accepted_socket_invoke_user_cb(struct event_callback *dcb, void *arg)
 			&socklen_remote);
 		sock = as->s;
 		cb = lev->cb;
+		batch_cb = lev->batch_cb;
 		as->s = EVUTIL_INVALID_SOCKET;
 
 		/* We need to call this so getsockname, getpeername, and
@@ -658,6 +892,13 @@ accepted_socket_invoke_user_cb(struct event_callback *dcb, void *arg)
 		errorcb(lev, data);
 	} else if (cb) {
 		cb(lev, sock, sa_remote, socklen_remote, data);
+	} else if (batch_cb) {
+		/* AcceptEx hands us one connection at a time. */
+		struct evconnlistener_conn conn;
+		conn.fd = sock;
+		conn.addr = sa_remote;
+		conn.socklen = socklen_remote;
+		batch_cb(lev, &conn, 1, data);
 	}
 
 	LOCK(lev);
@@ -36,10 +36,42 @@
 #include "util-internal.h"
 #include "mm-internal.h"
 
+#include <string.h>
+
+/* The timeout heap is a 4-ary min-heap.  Each entry keeps a copy of its
+ * event's deadline next to the event pointer, so that sifting up and down
+ * compares entries without touching the events themselves.  The array is
+ * laid out so that the four children of a node always share a single
+ * 64-byte cache line.
+ *
+ * A caller about to change many entries at once can mark the heap
+ * unordered first.  Until min_heap_heapify_() is called, pushes, erases and
+ * adjustments then only keep the array dense and the indices right, without
+ * sifting, and the heap must not be popped or have its top examined.
+ */
+
+#define MIN_HEAP_ARITY 4
+#define MIN_HEAP_CACHE_LINE 64
+
+/* The index of the parent of entry i, and of the first child of entry i. */
+#define MIN_HEAP_PARENT(i) (((i) - 1) / MIN_HEAP_ARITY)
+#define MIN_HEAP_FIRST_CHILD(i) (MIN_HEAP_ARITY * (i) + 1)
+
+struct min_heap_entry
+{
+	/* ev->ev_timeout, in microseconds. */
+	ev_int64_t deadline;
+	struct event* ev;
+};
+
 typedef struct min_heap
 {
-	struct event** p;
+	struct min_heap_entry* p;
+	/* The block that p lives in; p itself is offset for alignment. */
+	void* mem;
 	unsigned n, a;
+	/* True iff the heap property is suspended; see above. */
+	int unordered;
 } min_heap_t;
 
 static inline void	     min_heap_ctor_(min_heap_t* s);
@@ -54,26 +86,47 @@ static inline int	     min_heap_push_(min_heap_t* s, struct event* e);
 static inline struct event*  min_heap_pop_(min_heap_t* s);
 static inline int	     min_heap_adjust_(min_heap_t *s, struct event* e);
 static inline int	     min_heap_erase_(min_heap_t* s, struct event* e);
-static inline void	     min_heap_shift_up_(min_heap_t* s, unsigned hole_index, struct event* e);
-static inline void	     min_heap_shift_up_unconditional_(min_heap_t* s, unsigned hole_index, struct event* e);
-static inline void	     min_heap_shift_down_(min_heap_t* s, unsigned hole_index, struct event* e);
+static inline ev_int64_t     min_heap_deadline_(const struct event* e);
+static inline ev_int64_t     min_heap_elt_deadline_(min_heap_t* s, const struct event* e);
+static inline void	     min_heap_set_unordered_(min_heap_t* s);
+static inline void	     min_heap_heapify_(min_heap_t* s);
+static inline void	     min_heap_shift_up_(min_heap_t* s, unsigned hole_index, struct min_heap_entry e);
+static inline void	     min_heap_shift_up_unconditional_(min_heap_t* s, unsigned hole_index, struct min_heap_entry e);
+static inline void	     min_heap_shift_down_(min_heap_t* s, unsigned hole_index, struct min_heap_entry e);
 
-#define min_heap_elem_greater(a, b) \
-	(evutil_timercmp(&(a)->ev_timeout, &(b)->ev_timeout, >))
-
-void min_heap_ctor_(min_heap_t* s) { s->p = 0; s->n = 0; s->a = 0; }
-void min_heap_dtor_(min_heap_t* s) { if (s->p) mm_free(s->p); }
+void min_heap_ctor_(min_heap_t* s) { s->p = 0; s->mem = 0; s->n = 0; s->a = 0; s->unordered = 0; }
+void min_heap_dtor_(min_heap_t* s) { if (s->mem) mm_free(s->mem); }
 void min_heap_elem_init_(struct event* e) { e->ev_timeout_pos.min_heap_idx = -1; }
 int min_heap_empty_(min_heap_t* s) { return 0u == s->n; }
 unsigned min_heap_size_(min_heap_t* s) { return s->n; }
-struct event* min_heap_top_(min_heap_t* s) { return s->n ? *s->p : 0; }
+struct event* min_heap_top_(min_heap_t* s) { return s->n ? s->p->ev : 0; }
+
+ev_int64_t min_heap_deadline_(const struct event* e)
+{
+	return ((ev_int64_t)e->ev_timeout.tv_sec) * 1000000 +
+	    e->ev_timeout.tv_usec;
+}
+
+/* The deadline e is filed under, which the caller may have let fall behind
+ * ev_timeout.  e must be in the heap. */
+ev_int64_t min_heap_elt_deadline_(min_heap_t* s, const struct event* e)
+{
+	return s->p[e->ev_timeout_pos.min_heap_idx].deadline;
+}
 
-//向堆中添加event指针
 int min_heap_push_(min_heap_t* s, struct event* e)
 {
-	if (s->n == UINT32_MAX || min_heap_reserve_(s, s->n + 1)) //为待插入的event重新分配一个位置
+	struct min_heap_entry entry;
+	if (s->n == UINT32_MAX || min_heap_reserve_(s, s->n + 1))
 		return -1;
-	min_heap_shift_up_(s, s->n++, e); //虽然heap空间可能加倍，但是还是从当前heap的有效结点的后一个位置插入event，然后上浮，push后n加1
+	entry.deadline = min_heap_deadline_(e);
+	entry.ev = e;
+	if (s->unordered) {
+		(s->p[s->n] = entry).ev->ev_timeout_pos.min_heap_idx = s->n;
+		++s->n;
+	} else {
+		min_heap_shift_up_(s, s->n++, entry);
+	}
 	return 0;
 }
 
@@ -81,8 +134,9 @@ struct event* min_heap_pop_(min_heap_t* s)
 {
 	if (s->n)
 	{
-		struct event* e = *s->p;
-		min_heap_shift_down_(s, 0u, s->p[--s->n]); // --s->n为最后一个结点的的堆索引，这就相当于将最后一个event换到堆索引为0的位置，然后下沉调整这个堆，调整后堆顶就是新的最小值了
+		struct event* e = s->p->ev;
+		if (--s->n)
+			min_heap_shift_down_(s, 0u, s->p[s->n]);
 		e->ev_timeout_pos.min_heap_idx = -1;
 		return e;
 	}
@@ -94,31 +148,29 @@ int min_heap_elt_is_top_(const struct event *e)
 	return e->ev_timeout_pos.min_heap_idx == 0;
 }
 
-/*
- * 需要注意的一点是，由于堆末尾的元素对于整个堆来说，删除它对于堆是没有任何影响的，
- * 因此，如果要对堆中的任意一个元素进行删除，就可以将需要删除的元素先和堆尾元素互换，
- * 然后不考虑需要删除的元素，对互换后的堆进行调整，最终得到的堆就是删除了该元素的堆了。
- */
+/* To remove an entry, move the last entry of the heap into its place, and
+ * sift that up or down as needed. */
 int min_heap_erase_(min_heap_t* s, struct event* e)
 {
-	if (-1 != e->ev_timeout_pos.min_heap_idx) //堆索引为-1表示不在堆上
+	if (-1 != e->ev_timeout_pos.min_heap_idx)
 	{
-		struct event *last = s->p[--s->n]; //获取堆中的最后一个元素
-		unsigned parent = (e->ev_timeout_pos.min_heap_idx - 1) / 2; //找到需要删除的结点的父节点的堆索引
-		/* we replace e with the last element in the heap.  We might need to
-		   shift it upward if it is less than its parent, or downward if it is
-		   greater than one or both its children. Since the children are known
-		   to be less than the parent, it can't need to shift both up and
-		   down. */
-		//如果要删除的event不在堆顶，并且最后一个结点的超时值小于父节点的超时值
-		if (e->ev_timeout_pos.min_heap_idx > 0 && min_heap_elem_greater(s->p[parent], last))
-			min_heap_shift_up_unconditional_(s, e->ev_timeout_pos.min_heap_idx, last);
-		else //如果要删除的event本身就是堆顶，或者最后一个结点的超时值不小于父节点的超时值，就将最后一个结点的超时值换到要删除的结点位置，然后下沉
-			min_heap_shift_down_(s, e->ev_timeout_pos.min_heap_idx, last);
-		e->ev_timeout_pos.min_heap_idx = -1; //被删除的结点堆索引值重置为-1
+		unsigned idx = e->ev_timeout_pos.min_heap_idx;
+		struct min_heap_entry last = s->p[--s->n];
+		/* The children of the removed entry are known to be no less
+		 * than its parent, so the last entry can't need to shift both
+		 * up and down. */
+		if (idx != s->n) {
+			if (s->unordered)
+				(s->p[idx] = last).ev->ev_timeout_pos.min_heap_idx = idx;
+			else if (idx > 0 && s->p[MIN_HEAP_PARENT(idx)].deadline > last.deadline)
+				min_heap_shift_up_unconditional_(s, idx, last);
+			else
+				min_heap_shift_down_(s, idx, last);
+		}
+		e->ev_timeout_pos.min_heap_idx = -1;
 		return 0;
 	}
-	return -1; //说明需要删除的结点本身就不在堆上
+	return -1;
 }
 
 int min_heap_adjust_(min_heap_t *s, struct event *e)
@@ -126,13 +178,18 @@ int min_heap_adjust_(min_heap_t *s, struct event *e)
 	if (-1 == e->ev_timeout_pos.min_heap_idx) {
 		return min_heap_push_(s, e);
 	} else {
-		unsigned parent = (e->ev_timeout_pos.min_heap_idx - 1) / 2;
-		/* The position of e has changed; we shift it up or down
+		unsigned idx = e->ev_timeout_pos.min_heap_idx;
+		struct min_heap_entry entry;
+		entry.deadline = min_heap_deadline_(e);
+		entry.ev = e;
+		/* The deadline of e has changed; we shift it up or down
 		 * as needed.  We can't need to do both. */
-		if (e->ev_timeout_pos.min_heap_idx > 0 && min_heap_elem_greater(s->p[parent], e))
-			min_heap_shift_up_unconditional_(s, e->ev_timeout_pos.min_heap_idx, e);
+		if (s->unordered)
+			s->p[idx] = entry;
+		else if (idx > 0 && s->p[MIN_HEAP_PARENT(idx)].deadline > entry.deadline)
+			min_heap_shift_up_unconditional_(s, idx, entry);
 		else
-			min_heap_shift_down_(s, e->ev_timeout_pos.min_heap_idx, e);
+			min_heap_shift_down_(s, idx, entry);
 		return 0;
 	}
 }
@@ -141,69 +198,97 @@ int min_heap_reserve_(min_heap_t* s, unsigned n)
 {
 	if (s->a < n)
 	{
-		struct event** p;
+		void* mem;
+		struct min_heap_entry* p;
 		unsigned a = s->a ? s->a * 2 : 8;
+		size_t aligned;
 		if (a < n)
 			a = n;
 #if (SIZE_MAX == UINT32_MAX)
-		if (a > SIZE_MAX / sizeof *p)
+		if (a > (SIZE_MAX - 2 * MIN_HEAP_CACHE_LINE) / sizeof *p)
 			return -1;
 #endif
-		if (!(p = (struct event**)mm_realloc(s->p, a * sizeof *p)))
+		if (!(mem = mm_malloc(a * sizeof *p + 2 * MIN_HEAP_CACHE_LINE)))
 			return -1;
+		/* Put entry 0 at the end of a cache line, so that entries
+		 * 4i+1 ... 4i+4 start on one. */
+		aligned = ((size_t)(ev_uintptr_t)mem + MIN_HEAP_CACHE_LINE - 1) &
+		    ~(size_t)(MIN_HEAP_CACHE_LINE - 1);
+		p = (struct min_heap_entry*)(ev_uintptr_t)
+		    (aligned + MIN_HEAP_CACHE_LINE - sizeof *p);
+		if (s->n)
+			memcpy(p, s->p, s->n * sizeof *p);
+		if (s->mem)
+			mm_free(s->mem);
+		s->mem = mem;
 		s->p = p;
 		s->a = a;
 	}
 	return 0;
 }
 
-void min_heap_shift_up_unconditional_(min_heap_t* s, unsigned hole_index, struct event* e)
+void min_heap_set_unordered_(min_heap_t* s)
+{
+	s->unordered = 1;
+}
+
+/* Restore the heap property bottom-up, in time linear in the size of the
+ * heap; cheaper than sifting each changed entry once enough have changed. */
+void min_heap_heapify_(min_heap_t* s)
 {
-    unsigned parent = (hole_index - 1) / 2;
-    do
-    {
-	(s->p[hole_index] = s->p[parent])->ev_timeout_pos.min_heap_idx = hole_index;
-	hole_index = parent;
-	parent = (hole_index - 1) / 2;
-    } while (hole_index && min_heap_elem_greater(s->p[parent], e));
-    (s->p[hole_index] = e)->ev_timeout_pos.min_heap_idx = hole_index;
+	unsigned i;
+	s->unordered = 0;
+	if (s->n < 2)
+		return;
+	for (i = MIN_HEAP_PARENT(s->n - 1) + 1; i-- > 0; )
+		min_heap_shift_down_(s, i, s->p[i]);
 }
 
-//堆元素上浮
-//hole_index是需要调整的结点索引
-void min_heap_shift_up_(min_heap_t* s, unsigned hole_index, struct event* e)
+void min_heap_shift_up_unconditional_(min_heap_t* s, unsigned hole_index, struct min_heap_entry e)
 {
-    unsigned parent = (hole_index - 1) / 2; //找到其父节点的索引
-    //如果父节点的超时值大于当前event结点的超时值，不满足小顶堆性质，就上浮
-    while (hole_index && min_heap_elem_greater(s->p[parent], e))
-    {
-    	//将原来的父节点event换到hole_index的位置上并改变父节点event的堆索引值
-    	(s->p[hole_index] = s->p[parent])->ev_timeout_pos.min_heap_idx = hole_index;
-    	hole_index = parent; //此时就上浮到了parent的位置，现在以parent出发继续判断
-    	parent = (hole_index - 1) / 2; //计算新的父节点索引
-    }
-    //执行到这里hole_index就是需要调整的event的最终位置，然后就直接将event放到该位置并设置event中的堆索引值即可
-   (s->p[hole_index] = e)->ev_timeout_pos.min_heap_idx = hole_index;
+	unsigned parent = MIN_HEAP_PARENT(hole_index);
+	do
+	{
+		(s->p[hole_index] = s->p[parent]).ev->ev_timeout_pos.min_heap_idx = hole_index;
+		hole_index = parent;
+		parent = MIN_HEAP_PARENT(hole_index);
+	} while (hole_index && s->p[parent].deadline > e.deadline);
+	(s->p[hole_index] = e).ev->ev_timeout_pos.min_heap_idx = hole_index;
+}
+
+void min_heap_shift_up_(min_heap_t* s, unsigned hole_index, struct min_heap_entry e)
+{
+	unsigned parent = MIN_HEAP_PARENT(hole_index);
+	while (hole_index && s->p[parent].deadline > e.deadline)
+	{
+		(s->p[hole_index] = s->p[parent]).ev->ev_timeout_pos.min_heap_idx = hole_index;
+		hole_index = parent;
+		parent = MIN_HEAP_PARENT(hole_index);
+	}
+	(s->p[hole_index] = e).ev->ev_timeout_pos.min_heap_idx = hole_index;
 }
 
-//与堆元素的上浮相似，hole_index为需要调整的event的堆索引
-void min_heap_shift_down_(min_heap_t* s, unsigned hole_index, struct event* e)
+void min_heap_shift_down_(min_heap_t* s, unsigned hole_index, struct min_heap_entry e)
 {
-    unsigned min_child = 2 * (hole_index + 1); //计算右子结点的堆索引
-    while (min_child <= s->n)//如果右子结点存在
+	unsigned child = MIN_HEAP_FIRST_CHILD(hole_index);
+	while (child < s->n)
 	{
-    	//如果右子结点超时值大于左子结点或者只有左子结点，那么左子结点值就是较小的（或唯一的），此时就只用比较左子结点和当前结点，否则就比较当前结点和右子结点
-		min_child -= min_child == s->n || min_heap_elem_greater(s->p[min_child], s->p[min_child - 1]);
-		//到这里min_child的值就是左右子结点中较小结点的索引
-		if (!(min_heap_elem_greater(e, s->p[min_child])))
+		/* Find the smallest of the (up to four) children; they all
+		 * sit in the same cache line. */
+		unsigned min_child = child;
+		unsigned end = child + MIN_HEAP_ARITY;
+		if (end > s->n)
+			end = s->n;
+		for (++child; child < end; ++child)
+			if (s->p[child].deadline < s->p[min_child].deadline)
+				min_child = child;
+		if (!(e.deadline > s->p[min_child].deadline))
 			break;
-		//将较小结点赋值到当前结点，并修改其堆索引
-		(s->p[hole_index] = s->p[min_child])->ev_timeout_pos.min_heap_idx = hole_index;
-		hole_index = min_child; //更新hole_index到原最小结点的索引
-		min_child = 2 * (hole_index + 1); //继续计算右子结点索引
+		(s->p[hole_index] = s->p[min_child]).ev->ev_timeout_pos.min_heap_idx = hole_index;
+		hole_index = min_child;
+		child = MIN_HEAP_FIRST_CHILD(hole_index);
 	}
-    //此时已经找到合适的位置，直接更新event的索引及位置。
-    (s->p[hole_index] = e)->ev_timeout_pos.min_heap_idx = hole_index;
+	(s->p[hole_index] = e).ev->ev_timeout_pos.min_heap_idx = hole_index;
 }
 
 #endif /* MINHEAP_INTERNAL_H_INCLUDED_ */
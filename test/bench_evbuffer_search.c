@@ -0,0 +1,242 @@
+/*
+ * Copyright 2007-2012 Niels Provos and Nick Mathewson
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 4. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * This benchmark times the evbuffer line and pattern searches over a
+ * buffer full of HTTP request headers, split into 4096-byte chains the way
+ * socket reads leave them.  The "\r\n\r\n" search is run once for each
+ * level of the substring search in evutil_memscan.c; the scalar level is
+ * the code the SIMD versions replaced.  The line scans don't go through
+ * evutil_memscan.c and are timed once per round, for comparison.
+ */
+
+#include "event2/event-config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef EVENT__HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef _WIN32
+#include <getopt.h>
+#endif
+
+#include "event2/buffer.h"
+#include "event2/util.h"
+#include "../util-internal.h"
+
+#define CHAIN_SIZE 4096
+
+static const char *request_fmt =
+    "GET /api/v2/items/%d?fields=id,name,price&sort=desc HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 "
+    "(KHTML, like Gecko) Chrome/96.0.4664.110 Safari/537.36\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,"
+    "image/avif,image/webp,*/*;q=0.8\r\n"
+    "Accept-Language: en-US,en;q=0.5\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Referer: https://www.example.com/catalog/page/%d\r\n"
+    "Cookie: session=%08x%08x; theme=dark; consent=1; "
+    "_ga=GA1.2.%d.1639000000; _gid=GA1.2.%d.1639000000\r\n"
+    "Connection: keep-alive\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "Cache-Control: max-age=0\r\n"
+    "\r\n";
+
+static int num_requests;
+static char *blob;
+static size_t blob_len;
+
+static long
+elapsed_usec(const struct timeval *start)
+{
+	struct timeval now, diff;
+	evutil_gettimeofday(&now, NULL);
+	evutil_timersub(&now, start, &diff);
+	return diff.tv_sec * 1000000L + diff.tv_usec;
+}
+
+static struct evbuffer *
+make_buffer(void)
+{
+	struct evbuffer *buf = evbuffer_new();
+	size_t off, n;
+
+	if (!buf)
+		return NULL;
+	for (off = 0; off < blob_len; off += n) {
+		n = blob_len - off < CHAIN_SIZE ? blob_len - off : CHAIN_SIZE;
+		if (evbuffer_add_reference(buf, blob + off, n, NULL, NULL) < 0)
+			return NULL;
+	}
+	return buf;
+}
+
+/* Walk every line with the given EOL style; return the number of lines. */
+static long
+scan_lines(struct evbuffer *buf, enum evbuffer_eol_style style)
+{
+	struct evbuffer_ptr ptr;
+	size_t eol_len;
+	long lines = 0;
+
+	evbuffer_ptr_set(buf, &ptr, 0, EVBUFFER_PTR_SET);
+	for (;;) {
+		ptr = evbuffer_search_eol(buf, &ptr, &eol_len, style);
+		if (ptr.pos < 0)
+			break;
+		++lines;
+		if (evbuffer_ptr_set(buf, &ptr, eol_len, EVBUFFER_PTR_ADD) < 0)
+			break;
+	}
+	return lines;
+}
+
+/* Find the end of every header block; return the number found. */
+static long
+scan_blocks(struct evbuffer *buf)
+{
+	struct evbuffer_ptr ptr;
+	long blocks = 0;
+
+	evbuffer_ptr_set(buf, &ptr, 0, EVBUFFER_PTR_SET);
+	for (;;) {
+		ptr = evbuffer_search(buf, "\r\n\r\n", 4, &ptr);
+		if (ptr.pos < 0)
+			break;
+		++blocks;
+		if (evbuffer_ptr_set(buf, &ptr, 4, EVBUFFER_PTR_ADD) < 0)
+			break;
+	}
+	return blocks;
+}
+
+static void
+run_lines(struct evbuffer *buf)
+{
+	struct timeval start;
+	long t_any, t_strict, n_any, n_strict;
+
+	evutil_gettimeofday(&start, NULL);
+	n_any = scan_lines(buf, EVBUFFER_EOL_ANY);
+	t_any = elapsed_usec(&start);
+
+	evutil_gettimeofday(&start, NULL);
+	n_strict = scan_lines(buf, EVBUFFER_EOL_CRLF_STRICT);
+	t_strict = elapsed_usec(&start);
+
+	/* EOL_ANY treats the blank line as part of the previous EOL. */
+	if (n_any + num_requests != n_strict) {
+		fprintf(stderr, "wrong answer (%ld/%ld lines)\n",
+		    n_any, n_strict);
+		exit(1);
+	}
+	printf("eol_any     %7ld us (%.2f GB/s)  "
+	    "crlf_strict %7ld us (%.2f GB/s)\n",
+	    t_any, blob_len / 1000.0 / t_any,
+	    t_strict, blob_len / 1000.0 / t_strict);
+}
+
+static void
+run_blocks(const char *name, struct evbuffer *buf)
+{
+	struct timeval start;
+	long t_block, n_block;
+
+	evutil_gettimeofday(&start, NULL);
+	n_block = scan_blocks(buf);
+	t_block = elapsed_usec(&start);
+
+	if (n_block != num_requests) {
+		fprintf(stderr, "%s: wrong answer (%ld blocks)\n",
+		    name, n_block);
+		exit(1);
+	}
+	printf("header_end  %7ld us (%.2f GB/s)  %s\n",
+	    t_block, blob_len / 1000.0 / t_block, name);
+}
+
+int
+main(int argc, char **argv)
+{
+	static const char *names[] = { "scalar", "sse2", "avx2" };
+	struct evbuffer *buf;
+	int i, c, level, rounds = 3;
+	size_t off;
+
+	num_requests = 100000;
+	while ((c = getopt(argc, argv, "n:r:")) != -1) {
+		switch (c) {
+		case 'n':
+			num_requests = atoi(optarg);
+			break;
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "Illegal argument \"%c\"\n", c);
+			exit(1);
+		}
+	}
+	if (num_requests <= 0) {
+		fprintf(stderr, "Need at least one request\n");
+		exit(1);
+	}
+
+	blob = malloc((size_t)num_requests * 1024);
+	if (!blob) {
+		perror("malloc");
+		exit(1);
+	}
+	for (i = 0, off = 0; i < num_requests; ++i) {
+		off += evutil_snprintf(blob + off, 1024, request_fmt,
+		    i, i / 7, (unsigned)i * 2654435761U, (unsigned)~i,
+		    i * 31, i * 17);
+	}
+	blob_len = off;
+	if (!(buf = make_buffer())) {
+		perror("evbuffer");
+		exit(1);
+	}
+
+	printf("%d requests, %lu bytes\n", num_requests,
+	    (unsigned long)blob_len);
+	for (i = 0; i < rounds; ++i) {
+		run_lines(buf);
+		for (level = EVUTIL_MEMSCAN_SCALAR;
+		     level <= EVUTIL_MEMSCAN_AVX2; ++level) {
+			if (evutil_memscan_set_impl_(level) == 0)
+				run_blocks(names[level], buf);
+		}
+	}
+
+	evbuffer_free(buf);
+	free(blob);
+	exit(0);
+}
@@ -0,0 +1,327 @@
+/*
+ * Copyright 2007-2012 Niels Provos and Nick Mathewson
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 4. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * This benchmark compares the timeout heap in minheap-internal.h against
+ * the binary heap of event pointers that Libevent used before it.  Each
+ * heap is filled with a number of timers (a million by default), has every
+ * timer rescheduled once in random order, as happens when connections
+ * keep resetting their timeouts, and is then drained.
+ */
+
+#include "event2/event-config.h"
+#include "../minheap-internal.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef EVENT__HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef _WIN32
+#include <getopt.h>
+#endif
+
+#include "event2/event_struct.h"
+#include "event2/util.h"
+
+/* The binary heap of 'struct event *' that min_heap replaced. */
+struct bin_heap {
+	struct event **p;
+	unsigned n, a;
+};
+
+#define bin_heap_elem_greater(a, b) \
+	(evutil_timercmp(&(a)->ev_timeout, &(b)->ev_timeout, >))
+
+static int
+bin_heap_reserve(struct bin_heap *s, unsigned n)
+{
+	if (s->a < n) {
+		struct event **p;
+		unsigned a = s->a ? s->a * 2 : 8;
+		if (a < n)
+			a = n;
+		if (!(p = realloc(s->p, a * sizeof *p)))
+			return -1;
+		s->p = p;
+		s->a = a;
+	}
+	return 0;
+}
+
+static void
+bin_heap_shift_up_unconditional(struct bin_heap *s, unsigned hole_index,
+    struct event *e)
+{
+	unsigned parent = (hole_index - 1) / 2;
+	do {
+		(s->p[hole_index] = s->p[parent])->ev_timeout_pos.min_heap_idx = hole_index;
+		hole_index = parent;
+		parent = (hole_index - 1) / 2;
+	} while (hole_index && bin_heap_elem_greater(s->p[parent], e));
+	(s->p[hole_index] = e)->ev_timeout_pos.min_heap_idx = hole_index;
+}
+
+static void
+bin_heap_shift_up(struct bin_heap *s, unsigned hole_index, struct event *e)
+{
+	unsigned parent = (hole_index - 1) / 2;
+	while (hole_index && bin_heap_elem_greater(s->p[parent], e)) {
+		(s->p[hole_index] = s->p[parent])->ev_timeout_pos.min_heap_idx = hole_index;
+		hole_index = parent;
+		parent = (hole_index - 1) / 2;
+	}
+	(s->p[hole_index] = e)->ev_timeout_pos.min_heap_idx = hole_index;
+}
+
+static void
+bin_heap_shift_down(struct bin_heap *s, unsigned hole_index, struct event *e)
+{
+	unsigned min_child = 2 * (hole_index + 1);
+	while (min_child <= s->n) {
+		min_child -= min_child == s->n ||
+		    bin_heap_elem_greater(s->p[min_child], s->p[min_child - 1]);
+		if (!(bin_heap_elem_greater(e, s->p[min_child])))
+			break;
+		(s->p[hole_index] = s->p[min_child])->ev_timeout_pos.min_heap_idx = hole_index;
+		hole_index = min_child;
+		min_child = 2 * (hole_index + 1);
+	}
+	(s->p[hole_index] = e)->ev_timeout_pos.min_heap_idx = hole_index;
+}
+
+static int
+bin_heap_push(struct bin_heap *s, struct event *e)
+{
+	if (bin_heap_reserve(s, s->n + 1))
+		return -1;
+	bin_heap_shift_up(s, s->n++, e);
+	return 0;
+}
+
+static struct event *
+bin_heap_pop(struct bin_heap *s)
+{
+	if (s->n) {
+		struct event *e = *s->p;
+		bin_heap_shift_down(s, 0u, s->p[--s->n]);
+		e->ev_timeout_pos.min_heap_idx = -1;
+		return e;
+	}
+	return NULL;
+}
+
+static void
+bin_heap_erase(struct bin_heap *s, struct event *e)
+{
+	struct event *last = s->p[--s->n];
+	unsigned parent = (e->ev_timeout_pos.min_heap_idx - 1) / 2;
+	if (e->ev_timeout_pos.min_heap_idx > 0 &&
+	    bin_heap_elem_greater(s->p[parent], last))
+		bin_heap_shift_up_unconditional(s,
+		    e->ev_timeout_pos.min_heap_idx, last);
+	else
+		bin_heap_shift_down(s, e->ev_timeout_pos.min_heap_idx, last);
+	e->ev_timeout_pos.min_heap_idx = -1;
+}
+
+static struct event **events;
+static struct timeval *timeouts;
+static unsigned *order;
+static int num_timers;
+
+static ev_uint32_t rng_state = 2463534242U;
+
+static ev_uint32_t
+rng(void)
+{
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	return rng_state;
+}
+
+static void
+set_timeout(struct event *ev, const struct timeval *tv)
+{
+	ev->ev_timeout = *tv;
+	ev->ev_timeout_pos.min_heap_idx = -1;
+}
+
+static long
+elapsed_usec(const struct timeval *start)
+{
+	struct timeval now, diff;
+	evutil_gettimeofday(&now, NULL);
+	evutil_timersub(&now, start, &diff);
+	return diff.tv_sec * 1000000L + diff.tv_usec;
+}
+
+static void
+report(const char *name, long push, long resched, long drain)
+{
+	printf("%-8s push %8ld us  reschedule %8ld us  pop %8ld us  "
+	    "(%.1f ns/op overall)\n", name, push, resched, drain,
+	    (push + resched + drain) * 1000.0 / (3.0 * num_timers));
+}
+
+static int
+run_bin_heap(void)
+{
+	struct bin_heap heap = { NULL, 0, 0 };
+	struct timeval start;
+	long push, resched, drain;
+	int i;
+
+	for (i = 0; i < num_timers; ++i)
+		set_timeout(events[i], &timeouts[i]);
+
+	evutil_gettimeofday(&start, NULL);
+	for (i = 0; i < num_timers; ++i) {
+		if (bin_heap_push(&heap, events[i]) < 0)
+			return -1;
+	}
+	push = elapsed_usec(&start);
+
+	evutil_gettimeofday(&start, NULL);
+	for (i = 0; i < num_timers; ++i) {
+		struct event *ev = events[order[i]];
+		bin_heap_erase(&heap, ev);
+		ev->ev_timeout = timeouts[num_timers - 1 - order[i]];
+		bin_heap_push(&heap, ev);
+	}
+	resched = elapsed_usec(&start);
+
+	evutil_gettimeofday(&start, NULL);
+	while (bin_heap_pop(&heap))
+		;
+	drain = elapsed_usec(&start);
+
+	report("binary", push, resched, drain);
+	free(heap.p);
+	return 0;
+}
+
+static int
+run_min_heap(void)
+{
+	min_heap_t heap;
+	struct timeval start;
+	long push, resched, drain;
+	int i;
+
+	min_heap_ctor_(&heap);
+	for (i = 0; i < num_timers; ++i)
+		set_timeout(events[i], &timeouts[i]);
+
+	evutil_gettimeofday(&start, NULL);
+	for (i = 0; i < num_timers; ++i) {
+		if (min_heap_push_(&heap, events[i]) < 0)
+			return -1;
+	}
+	push = elapsed_usec(&start);
+
+	evutil_gettimeofday(&start, NULL);
+	for (i = 0; i < num_timers; ++i) {
+		struct event *ev = events[order[i]];
+		min_heap_erase_(&heap, ev);
+		ev->ev_timeout = timeouts[num_timers - 1 - order[i]];
+		min_heap_push_(&heap, ev);
+	}
+	resched = elapsed_usec(&start);
+
+	evutil_gettimeofday(&start, NULL);
+	while (min_heap_pop_(&heap))
+		;
+	drain = elapsed_usec(&start);
+
+	report("4-ary", push, resched, drain);
+	min_heap_dtor_(&heap);
+	return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+	int i, c, rounds = 3;
+
+	num_timers = 1000000;
+	while ((c = getopt(argc, argv, "n:r:")) != -1) {
+		switch (c) {
+		case 'n':
+			num_timers = atoi(optarg);
+			break;
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "Illegal argument \"%c\"\n", c);
+			exit(1);
+		}
+	}
+	if (num_timers <= 0) {
+		fprintf(stderr, "Need at least one timer\n");
+		exit(1);
+	}
+
+	events = calloc(num_timers, sizeof(struct event *));
+	timeouts = calloc(num_timers, sizeof(struct timeval));
+	order = calloc(num_timers, sizeof(unsigned));
+	if (!events || !timeouts || !order) {
+		perror("malloc");
+		exit(1);
+	}
+	/* Allocate the events one at a time, the way a server would, so
+	 * that they are scattered around the heap. */
+	for (i = 0; i < num_timers; ++i) {
+		events[i] = calloc(1, sizeof(struct event));
+		if (!events[i]) {
+			perror("malloc");
+			exit(1);
+		}
+		timeouts[i].tv_sec = 1000 + rng() % 600;
+		timeouts[i].tv_usec = rng() % 1000000;
+		order[i] = i;
+	}
+	for (i = num_timers - 1; i > 0; --i) {
+		unsigned j = rng() % (i + 1);
+		unsigned tmp = order[i];
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+
+	printf("%d timers\n", num_timers);
+	for (i = 0; i < rounds; ++i) {
+		if (run_bin_heap() < 0 || run_min_heap() < 0) {
+			perror("malloc");
+			exit(1);
+		}
+	}
+
+	exit(0);
+}
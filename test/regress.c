@@ -817,6 +817,503 @@ end:
 	data->base = NULL;
 }
 
+struct timer_wheel_info {
+	struct event ev;
+	struct timeval called_at;
+	int which;
+	int *order;
+	int *n_called;
+	struct timer_wheel_info *readd;
+};
+
+static void
+timer_wheel_cb(evutil_socket_t fd, short what, void *arg)
+{
+	struct timer_wheel_info *ti = arg;
+	struct timeval tv = { 1, 100*1000 };
+
+	evutil_gettimeofday(&ti->called_at, NULL);
+	ti->order[(*ti->n_called)++] = ti->which;
+	if (ti->readd)
+		event_add(&ti->readd->ev, &tv);
+}
+
+static void
+test_timer_wheel(void *ptr)
+{
+	struct event_base *base = NULL;
+	struct event_config *cfg = NULL;
+	struct timer_wheel_info info[8];
+	int order[8], n_called = 0;
+	int i;
+	struct timeval start, tv, when;
+	struct timeval ms_50 = { 0, 50*1000 };
+	struct timeval ms_1000 = { 1, 0 };
+	struct timeval ms_1050 = { 1, 50*1000 };
+	struct timeval ms_1100 = { 1, 100*1000 };
+	struct timeval ms_1200 = { 1, 200*1000 };
+	struct timeval sec_5 = { 5, 0 };
+	struct timeval hour = { 3600, 0 };
+	struct timeval days_60 = { 60*24*3600, 0 };
+
+	cfg = event_config_new();
+	tt_assert(cfg);
+	event_config_set_flag(cfg, EVENT_BASE_FLAG_TIMER_WHEEL);
+	base = event_base_new_with_config(cfg);
+	tt_assert(base);
+
+	memset(info, 0, sizeof(info));
+	for (i = 0; i < 8; ++i) {
+		info[i].which = i;
+		info[i].order = order;
+		info[i].n_called = &n_called;
+		event_assign(&info[i].ev, base, -1, 0, timer_wheel_cb, &info[i]);
+	}
+	/* 2 is on the heap; it adds 3 to the wheel while the loop runs. */
+	info[2].readd = &info[3];
+
+	evutil_gettimeofday(&start, NULL);
+	event_add(&info[0].ev, &ms_1200);
+	event_add(&info[1].ev, &ms_1000);
+	event_add(&info[2].ev, &ms_50);
+	event_add(&info[4].ev, &ms_1100);
+	event_add(&info[5].ev, &sec_5);
+	event_add(&info[6].ev, &hour);
+	/* Too far away for the wheel; this one goes on the heap. */
+	event_add(&info[7].ev, &days_60);
+	event_base_assert_ok_(base);
+
+	/* Deleting and resetting wheel timeouts. */
+	event_del(&info[4].ev);
+	event_add(&info[5].ev, &ms_1050);
+	event_base_assert_ok_(base);
+
+	tt_assert(event_pending(&info[6].ev, EV_TIMEOUT, &when));
+	evutil_gettimeofday(&tv, NULL);
+	tt_int_op(when.tv_sec - tv.tv_sec, >=, 3599);
+	tt_int_op(when.tv_sec - tv.tv_sec, <=, 3601);
+
+	tv.tv_sec = 1;
+	tv.tv_usec = 400*1000;
+	event_base_loopexit(base, &tv);
+	event_base_dispatch(base);
+	event_base_assert_ok_(base);
+
+	tt_int_op(n_called, ==, 5);
+	tt_int_op(order[0], ==, 2);
+	tt_int_op(order[1], ==, 1);
+	tt_int_op(order[2], ==, 5);
+	tt_int_op(order[3], ==, 3);
+	tt_int_op(order[4], ==, 0);
+	test_timeval_diff_eq(&start, &info[2].called_at, 50);
+	test_timeval_diff_eq(&start, &info[1].called_at, 1000);
+	test_timeval_diff_eq(&start, &info[5].called_at, 1050);
+	test_timeval_diff_eq(&start, &info[3].called_at, 1150);
+	test_timeval_diff_eq(&start, &info[0].called_at, 1200);
+
+	tt_assert(!event_pending(&info[4].ev, EV_TIMEOUT, NULL));
+	tt_assert(event_pending(&info[6].ev, EV_TIMEOUT, NULL));
+	tt_assert(event_pending(&info[7].ev, EV_TIMEOUT, NULL));
+
+	/* Make sure we can free the base with timeouts still in the wheel. */
+	event_add(&info[0].ev, &ms_1000);
+	event_add(&info[1].ev, &ms_1100);
+
+end:
+	if (base)
+		event_base_free(base);
+	if (cfg)
+		event_config_free(cfg);
+}
+
+struct batch_timer_info {
+	struct event ev;
+	/* Timeouts must fire in nondecreasing order of group. */
+	int group;
+	int count;
+	int *last_group;
+	int *out_of_order;
+};
+
+static void
+batch_timer_cb(evutil_socket_t fd, short what, void *arg)
+{
+	struct batch_timer_info *bi = arg;
+
+	++bi->count;
+	if (bi->group < *bi->last_group)
+		*bi->out_of_order = 1;
+	*bi->last_group = bi->group;
+}
+
+static void
+test_event_add_batch(void *ptr)
+{
+	struct basic_test_data *data = ptr;
+	struct event_base *base = data->base;
+	struct event_base *other = NULL;
+	struct batch_timer_info info[64];
+	struct event *evs[64];
+	struct event other_ev;
+	int i, last_group = 0, out_of_order = 0;
+	struct timeval tv;
+
+	memset(info, 0, sizeof(info));
+	for (i = 0; i < 64; ++i) {
+		info[i].last_group = &last_group;
+		info[i].out_of_order = &out_of_order;
+		event_assign(&info[i].ev, base, -1, 0, batch_timer_cb, &info[i]);
+		evs[i] = &info[i].ev;
+	}
+
+	/* A few timeouts already on the heap, one at a time. */
+	for (i = 0; i < 8; ++i) {
+		info[i].group = 1;
+		tv.tv_sec = 0;
+		tv.tv_usec = (20 + i) * 1000;
+		tt_int_op(event_add(evs[i], &tv), ==, 0);
+	}
+
+	/* Big enough next to the heap to be heapified. */
+	for (i = 8; i < 64; ++i)
+		info[i].group = 3;
+	tv.tv_sec = 0;
+	tv.tv_usec = 300 * 1000;
+	tt_int_op(event_add_batch(evs + 8, 56, &tv), ==, 0);
+	event_base_assert_ok_(base);
+
+	/* Reschedule half of those earlier... */
+	for (i = 8; i < 36; ++i)
+		info[i].group = 2;
+	tv.tv_usec = 100 * 1000;
+	tt_int_op(event_add_batch(evs + 8, 28, &tv), ==, 0);
+	event_base_assert_ok_(base);
+
+	/* ...and cancel some of the rest. */
+	tt_int_op(event_del_batch(evs + 48, 16), ==, 0);
+	event_base_assert_ok_(base);
+	for (i = 48; i < 64; ++i)
+		tt_assert(!event_pending(evs[i], EV_TIMEOUT, NULL));
+
+	/* Small batches go through the heap one event at a time. */
+	info[36].group = 2;
+	info[37].group = 2;
+	tt_int_op(event_add_batch(evs + 36, 2, &tv), ==, 0);
+	tt_int_op(event_del_batch(evs + 46, 2), ==, 0);
+	event_base_assert_ok_(base);
+
+	/* Every event in a batch must share a base. */
+	other = event_base_new();
+	tt_assert(other);
+	event_assign(&other_ev, other, -1, 0, batch_timer_cb, &info[0]);
+	evs[63] = &other_ev;
+	tt_int_op(event_add_batch(evs + 62, 2, &tv), ==, -1);
+	tt_int_op(event_del_batch(evs + 62, 2), ==, -1);
+	tt_assert(!event_pending(evs[62], EV_TIMEOUT, NULL));
+	tt_assert(!event_pending(&other_ev, EV_TIMEOUT, NULL));
+	evs[63] = &info[63].ev;
+
+	event_base_dispatch(base);
+	event_base_assert_ok_(base);
+
+	tt_int_op(out_of_order, ==, 0);
+	tt_int_op(last_group, ==, 3);
+	for (i = 0; i < 46; ++i)
+		tt_int_op(info[i].count, ==, 1);
+	for (i = 46; i < 64; ++i)
+		tt_int_op(info[i].count, ==, 0);
+
+end:
+	if (other)
+		event_base_free(other);
+}
+
+struct lazy_timeout_info {
+	struct event *target;
+	struct event *ticker;
+	int n_ticks;
+};
+
+static void
+lazy_timeout_fired_cb(evutil_socket_t fd, short what, void *arg)
+{
+	struct timeval *called_at = arg;
+	evutil_gettimeofday(called_at, NULL);
+}
+
+static void
+lazy_timeout_tick_cb(evutil_socket_t fd, short what, void *arg)
+{
+	struct lazy_timeout_info *li = arg;
+	struct timeval ms_100 = { 0, 100*1000 };
+
+	event_add(li->target, &ms_100);
+	if (--li->n_ticks == 0)
+		event_del(li->ticker);
+}
+
+static void
+test_lazy_timeouts(void *ptr)
+{
+	struct event_base *base = NULL;
+	struct event_config *cfg = NULL;
+	struct event *target = NULL, *early = NULL, *ticker = NULL;
+	struct lazy_timeout_info li;
+	struct timeval start, target_at, early_at, when, now;
+	struct timeval ms_50 = { 0, 50*1000 };
+	struct timeval ms_60 = { 0, 60*1000 };
+	struct timeval ms_100 = { 0, 100*1000 };
+	struct timeval ms_300 = { 0, 300*1000 };
+
+	cfg = event_config_new();
+	tt_assert(cfg);
+	event_config_set_flag(cfg, EVENT_BASE_FLAG_LAZY_TIMEOUTS);
+	base = event_base_new_with_config(cfg);
+	tt_assert(base);
+
+	evutil_timerclear(&target_at);
+	evutil_timerclear(&early_at);
+	target = evtimer_new(base, lazy_timeout_fired_cb, &target_at);
+	early = evtimer_new(base, lazy_timeout_fired_cb, &early_at);
+	ticker = event_new(base, -1, EV_PERSIST, lazy_timeout_tick_cb, &li);
+	tt_assert(target);
+	tt_assert(early);
+	tt_assert(ticker);
+	li.target = target;
+	li.ticker = ticker;
+	li.n_ticks = 4;
+
+	evutil_gettimeofday(&start, NULL);
+	tt_int_op(event_add(target, &ms_100), ==, 0);
+	tt_int_op(event_add(ticker, &ms_60), ==, 0);
+	/* Moving a timeout earlier still goes through the heap. */
+	tt_int_op(event_add(early, &ms_300), ==, 0);
+	tt_int_op(event_add(early, &ms_50), ==, 0);
+	event_base_assert_ok_(base);
+
+	/* An extended timeout reports its new deadline. */
+	tt_int_op(event_add(target, &ms_300), ==, 0);
+	event_base_assert_ok_(base);
+	tt_assert(event_pending(target, EV_TIMEOUT, &when));
+	evutil_gettimeofday(&now, NULL);
+	test_timeval_diff_eq(&now, &when, 300);
+	tt_int_op(event_add(target, &ms_100), ==, 0);
+
+	event_base_dispatch(base);
+	event_base_assert_ok_(base);
+
+	/* Each tick pushed the target 100 msec past it; it fired once, after
+	 * the last one. */
+	tt_int_op(li.n_ticks, ==, 0);
+	test_timeval_diff_eq(&start, &early_at, 50);
+	test_timeval_diff_eq(&start, &target_at, 340);
+
+end:
+	if (target)
+		event_free(target);
+	if (early)
+		event_free(early);
+	if (ticker)
+		event_free(ticker);
+	if (base)
+		event_base_free(base);
+	if (cfg)
+		event_config_free(cfg);
+}
+
+static void
+base_stats_slow_cb(evutil_socket_t fd, short what, void *arg)
+{
+	struct timeval tv = { 0, 5000 };
+	evutil_usleep_(&tv);
+}
+
+static void
+base_stats_fast_cb(evutil_socket_t fd, short what, void *arg)
+{
+}
+
+static void
+test_base_stats(void *ptr)
+{
+	struct event_base *base = NULL;
+	struct event_config *cfg = NULL;
+	struct event *slow = NULL, *fast = NULL, *later = NULL;
+	struct event_base_stats stats;
+	ev_uint64_t hist[EVENT_BASE_STATS_N_BUCKETS + 1];
+	ev_uint64_t n_slow = 0, n_fast = 0;
+	FILE *out = NULL;
+	char line[256];
+	int i;
+
+	/* Nothing is collected unless we ask for it. */
+	base = event_base_new();
+	tt_assert(base);
+	tt_int_op(event_base_get_stats(base, &stats), ==, -1);
+	tt_int_op(event_base_get_callback_histogram(base, 0, hist,
+		EVENT_BASE_STATS_N_BUCKETS), ==, -1);
+	event_base_free(base);
+
+	cfg = event_config_new();
+	tt_assert(cfg);
+	event_config_set_flag(cfg, EVENT_BASE_FLAG_COLLECT_STATS);
+	base = event_base_new_with_config(cfg);
+	tt_assert(base);
+	tt_int_op(event_base_priority_init(base, 2), ==, 0);
+	slow = event_new(base, -1, 0, base_stats_slow_cb, NULL);
+	fast = event_new(base, -1, 0, base_stats_fast_cb, NULL);
+	later = event_new(base, -1, 0, base_stats_fast_cb, NULL);
+	tt_assert(slow);
+	tt_assert(fast);
+	tt_assert(later);
+	event_priority_set(slow, 1);
+	event_priority_set(fast, 0);
+	event_priority_set(later, 0);
+
+	event_active(slow, EV_READ, 1);
+	event_active(fast, EV_READ, 1);
+	event_active_later_(later, EV_READ);
+	event_base_loop(base, EVLOOP_NONBLOCK);
+
+	tt_int_op(event_base_get_stats(base, &stats), ==, 0);
+	TT_BLATHER(("%d loops, %d us waiting, %d us busy, %d us in callbacks",
+		(int)stats.n_loops, (int)stats.wait_usec, (int)stats.busy_usec,
+		(int)stats.callback_usec));
+	/* fast, later, and slow. */
+	tt_int_op(stats.n_callbacks, ==, 3);
+	tt_int_op(stats.n_deferred, ==, 1);
+	tt_int_op(stats.n_loops, >=, 2);
+	/* 'later' joins the others before the first poll. */
+	tt_int_op(stats.max_active, ==, 3);
+	tt_int_op(stats.callback_usec, >=, 4000);
+	tt_int_op(stats.busy_usec, >=, stats.callback_usec);
+	tt_int_op(stats.max_busy_usec, >=, 4000);
+
+	/* Only a few buckets are asked for; the rest must be left alone. */
+	hist[EVENT_BASE_STATS_N_BUCKETS] = 12345;
+	tt_int_op(event_base_get_callback_histogram(base, 1, hist,
+		EVENT_BASE_STATS_N_BUCKETS + 1), ==, EVENT_BASE_STATS_N_BUCKETS);
+	tt_int_op(hist[EVENT_BASE_STATS_N_BUCKETS], ==, 12345);
+	/* The slow callback took at least 4096 microseconds. */
+	for (i = 13; i < EVENT_BASE_STATS_N_BUCKETS; ++i)
+		n_slow += hist[i];
+	tt_int_op(n_slow, ==, 1);
+	tt_int_op(event_base_get_callback_histogram(base, 0, hist,
+		EVENT_BASE_STATS_N_BUCKETS), ==, EVENT_BASE_STATS_N_BUCKETS);
+	for (i = 0; i < EVENT_BASE_STATS_N_BUCKETS; ++i)
+		n_fast += hist[i];
+	tt_int_op(n_fast, ==, 2);
+	tt_int_op(event_base_get_callback_histogram(base, 2, hist,
+		EVENT_BASE_STATS_N_BUCKETS), ==, -1);
+
+	out = tmpfile();
+	tt_assert(out);
+	event_base_dump_stats(base, out);
+	rewind(out);
+	tt_assert(fgets(line, sizeof(line), out));
+	tt_assert(!strncmp(line, "Loops: ", 7));
+
+	event_base_reset_stats(base);
+	tt_int_op(event_base_get_stats(base, &stats), ==, 0);
+	tt_int_op(stats.n_callbacks, ==, 0);
+	tt_int_op(event_base_get_callback_histogram(base, 1, hist,
+		EVENT_BASE_STATS_N_BUCKETS), ==, EVENT_BASE_STATS_N_BUCKETS);
+	tt_int_op(hist[13], ==, 0);
+
+end:
+	if (out)
+		fclose(out);
+	if (slow)
+		event_free(slow);
+	if (fast)
+		event_free(fast);
+	if (later)
+		event_free(later);
+	if (base)
+		event_base_free(base);
+	if (cfg)
+		event_config_free(cfg);
+}
+
+static int slow_hook_calls;
+static struct event_slow_callback slow_hook_last;
+
+static void
+slow_callback_hook(struct event_base *base,
+    const struct event_slow_callback *slow, void *arg)
+{
+	++slow_hook_calls;
+	slow_hook_last = *slow;
+	/* The base isn't locked while the hook runs. */
+	event_active(arg, EV_WRITE, 1);
+}
+
+static void
+test_slow_callbacks(void *ptr)
+{
+	struct basic_test_data *data = ptr;
+	struct event_base *base = data->base;
+	struct event *slow_ev = NULL, *fast_ev = NULL;
+	struct event_slow_callback slow[4];
+	struct timeval ms_2 = { 0, 2000 };
+	FILE *out = NULL;
+	char line[256];
+
+	tt_int_op(event_base_get_slow_callbacks(base, slow, 4), ==, -1);
+	slow_ev = event_new(base, data->pair[0], EV_READ, base_stats_slow_cb,
+	    &ms_2);
+	fast_ev = event_new(base, -1, 0, base_stats_fast_cb, NULL);
+	tt_assert(slow_ev);
+	tt_assert(fast_ev);
+	tt_int_op(event_base_set_slow_callback_threshold(base, &ms_2,
+		slow_callback_hook, fast_ev), ==, 0);
+	tt_int_op(event_base_get_slow_callbacks(base, slow, 4), ==, 0);
+
+	event_active(slow_ev, EV_READ, 1);
+	event_base_loop(base, EVLOOP_NONBLOCK);
+
+	/* The hook ran once, and the event it activated wasn't slow. */
+	tt_int_op(slow_hook_calls, ==, 1);
+	tt_int_op(event_base_get_slow_callbacks(base, slow, 4), ==, 1);
+	tt_assert(slow[0].fn == (void (*)(void))base_stats_slow_cb);
+	tt_ptr_op(slow[0].arg, ==, &ms_2);
+	tt_int_op(slow[0].fd, ==, data->pair[0]);
+	tt_int_op(slow[0].events, ==, EV_READ);
+	tt_int_op(slow[0].usec, >=, 4000);
+	tt_assert(slow_hook_last.fn == slow[0].fn);
+	tt_int_op(slow_hook_last.usec, ==, slow[0].usec);
+
+	out = tmpfile();
+	tt_assert(out);
+	event_base_dump_stats(base, out);
+	rewind(out);
+	tt_assert(fgets(line, sizeof(line), out));
+	tt_assert(!strncmp(line, "Slow callbacks (at least 2000 us): 1", 36));
+
+	/* Newest first. */
+	event_active(slow_ev, EV_TIMEOUT, 1);
+	event_base_loop(base, EVLOOP_NONBLOCK);
+	tt_int_op(event_base_get_slow_callbacks(base, slow, 4), ==, 2);
+	tt_int_op(slow[0].events, ==, EV_TIMEOUT);
+	tt_int_op(slow[1].events, ==, EV_READ);
+	tt_int_op(event_base_get_slow_callbacks(base, slow, 1), ==, 1);
+
+	tt_int_op(event_base_set_slow_callback_threshold(base, NULL, NULL,
+		NULL), ==, 0);
+	tt_int_op(event_base_get_slow_callbacks(base, slow, 4), ==, -1);
+	event_active(slow_ev, EV_READ, 1);
+	event_base_loop(base, EVLOOP_NONBLOCK);
+	tt_int_op(slow_hook_calls, ==, 2);
+
+end:
+	if (out)
+		fclose(out);
+	if (slow_ev)
+		event_free(slow_ev);
+	if (fast_ev)
+		event_free(fast_ev);
+}
+
 #ifndef _WIN32
 
 #define current_base event_global_current_base_
@@ -2321,6 +2818,282 @@ test_multiple_events_for_same_fd(void)
    cleanup_test();
 }
 
+static void
+count_calls_cb(evutil_socket_t fd, short event, void *arg)
+{
+	++*(int *)arg;
+}
+
+static void
+test_many_events_for_same_fd(void *ptr)
+{
+	struct basic_test_data *data = ptr;
+	struct event_base *base = data->base;
+	struct event evs[5], far_ev;
+	int calls[5], far_calls = 0;
+	evutil_socket_t far_fd = -1;
+	int i;
+
+	memset(calls, 0, sizeof(calls));
+	for (i = 0; i < 5; ++i) {
+		event_assign(&evs[i], base, data->pair[0], EV_READ,
+		    count_calls_cb, &calls[i]);
+		tt_int_op(event_add(&evs[i], NULL), ==, 0);
+	}
+	event_base_assert_ok_(base);
+
+#ifndef _WIN32
+	/* Growing the fd map moves the records for fds it already has. */
+	far_fd = dup2(data->pair[0], 1000);
+	tt_int_op(far_fd, ==, 1000);
+	event_assign(&far_ev, base, far_fd, EV_READ, count_calls_cb,
+	    &far_calls);
+	tt_int_op(event_add(&far_ev, NULL), ==, 0);
+	event_base_assert_ok_(base);
+#endif
+
+	/* Take out the first event, and one further along. */
+	tt_int_op(event_del(&evs[0]), ==, 0);
+	event_base_assert_ok_(base);
+	tt_int_op(event_del(&evs[3]), ==, 0);
+	event_base_assert_ok_(base);
+
+	event_base_active_by_fd(base, data->pair[0], EV_READ);
+	event_base_loop(base, EVLOOP_NONBLOCK);
+	tt_int_op(calls[0], ==, 0);
+	tt_int_op(calls[1], ==, 1);
+	tt_int_op(calls[2], ==, 1);
+	tt_int_op(calls[3], ==, 0);
+	tt_int_op(calls[4], ==, 1);
+	tt_int_op(far_calls, ==, 0);
+	event_base_assert_ok_(base);
+
+end:
+	if (far_fd >= 0) {
+		event_del(&far_ev);
+		evutil_closesocket(far_fd);
+	}
+}
+
+static void
+test_exclusive_events(void *ptr)
+{
+	struct basic_test_data *data = ptr;
+	struct event_base *base = NULL;
+	struct event_config *cfg = NULL;
+	struct event *ev_r = NULL, *ev_w = NULL;
+	int n_read = 0, n_write = 0;
+	int changelist;
+
+	tt_int_op(send(data->pair[1], "x", 1, 0), ==, 1);
+
+	for (changelist = 0; changelist < 2; ++changelist) {
+		cfg = event_config_new();
+		tt_assert(cfg);
+		if (changelist)
+			event_config_set_flag(cfg,
+			    EVENT_BASE_FLAG_EPOLL_USE_CHANGELIST);
+		base = event_base_new_with_config(cfg);
+		tt_assert(base);
+		n_read = n_write = 0;
+
+		ev_r = event_new(base, data->pair[0],
+		    EV_READ|EV_PERSIST|EV_EXCLUSIVE, count_calls_cb, &n_read);
+		ev_w = event_new(base, data->pair[0],
+		    EV_WRITE|EV_PERSIST|EV_EXCLUSIVE, count_calls_cb, &n_write);
+		tt_assert(ev_r);
+		tt_assert(ev_w);
+
+		/* Adding and removing the second event changes what an
+		 * exclusive fd is registered for. */
+		tt_int_op(event_add(ev_r, NULL), ==, 0);
+		tt_int_op(event_add(ev_w, NULL), ==, 0);
+		event_base_loop(base, EVLOOP_ONCE);
+		tt_int_op(n_read, ==, 1);
+		tt_int_op(n_write, ==, 1);
+
+		tt_int_op(event_del(ev_w), ==, 0);
+		event_base_loop(base, EVLOOP_ONCE);
+		tt_int_op(n_read, ==, 2);
+		tt_int_op(n_write, ==, 1);
+
+		event_free(ev_r);
+		event_free(ev_w);
+		ev_r = ev_w = NULL;
+		event_base_free(base);
+		base = NULL;
+		event_config_free(cfg);
+		cfg = NULL;
+	}
+
+end:
+	if (ev_r)
+		event_free(ev_r);
+	if (ev_w)
+		event_free(ev_w);
+	if (base)
+		event_base_free(base);
+	if (cfg)
+		event_config_free(cfg);
+}
+
+static void
+test_busy_poll(void *ptr)
+{
+	struct basic_test_data *data = ptr;
+	struct event_base *base = NULL;
+	struct event_config *cfg = NULL;
+	struct event *ev_r = NULL, *timer = NULL;
+	struct timeval ms_20 = { 0, 20*1000 }, start, fired;
+	int n_read = 0;
+
+	cfg = event_config_new();
+	tt_assert(cfg);
+	tt_int_op(event_config_set_busy_poll(cfg, -1), ==, -1);
+	tt_int_op(event_config_set_busy_poll(cfg, 5000), ==, 0);
+	base = event_base_new_with_config(cfg);
+	tt_assert(base);
+
+	ev_r = event_new(base, data->pair[0], EV_READ, count_calls_cb,
+	    &n_read);
+	timer = evtimer_new(base, lazy_timeout_fired_cb, &fired);
+	tt_assert(ev_r);
+	tt_assert(timer);
+
+	/* Something that turns up while spinning... */
+	tt_int_op(send(data->pair[1], "x", 1, 0), ==, 1);
+	tt_int_op(event_add(ev_r, NULL), ==, 0);
+	event_base_loop(base, EVLOOP_ONCE);
+	tt_int_op(n_read, ==, 1);
+
+	/* ...and a timeout that comes after it. */
+	evutil_gettimeofday(&start, NULL);
+	tt_int_op(event_add(timer, &ms_20), ==, 0);
+	event_base_dispatch(base);
+	test_timeval_diff_eq(&start, &fired, 20);
+
+end:
+	if (ev_r)
+		event_free(ev_r);
+	if (timer)
+		event_free(timer);
+	if (base)
+		event_base_free(base);
+	if (cfg)
+		event_config_free(cfg);
+}
+
+/* Run 'n' active events at priority 'pri' to completion; return how many
+ * times the loop polled while doing so. */
+static int
+run_budgeted_events(struct event_base *base, struct event **evs, int n,
+    int pri)
+{
+	struct event_base_stats before, after;
+	int i;
+
+	for (i = 0; i < n; ++i) {
+		event_priority_set(evs[i], pri);
+		event_active(evs[i], EV_READ, 1);
+	}
+	if (event_base_get_stats(base, &before) < 0)
+		return -1;
+	event_base_loop(base, EVLOOP_ONCE);
+	if (event_base_get_stats(base, &after) < 0)
+		return -1;
+	return (int)(after.n_loops - before.n_loops);
+}
+
+static void
+test_dispatch_budget(void *ptr)
+{
+	struct event_base *base = NULL;
+	struct event_config *cfg = NULL;
+	struct event *evs[20];
+	int i, n_calls = 0;
+
+	memset(evs, 0, sizeof(evs));
+	cfg = event_config_new();
+	tt_assert(cfg);
+	tt_int_op(event_config_set_dispatch_budget(cfg, -1), ==, -1);
+	tt_int_op(event_config_set_dispatch_budget(cfg, 8), ==, 0);
+	tt_int_op(event_config_set_backend_events(cfg, 8, 4), ==, -1);
+	tt_int_op(event_config_set_flag(cfg, EVENT_BASE_FLAG_COLLECT_STATS),
+	    ==, 0);
+	base = event_base_new_with_config(cfg);
+	tt_assert(base);
+	tt_int_op(event_base_priority_init(base, 4), ==, 0);
+
+	for (i = 0; i < 20; ++i) {
+		evs[i] = event_new(base, -1, 0, count_calls_cb, &n_calls);
+		tt_assert(evs[i]);
+	}
+
+	/* Priority 0 gets the whole budget, 8 callbacks a pass... */
+	tt_int_op(run_budgeted_events(base, evs, 20, 0), ==, 3);
+	tt_int_op(n_calls, ==, 20);
+	/* ...and the lowest priority a quarter of it. */
+	tt_int_op(run_budgeted_events(base, evs, 20, 3), ==, 10);
+	tt_int_op(n_calls, ==, 40);
+
+end:
+	for (i = 0; i < 20; ++i)
+		if (evs[i])
+			event_free(evs[i]);
+	if (base)
+		event_base_free(base);
+	if (cfg)
+		event_config_free(cfg);
+}
+
+static void
+test_backend_events(void *ptr)
+{
+	struct event_base *base = NULL;
+	struct event_config *cfg = NULL;
+	evutil_socket_t pairs[8][2];
+	struct event *evs[8];
+	int i, n_read = 0;
+
+	memset(evs, 0, sizeof(evs));
+	for (i = 0; i < 8; ++i)
+		pairs[i][0] = pairs[i][1] = -1;
+
+	/* However small the array, every ready fd gets its turn. */
+	cfg = event_config_new();
+	tt_assert(cfg);
+	tt_int_op(event_config_set_backend_events(cfg, 1, 2), ==, 0);
+	base = event_base_new_with_config(cfg);
+	tt_assert(base);
+
+	for (i = 0; i < 8; ++i) {
+		tt_int_op(evutil_socketpair(AF_UNIX, SOCK_STREAM, 0, pairs[i]),
+		    ==, 0);
+		evs[i] = event_new(base, pairs[i][0], EV_READ, count_calls_cb,
+		    &n_read);
+		tt_assert(evs[i]);
+		tt_int_op(event_add(evs[i], NULL), ==, 0);
+		tt_int_op(send(pairs[i][1], "x", 1, 0), ==, 1);
+	}
+	for (i = 0; i < 8 && n_read < 8; ++i)
+		event_base_loop(base, EVLOOP_ONCE);
+	tt_int_op(n_read, ==, 8);
+
+end:
+	for (i = 0; i < 8; ++i) {
+		if (evs[i])
+			event_free(evs[i]);
+		if (pairs[i][0] >= 0)
+			evutil_closesocket(pairs[i][0]);
+		if (pairs[i][1] >= 0)
+			evutil_closesocket(pairs[i][1]);
+	}
+	if (base)
+		event_base_free(base);
+	if (cfg)
+		event_config_free(cfg);
+}
+
 int evtag_decode_int(ev_uint32_t *pnumber, struct evbuffer *evbuf);
 int evtag_decode_int64(ev_uint64_t *pnumber, struct evbuffer *evbuf);
 int evtag_encode_tag(struct evbuffer *evbuf, ev_uint32_t number);
@@ -3459,6 +4232,11 @@ struct testcase_t main_testcases[] = {
 	BASIC(priority_active_inversion, TT_FORK|TT_NEED_BASE),
 	{ "common_timeout", test_common_timeout, TT_FORK|TT_NEED_BASE,
 	  &basic_setup, NULL },
+	{ "timer_wheel", test_timer_wheel, TT_FORK, NULL, NULL },
+	BASIC(event_add_batch, TT_FORK|TT_NEED_BASE|TT_NO_LOGS),
+	{ "lazy_timeouts", test_lazy_timeouts, TT_FORK, NULL, NULL },
+	{ "base_stats", test_base_stats, TT_FORK, NULL, NULL },
+	BASIC(slow_callbacks, TT_FORK|TT_NEED_BASE|TT_NEED_SOCKETPAIR),
 
 	/* These legacy tests may not all need all of these flags. */
 	LEGACY(simpleread, TT_ISOLATED),
@@ -3475,6 +4253,11 @@ struct testcase_t main_testcases[] = {
 	LEGACY(loopexit_multiple, TT_ISOLATED),
 	{ "nonpersist_readd", test_nonpersist_readd, TT_FORK|TT_NEED_SOCKETPAIR|TT_NEED_BASE, &basic_setup, NULL },
 	LEGACY(multiple_events_for_same_fd, TT_ISOLATED),
+	BASIC(many_events_for_same_fd, TT_FORK|TT_NEED_BASE|TT_NEED_SOCKETPAIR),
+	BASIC(exclusive_events, TT_FORK|TT_NEED_SOCKETPAIR),
+	BASIC(busy_poll, TT_FORK|TT_NEED_SOCKETPAIR),
+	{ "dispatch_budget", test_dispatch_budget, TT_FORK, NULL, NULL },
+	{ "backend_events", test_backend_events, TT_FORK, NULL, NULL },
 	LEGACY(want_only_once, TT_ISOLATED),
 	{ "event_once", test_event_once, TT_ISOLATED, &basic_setup, NULL },
 	{ "event_once_never", test_event_once_never, TT_ISOLATED, &basic_setup, NULL },
@@ -1890,6 +1890,105 @@ end:
 		evbuffer_free(tmp);
 }
 
+static void
+test_evbuffer_search_fragmented(void *ptr)
+{
+	struct evutil_weakrand_state seed = { 987654321U };
+	struct evbuffer *buf = evbuffer_new();
+	struct evbuffer_ptr pos, start, end;
+	char blob[2048];
+	const char *needle;
+	size_t blob_len = 0, off, nlen, eol_len;
+	ev_ssize_t s, e, i, expect;
+	int trial;
+
+	tt_assert(buf);
+
+	/* Something that looks like a header block, with the odd bare LF so
+	 * that CRLF_STRICT and ANY disagree now and then. */
+	while (blob_len < sizeof(blob) - 64) {
+		int n = evutil_snprintf(blob + blob_len, 64,
+		    "X-Header-%u: value %u%s",
+		    (unsigned)evutil_weakrand_range_(&seed, 1000),
+		    (unsigned)evutil_weakrand_(&seed),
+		    evutil_weakrand_range_(&seed, 8) ? "\r\n" : "\n");
+		blob_len += n;
+	}
+	/* Split it into many small chains, so that plenty of matches straddle
+	 * a chain boundary. */
+	for (off = 0; off < blob_len; off += nlen) {
+		nlen = 1 + evutil_weakrand_range_(&seed, 40);
+		if (nlen > blob_len - off)
+			nlen = blob_len - off;
+		evbuffer_add_reference(buf, blob + off, nlen, NULL, NULL);
+	}
+	tt_int_op(evbuffer_get_length(buf), ==, blob_len);
+
+	for (trial = 0; trial < 500; ++trial) {
+		/* A substring of the blob, or a header terminator. */
+		if (trial % 10 == 0) {
+			needle = "\r\n\r\n";
+			nlen = 4;
+		} else {
+			nlen = 1 + evutil_weakrand_range_(&seed, 12);
+			needle = blob + evutil_weakrand_range_(&seed,
+			    blob_len - nlen);
+		}
+		s = evutil_weakrand_range_(&seed, blob_len);
+		e = s + evutil_weakrand_range_(&seed, blob_len - s);
+
+		expect = -1;
+		for (i = s; i + (ev_ssize_t)nlen <= (ev_ssize_t)blob_len; ++i) {
+			if (!memcmp(blob + i, needle, nlen)) {
+				expect = i;
+				break;
+			}
+		}
+		tt_assert(evbuffer_ptr_set(buf, &start, s,
+			EVBUFFER_PTR_SET) == 0);
+		pos = evbuffer_search(buf, needle, nlen, &start);
+		tt_int_op(pos.pos, ==, expect);
+		if (expect >= 0)
+			tt_assert(!memcmp(blob + pos.pos, needle, nlen));
+
+		tt_assert(evbuffer_ptr_set(buf, &end, e,
+			EVBUFFER_PTR_SET) == 0);
+		pos = evbuffer_search_range(buf, needle, nlen, &start, &end);
+		if (expect >= 0 && expect + (ev_ssize_t)nlen > e)
+			expect = -1;
+		tt_int_op(pos.pos, ==, expect);
+
+		/* The EOL styles that go through the scanning kernels. */
+		expect = -1;
+		for (i = s; i < (ev_ssize_t)blob_len; ++i) {
+			if (blob[i] == '\r' || blob[i] == '\n') {
+				expect = i;
+				break;
+			}
+		}
+		pos = evbuffer_search_eol(buf, &start, &eol_len,
+		    EVBUFFER_EOL_ANY);
+		tt_int_op(pos.pos, ==, expect);
+		if (expect >= 0)
+			tt_int_op(eol_len, ==, strspn(blob + expect, "\r\n"));
+
+		expect = -1;
+		for (i = s; i + 1 < (ev_ssize_t)blob_len; ++i) {
+			if (blob[i] == '\r' && blob[i+1] == '\n') {
+				expect = i;
+				break;
+			}
+		}
+		pos = evbuffer_search_eol(buf, &start, &eol_len,
+		    EVBUFFER_EOL_CRLF_STRICT);
+		tt_int_op(pos.pos, ==, expect);
+	}
+
+end:
+	if (buf)
+		evbuffer_free(buf);
+}
+
 static void
 log_change_callback(struct evbuffer *buffer,
     const struct evbuffer_cb_info *cbinfo,
@@ -2702,6 +2801,256 @@ end:
 		evbuffer_free(buf);
 }
 
+static void
+test_evbuffer_chain_pool(void *dummy)
+{
+	struct event_config *cfg = NULL;
+	struct event_base *base = NULL;
+	struct evbuffer *buf = NULL, *buf2 = NULL;
+	struct evbuffer *bufs[20];
+	ev_uint64_t hits = 0, misses = 0;
+	size_t cached = 0;
+	char data[3000];
+	int i;
+
+	(void)dummy;
+
+	memset(data, 'x', sizeof(data));
+	memset(bufs, 0, sizeof(bufs));
+
+	/* No pool unless we ask for one. */
+	base = event_base_new();
+	tt_assert(base);
+	buf = evbuffer_new();
+	tt_assert(buf);
+	tt_int_op(evbuffer_use_chain_pool(buf, base), ==, -1);
+	tt_int_op(event_base_get_chain_pool_stats(base, NULL, NULL, NULL),
+	    ==, -1);
+	evbuffer_free(buf);
+	event_base_free(base);
+
+	cfg = event_config_new();
+	tt_assert(cfg);
+	tt_int_op(event_config_set_chain_pool(cfg, 16384), ==, 0);
+	base = event_base_new_with_config(cfg);
+	tt_assert(base);
+
+	buf = evbuffer_new();
+	tt_assert(buf);
+	tt_int_op(evbuffer_use_chain_pool(buf, base), ==, 0);
+
+	/* The first allocation misses; after that, draining and refilling
+	 * the buffer reuses the same chain. */
+	for (i = 0; i < 10; ++i) {
+		tt_int_op(evbuffer_add(buf, data, 500), ==, 0);
+		tt_int_op(evbuffer_drain(buf, 500), ==, 0);
+	}
+	tt_int_op(event_base_get_chain_pool_stats(base, &hits, &misses,
+		&cached), ==, 0);
+	tt_int_op(misses, ==, 1);
+	tt_int_op(hits, ==, 9);
+	tt_int_op(cached, ==, MIN_BUFFER_SIZE);
+
+	/* Chains that move to a buffer without a pool still go back to
+	 * the pool they came from. */
+	buf2 = evbuffer_new();
+	tt_assert(buf2);
+	tt_int_op(evbuffer_add(buf, data, sizeof(data)), ==, 0);
+	tt_int_op(evbuffer_add_buffer(buf2, buf), ==, 0);
+	evbuffer_validate(buf2);
+	evbuffer_free(buf2);
+	buf2 = NULL;
+	tt_int_op(event_base_get_chain_pool_stats(base, NULL, NULL,
+		&cached), ==, 0);
+	tt_int_op(cached, ==, MIN_BUFFER_SIZE + 4*MIN_BUFFER_SIZE);
+
+	/* Nothing above the high-water mark gets cached. */
+	for (i = 0; i < 20; ++i) {
+		bufs[i] = evbuffer_new();
+		tt_assert(bufs[i]);
+		evbuffer_use_chain_pool(bufs[i], base);
+		tt_int_op(evbuffer_add(bufs[i], data, 500), ==, 0);
+	}
+	for (i = 0; i < 20; ++i) {
+		evbuffer_free(bufs[i]);
+		bufs[i] = NULL;
+	}
+	tt_int_op(event_base_get_chain_pool_stats(base, NULL, NULL,
+		&cached), ==, 0);
+	tt_int_op(cached, ==, 16384 + 4*MIN_BUFFER_SIZE);
+
+	/* The buffer can outlive the base. */
+	event_base_free(base);
+	base = NULL;
+	tt_int_op(evbuffer_add(buf, data, sizeof(data)), ==, 0);
+	evbuffer_validate(buf);
+
+end:
+	if (buf)
+		evbuffer_free(buf);
+	if (buf2)
+		evbuffer_free(buf2);
+	for (i = 0; i < 20; ++i)
+		if (bufs[i])
+			evbuffer_free(bufs[i]);
+	if (base)
+		event_base_free(base);
+	if (cfg)
+		event_config_free(cfg);
+}
+
+static void
+test_evbuffer_arena(void *dummy)
+{
+	struct evbuffer_arena *arena = NULL;
+	struct evbuffer *buf = NULL, *buf2 = NULL;
+	size_t n_blocks = 0, n_blocks2 = 0, used = 0, used2 = 0;
+	char data[3000], out[600], *big = NULL;
+	unsigned char *p;
+	int i;
+
+	(void)dummy;
+
+	memset(data, 'x', sizeof(data));
+
+	arena = evbuffer_arena_new(0);
+	tt_assert(arena);
+	evbuffer_arena_get_stats(arena, &n_blocks, &used);
+	tt_int_op(n_blocks, ==, 1);
+	tt_int_op(used, ==, 0);
+
+	/* A buffer and a few small writes fit in the first block. */
+	buf = evbuffer_new_arena(arena);
+	tt_assert(buf);
+	for (i = 0; i < 5; ++i)
+		tt_int_op(evbuffer_add(buf, data, 100), ==, 0);
+	evbuffer_validate(buf);
+	tt_int_op(evbuffer_get_length(buf), ==, 500);
+	evbuffer_arena_get_stats(arena, &n_blocks, &used);
+	tt_int_op(n_blocks, ==, 1);
+	tt_int_op(used, >, MIN_BUFFER_SIZE);
+
+	/* A chain that is drained goes back to the arena, and is handed out
+	 * again. */
+	tt_int_op(evbuffer_drain(buf, 500), ==, 0);
+	tt_int_op(evbuffer_add(buf, data, 100), ==, 0);
+	evbuffer_arena_get_stats(arena, &n_blocks, &used2);
+	tt_int_op(n_blocks, ==, 1);
+	tt_int_op(used2, ==, used);
+
+	/* Writes too big for an arena chain come from the allocator. */
+	big = malloc(100000);
+	tt_assert(big);
+	memset(big, 'z', 100000);
+	tt_int_op(evbuffer_add(buf, big, 100000), ==, 0);
+	evbuffer_validate(buf);
+	evbuffer_arena_get_stats(arena, &n_blocks, &used2);
+	tt_int_op(n_blocks, ==, 1);
+	tt_int_op(used2, ==, used);
+
+	/* The arena can't be reset while its chains are in use, even in
+	 * another buffer. */
+	tt_int_op(evbuffer_arena_reset(arena), ==, -1);
+	buf2 = evbuffer_new();
+	tt_assert(buf2);
+	tt_int_op(evbuffer_add_buffer(buf2, buf), ==, 0);
+	evbuffer_free(buf);
+	buf = NULL;
+	tt_int_op(evbuffer_arena_reset(arena), ==, -1);
+	evbuffer_free(buf2);
+	buf2 = NULL;
+	tt_int_op(evbuffer_arena_reset(arena), ==, 0);
+	evbuffer_arena_get_stats(arena, &n_blocks, &used);
+	tt_int_op(n_blocks, ==, 1);
+	tt_int_op(used, ==, 0);
+
+	/* A big allocation gets a block of its own, and doesn't waste what's
+	 * left of the current one. */
+	p = evbuffer_arena_alloc(arena, 3);
+	tt_assert(p);
+	p = evbuffer_arena_alloc(arena, 10000);
+	tt_assert(p);
+	tt_int_op(((ev_uintptr_t)p) % 16, ==, 0);
+	memset(p, 0, 10000);
+	p = evbuffer_arena_alloc(arena, 100);
+	tt_assert(p);
+	tt_int_op(((ev_uintptr_t)p) % 16, ==, 0);
+	evbuffer_arena_get_stats(arena, &n_blocks, &used);
+	tt_int_op(n_blocks, ==, 2);
+	tt_int_op(used, ==, 10103);
+	tt_int_op(evbuffer_arena_reset(arena), ==, 0);
+
+	/* A buffer that keeps draining and refilling reuses its chains
+	 * instead of making its arena grow. */
+	buf = evbuffer_new_arena(arena);
+	tt_assert(buf);
+	tt_int_op(evbuffer_add(buf, data, 2000), ==, 0);
+	tt_int_op(evbuffer_drain(buf, 2000), ==, 0);
+	evbuffer_arena_get_stats(arena, &n_blocks, &used);
+	for (i = 0; i < 200; ++i) {
+		tt_int_op(evbuffer_add(buf, data, 2000), ==, 0);
+		tt_int_op(evbuffer_remove(buf, out, 500), ==, 500);
+		tt_int_op(evbuffer_drain(buf, 1500), ==, 0);
+	}
+	evbuffer_arena_get_stats(arena, &n_blocks2, &used2);
+	tt_int_op(n_blocks2, ==, n_blocks);
+	tt_int_op(used2, ==, used);
+
+	/* One that holds on to its data stops taking chains from the arena
+	 * once it has had sixteen blocks' worth. */
+	for (i = 0; i < 100; ++i)
+		tt_int_op(evbuffer_add(buf, big, 1000), ==, 0);
+	evbuffer_validate(buf);
+	tt_int_op(evbuffer_get_length(buf), ==, 100000);
+	evbuffer_arena_get_stats(arena, NULL, &used);
+	tt_int_op(used, >=, 16 * EVBUFFER_ARENA_DEFAULT_BLOCK);
+	tt_int_op(used, <, 100000);
+	evbuffer_free(buf);
+	buf = NULL;
+	tt_int_op(evbuffer_arena_reset(arena), ==, 0);
+
+	/* An arena sized for exactly what goes in it needs no more blocks. */
+	evbuffer_arena_free(arena);
+	arena = evbuffer_arena_new(EVBUFFER_ARENA_ROUNDUP(3) +
+	    EVBUFFER_ARENA_ROUNDUP(sizeof(struct evbuffer)));
+	tt_assert(arena);
+	tt_assert(evbuffer_arena_alloc(arena, 3));
+	buf = evbuffer_new_arena(arena);
+	tt_assert(buf);
+	evbuffer_free(buf);
+	buf = NULL;
+	evbuffer_arena_get_stats(arena, &n_blocks, NULL);
+	tt_int_op(n_blocks, ==, 1);
+	tt_int_op(evbuffer_arena_reset(arena), ==, 0);
+
+	/* Chains that move out of an arena buffer keep the arena alive. */
+	buf = evbuffer_new_arena(arena);
+	tt_assert(buf);
+	tt_int_op(evbuffer_add(buf, data, 500), ==, 0);
+	buf2 = evbuffer_new();
+	tt_assert(buf2);
+	tt_int_op(evbuffer_add_buffer(buf2, buf), ==, 0);
+	evbuffer_free(buf);
+	buf = NULL;
+	evbuffer_arena_free(arena);
+	arena = NULL;
+	tt_int_op(evbuffer_add(buf2, "y", 1), ==, 0);
+	evbuffer_validate(buf2);
+	tt_int_op(evbuffer_remove(buf2, out, sizeof(out)), ==, 501);
+	tt_assert(!memcmp(out, data, 500));
+	tt_int_op(out[500], ==, 'y');
+
+end:
+	if (buf)
+		evbuffer_free(buf);
+	if (buf2)
+		evbuffer_free(buf2);
+	if (arena)
+		evbuffer_arena_free(arena);
+	if (big)
+		free(big);
+}
+
 static void *
 setup_passthrough(const struct testcase_t *testcase)
 {
@@ -2747,6 +3096,7 @@ struct testcase_t evbuffer_testcases[] = {
 	{ "find", test_evbuffer_find, 0, NULL, NULL },
 	{ "ptr_set", test_evbuffer_ptr_set, 0, NULL, NULL },
 	{ "search", test_evbuffer_search, 0, NULL, NULL },
+	{ "search_fragmented", test_evbuffer_search_fragmented, 0, NULL, NULL },
 	{ "callbacks", test_evbuffer_callbacks, 0, NULL, NULL },
 	{ "add_reference", test_evbuffer_add_reference, 0, NULL, NULL },
 	{ "multicast", test_evbuffer_multicast, 0, NULL, NULL },
@@ -2761,6 +3111,8 @@ struct testcase_t evbuffer_testcases[] = {
 	{ "add_iovec", test_evbuffer_add_iovec, 0, NULL, NULL},
 	{ "copyout", test_evbuffer_copyout, 0, NULL, NULL},
 	{ "file_segment_add_cleanup_cb", test_evbuffer_file_segment_add_cleanup_cb, 0, NULL, NULL },
+	{ "chain_pool", test_evbuffer_chain_pool, TT_FORK, NULL, NULL },
+	{ "arena", test_evbuffer_arena, TT_FORK, NULL, NULL },
 
 #define ADDFILE_TEST(name, parameters)					\
 	{ name, test_evbuffer_add_file, TT_FORK|TT_NEED_BASE,		\
@@ -83,6 +83,7 @@
 
 #include "regress.h"
 #include "regress_testutils.h"
+#include "regress_thread.h"
 
 /*
  * simple bufferevent test
@@ -1045,6 +1046,71 @@ end:
 		bufferevent_free(bev2);
 }
 
+#define IS_COMMON_TIMEOUT(tv) (((tv)->tv_usec & 0xf0000000) == 0x50000000)
+
+static void
+test_bufferevent_auto_common_timeouts(void *arg)
+{
+	struct event_base *base = NULL;
+	struct event_config *cfg = NULL;
+	struct bufferevent *bev[4] = { NULL, NULL, NULL, NULL };
+	struct timeval tv[4];
+	int i;
+
+	cfg = event_config_new();
+	tt_assert(cfg);
+	tt_int_op(event_config_set_max_auto_common_timeouts(cfg, 2), ==, 0);
+	base = event_base_new_with_config(cfg);
+	tt_assert(base);
+
+	for (i = 0; i < 4; ++i) {
+		bev[i] = bufferevent_socket_new(base, -1, 0);
+		tt_assert(bev[i]);
+		tv[i].tv_sec = 10 + i;
+		tv[i].tv_usec = 0;
+	}
+
+	/* A duration that has only been seen once stays on the heap. */
+	bufferevent_set_timeouts(bev[0], &tv[0], NULL);
+	tt_assert(!IS_COMMON_TIMEOUT(BEV_EV_TIMEOUT_READ(bev[0])));
+	tt_int_op(bev[0]->timeout_read.tv_sec, ==, 10);
+	tt_assert(!evutil_timerisset(&bev[0]->timeout_write));
+
+	/* The second time around, it gets a common timeout queue, and the
+	 * user's own common timeouts share it. */
+	bufferevent_set_timeouts(bev[1], &tv[0], &tv[0]);
+	tt_assert(IS_COMMON_TIMEOUT(BEV_EV_TIMEOUT_READ(bev[1])));
+	tt_assert(IS_COMMON_TIMEOUT(BEV_EV_TIMEOUT_WRITE(bev[1])));
+	tt_int_op(BEV_EV_TIMEOUT_READ(bev[1])->tv_sec, ==, 10);
+	tt_int_op(BEV_EV_TIMEOUT_READ(bev[1])->tv_usec, ==,
+	    event_base_init_common_timeout(base, &tv[0])->tv_usec);
+	/* The public fields keep the plain durations. */
+	tt_assert(!IS_COMMON_TIMEOUT(&bev[1]->timeout_read));
+	tt_assert(evutil_timercmp(&bev[1]->timeout_read, &tv[0], ==));
+	tt_assert(evutil_timercmp(&bev[1]->timeout_write, &tv[0], ==));
+	bufferevent_set_timeouts(bev[0], &tv[0], NULL);
+	tt_assert(IS_COMMON_TIMEOUT(BEV_EV_TIMEOUT_READ(bev[0])));
+
+	/* Only two queues get created automatically. */
+	bufferevent_set_timeouts(bev[2], &tv[1], &tv[1]);
+	tt_assert(!IS_COMMON_TIMEOUT(BEV_EV_TIMEOUT_READ(bev[2])));
+	tt_assert(IS_COMMON_TIMEOUT(BEV_EV_TIMEOUT_WRITE(bev[2])));
+	bufferevent_set_timeouts(bev[3], &tv[2], &tv[2]);
+	tt_assert(!IS_COMMON_TIMEOUT(BEV_EV_TIMEOUT_READ(bev[3])));
+	tt_assert(!IS_COMMON_TIMEOUT(BEV_EV_TIMEOUT_WRITE(bev[3])));
+	tt_int_op(bev[3]->timeout_write.tv_sec, ==, 12);
+
+end:
+	for (i = 0; i < 4; ++i) {
+		if (bev[i])
+			bufferevent_free(bev[i]);
+	}
+	if (base)
+		event_base_free(base);
+	if (cfg)
+		event_config_free(cfg);
+}
+
 static void
 trigger_failure_cb(evutil_socket_t fd, short what, void *ctx)
 {
@@ -1326,6 +1392,554 @@ end:
 		bufferevent_free(filter);
 }
 
+struct uring_transfer_info {
+	struct event_base *base;
+	size_t n_read;
+	size_t n_expected;
+	int got_eof;
+	int n_high_wm;
+};
+
+static void
+uring_transfer_readcb(struct bufferevent *bev, void *ctx)
+{
+	struct uring_transfer_info *info = ctx;
+	struct evbuffer *input = bufferevent_get_input(bev);
+	size_t len = evbuffer_get_length(input);
+	unsigned char buf[4096];
+
+	if (len >= 4096)
+		++info->n_high_wm;
+	while ((len = evbuffer_remove(input, buf, sizeof(buf))) > 0) {
+		size_t i;
+		for (i = 0; i < len; ++i) {
+			if (buf[i] != (unsigned char)((info->n_read + i) % 251)) {
+				TT_FAIL(("Bad byte at %u",
+					(unsigned)(info->n_read + i)));
+				event_base_loopexit(info->base, NULL);
+				return;
+			}
+		}
+		info->n_read += len;
+	}
+}
+
+static void
+uring_transfer_eventcb(struct bufferevent *bev, short what, void *ctx)
+{
+	struct uring_transfer_info *info = ctx;
+	if (what & BEV_EVENT_EOF) {
+		info->got_eof = 1;
+		event_base_loopexit(info->base, NULL);
+	} else if (what & BEV_EVENT_ERROR) {
+		TT_FAIL(("Unexpected error %d", (int)what));
+		event_base_loopexit(info->base, NULL);
+	}
+}
+
+static void
+uring_transfer_writecb(struct bufferevent *bev, void *ctx)
+{
+	/* Everything is written: close our end, so the reader sees EOF. */
+	if (!evbuffer_get_length(bufferevent_get_output(bev)))
+		bufferevent_free(bev);
+}
+
+static void
+test_bufferevent_uring_transfer(void *arg)
+{
+	struct basic_test_data *data = arg;
+	struct bufferevent *bev1 = NULL, *bev2 = NULL;
+	struct uring_transfer_info info;
+	struct evbuffer *buf = NULL;
+	unsigned char chunk[1000];
+	size_t i;
+
+	memset(&info, 0, sizeof(info));
+	info.base = data->base;
+	info.n_expected = 1000 * 1000;
+
+	bev1 = bufferevent_socket_new(data->base, data->pair[0],
+	    BEV_OPT_CLOSE_ON_FREE);
+	bev2 = bufferevent_socket_new(data->base, data->pair[1], 0);
+	tt_assert(bev1);
+	tt_assert(bev2);
+	data->pair[0] = -1;
+
+	/* Build the data in its own buffer, then move it over in one go, so
+	 * that the writer sees lots of chains at once. */
+	buf = evbuffer_new();
+	for (i = 0; i < info.n_expected; ++i) {
+		chunk[i % sizeof(chunk)] = (unsigned char)(i % 251);
+		if (i % sizeof(chunk) == sizeof(chunk) - 1)
+			evbuffer_add(buf, chunk, sizeof(chunk));
+	}
+	tt_int_op(evbuffer_get_length(buf), ==, info.n_expected);
+
+	bufferevent_setcb(bev1, NULL, uring_transfer_writecb, NULL, &info);
+	bufferevent_setcb(bev2, uring_transfer_readcb, NULL,
+	    uring_transfer_eventcb, &info);
+	bufferevent_setwatermark(bev2, EV_READ, 0, 4096);
+	bufferevent_enable(bev2, EV_READ);
+	bufferevent_enable(bev1, EV_WRITE);
+	tt_assert(!bufferevent_write_buffer(bev1, buf));
+	bev1 = NULL; /* freed by uring_transfer_writecb */
+
+	event_base_dispatch(data->base);
+
+	tt_int_op(info.n_read, ==, info.n_expected);
+	tt_assert(info.got_eof);
+	tt_int_op(info.n_high_wm, >, 0);
+
+end:
+	if (buf)
+		evbuffer_free(buf);
+	if (bev1)
+		bufferevent_free(bev1);
+	if (bev2)
+		bufferevent_free(bev2);
+}
+
+struct zerocopy_info {
+	struct event_base *base;
+	size_t n_read;
+	size_t n_expected;
+	int released;
+	int released_at_drain;
+	int drained;
+};
+
+static void
+zerocopy_check_done(struct zerocopy_info *info)
+{
+	if (info->released && info->n_read == info->n_expected)
+		event_base_loopexit(info->base, NULL);
+}
+
+static void
+zerocopy_cleanup(const void *data, size_t len, void *arg)
+{
+	struct zerocopy_info *info = arg;
+	info->released = 1;
+	zerocopy_check_done(info);
+}
+
+static void
+zerocopy_readcb(struct bufferevent *bev, void *arg)
+{
+	struct zerocopy_info *info = arg;
+	struct evbuffer *input = bufferevent_get_input(bev);
+	unsigned char buf[4096];
+	int len;
+
+	while ((len = evbuffer_remove(input, buf, sizeof(buf))) > 0) {
+		int i;
+		for (i = 0; i < len; ++i) {
+			if (buf[i] != (unsigned char)((info->n_read + i) % 251)) {
+				TT_FAIL(("Bad byte at %u",
+					(unsigned)(info->n_read + i)));
+				event_base_loopexit(info->base, NULL);
+				return;
+			}
+		}
+		info->n_read += len;
+	}
+	zerocopy_check_done(info);
+}
+
+static void
+zerocopy_writecb(struct bufferevent *bev, void *arg)
+{
+	struct zerocopy_info *info = arg;
+	if (!info->drained &&
+	    !evbuffer_get_length(bufferevent_get_output(bev))) {
+		info->drained = 1;
+		info->released_at_drain = info->released;
+		/* Completions must still be reaped with nothing enabled. */
+		bufferevent_disable(bev, EV_READ|EV_WRITE);
+	}
+}
+
+static void
+test_bufferevent_zerocopy(void *arg)
+{
+	struct basic_test_data *data = arg;
+	struct bufferevent *bev1 = NULL, *bev2 = NULL;
+	struct zerocopy_info info;
+	struct timeval tv = { 10, 0 };
+	evutil_socket_t pair[2] = { -1, -1 };
+	unsigned char *payload = NULL, tail[100];
+	size_t i, len = 1024 * 1024;
+
+	memset(&info, 0, sizeof(info));
+	info.base = data->base;
+	info.n_expected = len + sizeof(tail);
+
+	/* MSG_ZEROCOPY only works on TCP (and UDP) sockets. */
+	tt_int_op(evutil_ersatz_socketpair_(AF_INET, SOCK_STREAM, 0, pair),
+	    ==, 0);
+	evutil_make_socket_nonblocking(pair[0]);
+	evutil_make_socket_nonblocking(pair[1]);
+	bev1 = bufferevent_socket_new(data->base, pair[0],
+	    BEV_OPT_CLOSE_ON_FREE);
+	bev2 = bufferevent_socket_new(data->base, pair[1],
+	    BEV_OPT_CLOSE_ON_FREE);
+	tt_assert(bev1);
+	tt_assert(bev2);
+	pair[0] = pair[1] = -1;
+
+	if (bufferevent_socket_set_zerocopy(bev1, 4096) < 0)
+		tt_skip();
+
+	payload = malloc(len);
+	tt_assert(payload);
+	for (i = 0; i < len; ++i)
+		payload[i] = (unsigned char)(i % 251);
+	for (i = 0; i < sizeof(tail); ++i)
+		tail[i] = (unsigned char)((len + i) % 251);
+
+	bufferevent_setcb(bev1, NULL, zerocopy_writecb, NULL, &info);
+	bufferevent_setcb(bev2, zerocopy_readcb, NULL, NULL, &info);
+	bufferevent_enable(bev1, EV_WRITE);
+	bufferevent_enable(bev2, EV_READ);
+	tt_int_op(evbuffer_add_reference(bufferevent_get_output(bev1),
+		payload, len, zerocopy_cleanup, &info), ==, 0);
+	tt_int_op(bufferevent_write(bev1, tail, sizeof(tail)), ==, 0);
+
+	event_base_loopexit(data->base, &tv);
+	event_base_dispatch(data->base);
+
+	tt_int_op(info.n_read, ==, info.n_expected);
+	/* The memory outlived the drain, and was given back after. */
+	tt_assert(info.drained);
+	tt_assert(!info.released_at_drain);
+	tt_assert(info.released);
+
+end:
+	if (bev1)
+		bufferevent_free(bev1);
+	if (bev2)
+		bufferevent_free(bev2);
+	if (pair[0] >= 0)
+		evutil_closesocket(pair[0]);
+	if (pair[1] >= 0)
+		evutil_closesocket(pair[1]);
+	if (payload)
+		free(payload);
+}
+
+static void
+zerocopy_free_writecb(struct bufferevent *bev, void *arg)
+{
+	struct zerocopy_info *info = arg;
+	/* Go away while the kernel may still be sending from our memory. */
+	if (!evbuffer_get_length(bufferevent_get_output(bev))) {
+		info->drained = 1;
+		info->released_at_drain = info->released;
+		bufferevent_free(bev);
+	}
+}
+
+static void
+test_bufferevent_zerocopy_free(void *arg)
+{
+	struct basic_test_data *data = arg;
+	struct bufferevent *bev1 = NULL, *bev2 = NULL;
+	struct zerocopy_info info;
+	struct timeval tv = { 10, 0 };
+	evutil_socket_t pair[2] = { -1, -1 };
+	unsigned char *payload = NULL;
+	size_t i, len = 1024 * 1024;
+
+	memset(&info, 0, sizeof(info));
+	info.base = data->base;
+	info.n_expected = len;
+
+	tt_int_op(evutil_ersatz_socketpair_(AF_INET, SOCK_STREAM, 0, pair),
+	    ==, 0);
+	evutil_make_socket_nonblocking(pair[0]);
+	evutil_make_socket_nonblocking(pair[1]);
+	bev1 = bufferevent_socket_new(data->base, pair[0],
+	    BEV_OPT_CLOSE_ON_FREE);
+	bev2 = bufferevent_socket_new(data->base, pair[1],
+	    BEV_OPT_CLOSE_ON_FREE);
+	tt_assert(bev1);
+	tt_assert(bev2);
+	pair[0] = pair[1] = -1;
+
+	if (bufferevent_socket_set_zerocopy(bev1, 4096) < 0)
+		tt_skip();
+
+	payload = malloc(len);
+	tt_assert(payload);
+	for (i = 0; i < len; ++i)
+		payload[i] = (unsigned char)(i % 251);
+
+	bufferevent_setcb(bev1, NULL, zerocopy_free_writecb, NULL, &info);
+	bufferevent_setcb(bev2, zerocopy_readcb, NULL, NULL, &info);
+	bufferevent_enable(bev1, EV_WRITE);
+	bufferevent_enable(bev2, EV_READ);
+	tt_int_op(evbuffer_add_reference(bufferevent_get_output(bev1),
+		payload, len, zerocopy_cleanup, &info), ==, 0);
+	bev1 = NULL;
+
+	event_base_loopexit(data->base, &tv);
+	event_base_dispatch(data->base);
+
+	/* The memory was only given back once the kernel was done, and
+	 * everything it sent from it arrived intact. */
+	tt_assert(info.drained);
+	tt_assert(info.released);
+	tt_int_op(info.n_read, ==, info.n_expected);
+
+end:
+	if (bev1)
+		bufferevent_free(bev1);
+	if (bev2)
+		bufferevent_free(bev2);
+	if (pair[0] >= 0)
+		evutil_closesocket(pair[0]);
+	if (pair[1] >= 0)
+		evutil_closesocket(pair[1]);
+	if (payload)
+		free(payload);
+}
+
+struct forward_info {
+	struct event_base *base;
+	struct bufferevent *writer;
+	size_t n_read;
+	size_t n_expected;
+};
+
+static void
+forward_writecb(struct bufferevent *bev, void *arg)
+{
+	struct forward_info *info = arg;
+	/* Once everything is sent, hang up so the forwarder sees EOF. */
+	if (!evbuffer_get_length(bufferevent_get_output(bev))) {
+		bufferevent_free(bev);
+		info->writer = NULL;
+	}
+}
+
+static void
+forward_readcb(struct bufferevent *bev, void *arg)
+{
+	struct forward_info *info = arg;
+	struct evbuffer *input = bufferevent_get_input(bev);
+	unsigned char buf[4096];
+	int len;
+
+	while ((len = evbuffer_remove(input, buf, sizeof(buf))) > 0) {
+		int i;
+		for (i = 0; i < len; ++i) {
+			if (buf[i] != (unsigned char)((info->n_read + i) % 251)) {
+				TT_FAIL(("Bad byte at %u",
+					(unsigned)(info->n_read + i)));
+				event_base_loopexit(info->base, NULL);
+				return;
+			}
+		}
+		info->n_read += len;
+	}
+	if (info->n_read == info->n_expected)
+		event_base_loopexit(info->base, NULL);
+}
+
+static void
+test_bufferevent_forward(void *arg)
+{
+	struct basic_test_data *data = arg;
+	const char *mode = data->setup_data;
+	int use_splice = !strcmp(mode, "splice");
+	struct bufferevent *src = NULL, *dst = NULL, *reader = NULL;
+	struct bufferevent *bevpair[2] = { NULL, NULL };
+	struct forward_info info;
+	struct timeval tv = { 10, 0 };
+	evutil_socket_t in[2] = { -1, -1 }, out[2] = { -1, -1 };
+	unsigned char *payload = NULL;
+	ev_uint64_t n_spliced = 0, n_copied = 0;
+	size_t i, head = 1000, len = 1024 * 1024;
+
+	memset(&info, 0, sizeof(info));
+	info.base = data->base;
+	info.n_expected = len;
+
+	payload = malloc(len);
+	tt_assert(payload);
+	for (i = 0; i < len; ++i)
+		payload[i] = (unsigned char)(i % 251);
+
+	tt_int_op(evutil_ersatz_socketpair_(AF_INET, SOCK_STREAM, 0, in),
+	    ==, 0);
+	evutil_make_socket_nonblocking(in[0]);
+	evutil_make_socket_nonblocking(in[1]);
+	info.writer = bufferevent_socket_new(data->base, in[0],
+	    BEV_OPT_CLOSE_ON_FREE);
+	src = bufferevent_socket_new(data->base, in[1], BEV_OPT_CLOSE_ON_FREE);
+	tt_assert(info.writer);
+	tt_assert(src);
+	in[0] = in[1] = -1;
+
+	if (use_splice) {
+		tt_int_op(evutil_ersatz_socketpair_(AF_INET, SOCK_STREAM, 0,
+			out), ==, 0);
+		evutil_make_socket_nonblocking(out[0]);
+		evutil_make_socket_nonblocking(out[1]);
+		dst = bufferevent_socket_new(data->base, out[0],
+		    BEV_OPT_CLOSE_ON_FREE);
+		reader = bufferevent_socket_new(data->base, out[1],
+		    BEV_OPT_CLOSE_ON_FREE);
+		out[0] = out[1] = -1;
+	} else {
+		tt_int_op(bufferevent_pair_new(data->base, 0, bevpair), ==, 0);
+		dst = bevpair[0];
+		reader = bevpair[1];
+	}
+	tt_assert(dst);
+	tt_assert(reader);
+
+	/* Small watermarks, so that reading has to stop and start again. */
+	bufferevent_setwatermark(dst, EV_WRITE, 4096, 65536);
+
+	/* What dst already had queued goes out first. */
+	tt_int_op(bufferevent_write(dst, payload, head), ==, 0);
+	tt_int_op(bufferevent_forward(src, dst), ==, 0);
+	tt_int_op(bufferevent_forward(src, reader), ==, -1);
+	tt_int_op(bufferevent_forward(reader, dst), ==, -1);
+
+	bufferevent_setcb(info.writer, NULL, forward_writecb, NULL, &info);
+	bufferevent_setcb(reader, forward_readcb, NULL, NULL, &info);
+	bufferevent_enable(info.writer, EV_WRITE);
+	bufferevent_enable(src, EV_READ);
+	bufferevent_enable(dst, EV_WRITE);
+	bufferevent_enable(reader, EV_READ);
+	tt_int_op(bufferevent_write(info.writer, payload + head, len - head),
+	    ==, 0);
+
+	event_base_loopexit(data->base, &tv);
+	event_base_dispatch(data->base);
+
+	tt_int_op(info.n_read, ==, info.n_expected);
+	tt_int_op(bufferevent_forward_get_counts(src, &n_spliced, &n_copied),
+	    ==, 0);
+	tt_int_op(n_spliced + n_copied, ==, len - head);
+#if defined(EVENT__HAVE_SPLICE) && defined(EVENT__HAVE_PIPE2)
+	if (use_splice)
+		tt_assert(n_spliced > 0);
+#endif
+	if (!use_splice)
+		tt_assert(n_spliced == 0);
+
+	tt_int_op(bufferevent_forward_stop(src), ==, 0);
+	tt_int_op(bufferevent_forward_stop(src), ==, -1);
+	tt_int_op(bufferevent_forward_get_counts(src, NULL, NULL), ==, -1);
+
+end:
+	if (info.writer)
+		bufferevent_free(info.writer);
+	if (src)
+		bufferevent_free(src);
+	if (dst)
+		bufferevent_free(dst);
+	if (reader)
+		bufferevent_free(reader);
+	if (in[0] >= 0)
+		evutil_closesocket(in[0]);
+	if (in[1] >= 0)
+		evutil_closesocket(in[1]);
+	if (out[0] >= 0)
+		evutil_closesocket(out[0]);
+	if (out[1] >= 0)
+		evutil_closesocket(out[1]);
+	if (payload)
+		free(payload);
+}
+
+#if defined(EVTHREAD_USE_PTHREADS_IMPLEMENTED)
+struct forward_lock_info {
+	struct bufferevent *src;
+	volatile int locked;
+	volatile int drained;
+	int timed_out;
+};
+
+static THREAD_FN
+forward_hold_src(void *arg)
+{
+	struct forward_lock_info *info = arg;
+	struct timeval tv = { 0, 1000 };
+	int i;
+
+	bufferevent_lock(info->src);
+	info->locked = 1;
+	for (i = 0; i < 5000 && !info->drained; ++i)
+		evutil_usleep_(&tv);
+	info->timed_out = !info->drained;
+	bufferevent_unlock(info->src);
+	THREAD_RETURN();
+}
+
+static void
+test_bufferevent_forward_lock_order(void *arg)
+{
+	struct basic_test_data *data = arg;
+	struct bufferevent *in[2] = { NULL, NULL }, *out[2] = { NULL, NULL };
+	struct bufferevent *src, *dst;
+	struct forward_lock_info info;
+	struct timeval tv = { 0, 1000 };
+	char buf[128];
+	THREAD_T thread;
+
+	memset(&info, 0, sizeof(info));
+	memset(buf, 'x', sizeof(buf));
+	tt_int_op(bufferevent_pair_new(data->base, BEV_OPT_THREADSAFE, in),
+	    ==, 0);
+	tt_int_op(bufferevent_pair_new(data->base, BEV_OPT_THREADSAFE, out),
+	    ==, 0);
+	src = in[1];
+	dst = out[0];
+
+	/* Fill dst past its high watermark, so that src stops reading. */
+	bufferevent_setwatermark(dst, EV_WRITE, 0, 64);
+	tt_int_op(bufferevent_forward(src, dst), ==, 0);
+	bufferevent_enable(src, EV_READ);
+	tt_int_op(bufferevent_write(in[0], buf, sizeof(buf)), ==, 0);
+	event_base_loop(data->base, EVLOOP_NONBLOCK);
+	tt_int_op(evbuffer_get_length(bufferevent_get_output(dst)), ==,
+	    sizeof(buf));
+	tt_assert(BEV_UPCAST(src)->read_suspended & BEV_SUSPEND_FORWARD);
+
+	/* Emptying dst while someone else holds src must not wait for
+	 * src's lock: whoever holds it may be waiting for dst's. */
+	info.src = src;
+	THREAD_START(thread, forward_hold_src, &info);
+	while (!info.locked)
+		evutil_usleep_(&tv);
+	tt_int_op(bufferevent_enable(out[1], EV_READ), ==, 0);
+	tt_int_op(evbuffer_get_length(bufferevent_get_output(dst)), ==, 0);
+	info.drained = 1;
+	THREAD_JOIN(thread);
+	tt_assert(!info.timed_out);
+
+	/* Reading starts again from the loop. */
+	tt_assert(BEV_UPCAST(src)->read_suspended & BEV_SUSPEND_FORWARD);
+	event_base_loop(data->base, EVLOOP_NONBLOCK);
+	tt_assert(!(BEV_UPCAST(src)->read_suspended & BEV_SUSPEND_FORWARD));
+
+end:
+	if (in[0])
+		bufferevent_free(in[0]);
+	if (in[1])
+		bufferevent_free(in[1]);
+	if (out[0])
+		bufferevent_free(out[0]);
+	if (out[1])
+		bufferevent_free(out[1]);
+}
+#endif
+
 struct testcase_t bufferevent_testcases[] = {
 
 	LEGACY(bufferevent, TT_ISOLATED),
@@ -1367,6 +1981,8 @@ struct testcase_t bufferevent_testcases[] = {
 	  TT_FORK|TT_NEED_BASE, &basic_setup, (void*)"pair" },
 	{ "bufferevent_timeout_filter", test_bufferevent_timeouts,
 	  TT_FORK|TT_NEED_BASE, &basic_setup, (void*)"filter" },
+	{ "bufferevent_auto_common_timeouts",
+	  test_bufferevent_auto_common_timeouts, TT_FORK, NULL, NULL },
 	{ "bufferevent_timeout_filter_pair", test_bufferevent_timeouts,
 	  TT_FORK|TT_NEED_BASE, &basic_setup, (void*)"filter pair" },
 	{ "bufferevent_trigger", test_bufferevent_trigger, TT_FORK|TT_NEED_BASE,
@@ -1401,6 +2017,19 @@ struct testcase_t bufferevent_testcases[] = {
 	{ "bufferevent_filter_data_stuck",
 	  test_bufferevent_filter_data_stuck,
 	  TT_FORK|TT_NEED_BASE, &basic_setup, NULL },
+	{ "bufferevent_zerocopy", test_bufferevent_zerocopy,
+	  TT_FORK|TT_NEED_BASE, &basic_setup, NULL },
+	{ "bufferevent_zerocopy_free", test_bufferevent_zerocopy_free,
+	  TT_FORK|TT_NEED_BASE, &basic_setup, NULL },
+	{ "bufferevent_forward_splice", test_bufferevent_forward,
+	  TT_FORK|TT_NEED_BASE, &basic_setup, (void*)"splice" },
+	{ "bufferevent_forward_copy", test_bufferevent_forward,
+	  TT_FORK|TT_NEED_BASE, &basic_setup, (void*)"copy" },
+#if defined(EVTHREAD_USE_PTHREADS_IMPLEMENTED)
+	{ "bufferevent_forward_lock_order",
+	  test_bufferevent_forward_lock_order,
+	  TT_FORK|TT_NEED_THREADS|TT_NEED_BASE, &basic_setup, NULL },
+#endif
 
 	END_OF_TESTCASES,
 };
@@ -1437,3 +2066,23 @@ struct testcase_t bufferevent_iocp_testcases[] = {
 
 	END_OF_TESTCASES,
 };
+
+#define TT_URING (TT_FORK|TT_NEED_BASE|TT_ENABLE_IO_URING)
+struct testcase_t bufferevent_uring_testcases[] = {
+	{ "bufferevent_transfer", test_bufferevent_uring_transfer,
+	  TT_URING|TT_NEED_SOCKETPAIR, &basic_setup, NULL },
+	{ "bufferevent_connect", test_bufferevent_connect,
+	  TT_URING, &basic_setup, (void*)"" },
+	{ "bufferevent_connect_defer", test_bufferevent_connect,
+	  TT_URING, &basic_setup, (void*)"defer" },
+	{ "bufferevent_connect_fail", test_bufferevent_connect_fail,
+	  TT_URING, &basic_setup, NULL },
+	{ "bufferevent_connect_fail_eventcb",
+	  test_bufferevent_connect_fail_eventcb, TT_URING, &basic_setup, NULL },
+	{ "bufferevent_timeout", test_bufferevent_timeouts,
+	  TT_URING, &basic_setup, (void*)"" },
+	{ "bufferevent_trigger", test_bufferevent_trigger,
+	  TT_URING, &basic_setup, (void*)"" },
+
+	END_OF_TESTCASES,
+};
@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2007-2012 Niels Provos and Nick Mathewson
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "util-internal.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <windows.h>
+#endif
+
+#include <sys/types.h>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <netinet/in.h>
+# ifdef _XOPEN_SOURCE_EXTENDED
+#  include <arpa/inet.h>
+# endif
+#include <unistd.h>
+#endif
+
+#include <string.h>
+
+#include "event2/dgram.h"
+#include "event2/event.h"
+#include "event2/util.h"
+
+#include "regress.h"
+#include "tinytest.h"
+#include "tinytest_macros.h"
+
+/* Make a nonblocking UDP socket bound to a free port on 127.0.0.1, and
+ * store its address in *sin. */
+static evutil_socket_t
+dgram_socket(struct sockaddr_in *sin)
+{
+	evutil_socket_t fd;
+	ev_socklen_t slen = sizeof(*sin);
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0)
+		return fd;
+	memset(sin, 0, sizeof(*sin));
+	sin->sin_family = AF_INET;
+	sin->sin_addr.s_addr = htonl(0x7f000001);
+	if (bind(fd, (struct sockaddr *)sin, sizeof(*sin)) < 0 ||
+	    getsockname(fd, (struct sockaddr *)sin, &slen) < 0 ||
+	    evutil_make_socket_nonblocking(fd) < 0) {
+		evutil_closesocket(fd);
+		return -1;
+	}
+	return fd;
+}
+
+struct dgram_info {
+	struct event_base *base;
+	int n_calls;
+	int n_msgs;
+	int n_expected;
+	int n_truncated;
+	size_t len_seen[64];
+	unsigned char first_byte[64];
+	struct sockaddr_in from;
+};
+
+static void
+dgram_readcb(struct evdgram *dg, struct evdgram_msg *msgs, int n_msgs,
+    void *arg)
+{
+	struct dgram_info *info = arg;
+	int i;
+
+	++info->n_calls;
+	for (i = 0; i < n_msgs; ++i) {
+		if (info->n_msgs < 64) {
+			info->len_seen[info->n_msgs] = msgs[i].len;
+			info->first_byte[info->n_msgs] =
+			    msgs[i].len ? msgs[i].data[0] : 0;
+		}
+		if (msgs[i].truncated)
+			++info->n_truncated;
+		if (msgs[i].socklen == sizeof(info->from))
+			memcpy(&info->from, msgs[i].addr, sizeof(info->from));
+		++info->n_msgs;
+	}
+	if (info->n_msgs >= info->n_expected)
+		event_base_loopexit(info->base, NULL);
+}
+
+static void
+regress_dgram_batch_read(void *arg)
+{
+	struct basic_test_data *data = arg;
+	struct evdgram *dg = NULL;
+	struct dgram_info info;
+	struct sockaddr_in sin_r, sin_w;
+	struct timeval tv = { 5, 0 };
+	evutil_socket_t r = -1, w = -1;
+	unsigned char buf[200];
+	int i;
+
+	memset(&info, 0, sizeof(info));
+	info.base = data->base;
+	info.n_expected = 11;
+
+	tt_assert((r = dgram_socket(&sin_r)) >= 0);
+	tt_assert((w = dgram_socket(&sin_w)) >= 0);
+
+	/* Ten ordinary datagrams and one too big for the evdgram. */
+	for (i = 0; i < 10; ++i) {
+		memset(buf, 'a' + i, 10 + i);
+		tt_int_op(sendto(w, (void *)buf, 10 + i, 0,
+			(struct sockaddr *)&sin_r, sizeof(sin_r)), ==, 10 + i);
+	}
+	memset(buf, 'z', sizeof(buf));
+	tt_int_op(sendto(w, (void *)buf, sizeof(buf), 0,
+		(struct sockaddr *)&sin_r, sizeof(sin_r)), ==, sizeof(buf));
+
+	dg = evdgram_new(data->base, r, EVDGRAM_OPT_CLOSE_ON_FREE, 16, 100,
+	    dgram_readcb, &info);
+	tt_assert(dg);
+	r = -1;
+	tt_int_op(evdgram_get_fd(dg), >=, 0);
+	tt_ptr_op(evdgram_get_base(dg), ==, data->base);
+
+	event_base_loopexit(data->base, &tv);
+	event_base_dispatch(data->base);
+
+	tt_int_op(info.n_msgs, ==, 11);
+	/* They were all waiting, so they all came in one read. */
+	tt_int_op(info.n_calls, ==, 1);
+	for (i = 0; i < 10; ++i) {
+		tt_int_op(info.len_seen[i], ==, 10 + i);
+		tt_int_op(info.first_byte[i], ==, 'a' + i);
+	}
+	tt_int_op(info.len_seen[10], <=, 100);
+	tt_int_op(info.first_byte[10], ==, 'z');
+#ifdef EVENT__HAVE_RECVMMSG
+	tt_int_op(info.n_truncated, ==, 1);
+#endif
+	tt_int_op(info.from.sin_port, ==, sin_w.sin_port);
+
+end:
+	if (dg)
+		evdgram_free(dg);
+	if (r >= 0)
+		evutil_closesocket(r);
+	if (w >= 0)
+		evutil_closesocket(w);
+}
+
+static void
+regress_dgram_send(void *arg)
+{
+	struct basic_test_data *data = arg;
+	const char *mode = data->setup_data;
+	struct evdgram *dg_r = NULL, *dg_w = NULL;
+	struct dgram_info info;
+	struct sockaddr_in sin_r, sin_w;
+	struct timeval tv = { 5, 0 };
+	evutil_socket_t r = -1, w = -1;
+	unsigned char buf[300];
+	unsigned flags = EVDGRAM_OPT_CLOSE_ON_FREE;
+	int i, n = 9;
+
+	if (!strcmp(mode, "gso"))
+		flags |= EVDGRAM_OPT_GSO;
+
+	memset(&info, 0, sizeof(info));
+	info.base = data->base;
+	info.n_expected = n;
+
+	tt_assert((r = dgram_socket(&sin_r)) >= 0);
+	tt_assert((w = dgram_socket(&sin_w)) >= 0);
+	dg_r = evdgram_new(data->base, r, EVDGRAM_OPT_CLOSE_ON_FREE, 0, 0,
+	    dgram_readcb, &info);
+	tt_assert(dg_r);
+	r = -1;
+	dg_w = evdgram_new(data->base, w, flags, 0, 0, NULL, NULL);
+	tt_assert(dg_w);
+	w = -1;
+
+	/* Eight of the same size, which GSO can send as one, and a shorter
+	 * one to finish. */
+	for (i = 0; i < n; ++i) {
+		size_t len = i < n - 1 ? sizeof(buf) : 17;
+		memset(buf, 'a' + i, sizeof(buf));
+		tt_int_op(evdgram_send(dg_w, buf, len,
+			(struct sockaddr *)&sin_r, sizeof(sin_r)), ==, 0);
+	}
+	/* Nothing goes out until the loop runs. */
+	tt_int_op(evdgram_get_n_queued(dg_w), >=, 1);
+	tt_int_op(evdgram_get_n_queued(dg_w), <=, n);
+
+	event_base_loopexit(data->base, &tv);
+	event_base_dispatch(data->base);
+
+	tt_int_op(evdgram_get_n_queued(dg_w), ==, 0);
+	tt_int_op(info.n_msgs, ==, n);
+	for (i = 0; i < n; ++i) {
+		tt_int_op(info.len_seen[i], ==, i < n - 1 ? sizeof(buf) : 17);
+		tt_int_op(info.first_byte[i], ==, 'a' + i);
+	}
+	tt_int_op(info.from.sin_port, ==, sin_w.sin_port);
+
+	/* evdgram_flush() sends at once. */
+	info.n_msgs = 0;
+	info.n_expected = 1;
+	tt_int_op(evdgram_send(dg_w, "x", 1,
+		(struct sockaddr *)&sin_r, sizeof(sin_r)), ==, 0);
+	tt_int_op(evdgram_flush(dg_w), ==, 0);
+	event_base_loopexit(data->base, &tv);
+	event_base_dispatch(data->base);
+	tt_int_op(info.n_msgs, ==, 1);
+	tt_int_op(info.first_byte[0], ==, 'x');
+
+end:
+	if (dg_r)
+		evdgram_free(dg_r);
+	if (dg_w)
+		evdgram_free(dg_w);
+	if (r >= 0)
+		evutil_closesocket(r);
+	if (w >= 0)
+		evutil_closesocket(w);
+}
+
+struct testcase_t dgram_testcases[] = {
+	{ "batch_read", regress_dgram_batch_read,
+	  TT_FORK|TT_NEED_BASE, &basic_setup, NULL },
+	{ "send", regress_dgram_send,
+	  TT_FORK|TT_NEED_BASE, &basic_setup, (void*)"plain" },
+	{ "send_gso", regress_dgram_send,
+	  TT_FORK|TT_NEED_BASE, &basic_setup, (void*)"gso" },
+
+	END_OF_TESTCASES,
+};
@@ -56,11 +56,13 @@
 
 #include "event2/event.h"
 #include "event2/http.h"
+#include "event2/http_struct.h"
 #include "event2/buffer.h"
 #include "event2/bufferevent.h"
 #include "event2/bufferevent_ssl.h"
 #include "event2/util.h"
 #include "event2/listener.h"
+#include "event2/thread.h"
 #include "log-internal.h"
 #include "http-internal.h"
 #include "regress.h"
@@ -3908,7 +3910,7 @@ http_primitives(void *ptr)
 }
 
 static void
-http_multi_line_header_test(void *arg)
+http_multi_line_header_test_impl(void *arg, int flags)
 {
 	struct basic_test_data *data = arg;
 	struct bufferevent *bev= NULL;
@@ -3921,6 +3923,7 @@ http_multi_line_header_test(void *arg)
 	test_ok = 0;
 
 	tt_ptr_op(http, !=, NULL);
+	tt_assert(!evhttp_set_flags(http, flags));
 
 	fd = http_connect("127.0.0.1", port);
 	tt_assert(fd != EVUTIL_INVALID_SOCKET);
@@ -3959,6 +3962,242 @@ http_multi_line_header_test(void *arg)
 	if (http)
 		evhttp_free(http);
 }
+static void http_multi_line_header_test(void *arg)
+{ http_multi_line_header_test_impl(arg, 0); }
+static void http_multi_line_header_inplace_test(void *arg)
+{ http_multi_line_header_test_impl(arg, EVHTTP_SERVER_INPLACE_HEADERS); }
+
+/* Print the headers and what's left of the buffer, so that the two header
+ * parsers can be compared. */
+static void
+http_dump_parse_result(struct evbuffer *out, enum message_read_status status,
+    struct evhttp_request *req, struct evbuffer *buf)
+{
+	struct evkeyval *header;
+
+	evbuffer_add_printf(out, "%d:", (int)status);
+	if (status == ALL_DATA_READ) {
+		TAILQ_FOREACH(header, req->input_headers, next) {
+			evbuffer_add_printf(out, "[%s]=[%s] ",
+			    header->key, header->value);
+		}
+		evbuffer_add_printf(out, "rest=[%.*s] size=%u",
+		    (int)evbuffer_get_length(buf),
+		    (const char *)evbuffer_pullup(buf, -1),
+		    (unsigned)req->headers_size);
+	}
+}
+
+static void
+http_parse_headers_inplace_test(void *arg)
+{
+	struct basic_test_data *data = arg;
+	static const char *blocks[] = {
+		"Host: a\r\nX-Multi:  aaa  \r\n b \r\n\tEND\r\n"
+		"X-Last: last\r\n\r\nBODY",
+		"A: 1\nB:2\n\nBODY",
+		"Empty:\r\nSpaces:   \r\n\r\n",
+		"\r\nBODY",
+		"Folded: one\r\n two\r\n\r\n",
+		"NoColon\r\n\r\n",
+		"K\rey: v\r\n\r\n",
+		"K: v\r\rx\r\n\r\n",
+		" leading continuation\r\n\r\n",
+		"Big: 0123456789012345678901234567890123456789\r\n\r\n",
+		NULL
+	};
+	struct evhttp_connection *evcon = NULL;
+	struct evhttp_request *req = NULL;
+	struct evbuffer *buf = NULL, *out[2] = { NULL, NULL };
+	enum message_read_status status;
+	size_t i, split, len;
+	int inplace;
+
+	evcon = evhttp_connection_base_new(data->base, NULL, "127.0.0.1", 80);
+	tt_assert(evcon);
+	evhttp_connection_set_max_headers_size(evcon, 40);
+	out[0] = evbuffer_new();
+	out[1] = evbuffer_new();
+	tt_assert(out[0] && out[1]);
+
+	for (i = 0; blocks[i]; ++i) {
+		len = strlen(blocks[i]);
+		/* Deliver the block in two pieces, split everywhere. */
+		for (split = 0; split <= len; ++split) {
+			for (inplace = 0; inplace < 2; ++inplace) {
+				tt_assert(!evhttp_connection_set_flags(evcon,
+					inplace ? EVHTTP_CON_INPLACE_HEADERS : 0));
+				req = evhttp_request_new(NULL, NULL);
+				tt_assert(req);
+				req->evcon = evcon;
+				buf = evbuffer_new();
+				tt_assert(buf);
+
+				evbuffer_add(buf, blocks[i], split);
+				status = evhttp_parse_headers_(req, buf);
+				if (status == MORE_DATA_EXPECTED) {
+					evbuffer_add(buf, blocks[i] + split,
+					    len - split);
+					status = evhttp_parse_headers_(req, buf);
+				}
+				evbuffer_drain(out[inplace], -1);
+				http_dump_parse_result(out[inplace], status,
+				    req, buf);
+
+				req->evcon = NULL;
+				evhttp_request_free(req);
+				req = NULL;
+				evbuffer_free(buf);
+				buf = NULL;
+			}
+			evbuffer_add(out[0], "", 1);
+			evbuffer_add(out[1], "", 1);
+			tt_str_op((const char *)evbuffer_pullup(out[1], -1),
+			    ==, (const char *)evbuffer_pullup(out[0], -1));
+		}
+		TT_BLATHER(("%s", (const char *)evbuffer_pullup(out[0], -1)));
+	}
+
+ end:
+	if (req) {
+		req->evcon = NULL;
+		evhttp_request_free(req);
+	}
+	if (buf)
+		evbuffer_free(buf);
+	if (out[0])
+		evbuffer_free(out[0]);
+	if (out[1])
+		evbuffer_free(out[1]);
+	if (evcon)
+		evhttp_connection_free(evcon);
+}
+
+static void
+http_parse_headers_inplace_resume_test(void *arg)
+{
+	struct basic_test_data *data = arg;
+	const char *block = "Host: a\r\nX-Long: 0123456789\r\n\r\nBODY";
+	struct evhttp_connection *evcon = NULL;
+	struct evhttp_request *req = NULL;
+	struct evbuffer *buf = NULL;
+	enum message_read_status status = MORE_DATA_EXPECTED;
+	size_t i, len = strlen(block);
+
+	evcon = evhttp_connection_base_new(data->base, NULL, "127.0.0.1", 80);
+	tt_assert(evcon);
+	tt_assert(!evhttp_connection_set_flags(evcon,
+		EVHTTP_CON_INPLACE_HEADERS));
+	req = evhttp_request_new(NULL, NULL);
+	tt_assert(req);
+	req->evcon = evcon;
+	buf = evbuffer_new();
+	tt_assert(buf);
+
+	/* One byte at a time: each call only looks at the lines it hasn't
+	 * seen yet. */
+	for (i = 0; i < len && status == MORE_DATA_EXPECTED; ++i) {
+		evbuffer_add(buf, block + i, 1);
+		status = evhttp_parse_headers_(req, buf);
+		if (i == 9)
+			tt_int_op(evcon->header_scan_off, ==, 9);
+	}
+	tt_int_op(status, ==, ALL_DATA_READ);
+	tt_int_op(i, ==, 31);
+	tt_int_op(evcon->header_scan_off, ==, 0);
+	tt_int_op(req->headers_size, ==, 7 + 18);
+	tt_str_op(evhttp_find_header(req->input_headers, "Host"), ==, "a");
+	tt_str_op(evhttp_find_header(req->input_headers, "X-Long"), ==,
+	    "0123456789");
+	tt_int_op(evbuffer_get_length(buf), ==, 0);
+
+ end:
+	if (req) {
+		req->evcon = NULL;
+		evhttp_request_free(req);
+	}
+	if (buf)
+		evbuffer_free(buf);
+	if (evcon)
+		evhttp_connection_free(evcon);
+}
+
+static void
+http_header_ownership_test(void *arg)
+{
+	struct basic_test_data *data = arg;
+	const char *block = "A: one\r\nB: two\r\n\r\n";
+	struct evhttp_connection *evcon = NULL;
+	struct evhttp_request *req = NULL;
+	struct evbuffer *buf = NULL;
+	struct evkeyvalq headers;
+	struct evkeyval *header;
+	int inplace;
+
+	/* Headers built by hand, with their own key and value. */
+	TAILQ_INIT(&headers);
+	header = calloc(1, sizeof(*header));
+	tt_assert(header);
+	header->key = strdup("Mine");
+	header->value = strdup("yes");
+	TAILQ_INSERT_TAIL(&headers, header, next);
+	tt_int_op(evhttp_add_header(&headers, "Theirs", "no"), ==, 0);
+	tt_str_op(evhttp_find_header(&headers, "Mine"), ==, "yes");
+
+	/* Replacing a value is fine. */
+	header = TAILQ_LAST(&headers, evkeyvalq);
+	free(header->value);
+	header->value = strdup("changed");
+	tt_str_op(evhttp_find_header(&headers, "Theirs"), ==, "changed");
+	tt_int_op(evhttp_remove_header(&headers, "Mine"), ==, 0);
+	evhttp_clear_headers(&headers);
+	tt_assert(TAILQ_EMPTY(&headers));
+
+	/* So is it for headers parsed either way. */
+	evcon = evhttp_connection_base_new(data->base, NULL, "127.0.0.1", 80);
+	tt_assert(evcon);
+	for (inplace = 0; inplace < 2; ++inplace) {
+		tt_assert(!evhttp_connection_set_flags(evcon,
+			inplace ? EVHTTP_CON_INPLACE_HEADERS : 0));
+		req = evhttp_request_new(NULL, NULL);
+		tt_assert(req);
+		req->evcon = evcon;
+		buf = evbuffer_new();
+		tt_assert(buf);
+		evbuffer_add(buf, block, strlen(block));
+		tt_int_op(evhttp_parse_headers_(req, buf), ==, ALL_DATA_READ);
+
+		header = TAILQ_FIRST(req->input_headers);
+		tt_assert(header);
+		tt_str_op(header->key, ==, "A");
+		tt_int_op(header->flags, ==,
+		    inplace ? EVHTTP_HEADER_PACKED : 0);
+		if (!inplace)
+			free(header->value);
+		header->value = strdup("replaced");
+		tt_str_op(evhttp_find_header(req->input_headers, "A"), ==,
+		    "replaced");
+		tt_int_op(evhttp_remove_header(req->input_headers, "B"), ==,
+		    0);
+
+		req->evcon = NULL;
+		evhttp_request_free(req);
+		req = NULL;
+		evbuffer_free(buf);
+		buf = NULL;
+	}
+
+ end:
+	evhttp_clear_headers(&headers);
+	if (req) {
+		req->evcon = NULL;
+		evhttp_request_free(req);
+	}
+	if (buf)
+		evbuffer_free(buf);
+	if (evcon)
+		evhttp_connection_free(evcon);
+}
 
 static void
 http_request_bad(struct evhttp_request *req, void *arg)
@@ -4651,6 +4890,149 @@ http_request_extra_body_test(void *arg)
 		evbuffer_free(body);
 }
 
+#ifdef EVTHREAD_USE_PTHREADS_IMPLEMENTED
+struct http_worker_info {
+	struct event_base *workers[2];
+	int served[2];
+	int wrong_base;
+	int done;
+	struct event_base *client_base;
+};
+
+static void
+http_worker_cb(struct evhttp_request *req, void *arg)
+{
+	struct http_worker_info *info = arg;
+	struct event_base *base =
+	    evhttp_connection_get_base(evhttp_request_get_connection(req));
+	struct evbuffer *evb = evbuffer_new();
+
+	/* Each worker only ever touches its own slot. */
+	if (base == info->workers[0])
+		++info->served[0];
+	else if (base == info->workers[1])
+		++info->served[1];
+	else
+		++info->wrong_base;
+
+	evbuffer_add_printf(evb, "%s", evhttp_request_get_uri(req));
+	evhttp_send_reply(req, HTTP_OK, "Everything is fine", evb);
+	evbuffer_free(evb);
+}
+
+static void
+http_worker_done(struct evhttp_request *req, void *arg)
+{
+	struct http_worker_info *info = arg;
+
+	if (!req || evhttp_request_get_response_code(req) != HTTP_OK)
+		info->wrong_base = -1000;
+	if (++info->done == 12)
+		event_base_loopexit(info->client_base, NULL);
+}
+
+static void
+http_worker_bases_test(void *arg)
+{
+	struct basic_test_data *data = arg;
+	struct http_worker_info info;
+	struct event_base_group *grp = NULL;
+	struct evhttp *http = NULL;
+	struct evhttp_connection *evcons[4] = { NULL, NULL, NULL, NULL };
+	ev_uint16_t port = 0;
+	char uri[32];
+	int i, j;
+
+	memset(&info, 0, sizeof(info));
+	info.client_base = data->base;
+
+	http = http_setup(&port, data->base, 0);
+	tt_assert(http);
+	evhttp_set_gencb(http, http_worker_cb, &info);
+
+	grp = event_base_group_new(NULL, 2, EVENT_BASE_GROUP_NO_AFFINITY);
+	tt_assert(grp);
+	info.workers[0] = event_base_group_get_base(grp, 0);
+	info.workers[1] = event_base_group_get_base(grp, 1);
+	tt_int_op(evhttp_set_worker_bases(http,
+		event_base_group_get_bases(grp), 2), ==, 0);
+
+	for (i = 0; i < 4; ++i) {
+		evcons[i] = evhttp_connection_base_new(data->base, NULL,
+		    "127.0.0.1", port);
+		tt_assert(evcons[i]);
+		for (j = 0; j < 3; ++j) {
+			struct evhttp_request *req =
+			    evhttp_request_new(http_worker_done, &info);
+			tt_assert(req);
+			evutil_snprintf(uri, sizeof(uri), "/worker/%d", i*3+j);
+			tt_int_op(evhttp_make_request(evcons[i], req,
+				EVHTTP_REQ_GET, uri), ==, 0);
+		}
+	}
+
+	event_base_dispatch(data->base);
+
+	tt_int_op(info.done, ==, 12);
+	tt_int_op(info.wrong_base, ==, 0);
+	/* The connections were handed out round-robin. */
+	tt_int_op(info.served[0], ==, 6);
+	tt_int_op(info.served[1], ==, 6);
+
+end:
+	for (i = 0; i < 4; ++i) {
+		if (evcons[i])
+			evhttp_connection_free(evcons[i]);
+	}
+	if (grp)
+		event_base_group_stop(grp);
+	if (http)
+		evhttp_free(http);
+	if (grp)
+		event_base_group_free(grp);
+}
+
+static void
+http_worker_bases_pending_test(void *arg)
+{
+	struct basic_test_data *data = arg;
+	struct event_base *worker = NULL;
+	struct evhttp *http = NULL;
+	struct timeval tv = { 0, 200*1000 };
+	evutil_socket_t fd = -1;
+	ev_uint16_t port = 0;
+	char c;
+
+	http = http_setup(&port, data->base, 0);
+	tt_assert(http);
+	worker = event_base_new();
+	tt_assert(worker);
+	tt_int_op(evhttp_set_worker_bases(http, &worker, 1), ==, 0);
+
+	/* Accept a connection, but never run the worker's loop. */
+	fd = http_connect("127.0.0.1", port);
+	tt_assert(fd != EVUTIL_INVALID_SOCKET);
+	event_base_loopexit(data->base, &tv);
+	event_base_dispatch(data->base);
+
+	/* evhttp_free() closes the connection that is still waiting. */
+	evhttp_free(http);
+	http = NULL;
+	tt_int_op(recv(fd, &c, 1, 0), ==, 0);
+
+	/* And the worker never hears of it. */
+	tt_int_op(event_base_loop(worker, EVLOOP_NONBLOCK), ==, 1);
+
+end:
+	if (fd >= 0)
+		evutil_closesocket(fd);
+	if (http)
+		evhttp_free(http);
+	if (worker)
+		event_base_free(worker);
+}
+#endif
+
 #define HTTP_LEGACY(name)						\
 	{ #name, run_legacy_test_fn, TT_ISOLATED|TT_LEGACY, &legacy_setup, \
 		    http_##name##_test }
@@ -4748,6 +5130,10 @@ struct testcase_t http_testcases[] = {
 	HTTP(highport),
 	HTTP(dispatcher),
 	HTTP(multi_line_header),
+	HTTP(multi_line_header_inplace),
+	HTTP(parse_headers_inplace),
+	HTTP(parse_headers_inplace_resume),
+	HTTP(header_ownership),
 	HTTP(negative_content_length),
 	HTTP(chunk_out),
 	HTTP(stream_out),
@@ -4776,6 +5162,11 @@ struct testcase_t http_testcases[] = {
 	HTTP(request_own),
 
 	HTTP(request_extra_body),
+#ifdef EVTHREAD_USE_PTHREADS_IMPLEMENTED
+	HTTP_N(worker_bases, worker_bases, TT_NEED_THREADS, NULL),
+	HTTP_N(worker_bases_pending, worker_bases_pending, TT_NEED_THREADS,
+	    NULL),
+#endif
 
 #ifdef EVENT__HAVE_OPENSSL
 	HTTPS(basic),
@@ -269,6 +269,89 @@ end:
 		evconnlistener_free(listener);
 }
 
+struct batch_info {
+	int n_batches;
+	int n_conns;
+	int max_batch;
+	int bad_addrs;
+};
+
+static void
+batchcb(struct evconnlistener *listener, struct evconnlistener_conn *conns,
+    int n_conns, void *arg)
+{
+	struct batch_info *info = arg;
+	int i;
+
+	++info->n_batches;
+	info->n_conns += n_conns;
+	if (n_conns > info->max_batch)
+		info->max_batch = n_conns;
+	for (i = 0; i < n_conns; ++i) {
+		if (conns[i].addr->sa_family != AF_INET ||
+		    conns[i].socklen != sizeof(struct sockaddr_in))
+			++info->bad_addrs;
+		evutil_closesocket(conns[i].fd);
+	}
+}
+
+#define N_BATCH_CONNS 8
+
+static void
+regress_listener_batch(void *arg)
+{
+	struct basic_test_data *data = arg;
+	struct event_base *base = data->base;
+	struct evconnlistener *listener = NULL;
+	struct batch_info info;
+	struct sockaddr_in sin;
+	struct sockaddr_storage ss;
+	ev_socklen_t slen = sizeof(ss);
+	struct timeval tv = { 0, 100000 };
+	evutil_socket_t fds[N_BATCH_CONNS];
+	int i;
+
+	for (i = 0; i < N_BATCH_CONNS; ++i)
+		fds[i] = EVUTIL_INVALID_SOCKET;
+	memset(&info, 0, sizeof(info));
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(0x7f000001); /* 127.0.0.1 */
+	sin.sin_port = 0; /* "You pick!" */
+
+	listener = evconnlistener_new_bind(base, acceptcb, NULL,
+	    LEV_OPT_CLOSE_ON_FREE|LEV_OPT_REUSEABLE, -1,
+	    (struct sockaddr *)&sin, sizeof(sin));
+	tt_assert(listener);
+	tt_int_op(evconnlistener_set_batch_cb(listener, batchcb, &info), ==, 0);
+	evconnlistener_set_accept_budget(listener, 3);
+	tt_assert(getsockname(evconnlistener_get_fd(listener),
+		(struct sockaddr*)&ss, &slen) == 0);
+
+	for (i = 0; i < N_BATCH_CONNS; ++i)
+		evutil_socket_connect_(&fds[i], (struct sockaddr*)&ss, slen);
+	/* Let the handshakes finish, so that the whole backlog is there when
+	 * the listener first wakes up. */
+	evutil_usleep_(&tv);
+
+	/* Each pass through the loop takes at most a budget's worth. */
+	for (i = 0; i < 20 && info.n_conns < N_BATCH_CONNS; ++i)
+		event_base_loop(base, EVLOOP_ONCE);
+
+	tt_int_op(info.n_conns, ==, N_BATCH_CONNS);
+	tt_int_op(info.max_batch, ==, 3);
+	tt_int_op(info.n_batches, ==, 3);
+	tt_int_op(info.bad_addrs, ==, 0);
+
+end:
+	for (i = 0; i < N_BATCH_CONNS; ++i) {
+		if (fds[i] >= 0)
+			evutil_closesocket(fds[i]);
+	}
+	if (listener)
+		evconnlistener_free(listener);
+}
+
 #ifdef EVENT__HAVE_SETRLIMIT
 static void
 regress_listener_error_unlock(void *arg)
@@ -332,6 +415,9 @@ struct testcase_t listener_testcases[] = {
 	{ "immediate_close", regress_listener_immediate_close,
 	  TT_FORK|TT_NEED_BASE, &basic_setup, NULL, },
 
+	{ "batch", regress_listener_batch,
+	  TT_FORK|TT_NEED_BASE, &basic_setup, NULL, },
+
 	END_OF_TESTCASES,
 };
 
@@ -228,14 +228,34 @@ basic_test_setup(const struct testcase_t *testcase)
 			exit(1);
 		}
 	}
+#ifndef EVENT__HAVE_IO_URING
+	if (testcase->flags & TT_ENABLE_IO_URING)
+		return (void*)TT_SKIP;
+#endif
+
 	if (testcase->flags & TT_NEED_BASE) {
 		if (testcase->flags & TT_LEGACY)
 			base = event_init();
-		else
+		else if (testcase->flags & TT_ENABLE_IO_URING) {
+			struct event_config *cfg = event_config_new();
+			if (!cfg)
+				exit(1);
+			event_config_avoid_method(cfg, "epoll");
+			event_config_set_flag(cfg,
+			    EVENT_BASE_FLAG_IO_URING_COMPLETION);
+			base = event_base_new_with_config(cfg);
+			event_config_free(cfg);
+		} else
 			base = event_base_new();
 		if (!base)
 			exit(1);
 	}
+	if (testcase->flags & TT_ENABLE_IO_URING) {
+		if (strcmp(event_base_get_method(base), "io_uring")) {
+			event_base_free(base);
+			return (void*)TT_SKIP;
+		}
+	}
 	if (testcase->flags & TT_ENABLE_IOCP_FLAG) {
 		if (event_base_start_iocp_(base, 0)<0) {
 			event_base_free(base);
@@ -380,6 +400,8 @@ struct testgroup_t testgroups[] = {
 	{ "rpc/", rpc_testcases },
 	{ "thread/", thread_testcases },
 	{ "listener/", listener_testcases },
+	{ "dgram/", dgram_testcases },
+	{ "uring/bufferevent/", bufferevent_uring_testcases },
 #ifdef _WIN32
 	{ "iocp/", iocp_testcases },
 	{ "iocp/bufferevent/", bufferevent_iocp_testcases },
@@ -44,10 +44,14 @@ static void
 check_heap(struct min_heap *heap)
 {
 	unsigned i;
-	for (i = 1; i < heap->n; ++i) {
-		unsigned parent_idx = (i-1)/2;
-		tt_want(evutil_timercmp(&heap->p[i]->ev_timeout,
-			&heap->p[parent_idx]->ev_timeout, >=));
+	for (i = 0; i < heap->n; ++i) {
+		tt_want(heap->p[i].ev->ev_timeout_pos.min_heap_idx == (int)i);
+		tt_want(heap->p[i].deadline == min_heap_deadline_(heap->p[i].ev));
+		if (i) {
+			unsigned parent_idx = MIN_HEAP_PARENT(i);
+			tt_want(evutil_timercmp(&heap->p[i].ev->ev_timeout,
+				&heap->p[parent_idx].ev->ev_timeout, >=));
+		}
 	}
 }
 
@@ -76,6 +80,18 @@ test_heap_randomized(void *ptr)
 			check_heap(&heap);
 	}
 	tt_assert(min_heap_size_(&heap) == 512);
+	/* Siblings share a cache line. */
+	tt_int_op(((ev_uintptr_t)&heap.p[1]) % MIN_HEAP_CACHE_LINE, ==, 0);
+
+	/* Change some timeouts in place. */
+	for (i = 512; i < 1024; i += 7) {
+		int idx = inserted[i]->ev_timeout_pos.min_heap_idx;
+		set_random_timeout(inserted[i]);
+		inserted[i]->ev_timeout_pos.min_heap_idx = idx;
+		min_heap_adjust_(&heap, inserted[i]);
+	}
+	check_heap(&heap);
+	tt_assert(min_heap_size_(&heap) == 512);
 
 	last_e = min_heap_pop_(&heap);
 	while (1) {
@@ -57,6 +57,7 @@
 #include "event2/event.h"
 #include "event2/event_struct.h"
 #include "event2/thread.h"
+#include "event2/listener.h"
 #include "event2/util.h"
 #include "evthread-internal.h"
 #include "event-internal.h"
@@ -564,6 +565,425 @@ end:
 	;
 }
 
+#if defined(EVTHREAD_USE_PTHREADS_IMPLEMENTED) && defined(__linux__)
+struct base_group_info {
+	pthread_mutex_t lock;
+	struct event_base_group *grp;
+	int accepted[2];
+	int wrong_thread;
+};
+
+static void
+base_group_acceptcb(struct evconnlistener *listener, evutil_socket_t fd,
+    struct sockaddr *addr, int socklen, void *arg)
+{
+	struct base_group_info *info = arg;
+	struct event_base *base = evconnlistener_get_base(listener);
+	int i;
+
+	evutil_closesocket(fd);
+	pthread_mutex_lock(&info->lock);
+	for (i = 0; i < 2; ++i) {
+		if (event_base_group_get_base(info->grp, i) == base)
+			++info->accepted[i];
+	}
+	if (!EVBASE_IN_THREAD(base))
+		++info->wrong_thread;
+	pthread_mutex_unlock(&info->lock);
+}
+
+static void
+thread_base_group(void *arg)
+{
+	struct base_group_info info;
+	struct evconnlistener_group *lg = NULL;
+	struct sockaddr_in sin;
+	struct sockaddr_storage ss1, ss2;
+	ev_socklen_t slen1 = sizeof(ss1), slen2 = sizeof(ss2);
+	evutil_socket_t fds[20];
+	int i, total = 0;
+
+	memset(&info, 0, sizeof(info));
+	pthread_mutex_init(&info.lock, NULL);
+	for (i = 0; i < 20; ++i)
+		fds[i] = EVUTIL_INVALID_SOCKET;
+
+	info.grp = event_base_group_new(NULL, 2, 0);
+	tt_assert(info.grp);
+	tt_int_op(event_base_group_get_n_bases(info.grp), ==, 2);
+	tt_assert(event_base_group_get_base(info.grp, 0) !=
+	    event_base_group_get_base(info.grp, 1));
+	tt_ptr_op(event_base_group_get_base(info.grp, 2), ==, NULL);
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(0x7f000001); /* 127.0.0.1 */
+	sin.sin_port = 0; /* "You pick!" */
+
+	lg = evconnlistener_group_new_bind(
+	    event_base_group_get_bases(info.grp), 2, base_group_acceptcb,
+	    &info, LEV_OPT_CLOSE_ON_FREE|LEV_OPT_REUSEABLE, -1,
+	    (struct sockaddr *)&sin, sizeof(sin));
+	tt_assert(lg);
+	tt_int_op(evconnlistener_group_get_n_listeners(lg), ==, 2);
+
+	/* Both sockets share the port that was picked for the first. */
+	tt_assert(getsockname(evconnlistener_get_fd(
+		evconnlistener_group_get_listener(lg, 0)),
+		(struct sockaddr*)&ss1, &slen1) == 0);
+	tt_assert(getsockname(evconnlistener_get_fd(
+		evconnlistener_group_get_listener(lg, 1)),
+		(struct sockaddr*)&ss2, &slen2) == 0);
+	tt_int_op(((struct sockaddr_in*)&ss1)->sin_port, ==,
+	    ((struct sockaddr_in*)&ss2)->sin_port);
+
+	for (i = 0; i < 20; ++i)
+		evutil_socket_connect_(&fds[i], (struct sockaddr*)&ss1, slen1);
+
+	for (i = 0; i < 500 && total < 20; ++i) {
+		SLEEP_MS(10);
+		pthread_mutex_lock(&info.lock);
+		total = info.accepted[0] + info.accepted[1];
+		pthread_mutex_unlock(&info.lock);
+	}
+	tt_int_op(total, ==, 20);
+	TT_BLATHER(("%d and %d accepted", info.accepted[0], info.accepted[1]));
+	/* The kernel spreads the connections by address hash, so both bases
+	 * should have had a share. */
+	tt_int_op(info.accepted[0], >, 0);
+	tt_int_op(info.accepted[1], >, 0);
+	tt_int_op(info.wrong_thread, ==, 0);
+
+end:
+	if (lg)
+		evconnlistener_group_free(lg);
+	for (i = 0; i < 20; ++i) {
+		if (fds[i] != EVUTIL_INVALID_SOCKET)
+			evutil_closesocket(fds[i]);
+	}
+	if (info.grp)
+		event_base_group_free(info.grp);
+	pthread_mutex_destroy(&info.lock);
+}
+#endif
+
+#ifdef EVENT_HAVE_ACTIVATION_QUEUE_
+#define AQ_THREADS 8
+#define AQ_ONCES 1000
+
+static struct activation_queue_info {
+	struct event_base *base;
+	struct event *ev;
+	int next_seq[AQ_THREADS];
+	int n_once;
+	int n_active;
+	int out_of_order;
+} aq_info;
+
+static void
+aq_once_cb(evutil_socket_t fd, short what, void *arg)
+{
+	int id = (int)((ev_intptr_t)arg / AQ_ONCES);
+	int seq = (int)((ev_intptr_t)arg % AQ_ONCES);
+
+	if (seq != aq_info.next_seq[id])
+		++aq_info.out_of_order;
+	aq_info.next_seq[id] = seq + 1;
+	if (++aq_info.n_once == AQ_THREADS * AQ_ONCES)
+		event_base_loopbreak(aq_info.base);
+}
+
+static void
+aq_active_cb(evutil_socket_t fd, short what, void *arg)
+{
+	++aq_info.n_active;
+}
+
+static THREAD_FN
+aq_producer(void *arg)
+{
+	ev_intptr_t id = (ev_intptr_t)arg;
+	int seq;
+
+	for (seq = 0; seq < AQ_ONCES; ++seq) {
+		event_base_once(aq_info.base, -1, EV_TIMEOUT, aq_once_cb,
+		    (void *)(id * AQ_ONCES + seq), NULL);
+		if (seq % 100 == 0)
+			event_active(aq_info.ev, EV_READ, 1);
+	}
+	THREAD_RETURN();
+}
+
+static void
+thread_activation_queue(void *arg)
+{
+	struct event_config *cfg = NULL;
+	THREAD_T threads[AQ_THREADS];
+	struct timeval tv = { 10, 0 };
+	ev_intptr_t i;
+
+	memset(&aq_info, 0, sizeof(aq_info));
+	cfg = event_config_new();
+	tt_assert(cfg);
+	event_config_set_flag(cfg, EVENT_BASE_FLAG_ACTIVATION_QUEUE);
+	aq_info.base = event_base_new_with_config(cfg);
+	tt_assert(aq_info.base);
+	aq_info.ev = event_new(aq_info.base, -1, 0, aq_active_cb, NULL);
+	tt_assert(aq_info.ev);
+
+	/* Hold the base lock while the producers run: activating through
+	 * the queue must never need it. */
+	EVBASE_ACQUIRE_LOCK(aq_info.base, th_base_lock);
+	for (i = 0; i < AQ_THREADS; ++i)
+		THREAD_START(threads[i], aq_producer, (void *)i);
+	for (i = 0; i < AQ_THREADS; ++i)
+		THREAD_JOIN(threads[i]);
+	EVBASE_RELEASE_LOCK(aq_info.base, th_base_lock);
+	tt_int_op(aq_info.n_once, ==, 0);
+
+	event_base_loopexit(aq_info.base, &tv);
+	event_base_dispatch(aq_info.base);
+
+	tt_int_op(aq_info.n_once, ==, AQ_THREADS * AQ_ONCES);
+	tt_int_op(aq_info.out_of_order, ==, 0);
+	/* All the event_active() calls were queued before the loop ran, so
+	 * they were merged into one activation. */
+	tt_int_op(aq_info.n_active, ==, 1);
+
+	/* Activations that nobody has drained yet are visible to
+	 * event_pending(), and are dropped by event_del(). */
+	THREAD_START(threads[0], aq_producer, (void *)0);
+	THREAD_JOIN(threads[0]);
+	tt_assert(event_pending(aq_info.ev, EV_READ, NULL));
+	event_del(aq_info.ev);
+	tt_assert(!event_pending(aq_info.ev, EV_READ, NULL));
+
+end:
+	if (aq_info.ev)
+		event_free(aq_info.ev);
+	if (aq_info.base)
+		event_base_free(aq_info.base);
+	if (cfg)
+		event_config_free(cfg);
+}
+#endif
+
+#define CHAN_MSGS 100000
+#define CHAN_CHUNK 16
+
+static struct channel_info {
+	struct event_base *base;
+	struct event_base *sender_base;
+	struct event_channel *chan;
+	int n_sent;
+	int n_recv;
+	int n_batches;
+	int n_space;
+	int out_of_order;
+	int wrong_thread;
+} chan_info;
+
+static void
+chan_recv_cb(struct event_channel *chan, void **msgs, int n_msgs, void *arg)
+{
+	int i;
+
+	if (!EVBASE_IN_THREAD(chan_info.base))
+		++chan_info.wrong_thread;
+	for (i = 0; i < n_msgs; ++i) {
+		if ((ev_intptr_t)msgs[i] != chan_info.n_recv + i)
+			++chan_info.out_of_order;
+	}
+	chan_info.n_recv += n_msgs;
+	++chan_info.n_batches;
+	if (chan_info.n_recv == CHAN_MSGS)
+		event_base_loopbreak(chan_info.base);
+}
+
+/* Send until we are done or the channel is full. */
+static void
+chan_send_more(struct event_channel *chan, void *arg)
+{
+	void *msgs[CHAN_CHUNK];
+	int i, n, sent;
+
+	if (arg)
+		++chan_info.n_space;
+	if (!EVBASE_IN_THREAD(chan_info.sender_base))
+		++chan_info.wrong_thread;
+	while (chan_info.n_sent < CHAN_MSGS) {
+		n = CHAN_MSGS - chan_info.n_sent;
+		if (n > CHAN_CHUNK)
+			n = CHAN_CHUNK;
+		for (i = 0; i < n; ++i)
+			msgs[i] = (void *)(ev_intptr_t)(chan_info.n_sent + i);
+		sent = event_channel_send_batch(chan, msgs, n);
+		chan_info.n_sent += sent;
+		if (sent < n)
+			return;
+	}
+	event_base_loopbreak(chan_info.sender_base);
+}
+
+static void
+chan_start_cb(evutil_socket_t fd, short what, void *arg)
+{
+	chan_send_more(chan_info.chan, NULL);
+}
+
+static THREAD_FN
+chan_sender(void *arg)
+{
+	/* An event that is only ever activated doesn't keep the loop
+	 * running, so give it a timer to wait on for the space callbacks. */
+	struct timeval tv = { 10, 0 };
+	event_base_loopexit(chan_info.sender_base, &tv);
+	event_base_dispatch(chan_info.sender_base);
+	THREAD_RETURN();
+}
+
+static void
+thread_channel(void *arg)
+{
+	struct basic_test_data *data = arg;
+	THREAD_T thread;
+	struct timeval tv = { 10, 0 };
+	void *msgs[5];
+	int i;
+
+	memset(&chan_info, 0, sizeof(chan_info));
+	chan_info.base = data->base;
+
+	/* Without a sending base, a full channel just says no. */
+	chan_info.chan = event_channel_new(data->base, 3, chan_recv_cb, NULL);
+	tt_assert(chan_info.chan);
+	for (i = 0; i < 5; ++i)
+		msgs[i] = (void *)(ev_intptr_t)i;
+	tt_int_op(event_channel_send_batch(chan_info.chan, msgs, 5), ==, 4);
+	tt_int_op(event_channel_send(chan_info.chan, msgs[4]), ==, -1);
+	event_base_loop(data->base, EVLOOP_ONCE|EVLOOP_NONBLOCK);
+	tt_int_op(chan_info.n_recv, ==, 4);
+	tt_int_op(chan_info.n_batches, ==, 1);
+	tt_int_op(event_channel_send(chan_info.chan, msgs[4]), ==, 0);
+	event_base_loop(data->base, EVLOOP_ONCE|EVLOOP_NONBLOCK);
+	tt_int_op(chan_info.n_recv, ==, 5);
+	tt_int_op(chan_info.out_of_order, ==, 0);
+	event_channel_free(chan_info.chan);
+
+	/* Now from a sending thread that has to wait for space. */
+	memset(&chan_info, 0, sizeof(chan_info));
+	chan_info.base = data->base;
+	chan_info.sender_base = event_base_new();
+	tt_assert(chan_info.sender_base);
+	chan_info.chan = event_channel_new(data->base, 64, chan_recv_cb, NULL);
+	tt_assert(chan_info.chan);
+	tt_int_op(event_channel_set_space_cb(chan_info.chan,
+		chan_info.sender_base, chan_send_more, &chan_info), ==, 0);
+	tt_int_op(event_base_once(chan_info.sender_base, -1, EV_TIMEOUT,
+		chan_start_cb, NULL, NULL), ==, 0);
+
+	THREAD_START(thread, chan_sender, NULL);
+	event_base_loopexit(data->base, &tv);
+	event_base_dispatch(data->base);
+	THREAD_JOIN(thread);
+
+	TT_BLATHER(("%d messages in %d batches, %d space callbacks",
+		chan_info.n_recv, chan_info.n_batches, chan_info.n_space));
+	tt_int_op(chan_info.n_sent, ==, CHAN_MSGS);
+	tt_int_op(chan_info.n_recv, ==, CHAN_MSGS);
+	tt_int_op(chan_info.out_of_order, ==, 0);
+	tt_int_op(chan_info.wrong_thread, ==, 0);
+	tt_int_op(chan_info.n_batches, <, CHAN_MSGS);
+
+end:
+	if (chan_info.chan)
+		event_channel_free(chan_info.chan);
+	if (chan_info.sender_base)
+		event_base_free(chan_info.sender_base);
+}
+
+#if defined(EVTHREAD_USE_PTHREADS_IMPLEMENTED)
+#define POOL_THREADS 4
+#define POOL_TASKS 200
+
+static struct pool_info {
+	struct event_base *base;
+	pthread_t workers[POOL_TASKS];
+	int n_done;
+	int wrong_thread;
+} pool_info;
+
+static void
+pool_work_cb(void *arg)
+{
+	int i = (int)(ev_intptr_t)arg;
+	pool_info.workers[i] = pthread_self();
+	/* Long enough that one worker can't drain the queue by itself. */
+	SLEEP_MS(1);
+}
+
+static void
+pool_done_cb(void *arg)
+{
+	if (!EVBASE_IN_THREAD(pool_info.base))
+		++pool_info.wrong_thread;
+	++pool_info.n_done;
+}
+
+static void
+pool_submit_cb(evutil_socket_t fd, short what, void *arg)
+{
+	struct evthread_pool *pool = arg;
+	ev_intptr_t i;
+
+	/* Everything comes from one thread, and so goes onto one worker's
+	 * queue; the rest of the workers have to steal. */
+	for (i = 0; i < POOL_TASKS; ++i)
+		evthread_pool_submit(pool, pool_info.base, pool_work_cb,
+		    pool_done_cb, (void *)i);
+}
+
+static void
+thread_pool(void *arg)
+{
+	struct basic_test_data *data = arg;
+	struct evthread_pool *pool;
+	int i, j, n_workers = 0;
+
+	memset(&pool_info, 0, sizeof(pool_info));
+	pool_info.base = data->base;
+	pool = evthread_pool_new(POOL_THREADS);
+	tt_assert(pool);
+	tt_int_op(evthread_pool_get_n_threads(pool), ==, POOL_THREADS);
+	tt_int_op(evthread_pool_submit(pool, NULL, pool_work_cb, NULL, NULL),
+	    ==, -1);
+
+	event_base_once(data->base, -1, EV_TIMEOUT, pool_submit_cb, pool,
+	    NULL);
+	/* The tasks in flight keep the loop running until they are done. */
+	event_base_dispatch(data->base);
+	tt_int_op(pool_info.n_done, ==, POOL_TASKS);
+	tt_int_op(pool_info.wrong_thread, ==, 0);
+
+	for (i = 0; i < POOL_TASKS; ++i) {
+		for (j = 0; j < i; ++j) {
+			if (pthread_equal(pool_info.workers[i],
+				pool_info.workers[j]))
+				break;
+		}
+		if (j == i)
+			++n_workers;
+	}
+	TT_BLATHER(("%d tasks ran on %d workers", POOL_TASKS, n_workers));
+	tt_int_op(n_workers, >, 1);
+	tt_int_op(n_workers, <=, POOL_THREADS);
+
+end:
+	if (pool)
+		evthread_pool_free(pool);
+}
+#endif
+
 #define TEST(name, f)							\
 	{ #name, thread_##name, TT_FORK|TT_NEED_THREADS|TT_NEED_BASE|(f),	\
 	  &basic_setup, NULL }
@@ -584,6 +1004,18 @@ struct testcase_t thread_testcases[] = {
 	 * looking into it now. / ellzey
 	 ******/
 	TEST(no_events, TT_RETRIABLE),
+#endif
+#if defined(EVTHREAD_USE_PTHREADS_IMPLEMENTED) && defined(__linux__)
+	{ "base_group", thread_base_group, TT_FORK|TT_NEED_THREADS,
+	  &basic_setup, NULL },
+#endif
+#ifdef EVENT_HAVE_ACTIVATION_QUEUE_
+	{ "activation_queue", thread_activation_queue,
+	  TT_FORK|TT_NEED_THREADS, &basic_setup, NULL },
+#endif
+	TEST(channel, 0),
+#if defined(EVTHREAD_USE_PTHREADS_IMPLEMENTED)
+	TEST(pool, 0),
 #endif
 	END_OF_TESTCASES
 };
@@ -1536,6 +1536,59 @@ end:
 	;
 }
 
+static const char *
+naive_memmem(const char *hay, size_t hlen, const char *needle, size_t nlen)
+{
+	size_t i;
+	for (i = 0; i + nlen <= hlen; ++i) {
+		if (!memcmp(hay + i, needle, nlen))
+			return hay + i;
+	}
+	return NULL;
+}
+
+static void
+test_evutil_memscan(void *arg)
+{
+	struct evutil_weakrand_state seed = { 4242U };
+	int orig_level = evutil_memscan_get_impl_();
+	int level, trial;
+	char buf[320], needle[8];
+
+	for (level = EVUTIL_MEMSCAN_SCALAR; level <= EVUTIL_MEMSCAN_AVX2;
+	     ++level) {
+		if (evutil_memscan_set_impl_(level) < 0) {
+			TT_BLATHER(("memscan level %d not available", level));
+			continue;
+		}
+		tt_int_op(evutil_memscan_get_impl_(), ==, level);
+		for (trial = 0; trial < 2000; ++trial) {
+			size_t off = evutil_weakrand_range_(&seed, 40);
+			size_t len = evutil_weakrand_range_(&seed, 260);
+			size_t nlen = 1 + evutil_weakrand_range_(&seed, 7);
+			size_t i;
+
+			/* Only 'a' and 'b', so that the needle has lots of
+			 * near misses. */
+			for (i = 0; i < sizeof(buf); ++i)
+				buf[i] = (evutil_weakrand_(&seed) & 1) ?
+				    'a' : 'b';
+			for (i = 0; i < nlen; ++i)
+				needle[i] = (evutil_weakrand_(&seed) & 1) ?
+				    'a' : 'b';
+			tt_ptr_op(evutil_memmem_(buf + off, len, needle, nlen),
+			    ==, naive_memmem(buf + off, len, needle, nlen));
+		}
+		/* A needle as long as the haystack, and one longer. */
+		memset(buf, 'a', 64);
+		tt_ptr_op(evutil_memmem_(buf, 64, buf, 64), ==, buf);
+		tt_ptr_op(evutil_memmem_(buf, 63, buf, 64), ==, NULL);
+	}
+
+end:
+	evutil_memscan_set_impl_(orig_level);
+}
+
 struct testcase_t util_testcases[] = {
 	{ "ipv4_parse", regress_ipv4_parse, 0, NULL, NULL },
 	{ "ipv6_parse", regress_ipv6_parse, 0, NULL, NULL },
@@ -1569,6 +1622,7 @@ struct testcase_t util_testcases[] = {
 	{ "date_rfc1123", test_evutil_date_rfc1123, 0, NULL, NULL },
 	{ "evutil_v4addr_is_local", test_evutil_v4addr_is_local, 0, NULL, NULL },
 	{ "evutil_v6addr_is_local", test_evutil_v6addr_is_local, 0, NULL, NULL },
+	{ "memscan", test_evutil_memscan, 0, NULL, NULL },
 	END_OF_TESTCASES,
 };
 
@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2007-2012 Niels Provos and Nick Mathewson
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef TIMERWHEEL_INTERNAL_H_INCLUDED_
+#define TIMERWHEEL_INTERNAL_H_INCLUDED_
+
+#include "event2/event-config.h"
+#include "evconfig-private.h"
+#include "event2/event.h"
+#include "event2/event_struct.h"
+#include "event2/util.h"
+#include "util-internal.h"
+
+#include <string.h>
+
+/* A hierarchical timing wheel.
+ *
+ * Time is counted in ticks of one millisecond.  The wheel has
+ * TIMER_WHEEL_LEVELS levels of TIMER_WHEEL_SLOTS slots each; a slot on
+ * level L covers 256^L ticks.  An event whose timeout falls on tick 't'
+ * goes on the lowest level L at which 't' and the current tick agree in
+ * every byte above byte L, in the slot given by byte L of 't'.  When the
+ * current tick reaches the start of a slot on a higher level, the events
+ * in that slot are "cascaded" down to the levels below.
+ *
+ * Adding and removing an event are O(1), and no memory is allocated.  In
+ * exchange, an event fires on the first tick boundary at or after its
+ * timeout, and events that fall in the same tick fire in the order they
+ * were added.
+ *
+ * Timeouts that are too far away for the wheel (about 49 days) are refused
+ * by timer_wheel_push_(), and must be stored somewhere else.
+ */
+
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_BITS 8
+#define TIMER_WHEEL_SLOTS (1<<TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS-1)
+
+typedef struct timer_wheel
+{
+	/* The next tick that has not been expired yet. */
+	ev_uint64_t cur;
+	/* The number of events in the wheel. */
+	unsigned n;
+	/* One bit per non-empty slot. */
+	ev_uint64_t occupied[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS/64];
+	/* Events waiting in each slot, linked through
+	 * ev_timeout_pos.ev_next_with_common_timeout. */
+	struct event_list slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+} timer_wheel_t;
+
+static inline void	     timer_wheel_ctor_(timer_wheel_t *w, const struct timeval *now);
+static inline ev_uint64_t    timer_wheel_tick_floor_(const struct timeval *tv);
+static inline ev_uint64_t    timer_wheel_tick_ceil_(const struct timeval *tv);
+static inline void	     timer_wheel_tick_to_tv_(ev_uint64_t tick, struct timeval *tv);
+static inline int	     timer_wheel_push_(timer_wheel_t *w, struct event *e, const struct timeval *now);
+static inline void	     timer_wheel_erase_(timer_wheel_t *w, struct event *e);
+static inline int	     timer_wheel_next_(timer_wheel_t *w, ev_uint64_t *tick);
+static inline struct event  *timer_wheel_expired_(timer_wheel_t *w, ev_uint64_t now);
+static inline struct event_list *timer_wheel_slot_(timer_wheel_t *w, ev_uint64_t t, int *level, int *slot);
+static inline void	     timer_wheel_insert_(timer_wheel_t *w, struct event *e);
+static inline int	     timer_wheel_find_(const ev_uint64_t *bits, int start);
+static inline void	     timer_wheel_cascade_(timer_wheel_t *w);
+
+void timer_wheel_ctor_(timer_wheel_t *w, const struct timeval *now)
+{
+	int i, j;
+	w->cur = timer_wheel_tick_floor_(now);
+	w->n = 0;
+	memset(w->occupied, 0, sizeof(w->occupied));
+	for (i = 0; i < TIMER_WHEEL_LEVELS; ++i)
+		for (j = 0; j < TIMER_WHEEL_SLOTS; ++j)
+			TAILQ_INIT(&w->slots[i][j]);
+}
+
+ev_uint64_t timer_wheel_tick_floor_(const struct timeval *tv)
+{
+	return ((ev_uint64_t)tv->tv_sec) * 1000 + tv->tv_usec / 1000;
+}
+
+/* Round up, so that an event never fires before its timeout. */
+ev_uint64_t timer_wheel_tick_ceil_(const struct timeval *tv)
+{
+	return ((ev_uint64_t)tv->tv_sec) * 1000 + (tv->tv_usec + 999) / 1000;
+}
+
+void timer_wheel_tick_to_tv_(ev_uint64_t tick, struct timeval *tv)
+{
+	tv->tv_sec = (time_t)(tick / 1000);
+	tv->tv_usec = (long)(tick % 1000) * 1000;
+}
+
+/* Return the list that an event expiring on tick 't' belongs in, given the
+ * current tick.  Since the wheel cascades a slot as soon as the current
+ * tick enters it, this is the same list for as long as the event is in the
+ * wheel. */
+struct event_list *timer_wheel_slot_(timer_wheel_t *w, ev_uint64_t t,
+    int *level, int *slot)
+{
+	int l = 0;
+	if (t < w->cur)
+		t = w->cur;
+	while (l < TIMER_WHEEL_LEVELS - 1 &&
+	    (t >> ((l+1)*TIMER_WHEEL_BITS)) != (w->cur >> ((l+1)*TIMER_WHEEL_BITS)))
+		++l;
+	*level = l;
+	*slot = (int)((t >> (l*TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK);
+	return &w->slots[l][*slot];
+}
+
+void timer_wheel_insert_(timer_wheel_t *w, struct event *e)
+{
+	int level, slot;
+	struct event_list *list = timer_wheel_slot_(w,
+	    timer_wheel_tick_ceil_(&e->ev_timeout), &level, &slot);
+	TAILQ_INSERT_TAIL(list, e, ev_timeout_pos.ev_next_with_common_timeout);
+	w->occupied[level][slot/64] |= ((ev_uint64_t)1) << (slot%64);
+}
+
+/* Add 'e' to the wheel.  Return -1 if its timeout is too far away. */
+int timer_wheel_push_(timer_wheel_t *w, struct event *e,
+    const struct timeval *now)
+{
+	int shift = TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS;
+	ev_uint64_t t = timer_wheel_tick_ceil_(&e->ev_timeout);
+	/* Nothing is waiting, so there is no reason to walk the wheel forward
+	 * from wherever we last left it. */
+	if (!w->n)
+		w->cur = timer_wheel_tick_floor_(now);
+	if (t > w->cur && (t >> shift) != (w->cur >> shift))
+		return -1;
+	timer_wheel_insert_(w, e);
+	++w->n;
+	return 0;
+}
+
+void timer_wheel_erase_(timer_wheel_t *w, struct event *e)
+{
+	int level, slot;
+	struct event_list *list = timer_wheel_slot_(w,
+	    timer_wheel_tick_ceil_(&e->ev_timeout), &level, &slot);
+	TAILQ_REMOVE(list, e, ev_timeout_pos.ev_next_with_common_timeout);
+	if (TAILQ_EMPTY(list))
+		w->occupied[level][slot/64] &= ~(((ev_uint64_t)1) << (slot%64));
+	--w->n;
+}
+
+/* Return the index of the first non-empty slot at or after 'start' in the
+ * bitmap 'bits', or -1 if there is none. */
+int timer_wheel_find_(const ev_uint64_t *bits, int start)
+{
+	int i;
+	for (i = start / 64; i < TIMER_WHEEL_SLOTS / 64; ++i) {
+		ev_uint64_t word = bits[i];
+		if (i == start / 64)
+			word &= ~((((ev_uint64_t)1) << (start%64)) - 1);
+		if (word) {
+#if defined(__GNUC__)
+			return i*64 + __builtin_ctzll(word);
+#else
+			int b = 0;
+			while (!(word & 1)) {
+				word >>= 1;
+				++b;
+			}
+			return i*64 + b;
+#endif
+		}
+	}
+	return -1;
+}
+
+/* Set *tick to the next tick at which the wheel has work to do: either
+ * events to expire, or a slot to cascade.  Return 0 if the wheel is
+ * empty. */
+int timer_wheel_next_(timer_wheel_t *w, ev_uint64_t *tick)
+{
+	int l, idx;
+	if (!w->n)
+		return 0;
+	for (l = 0; l < TIMER_WHEEL_LEVELS; ++l) {
+		int shift = l * TIMER_WHEEL_BITS;
+		int start = (int)((w->cur >> shift) & TIMER_WHEEL_MASK);
+		/* Slots on the upper levels that the current tick is already
+		 * in have been cascaded. */
+		idx = timer_wheel_find_(w->occupied[l], l ? start + 1 : start);
+		if (idx >= 0) {
+			ev_uint64_t base =
+			    (w->cur >> (shift + TIMER_WHEEL_BITS)) <<
+			    (shift + TIMER_WHEEL_BITS);
+			*tick = base + (((ev_uint64_t)idx) << shift);
+			if (*tick < w->cur)
+				*tick = w->cur;
+			return 1;
+		}
+	}
+	/* unreachable as long as w->n is accurate */
+	*tick = w->cur;
+	return 1;
+}
+
+/* Move the events in every upper-level slot that starts at the current
+ * tick down to the levels below. */
+void timer_wheel_cascade_(timer_wheel_t *w)
+{
+	int l;
+	for (l = TIMER_WHEEL_LEVELS - 1; l > 0; --l) {
+		int shift = l * TIMER_WHEEL_BITS;
+		int slot;
+		struct event_list *list;
+		struct event *e;
+		if (w->cur & ((((ev_uint64_t)1) << shift) - 1))
+			continue;
+		slot = (int)((w->cur >> shift) & TIMER_WHEEL_MASK);
+		if (!(w->occupied[l][slot/64] & (((ev_uint64_t)1) << (slot%64))))
+			continue;
+		w->occupied[l][slot/64] &= ~(((ev_uint64_t)1) << (slot%64));
+		list = &w->slots[l][slot];
+		while ((e = TAILQ_FIRST(list))) {
+			TAILQ_REMOVE(list, e,
+			    ev_timeout_pos.ev_next_with_common_timeout);
+			timer_wheel_insert_(w, e);
+		}
+	}
+}
+
+/* Advance the wheel up to tick 'now', and return the first event whose
+ * tick has come, or NULL if there are no more.  The event is left in the
+ * wheel: the caller must remove it with timer_wheel_erase_() before
+ * calling this function again. */
+struct event *timer_wheel_expired_(timer_wheel_t *w, ev_uint64_t now)
+{
+	while (w->n && w->cur <= now) {
+		int idx = (int)(w->cur & TIMER_WHEEL_MASK);
+		struct event *e = TAILQ_FIRST(&w->slots[0][idx]);
+		ev_uint64_t next;
+		if (e)
+			return e;
+		/* Skip ahead to the next non-empty slot, but never past the
+		 * end of this lap of the lowest level, since the upper levels
+		 * need to cascade there. */
+		idx = timer_wheel_find_(w->occupied[0], idx);
+		if (idx >= 0)
+			next = (w->cur & ~((ev_uint64_t)TIMER_WHEEL_MASK)) + idx;
+		else
+			next = (w->cur | TIMER_WHEEL_MASK) + 1;
+		if (next > now + 1)
+			next = now + 1;
+		w->cur = next;
+		if (!(w->cur & TIMER_WHEEL_MASK))
+			timer_wheel_cascade_(w);
+	}
+	return NULL;
+}
+
+#endif /* TIMERWHEEL_INTERNAL_H_INCLUDED_ */
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2007-2012 Niels Provos and Nick Mathewson
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef URING_INTERNAL_H_INCLUDED_
+#define URING_INTERNAL_H_INCLUDED_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "event2/event-config.h"
+#include "evconfig-private.h"
+
+/* This whole file is only meaningful when the io_uring backend is built. */
+#ifdef EVENT__HAVE_IO_URING
+
+#include "event2/event_struct.h"
+#include "event2/buffer.h"
+
+struct event_base;
+struct event_uring_op;
+typedef void (*uring_callback)(struct event_uring_op *, int res);
+
+/**
+   Internal use only.  An IO operation submitted to the io_uring of an
+   event_base that is using the io_uring backend.
+
+   When the kernel reports the operation as complete, the result it gave
+   (a byte count, a poll mask, or a negative errno value) is passed to the
+   uring_callback from the event loop, just like any other active callback.
+   An event_uring_op may only have one operation in flight at a time.
+ */
+struct event_uring_op {
+	/** Activated when the operation completes. */
+	struct event_callback cb;
+	/** The function to invoke with the result of the operation. */
+	uring_callback complete;
+	/** The result reported by the kernel for the last operation. */
+	int res;
+};
+
+/** Initialize the fields in an event_uring_op.
+
+    @param base The event_base that the operation will be submitted to.
+    @param op The struct event_uring_op to initialize
+    @param cb The callback that should be invoked once the IO operation has
+	finished.
+ */
+void event_uring_op_init_(struct event_base *base, struct event_uring_op *op,
+    uring_callback cb);
+
+/** Return true iff 'base' is using the io_uring backend, and was configured
+    with EVENT_BASE_FLAG_IO_URING_COMPLETION, so that completion-based IO
+    may be submitted to it. */
+int event_base_uring_completion_enabled_(struct event_base *base);
+
+/** Submit a readv() of 'fd' into the 'n_vecs' buffers of 'vecs' to the
+    io_uring of 'base'.  The vectors and the memory they point to must
+    remain valid until the operation completes.  Return 0 on success, -1
+    on failure. */
+int event_uring_readv_(struct event_base *base, evutil_socket_t fd,
+    struct evbuffer_iovec *vecs, int n_vecs, struct event_uring_op *op);
+
+/** As event_uring_readv_, but write the buffers to 'fd' with writev(). */
+int event_uring_writev_(struct event_base *base, evutil_socket_t fd,
+    struct evbuffer_iovec *vecs, int n_vecs, struct event_uring_op *op);
+
+/** Submit a one-shot wait for 'fd' to become readable or writable, as given
+    by the EV_READ and EV_WRITE bits of 'what'.  The result passed to the
+    callback is a poll(2) revents mask. */
+int event_uring_poll_(struct event_base *base, evutil_socket_t fd,
+    short what, struct event_uring_op *op);
+
+/** Ask the kernel to cancel the operation in flight on 'op', if any.  The
+    operation still completes, usually with a result of -ECANCELED. */
+int event_uring_cancel_(struct event_base *base, struct event_uring_op *op);
+
+struct bufferevent;
+/** Create a new bufferevent that does its IO through the io_uring of 'base'.
+    Returns NULL if 'base' can't do completion-based IO. */
+struct bufferevent *bufferevent_uring_new_(struct event_base *base,
+    evutil_socket_t fd, int options);
+/** Tell an io_uring bufferevent that its nonblocking connect() has
+    finished, so that it can start reading and writing. */
+void bufferevent_uring_set_connected_(struct bufferevent *bev);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -310,6 +310,25 @@ int evutil_resolve_(int family, const char *hostname, struct sockaddr *sa,
 
 const char *evutil_getenv_(const char *name);
 
+/* Levels of the substring search in evutil_memscan.c. */
+#define EVUTIL_MEMSCAN_SCALAR 0
+#define EVUTIL_MEMSCAN_SSE2 1
+#define EVUTIL_MEMSCAN_AVX2 2
+
+/** Return a pointer to the first copy of the nlen bytes at needle that lies
+ * entirely within the hlen bytes at hay, or NULL if there is none. */
+EVENT2_EXPORT_SYMBOL
+const char *evutil_memmem_(const char *hay, size_t hlen,
+    const char *needle, size_t nlen);
+/** Force the substring search to one of the EVUTIL_MEMSCAN_* levels.
+ * Return 0 on success, -1 if this build or this CPU can't run that level.
+ * Used by the tests and benchmarks. */
+EVENT2_EXPORT_SYMBOL
+int evutil_memscan_set_impl_(int level);
+/** Return the EVUTIL_MEMSCAN_* level in use. */
+EVENT2_EXPORT_SYMBOL
+int evutil_memscan_get_impl_(void);
+
 /* Structure to hold the state of our weak random number generator.
  */
 struct evutil_weakrand_state {